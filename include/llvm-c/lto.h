@@ -40,7 +40,7 @@ typedef bool lto_bool_t;
  * @{
  */
 
-#define LTO_API_VERSION 17
+#define LTO_API_VERSION 19
 
 /**
  * \since prior to LTO_API_VERSION=3
@@ -548,6 +548,132 @@ extern void
 lto_codegen_set_should_embed_uselists(lto_code_gen_t cg,
                                       lto_bool_t ShouldEmbedUselists);
 
+/**
+ * Opaque reference to a ThinLTO code generator, which runs function import,
+ * optimization and code generation for a set of modules in process.
+ *
+ * \since LTO_API_VERSION=18
+ */
+typedef struct LLVMOpaqueThinLTOCodeGenerator *thinlto_code_gen_t;
+
+/**
+ * Type to wrap a single object returned by ThinLTO.
+ *
+ * \since LTO_API_VERSION=18
+ */
+typedef struct {
+  const char *Buffer;
+  size_t Size;
+} LTOObjectBuffer;
+
+/**
+ * Instantiates a ThinLTO code generator.
+ * Returns NULL on error (check lto_get_error_message() for details).
+ *
+ * \since LTO_API_VERSION=18
+ */
+extern thinlto_code_gen_t thinlto_create_codegen(void);
+
+/**
+ * Frees the generator, its objects and all of its memory.
+ *
+ * \since LTO_API_VERSION=18
+ */
+extern void thinlto_codegen_dispose(thinlto_code_gen_t cg);
+
+/**
+ * Adds the bitcode module in \p data to the modules to compile. The
+ * \p identifier has to be unique among the modules. The data is not copied,
+ * and has to stay valid until thinlto_codegen_process() returns.
+ *
+ * \since LTO_API_VERSION=18
+ */
+extern void thinlto_codegen_add_module(thinlto_code_gen_t cg,
+                                       const char *identifier,
+                                       const char *data, int length);
+
+/**
+ * Imports, optimizes and compiles every module, running up to the number of
+ * threads set with thinlto_codegen_set_parallelism() at a time. Returns true
+ * on error (check lto_get_error_message() for details).
+ *
+ * \since LTO_API_VERSION=18
+ */
+extern lto_bool_t thinlto_codegen_process(thinlto_code_gen_t cg);
+
+/**
+ * Returns the number of objects produced by thinlto_codegen_process(), one
+ * for each module in the order they were added.
+ *
+ * \since LTO_API_VERSION=18
+ */
+extern unsigned int thinlto_module_get_num_objects(thinlto_code_gen_t cg);
+
+/**
+ * Returns the object at \p index. The buffer is owned by the code generator.
+ * If the module at \p index failed to compile, the returned buffer is null
+ * and has size 0.
+ *
+ * \since LTO_API_VERSION=18
+ */
+extern LTOObjectBuffer thinlto_module_get_object(thinlto_code_gen_t cg,
+                                                 unsigned int index);
+
+/**
+ * Sets the number of modules that are processed at the same time. The default,
+ * 0, uses the number of hardware threads.
+ *
+ * \since LTO_API_VERSION=18
+ */
+extern void thinlto_codegen_set_parallelism(thinlto_code_gen_t cg,
+                                            unsigned int threads);
+
+/**
+ * Sets the cpu to generate code for.
+ *
+ * \since LTO_API_VERSION=18
+ */
+extern void thinlto_codegen_set_cpu(thinlto_code_gen_t cg, const char *cpu);
+
+/**
+ * Sets which PIC code model to generate.
+ * Returns true on error (check lto_get_error_message() for details).
+ *
+ * \since LTO_API_VERSION=18
+ */
+extern lto_bool_t thinlto_codegen_set_pic_model(thinlto_code_gen_t cg,
+                                                lto_codegen_model);
+
+/**
+ * Sets the directory of the object cache. A module whose bitcode, imported
+ * functions and code generation options match an entry of the cache is not
+ * optimized or compiled again. An empty path, the default, disables the cache.
+ *
+ * \since LTO_API_VERSION=19
+ */
+extern void thinlto_codegen_set_cache_dir(thinlto_code_gen_t cg,
+                                          const char *cache_dir);
+
+/**
+ * Sets the size, in bytes, the cache is pruned down to after
+ * thinlto_codegen_process(), least recently used entries first. 0, the
+ * default, never prunes.
+ *
+ * \since LTO_API_VERSION=19
+ */
+extern void thinlto_codegen_set_cache_size_limit(thinlto_code_gen_t cg,
+                                                 unsigned long long bytes);
+
+/**
+ * Returns the number of modules that thinlto_codegen_process() loaded from
+ * the cache in \p hits, and the number it had to compile in \p misses.
+ *
+ * \since LTO_API_VERSION=19
+ */
+extern void thinlto_codegen_get_cache_stats(thinlto_code_gen_t cg,
+                                            unsigned int *hits,
+                                            unsigned int *misses);
+
 #ifdef __cplusplus
 }
 #endif
@@ -148,6 +148,15 @@ public:
     }
   }
 
+  /// Append the encoding of whole blocks that another writer emitted at the
+  /// same abbrev ID width and with the same block info. Both streams have to
+  /// be 32-bit aligned, as they are after a block.
+  void AppendBlocks(StringRef Bytes) {
+    assert(CurBit == 0 && "Blocks can only be appended at a word boundary");
+    assert((Bytes.size() & 3) == 0 && "Blocks end at a word boundary");
+    Out.append(Bytes.begin(), Bytes.end());
+  }
+
   void EmitVBR(uint32_t Val, unsigned NumBits) {
     assert(NumBits <= 32 && "Too many bits to emit!");
     uint32_t Threshold = 1U << (NumBits-1);
@@ -223,6 +223,11 @@ enum { BITCODE_CURRENT_EPOCH = 0 };
     METADATA_MODULE        = 32,  // [distinct, scope, name, ...]
     METADATA_MACRO         = 33,  // [distinct, macinfo, line, name, value]
     METADATA_MACRO_FILE    = 34,  // [distinct, macinfo, line, file, ...]
+    METADATA_STRINGS       = 35,  // [count, offset] blob([lengths][chars])
+    // Codes 36 and 37 are taken upstream by GLOBAL_DECL_ATTACHMENT and
+    // GLOBAL_VAR_EXPR.
+    METADATA_INDEX_OFFSET  = 38,  // [offset]
+    METADATA_INDEX         = 39,  // [n x bitpos delta]
   };
 
   // The constants block (CONSTANTS_BLOCK_ID) describes emission for each
@@ -27,7 +27,8 @@ class raw_pwrite_stream;
 /// Split M into OSs.size() partitions, and generate code for each. Writes
 /// OSs.size() output files to the output streams in OSs. The resulting output
 /// files if linked together are intended to be equivalent to the single output
-/// file that would have been code generated from M.
+/// file that would have been code generated from M. The partitions are
+/// balanced by their estimated codegen cost, see llvm::SplitModule.
 ///
 /// \returns M if OSs.size() == 1, otherwise returns std::unique_ptr<Module>().
 std::unique_ptr<Module>
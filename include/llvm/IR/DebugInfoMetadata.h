@@ -270,9 +270,9 @@ class GenericDINode : public DINode {
                                 MDString *Header, ArrayRef<Metadata *> DwarfOps,
                                 StorageType Storage, bool ShouldCreate = true);
 
-  TempGenericDINode cloneImpl() const {
+  TempGenericDINode cloneImpl(LLVMContext &Ctx) const {
     return getTemporary(
-        getContext(), getTag(), getHeader(),
+        Ctx, getTag(), getHeader(),
         SmallVector<Metadata *, 4>(dwarf_op_begin(), dwarf_op_end()));
   }
 
@@ -287,7 +287,7 @@ public:
                     (Tag, Header, DwarfOps))
 
   /// \brief Return a (temporary) clone of this.
-  TempGenericDINode clone() const { return cloneImpl(); }
+  TempGenericDINode clone() const { return cloneImpl(getContext()); }
 
   unsigned getTag() const { return SubclassData16; }
   StringRef getHeader() const { return getStringOperand(0); }
@@ -332,15 +332,15 @@ class DISubrange : public DINode {
                              int64_t LowerBound, StorageType Storage,
                              bool ShouldCreate = true);
 
-  TempDISubrange cloneImpl() const {
-    return getTemporary(getContext(), getCount(), getLowerBound());
+  TempDISubrange cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getCount(), getLowerBound());
   }
 
 public:
   DEFINE_MDNODE_GET(DISubrange, (int64_t Count, int64_t LowerBound = 0),
                     (Count, LowerBound))
 
-  TempDISubrange clone() const { return cloneImpl(); }
+  TempDISubrange clone() const { return cloneImpl(getContext()); }
 
   int64_t getLowerBound() const { return LowerBound; }
   int64_t getCount() const { return Count; }
@@ -376,8 +376,8 @@ class DIEnumerator : public DINode {
                                MDString *Name, StorageType Storage,
                                bool ShouldCreate = true);
 
-  TempDIEnumerator cloneImpl() const {
-    return getTemporary(getContext(), getValue(), getName());
+  TempDIEnumerator cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getValue(), getName());
   }
 
 public:
@@ -386,7 +386,7 @@ public:
   DEFINE_MDNODE_GET(DIEnumerator, (int64_t Value, MDString *Name),
                     (Value, Name))
 
-  TempDIEnumerator clone() const { return cloneImpl(); }
+  TempDIEnumerator clone() const { return cloneImpl(getContext()); }
 
   int64_t getValue() const { return Value; }
   StringRef getName() const { return getStringOperand(0); }
@@ -476,8 +476,8 @@ class DIFile : public DIScope {
                          MDString *Directory, StorageType Storage,
                          bool ShouldCreate = true);
 
-  TempDIFile cloneImpl() const {
-    return getTemporary(getContext(), getFilename(), getDirectory());
+  TempDIFile cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getFilename(), getDirectory());
   }
 
 public:
@@ -486,7 +486,7 @@ public:
   DEFINE_MDNODE_GET(DIFile, (MDString * Filename, MDString *Directory),
                     (Filename, Directory))
 
-  TempDIFile clone() const { return cloneImpl(); }
+  TempDIFile clone() const { return cloneImpl(getContext()); }
 
   StringRef getFilename() const { return getStringOperand(0); }
   StringRef getDirectory() const { return getStringOperand(1); }
@@ -624,8 +624,8 @@ class DIBasicType : public DIType {
                               uint64_t AlignInBits, unsigned Encoding,
                               StorageType Storage, bool ShouldCreate = true);
 
-  TempDIBasicType cloneImpl() const {
-    return getTemporary(getContext(), getTag(), getName(), getSizeInBits(),
+  TempDIBasicType cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getTag(), getName(), getSizeInBits(),
                         getAlignInBits(), getEncoding());
   }
 
@@ -641,7 +641,7 @@ public:
                      uint64_t AlignInBits, unsigned Encoding),
                     (Tag, Name, SizeInBits, AlignInBits, Encoding))
 
-  TempDIBasicType clone() const { return cloneImpl(); }
+  TempDIBasicType clone() const { return cloneImpl(getContext()); }
 
   unsigned getEncoding() const { return Encoding; }
 
@@ -686,8 +686,8 @@ class DIDerivedType : public DIType {
                                 Metadata *ExtraData, StorageType Storage,
                                 bool ShouldCreate = true);
 
-  TempDIDerivedType cloneImpl() const {
-    return getTemporary(getContext(), getTag(), getName(), getFile(), getLine(),
+  TempDIDerivedType cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getTag(), getName(), getFile(), getLine(),
                         getScope(), getBaseType(), getSizeInBits(),
                         getAlignInBits(), getOffsetInBits(), getFlags(),
                         getExtraData());
@@ -710,7 +710,7 @@ public:
                     (Tag, Name, File, Line, Scope, BaseType, SizeInBits,
                      AlignInBits, OffsetInBits, Flags, ExtraData))
 
-  TempDIDerivedType clone() const { return cloneImpl(); }
+  TempDIDerivedType clone() const { return cloneImpl(getContext()); }
 
   //// Get the base type this is derived from.
   DITypeRef getBaseType() const { return DITypeRef(getRawBaseType()); }
@@ -788,8 +788,8 @@ class DICompositeType : public DIType {
           Metadata *VTableHolder, Metadata *TemplateParams,
           MDString *Identifier, StorageType Storage, bool ShouldCreate = true);
 
-  TempDICompositeType cloneImpl() const {
-    return getTemporary(getContext(), getTag(), getName(), getFile(), getLine(),
+  TempDICompositeType cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getTag(), getName(), getFile(), getLine(),
                         getScope(), getBaseType(), getSizeInBits(),
                         getAlignInBits(), getOffsetInBits(), getFlags(),
                         getElements(), getRuntimeLang(), getVTableHolder(),
@@ -820,7 +820,7 @@ public:
                      AlignInBits, OffsetInBits, Flags, Elements, RuntimeLang,
                      VTableHolder, TemplateParams, Identifier))
 
-  TempDICompositeType clone() const { return cloneImpl(); }
+  TempDICompositeType clone() const { return cloneImpl(getContext()); }
 
   DITypeRef getBaseType() const { return DITypeRef(getRawBaseType()); }
   DINodeArray getElements() const {
@@ -897,8 +897,8 @@ class DISubroutineType : public DIType {
                                    Metadata *TypeArray, StorageType Storage,
                                    bool ShouldCreate = true);
 
-  TempDISubroutineType cloneImpl() const {
-    return getTemporary(getContext(), getFlags(), getTypeArray());
+  TempDISubroutineType cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getFlags(), getTypeArray());
   }
 
 public:
@@ -908,7 +908,7 @@ public:
   DEFINE_MDNODE_GET(DISubroutineType, (unsigned Flags, Metadata *TypeArray),
                     (Flags, TypeArray))
 
-  TempDISubroutineType clone() const { return cloneImpl(); }
+  TempDISubroutineType clone() const { return cloneImpl(getContext()); }
 
   DITypeRefArray getTypeArray() const {
     return cast_or_null<MDTuple>(getRawTypeArray());
@@ -969,9 +969,9 @@ class DICompileUnit : public DIScope {
           Metadata *ImportedEntities, Metadata *Macros, uint64_t DWOId,
           StorageType Storage, bool ShouldCreate = true);
 
-  TempDICompileUnit cloneImpl() const {
+  TempDICompileUnit cloneImpl(LLVMContext &Ctx) const {
     return getTemporary(
-        getContext(), getSourceLanguage(), getFile(), getProducer(),
+        Ctx, getSourceLanguage(), getFile(), getProducer(),
         isOptimized(), getFlags(), getRuntimeVersion(), getSplitDebugFilename(),
         getEmissionKind(), getEnumTypes(), getRetainedTypes(), getSubprograms(),
         getGlobalVariables(), getImportedEntities(), getMacros(), DWOId);
@@ -1005,7 +1005,7 @@ public:
        SplitDebugFilename, EmissionKind, EnumTypes, RetainedTypes, Subprograms,
        GlobalVariables, ImportedEntities, Macros, DWOId))
 
-  TempDICompileUnit clone() const { return cloneImpl(); }
+  TempDICompileUnit clone() const { return cloneImpl(getContext()); }
 
   unsigned getSourceLanguage() const { return SourceLanguage; }
   bool isOptimized() const { return IsOptimized; }
@@ -1125,10 +1125,10 @@ class DILocation : public MDNode {
                    static_cast<Metadata *>(InlinedAt), Storage, ShouldCreate);
   }
 
-  TempDILocation cloneImpl() const {
+  TempDILocation cloneImpl(LLVMContext &Ctx) const {
     // Get the raw scope/inlinedAt since it is possible to invoke this on
     // a DILocation containing temporary metadata.
-    return getTemporary(getContext(), getLine(), getColumn(), getRawScope(),
+    return getTemporary(Ctx, getLine(), getColumn(), getRawScope(),
                         getRawInlinedAt());
   }
 
@@ -1146,7 +1146,7 @@ public:
                     (Line, Column, Scope, InlinedAt))
 
   /// \brief Return a (temporary) clone of this.
-  TempDILocation clone() const { return cloneImpl(); }
+  TempDILocation clone() const { return cloneImpl(getContext()); }
 
   unsigned getLine() const { return SubclassData32; }
   unsigned getColumn() const { return SubclassData16; }
@@ -1266,9 +1266,9 @@ class DISubprogram : public DILocalScope {
           Metadata *Declaration, Metadata *Variables, StorageType Storage,
           bool ShouldCreate = true);
 
-  TempDISubprogram cloneImpl() const {
+  TempDISubprogram cloneImpl(LLVMContext &Ctx) const {
     return getTemporary(
-        getContext(), getScope(), getName(), getLinkageName(), getFile(),
+        Ctx, getScope(), getName(), getLinkageName(), getFile(),
         getLine(), getType(), isLocalToUnit(), isDefinition(), getScopeLine(),
         getContainingType(), getVirtuality(), getVirtualIndex(), getFlags(),
         isOptimized(), getTemplateParams(), getDeclaration(), getVariables());
@@ -1300,7 +1300,7 @@ public:
        ScopeLine, ContainingType, Virtuality, VirtualIndex, Flags, IsOptimized,
        TemplateParams, Declaration, Variables))
 
-  TempDISubprogram clone() const { return cloneImpl(); }
+  TempDISubprogram clone() const { return cloneImpl(getContext()); }
 
 public:
   unsigned getLine() const { return Line; }
@@ -1430,8 +1430,8 @@ class DILexicalBlock : public DILexicalBlockBase {
                                  Metadata *File, unsigned Line, unsigned Column,
                                  StorageType Storage, bool ShouldCreate = true);
 
-  TempDILexicalBlock cloneImpl() const {
-    return getTemporary(getContext(), getScope(), getFile(), getLine(),
+  TempDILexicalBlock cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getScope(), getFile(), getLine(),
                         getColumn());
   }
 
@@ -1443,7 +1443,7 @@ public:
                                      unsigned Line, unsigned Column),
                     (Scope, File, Line, Column))
 
-  TempDILexicalBlock clone() const { return cloneImpl(); }
+  TempDILexicalBlock clone() const { return cloneImpl(getContext()); }
 
   unsigned getLine() const { return Line; }
   unsigned getColumn() const { return Column; }
@@ -1479,8 +1479,8 @@ class DILexicalBlockFile : public DILexicalBlockBase {
                                      StorageType Storage,
                                      bool ShouldCreate = true);
 
-  TempDILexicalBlockFile cloneImpl() const {
-    return getTemporary(getContext(), getScope(), getFile(),
+  TempDILexicalBlockFile cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getScope(), getFile(),
                         getDiscriminator());
   }
 
@@ -1492,7 +1492,7 @@ public:
                     (Metadata * Scope, Metadata *File, unsigned Discriminator),
                     (Scope, File, Discriminator))
 
-  TempDILexicalBlockFile clone() const { return cloneImpl(); }
+  TempDILexicalBlockFile clone() const { return cloneImpl(getContext()); }
 
   // TODO: Remove these once they're gone from DILexicalBlockBase.
   unsigned getLine() const = delete;
@@ -1534,8 +1534,8 @@ class DINamespace : public DIScope {
                               Metadata *File, MDString *Name, unsigned Line,
                               StorageType Storage, bool ShouldCreate = true);
 
-  TempDINamespace cloneImpl() const {
-    return getTemporary(getContext(), getScope(), getFile(), getName(),
+  TempDINamespace cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getScope(), getFile(), getName(),
                         getLine());
   }
 
@@ -1547,7 +1547,7 @@ public:
                                   MDString *Name, unsigned Line),
                     (Scope, File, Name, Line))
 
-  TempDINamespace clone() const { return cloneImpl(); }
+  TempDINamespace clone() const { return cloneImpl(getContext()); }
 
   unsigned getLine() const { return Line; }
   DIScope *getScope() const { return cast_or_null<DIScope>(getRawScope()); }
@@ -1586,8 +1586,8 @@ class DIModule : public DIScope {
                            MDString *IncludePath, MDString *ISysRoot,
                            StorageType Storage, bool ShouldCreate = true);
 
-  TempDIModule cloneImpl() const {
-    return getTemporary(getContext(), getScope(), getName(),
+  TempDIModule cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getScope(), getName(),
                         getConfigurationMacros(), getIncludePath(),
                         getISysRoot());
   }
@@ -1602,7 +1602,7 @@ public:
                      MDString *IncludePath, MDString *ISysRoot),
                     (Scope, Name, ConfigurationMacros, IncludePath, ISysRoot))
 
-  TempDIModule clone() const { return cloneImpl(); }
+  TempDIModule clone() const { return cloneImpl(getContext()); }
 
   DIScope *getScope() const { return cast_or_null<DIScope>(getRawScope()); }
   StringRef getName() const { return getStringOperand(1); }
@@ -1662,8 +1662,8 @@ class DITemplateTypeParameter : public DITemplateParameter {
                                           Metadata *Type, StorageType Storage,
                                           bool ShouldCreate = true);
 
-  TempDITemplateTypeParameter cloneImpl() const {
-    return getTemporary(getContext(), getName(), getType());
+  TempDITemplateTypeParameter cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getName(), getType());
   }
 
 public:
@@ -1672,7 +1672,7 @@ public:
   DEFINE_MDNODE_GET(DITemplateTypeParameter, (MDString * Name, Metadata *Type),
                     (Name, Type))
 
-  TempDITemplateTypeParameter clone() const { return cloneImpl(); }
+  TempDITemplateTypeParameter clone() const { return cloneImpl(getContext()); }
 
   static bool classof(const Metadata *MD) {
     return MD->getMetadataID() == DITemplateTypeParameterKind;
@@ -1701,8 +1701,8 @@ class DITemplateValueParameter : public DITemplateParameter {
                                            Metadata *Value, StorageType Storage,
                                            bool ShouldCreate = true);
 
-  TempDITemplateValueParameter cloneImpl() const {
-    return getTemporary(getContext(), getTag(), getName(), getType(),
+  TempDITemplateValueParameter cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getTag(), getName(), getType(),
                         getValue());
   }
 
@@ -1714,7 +1714,7 @@ public:
                                                Metadata *Type, Metadata *Value),
                     (Tag, Name, Type, Value))
 
-  TempDITemplateValueParameter clone() const { return cloneImpl(); }
+  TempDITemplateValueParameter clone() const { return cloneImpl(getContext()); }
 
   Metadata *getValue() const { return getOperand(2); }
 
@@ -1798,8 +1798,8 @@ class DIGlobalVariable : public DIVariable {
           Metadata *StaticDataMemberDeclaration, StorageType Storage,
           bool ShouldCreate = true);
 
-  TempDIGlobalVariable cloneImpl() const {
-    return getTemporary(getContext(), getScope(), getName(), getLinkageName(),
+  TempDIGlobalVariable cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getScope(), getName(), getLinkageName(),
                         getFile(), getLine(), getType(), isLocalToUnit(),
                         isDefinition(), getVariable(),
                         getStaticDataMemberDeclaration());
@@ -1821,7 +1821,7 @@ public:
                     (Scope, Name, LinkageName, File, Line, Type, IsLocalToUnit,
                      IsDefinition, Variable, StaticDataMemberDeclaration))
 
-  TempDIGlobalVariable clone() const { return cloneImpl(); }
+  TempDIGlobalVariable clone() const { return cloneImpl(getContext()); }
 
   bool isLocalToUnit() const { return IsLocalToUnit; }
   bool isDefinition() const { return IsDefinition; }
@@ -1875,8 +1875,8 @@ class DILocalVariable : public DIVariable {
                                   StorageType Storage,
                                   bool ShouldCreate = true);
 
-  TempDILocalVariable cloneImpl() const {
-    return getTemporary(getContext(), getScope(), getName(), getFile(),
+  TempDILocalVariable cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getScope(), getName(), getFile(),
                         getLine(), getType(), getArg(), getFlags());
   }
 
@@ -1892,7 +1892,7 @@ public:
                      unsigned Flags),
                     (Scope, Name, File, Line, Type, Arg, Flags))
 
-  TempDILocalVariable clone() const { return cloneImpl(); }
+  TempDILocalVariable clone() const { return cloneImpl(getContext()); }
 
   /// \brief Get the local scope for this variable.
   ///
@@ -1948,14 +1948,14 @@ class DIExpression : public MDNode {
                                ArrayRef<uint64_t> Elements, StorageType Storage,
                                bool ShouldCreate = true);
 
-  TempDIExpression cloneImpl() const {
-    return getTemporary(getContext(), getElements());
+  TempDIExpression cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getElements());
   }
 
 public:
   DEFINE_MDNODE_GET(DIExpression, (ArrayRef<uint64_t> Elements), (Elements))
 
-  TempDIExpression clone() const { return cloneImpl(); }
+  TempDIExpression clone() const { return cloneImpl(getContext()); }
 
   ArrayRef<uint64_t> getElements() const { return Elements; }
 
@@ -2098,8 +2098,8 @@ class DIObjCProperty : public DINode {
                                  unsigned Attributes, Metadata *Type,
                                  StorageType Storage, bool ShouldCreate = true);
 
-  TempDIObjCProperty cloneImpl() const {
-    return getTemporary(getContext(), getName(), getFile(), getLine(),
+  TempDIObjCProperty cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getName(), getFile(), getLine(),
                         getGetterName(), getSetterName(), getAttributes(),
                         getType());
   }
@@ -2118,7 +2118,7 @@ public:
                     (Name, File, Line, GetterName, SetterName, Attributes,
                      Type))
 
-  TempDIObjCProperty clone() const { return cloneImpl(); }
+  TempDIObjCProperty clone() const { return cloneImpl(getContext()); }
 
   unsigned getLine() const { return Line; }
   unsigned getAttributes() const { return Attributes; }
@@ -2176,8 +2176,8 @@ class DIImportedEntity : public DINode {
                                    StorageType Storage,
                                    bool ShouldCreate = true);
 
-  TempDIImportedEntity cloneImpl() const {
-    return getTemporary(getContext(), getTag(), getScope(), getEntity(),
+  TempDIImportedEntity cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getTag(), getScope(), getEntity(),
                         getLine(), getName());
   }
 
@@ -2191,7 +2191,7 @@ public:
                      unsigned Line, MDString *Name),
                     (Tag, Scope, Entity, Line, Name))
 
-  TempDIImportedEntity clone() const { return cloneImpl(); }
+  TempDIImportedEntity clone() const { return cloneImpl(getContext()); }
 
   unsigned getLine() const { return Line; }
   DIScope *getScope() const { return cast_or_null<DIScope>(getRawScope()); }
@@ -2276,8 +2276,8 @@ class DIMacro : public DIMacroNode {
                           MDString *Name, MDString *Value, StorageType Storage,
                           bool ShouldCreate = true);
 
-  TempDIMacro cloneImpl() const {
-    return getTemporary(getContext(), getMacinfoType(), getLine(), getName(),
+  TempDIMacro cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getMacinfoType(), getLine(), getName(),
                         getValue());
   }
 
@@ -2289,7 +2289,7 @@ public:
                               MDString *Value),
                     (MIType, Line, Name, Value))
 
-  TempDIMacro clone() const { return cloneImpl(); }
+  TempDIMacro clone() const { return cloneImpl(getContext()); }
 
   unsigned getLine() const { return Line; }
 
@@ -2327,8 +2327,8 @@ class DIMacroFile : public DIMacroNode {
                               unsigned Line, Metadata *File, Metadata *Elements,
                               StorageType Storage, bool ShouldCreate = true);
 
-  TempDIMacroFile cloneImpl() const {
-    return getTemporary(getContext(), getMacinfoType(), getLine(), getFile(),
+  TempDIMacroFile cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, getMacinfoType(), getLine(), getFile(),
                         getElements());
   }
 
@@ -2340,7 +2340,7 @@ public:
                                   Metadata *File, Metadata *Elements),
                     (MIType, Line, File, Elements))
 
-  TempDIMacroFile clone() const { return cloneImpl(); }
+  TempDIMacroFile clone() const { return cloneImpl(getContext()); }
 
   void replaceElements(DIMacroNodeArray Elements) {
 #ifndef NDEBUG
@@ -18,6 +18,7 @@
 #ifndef LLVM_IR_GVMATERIALIZER_H
 #define LLVM_IR_GVMATERIALIZER_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include <system_error>
 #include <vector>
@@ -55,6 +56,13 @@ public:
   saveMetadataList(DenseMap<const Metadata *, unsigned> &MetadataToIDs,
                    bool OnlyTempMD) {}
 
+  /// Make sure the metadata with the given value ids, as recorded by
+  /// saveMetadataList, has been read. A materializer that reads module-level
+  /// metadata on demand only records the metadata it has read.
+  virtual std::error_code materializeMetadataIDs(ArrayRef<unsigned> IDs) {
+    return std::error_code();
+  }
+
   virtual std::vector<StructType *> getIdentifiedStructTypes() const = 0;
 };
 
@@ -17,11 +17,14 @@
 #ifndef LLVM_IR_LEGACYPASSMANAGER_H
 #define LLVM_IR_LEGACYPASSMANAGER_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CBindingWrapping.h"
+#include <functional>
 
 namespace llvm {
 
+class Function;
 class Pass;
 class Module;
 
@@ -45,6 +48,16 @@ public:
   virtual void add(Pass *P) = 0;
 };
 
+/// A function that runs RunPasses over the function definitions of M on
+/// Threads threads, each on a copy of its functions in a context of its own,
+/// such as llvm::runFunctionPassesInParallel. With CloneAllDefinitions, each
+/// copy has all of the definitions of M.
+typedef std::function<void(
+    Module &M, unsigned Threads,
+    std::function<void(Module &M, ArrayRef<Function *> Fs)> RunPasses,
+    bool CloneAllDefinitions)>
+    ParallelFunctionRunner;
+
 /// PassManager manages ModulePassManagers
 class PassManager : public PassManagerBase {
 public:
@@ -58,6 +71,22 @@ public:
   /// whether any of the passes modifies the module, and if so, return true.
   bool run(Module &M);
 
+  /// Run the function pass managers scheduled between the module passes on
+  /// Threads threads. Runner splits the functions over the threads, and
+  /// AddPasses is called on each thread to build the pipeline again, so it
+  /// must add the same passes in the same order as were added to this pass
+  /// manager, and be safe to call concurrently.
+  ///
+  /// The module analyses that the function passes use are computed again on
+  /// each thread. A function pass manager stays on the calling thread when
+  /// such an analysis was computed before the module last changed, or is not
+  /// an analysis of the module pass manager, and when passes are timed or
+  /// printed. The function passes of a call graph SCC pass manager always do:
+  /// they run in the order of the SCCs.
+  void setFunctionPassThreads(unsigned Threads,
+                              std::function<void(PassManagerBase &)> AddPasses,
+                              ParallelFunctionRunner Runner);
+
 private:
   /// PassManagerImpl_New is the actual class. PassManager is just the
   /// wraper to publish simple pass manager interface
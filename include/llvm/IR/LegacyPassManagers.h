@@ -19,8 +19,10 @@
 #include "llvm/ADT/FoldingSet.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/ValueMap.h"
 #include "llvm/Pass.h"
 #include <map>
+#include <memory>
 #include <vector>
 
 //===----------------------------------------------------------------------===//
@@ -93,6 +95,7 @@
 #include "llvm/Support/PrettyStackTrace.h"
 
 namespace llvm {
+  class Function;
   class Module;
   class Pass;
   class StringRef;
@@ -159,6 +162,53 @@ private:
   std::vector<PMDataManager *> S;
 };
 
+//===----------------------------------------------------------------------===//
+// PMChangeJournal
+//
+/// PMChangeJournal - Records which functions the passes of a top level
+/// manager changed, so that the incremental verifier only checks again the
+/// functions changed since it last checked them. Changes are numbered in the
+/// order they happen, and a change made by a module pass counts as a change
+/// to every function. The entries of a function go away when it is deleted.
+class PMChangeJournal {
+public:
+  /// Record that a pass changed F.
+  void recordChange(const Function &F);
+
+  /// Record that a module pass changed the module.
+  void recordModuleChange() { LastModuleChange = ++Generation; }
+
+  /// Return true if F was never verified, or changed since it last was.
+  bool needsVerification(const Function &F) const;
+  void recordVerified(const Function &F);
+
+  /// Return true if the module was never verified, or anything changed since
+  /// it last was.
+  bool moduleNeedsVerification() const {
+    return !ModuleVerified || Generation > LastModuleVerification;
+  }
+  void recordModuleVerified() {
+    ModuleVerified = true;
+    LastModuleVerification = Generation;
+  }
+
+private:
+  // A function replaced by another one, like by argpromotion, is deleted
+  // afterwards: its entries do not carry over to the new function, which
+  // may also be a constant expression around it.
+  struct Config : ValueMapConfig<const Value *> {
+    enum { FollowRAUW = false };
+  };
+  typedef ValueMap<const Value *, unsigned, Config> GenerationMap;
+
+  unsigned Generation = 0;
+  unsigned LastModuleChange = 0;
+  unsigned LastModuleVerification = 0;
+  bool ModuleVerified = false;
+  GenerationMap LastChange;
+  GenerationMap LastVerification;
+};
+
 //===----------------------------------------------------------------------===//
 // PMTopLevelManager
 //
@@ -224,6 +274,13 @@ public:
   void dumpPasses() const;
   void dumpArguments() const;
 
+  /// Start recording which functions the passes change, if not already, and
+  /// return the journal.
+  PMChangeJournal &enableChangeJournal();
+
+  /// Return the change journal, or null if no pass asked for one.
+  PMChangeJournal *getChangeJournal() const { return ChangeJournal.get(); }
+
   // Active Pass Managers
   PMStack activeStack;
 
@@ -251,6 +308,9 @@ private:
   /// Map from ID to immutable passes.
   SmallDenseMap<AnalysisID, ImmutablePass *, 8> ImmutablePassMap;
 
+  /// The functions changed by the passes, once a pass asked for it.
+  std::unique_ptr<PMChangeJournal> ChangeJournal;
+
 
   /// A wrapper around AnalysisUsage for the purpose of uniqueing.  The wrapper
   /// is used to avoid needing to make AnalysisUsage itself a folding set node.
@@ -387,6 +447,9 @@ public:
     return (unsigned)PassVector.size();
   }
 
+  /// Return the passes managed by this manager.
+  ArrayRef<Pass *> getContainedPasses() const { return PassVector; }
+
   virtual PassManagerType getPassManagerType() const {
     assert ( 0 && "Invalid use of getPassManagerType");
     return PMT_Unknown;
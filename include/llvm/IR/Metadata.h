@@ -870,6 +870,13 @@ public:
   /// \brief Create a (temporary) clone of this.
   TempMDNode clone() const;
 
+  /// \brief Create a (temporary) clone of this in another context.
+  ///
+  /// The operands are copied as they are, so they still refer to metadata in
+  /// the context of this node and must all be replaced before the clone is
+  /// uniqued or made distinct.
+  TempMDNode clone(LLVMContext &Ctx) const;
+
   /// \brief Deallocate a node created by getTemporary.
   ///
   /// Calls \c replaceAllUsesWith(nullptr) before deleting, so any remaining
@@ -1090,9 +1097,8 @@ class MDTuple : public MDNode {
   static MDTuple *getImpl(LLVMContext &Context, ArrayRef<Metadata *> MDs,
                           StorageType Storage, bool ShouldCreate = true);
 
-  TempMDTuple cloneImpl() const {
-    return getTemporary(getContext(),
-                        SmallVector<Metadata *, 4>(op_begin(), op_end()));
+  TempMDTuple cloneImpl(LLVMContext &Ctx) const {
+    return getTemporary(Ctx, SmallVector<Metadata *, 4>(op_begin(), op_end()));
   }
 
 public:
@@ -1124,7 +1130,7 @@ public:
   }
 
   /// \brief Return a (temporary) clone of this.
-  TempMDTuple clone() const { return cloneImpl(); }
+  TempMDTuple clone() const { return cloneImpl(getContext()); }
 
   static bool classof(const Metadata *MD) {
     return MD->getMetadataID() == MDTupleKind;
@@ -39,6 +39,7 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 #include <string>
@@ -51,6 +52,7 @@ namespace llvm {
   class Linker;
   class Mangler;
   class MemoryBuffer;
+  class Module;
   class TargetLibraryInfo;
   class TargetMachine;
   class raw_ostream;
@@ -66,6 +68,9 @@ struct LTOCodeGenerator {
   ~LTOCodeGenerator();
 
   /// Merge given module.  Return true on success.
+  ///
+  /// With -lto-dead-strip, the module and its bitcode are taken from the
+  /// LTOModule, and only linked once the symbols to preserve are known.
   bool addModule(struct LTOModule *);
 
   /// Set the destination module.
@@ -154,6 +159,8 @@ private:
   void initializeLTOPasses();
 
   bool compileOptimizedToFile(const char **Name);
+  bool linkDeferredModules();
+  void stripDeadDefinitions();
   void applyScopeRestrictions();
   void applyRestriction(GlobalValue &GV, ArrayRef<StringRef> Libcalls,
                         std::vector<const char *> &MustPreserveList,
@@ -167,11 +174,24 @@ private:
 
   void emitError(const std::string &ErrMsg);
 
+  /// Record the heap in use for the memory report of -time-passes, and return
+  /// it. Returns 0 without -time-passes.
+  size_t sampleMemoryUsage();
+  void printMemoryReport();
+
   typedef StringMap<uint8_t> StringSet;
 
+  /// A module added with -lto-dead-strip, and the bitcode its function bodies
+  /// are parsed from.
+  struct DeferredModule {
+    std::unique_ptr<MemoryBuffer> Buffer;
+    std::unique_ptr<Module> M;
+  };
+
   LLVMContext &Context;
   std::unique_ptr<Module> MergedModule;
   std::unique_ptr<Linker> TheLinker;
+  std::vector<DeferredModule> DeferredModules;
   std::unique_ptr<TargetMachine> TargetMach;
   bool EmitDwarfDebugInfo = false;
   bool ScopeRestrictionsDone = false;
@@ -191,6 +211,18 @@ private:
   bool ShouldInternalize = true;
   bool ShouldEmbedUselists = false;
   TargetMachine::CodeGenFileType FileType = TargetMachine::CGFT_ObjectFile;
+
+  /// The phases of the link, timed with -time-passes.
+  TimerGroup PhaseTimers{"LTO phases"};
+  Timer LinkTimer{"Link", PhaseTimers};
+  Timer OptimizeTimer{"Optimize", PhaseTimers};
+  Timer CodeGenTimer{"Code generation", PhaseTimers};
+
+  size_t PeakMemoryUsage = 0;
+  size_t MemoryUsageAfterLink = 0;
+  size_t MemoryUsageAfterOptimize = 0;
+  unsigned NumReleasedBodies = 0;
+  size_t ReleasedBodiesMemoryUsage = 0;
 };
 }
 #endif
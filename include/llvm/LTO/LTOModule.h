@@ -47,6 +47,10 @@ private:
 
   std::unique_ptr<LLVMContext> OwnedContext;
 
+  /// The bitcode of a module whose function bodies are parsed lazily, with
+  /// -lto-streaming-link or -lto-dead-strip.
+  std::unique_ptr<MemoryBuffer> OwnedBuffer;
+
   std::string LinkerOpts;
 
   std::unique_ptr<object::IRObjectFile> IRFile;
@@ -117,8 +121,16 @@ public:
     return IRFile->getModule();
   }
 
+  /// Take the module. With -lto-streaming-link or -lto-dead-strip, the
+  /// function bodies of the module are parsed from bitcode that this LTOModule
+  /// owns, so it has to outlive the module, or the module has to be fully
+  /// materialized first, or the bitcode has to be taken too.
   std::unique_ptr<Module> takeModule() { return IRFile->takeModule(); }
 
+  /// Take the bitcode that the function bodies of the module are parsed from,
+  /// if this LTOModule owns it. The module has to be taken first.
+  std::unique_ptr<MemoryBuffer> takeBuffer() { return std::move(OwnedBuffer); }
+
   /// Return the Module's target triple.
   const std::string &getTargetTriple() {
     return getModule().getTargetTriple();
@@ -208,7 +220,13 @@ private:
   /// Create an LTOModule (private version).
   static ErrorOr<std::unique_ptr<LTOModule>>
   makeLTOModule(MemoryBufferRef Buffer, TargetOptions options,
-                LLVMContext *Context);
+                LLVMContext *Context, bool ShouldBeLazy = false);
+
+  /// Create an LTOModule from a buffer it may keep, so that function bodies
+  /// can be parsed when the linker needs them.
+  static ErrorOr<std::unique_ptr<LTOModule>>
+  makeLTOModule(std::unique_ptr<MemoryBuffer> Buffer, TargetOptions options,
+                LLVMContext &Context);
 };
 }
 #endif
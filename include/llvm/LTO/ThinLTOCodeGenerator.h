@@ -0,0 +1,143 @@
+//===-ThinLTOCodeGenerator.h - LLVM Link Time Optimizer -------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the ThinLTOCodeGenerator class, which runs the ThinLTO
+// backends for a set of bitcode modules in process. The function summaries of
+// all of the modules are merged into a combined index; then every module
+// imports the functions it calls from the other modules, is optimized and is
+// compiled to its own object, in parallel on a thread pool. The objects can
+// be kept in an on-disk cache, so that a relink only recompiles the modules
+// whose inputs changed.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LTO_THINLTOCODEGENERATOR_H
+#define LLVM_LTO_THINLTOCODEGENERATOR_H
+
+#include "llvm-c/lto.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class DiagnosticInfo;
+  class FunctionInfoIndex;
+  class LLVMContext;
+  class Module;
+
+//===----------------------------------------------------------------------===//
+/// C++ class which implements the opaque thinlto_code_gen_t type.
+///
+struct ThinLTOCodeGenerator {
+  ThinLTOCodeGenerator();
+  ~ThinLTOCodeGenerator();
+
+  /// Add the bitcode module in Data to the modules to compile. Identifier is
+  /// the path of the module in the combined index and has to be unique. The
+  /// data is not copied and has to stay alive until run() returns.
+  void addModule(StringRef Identifier, StringRef Data);
+
+  void setTargetOptions(TargetOptions Options) { this->Options = Options; }
+  void setCodePICModel(Reloc::Model Model) { RelocModel = Model; }
+
+  /// Set the file type to be emitted (assembly or object code).
+  /// The default is TargetMachine::CGFT_ObjectFile.
+  void setFileType(TargetMachine::CodeGenFileType FT) { FileType = FT; }
+
+  void setCpu(const char *MCpu) { this->MCpu = MCpu; }
+  void setAttr(const char *MAttr) { this->MAttr = MAttr; }
+  void setOptLevel(unsigned OptLevel);
+
+  /// Set the number of modules processed at the same time. Each of them has
+  /// its own context, which bounds the memory in use. 0, the default, uses
+  /// the number of hardware threads.
+  void setParallelism(unsigned Threads) { Parallelism = Threads; }
+
+  void setDiagnosticHandler(lto_diagnostic_handler_t, void *);
+
+  /// Set the directory of the object cache. The cache is disabled when the
+  /// path is empty, which is the default.
+  ///
+  /// An entry is keyed on a hash of the bitcode of the module, the functions
+  /// it imports and the modules they come from, the target and code
+  /// generation options and the version of LLVM. A module whose entry exists
+  /// skips optimization and code generation.
+  void setCacheDir(std::string Path) { CacheDir = std::move(Path); }
+
+  /// After run(), remove the least recently used entries of the cache until
+  /// it takes at most Bytes. 0, the default, does not prune.
+  void setCachePruningSizeLimit(uint64_t Bytes) { CacheSizeLimit = Bytes; }
+
+  /// The number of modules that were loaded from the cache, or had to be
+  /// compiled, in the last run().
+  unsigned getCacheHits() const { return CacheHits; }
+  unsigned getCacheMisses() const { return CacheMisses; }
+
+  /// Import, optimize and compile every module. Returns true on success.
+  bool run();
+
+  /// The outputs of run(), in the order the modules were added.
+  std::vector<std::unique_ptr<MemoryBuffer>> &getProducedBinaries() {
+    return ProducedBinaries;
+  }
+
+private:
+  std::unique_ptr<FunctionInfoIndex> linkCombinedIndex();
+  std::unique_ptr<TargetMachine> createTargetMachine(Module &TheModule);
+  void optimizeModule(Module &TheModule, TargetMachine &TM);
+  std::unique_ptr<MemoryBuffer> codegenModule(Module &TheModule,
+                                              TargetMachine &TM);
+  std::unique_ptr<MemoryBuffer> runBackend(MemoryBufferRef Buffer,
+                                           const FunctionInfoIndex &Index);
+  std::string computeCacheKey(const Module &TheModule,
+                              const FunctionInfoIndex &Index,
+                              std::vector<std::string> &Sources,
+                              std::vector<std::string> &Imports);
+
+  static void DiagnosticHandler(const DiagnosticInfo &DI, void *Context);
+
+  void DiagnosticHandler2(const DiagnosticInfo &DI);
+
+  void emitError(const std::string &ErrMsg);
+  void emitWarning(const std::string &WarnMsg);
+
+  std::vector<MemoryBufferRef> Modules;
+  StringMap<MemoryBufferRef> ModuleMap;
+  std::vector<std::unique_ptr<MemoryBuffer>> ProducedBinaries;
+  std::string MCpu;
+  std::string MAttr;
+  TargetOptions Options;
+  Reloc::Model RelocModel = Reloc::Default;
+  CodeGenOpt::Level CGOptLevel = CodeGenOpt::Default;
+  unsigned OptLevel = 2;
+  unsigned Parallelism = 0;
+  TargetMachine::CodeGenFileType FileType = TargetMachine::CGFT_ObjectFile;
+  lto_diagnostic_handler_t DiagHandler = nullptr;
+  void *DiagContext = nullptr;
+  std::string CacheDir;
+  uint64_t CacheSizeLimit = 0;
+
+  /// The MD5 of every module, by identifier, when the cache is enabled.
+  StringMap<std::string> ModuleHashes;
+  std::atomic<unsigned> CacheHits{0};
+  std::atomic<unsigned> CacheMisses{0};
+
+  /// Serializes the diagnostics of the backends running in parallel.
+  std::mutex DiagLock;
+  bool HadErrors = false;
+};
+}
+#endif
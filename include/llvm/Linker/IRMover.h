@@ -11,7 +11,9 @@
 #define LLVM_LINKER_IRMOVER_H
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/TinyPtrVector.h"
 #include <functional>
 
 namespace llvm {
@@ -47,11 +49,18 @@ public:
     // The set of identified but non opaque structures in the composite module.
     DenseSet<StructType *, StructTypeKeyInfo> NonOpaqueStructTypes;
 
+    // The same structures, indexed by a hash of their shape which all of the
+    // types isomorphic to one have in common.
+    DenseMap<unsigned, TinyPtrVector<StructType *>> NonOpaqueStructTypesByShape;
+
   public:
     void addNonOpaque(StructType *Ty);
     void switchToNonOpaque(StructType *Ty);
     void addOpaque(StructType *Ty);
     StructType *findNonOpaque(ArrayRef<Type *> ETypes, bool IsPacked);
+    /// Return the non opaque structures that may be isomorphic to Ty. Any
+    /// structure that is isomorphic to it is among them.
+    ArrayRef<StructType *> findIsomorphicCandidates(StructType *Ty);
     bool hasType(StructType *Ty);
   };
 
@@ -321,6 +321,10 @@ public:
     VK_Nios2_JUMP_SLOT,
     VK_Nios2_RELATIVE,
     VK_Nios2_GOTOFF,
+    VK_Nios2_GOT_LO,
+    VK_Nios2_GOT_HA,
+    VK_Nios2_CALL_LO,
+    VK_Nios2_CALL_HA,
 
     VK_Hexagon_PCREL,
     VK_Hexagon_LO16,
@@ -599,6 +599,17 @@ enum {
 #include "ELFRelocs/Sparc.def"
 };
 
+// Nios2-specific e_flags
+enum : unsigned {
+  EF_NIOS2_ARCH_R1 = 0x00000000, // Nios II R1 instruction set
+  EF_NIOS2_ARCH_R2 = 0x00000001  // Nios II R2 instruction set
+};
+
+// ELF Relocation types for Nios2
+enum {
+#include "ELFRelocs/Nios2.def"
+};
+
 // ELF Relocation types for WebAssembly
 enum {
 #include "ELFRelocs/WebAssembly.def"
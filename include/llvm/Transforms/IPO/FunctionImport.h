@@ -25,7 +25,8 @@ class FunctionImporter {
   /// The summaries index used to trigger importing.
   const FunctionInfoIndex &Index;
 
-  /// Factory function to load a Module for a given identifier
+  /// Factory function to load a Module for a given identifier. It returns
+  /// nullptr if the module cannot be loaded; no function is imported from it.
   std::function<std::unique_ptr<Module>(StringRef Identifier)> ModuleLoader;
 
 public:
@@ -18,6 +18,7 @@
 #ifndef LLVM_TRANSFORMS_UTILS_CLONING_H
 #define LLVM_TRANSFORMS_UTILS_CLONING_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/Analysis/AliasAnalysis.h"
@@ -29,6 +30,7 @@
 namespace llvm {
 
 class Module;
+class LLVMContext;
 class Function;
 class Instruction;
 class Pass;
@@ -61,6 +63,29 @@ std::unique_ptr<Module>
 CloneModule(const Module *M, ValueToValueMapTy &VMap,
             std::function<bool(const GlobalValue *)> ShouldCloneDefinition);
 
+/// Return a copy of the specified module in the context Ctx. Types,
+/// constants, metadata and attributes are all recreated in Ctx, so the copy
+/// does not share anything with the context of M and can, for example, be
+/// used on another thread.
+std::unique_ptr<Module> CloneModuleIntoContext(const Module *M,
+                                               LLVMContext &Ctx);
+
+/// Return a copy of the specified module in the context Ctx, as above. VMap
+/// maps the globals, and the metadata, of M to their copies. Only the
+/// definitions for which ShouldCloneDefinition returns true are copied; the
+/// other globals become external declarations.
+std::unique_ptr<Module> CloneModuleIntoContext(
+    const Module *M, LLVMContext &Ctx, ValueToValueMapTy &VMap,
+    std::function<bool(const GlobalValue *)> ShouldCloneDefinition);
+
+/// Replace the bodies of the functions Fs of M with the ones of their copies
+/// in a module returned by CloneModuleIntoContext(M, Ctx, VMap, ...), which
+/// may have been transformed since. References to the globals and metadata of
+/// M map back to them; the globals added to the copy are added to M. No block
+/// of the functions in Fs may have its address taken.
+void CopyFunctionBodiesFromContext(Module &M, ArrayRef<Function *> Fs,
+                                   ValueToValueMapTy &VMap);
+
 /// ClonedCodeInfo - This struct can be used to capture information about code
 /// being cloned, while it is being cloned.
 struct ClonedCodeInfo {
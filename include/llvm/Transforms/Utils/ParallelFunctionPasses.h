@@ -0,0 +1,55 @@
+//===- ParallelFunctionPasses.h - Function passes on threads ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the function llvm::runFunctionPassesInParallel, which
+// runs a function pass pipeline over the functions of a module on several
+// threads.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_UTILS_PARALLELFUNCTIONPASSES_H
+#define LLVM_TRANSFORMS_UTILS_PARALLELFUNCTIONPASSES_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include <functional>
+
+namespace llvm {
+
+class Function;
+class Module;
+
+/// Run RunPasses over the function definitions of M on Threads threads.
+///
+/// The definitions are split into Threads groups of about the same size, and
+/// each group is cloned into a module in an LLVMContext of its own, where the
+/// other functions are only declared. RunPasses is then called on each clone,
+/// with the definitions of the group, on a thread of its own; it typically
+/// runs a legacy::FunctionPassManager over them. Once all of the groups are
+/// done, the transformed bodies are copied back into M, in order, so the
+/// result does not depend on the scheduling of the threads.
+///
+/// RunPasses is called concurrently, and must only touch the module it is
+/// given. The passes it runs must only change the functions they run on, as
+/// the function passes of the legacy pass manager are required to.
+///
+/// With CloneAllDefinitions, every clone has all of the definitions of M,
+/// for passes that use analyses of the whole module, but only the
+/// definitions of its group are passed to RunPasses and copied back.
+///
+/// Functions whose blocks have their address taken, and all of the functions
+/// when Threads is 1, are processed by a final call of RunPasses on M itself,
+/// on the calling thread.
+void runFunctionPassesInParallel(
+    Module &M, unsigned Threads,
+    std::function<void(Module &M, ArrayRef<Function *> Fs)> RunPasses,
+    bool CloneAllDefinitions = false);
+
+} // End llvm namespace
+
+#endif
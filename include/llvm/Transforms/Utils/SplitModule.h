@@ -16,17 +16,35 @@
 #ifndef LLVM_TRANSFORMS_UTILS_SPLITMODULE_H
 #define LLVM_TRANSFORMS_UTILS_SPLITMODULE_H
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 
 namespace llvm {
 
+class Function;
 class Module;
 class StringRef;
 
+/// Returns an estimate of the relative cost of generating code for F, made of
+/// its instructions, its basic blocks and the lines of its inline asm.
+uint64_t estimateCodeGenCost(const Function &F);
+
+/// Returns the estimated cost of generating code for all of the function
+/// definitions in M.
+uint64_t estimateCodeGenCost(const Module &M);
+
 /// Splits the module M into N linkable partitions. The function ModuleCallback
 /// is called N times passing each individual partition as the MPart argument.
 ///
+/// By default globals are assigned to partitions by a hash of their names and
+/// local symbols are externalized. If Balance is true, globals that must stay
+/// together (members of a comdat, aliases and their aliasees, local symbols
+/// and all of their users) are grouped into clusters instead, and clusters are
+/// assigned largest first to the partition with the smallest estimated code
+/// generation cost so far. Local symbols keep their linkage in that mode,
+/// unless a global with appending linkage such as llvm.used refers to them.
+///
 /// FIXME: This function does not deal with the somewhat subtle symbol
 /// visibility issues around module splitting, including (but not limited to):
 ///
@@ -36,7 +54,8 @@ class StringRef;
 ///   each partition.
 void SplitModule(
     std::unique_ptr<Module> M, unsigned N,
-    std::function<void(std::unique_ptr<Module> MPart)> ModuleCallback);
+    std::function<void(std::unique_ptr<Module> MPart)> ModuleCallback,
+    bool Balance = false);
 
 } // End llvm namespace
 
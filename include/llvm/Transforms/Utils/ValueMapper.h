@@ -20,6 +20,7 @@
 namespace llvm {
   class Value;
   class Instruction;
+  class LLVMContext;
   typedef ValueMap<const Value *, WeakVH> ValueToValueMapTy;
 
   /// ValueMapTypeRemapper - This is a class that can be implemented by clients
@@ -32,6 +33,11 @@ namespace llvm {
     /// remapType - The client should implement this method if they want to
     /// remap types while mapping values.
     virtual Type *remapType(Type *SrcTy) = 0;
+
+    /// getDestinationContext - Clients that remap types into another
+    /// LLVMContext return it here, so that constants and metadata are
+    /// recreated in that context as well.
+    virtual LLVMContext *getDestinationContext() { return nullptr; }
   };
 
   /// ValueMaterializer - This is a class that can be implemented by clients
@@ -125,6 +125,18 @@ bool CGPassManager::RunPassOnSCC(Pass *P, CallGraphSCC &CurSCC,
       TimeRegion PassTimer(getPassTimer(CGSP));
       Changed = CGSP->runOnSCC(CurSCC);
     }
+
+    // Record the functions of the SCC as changed, and their callers too, as
+    // a pass like argpromotion rewrites the call sites.
+    if (Changed)
+      if (PMChangeJournal *CJ = TPM->getChangeJournal())
+        for (CallGraphNode *CGN : CurSCC)
+          if (Function *F = CGN->getFunction()) {
+            CJ->recordChange(*F);
+            for (User *U : F->users())
+              if (auto *I = dyn_cast<Instruction>(U))
+                CJ->recordChange(*I->getParent()->getParent());
+          }
     
     // After the CGSCCPass is done, when assertions are enabled, use
     // RefreshCallGraph to verify that the callgraph was correctly updated.
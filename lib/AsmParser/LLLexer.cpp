@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "LLLexer.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/AsmParser/Parser.h"
@@ -19,14 +20,17 @@
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 using namespace llvm;
 
 bool LLLexer::Error(LocTy ErrorLoc, const Twine &Msg) const {
@@ -141,10 +145,16 @@ static void UnEscapeLexed(std::string &Str) {
   Str.resize(BOut-Buffer);
 }
 
+/// isKeywordChar - Return true for [a-zA-Z_0-9]. This is on the path of every
+/// identifier, so it does not go through the locale like isalnum.
+static bool isKeywordChar(char C) {
+  return (C >= 'a' && C <= 'z') || (C >= 'A' && C <= 'Z') ||
+         (C >= '0' && C <= '9') || C == '_';
+}
+
 /// isLabelChar - Return true for [-a-zA-Z$._0-9].
 static bool isLabelChar(char C) {
-  return isalnum(static_cast<unsigned char>(C)) || C == '-' || C == '$' ||
-         C == '.' || C == '_';
+  return isKeywordChar(C) || C == '-' || C == '$' || C == '.';
 }
 
 
@@ -187,61 +197,63 @@ int LLLexer::getNextChar() {
 
 
 lltok::Kind LLLexer::LexToken() {
-  TokStart = CurPtr;
+  while (true) {
+    TokStart = CurPtr;
 
-  int CurChar = getNextChar();
-  switch (CurChar) {
-  default:
-    // Handle letters: [a-zA-Z_]
-    if (isalpha(static_cast<unsigned char>(CurChar)) || CurChar == '_')
-      return LexIdentifier();
+    int CurChar = getNextChar();
+    switch (CurChar) {
+    default:
+      // Handle letters: [a-zA-Z_]
+      if (isalpha(static_cast<unsigned char>(CurChar)) || CurChar == '_')
+        return LexIdentifier();
 
-    return lltok::Error;
-  case EOF: return lltok::Eof;
-  case 0:
-  case ' ':
-  case '\t':
-  case '\n':
-  case '\r':
-    // Ignore whitespace.
-    return LexToken();
-  case '+': return LexPositive();
-  case '@': return LexAt();
-  case '$': return LexDollar();
-  case '%': return LexPercent();
-  case '"': return LexQuote();
-  case '.':
-    if (const char *Ptr = isLabelTail(CurPtr)) {
-      CurPtr = Ptr;
-      StrVal.assign(TokStart, CurPtr-1);
-      return lltok::LabelStr;
-    }
-    if (CurPtr[0] == '.' && CurPtr[1] == '.') {
-      CurPtr += 2;
-      return lltok::dotdotdot;
+      return lltok::Error;
+    case EOF: return lltok::Eof;
+    case 0:
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+      // Ignore whitespace.
+      continue;
+    case '+': return LexPositive();
+    case '@': return LexAt();
+    case '$': return LexDollar();
+    case '%': return LexPercent();
+    case '"': return LexQuote();
+    case '.':
+      if (const char *Ptr = isLabelTail(CurPtr)) {
+        CurPtr = Ptr;
+        StrVal.assign(TokStart, CurPtr-1);
+        return lltok::LabelStr;
+      }
+      if (CurPtr[0] == '.' && CurPtr[1] == '.') {
+        CurPtr += 2;
+        return lltok::dotdotdot;
+      }
+      return lltok::Error;
+    case ';':
+      SkipLineComment();
+      continue;
+    case '!': return LexExclaim();
+    case '#': return LexHash();
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+    case '-':
+      return LexDigitOrNegative();
+    case '=': return lltok::equal;
+    case '[': return lltok::lsquare;
+    case ']': return lltok::rsquare;
+    case '{': return lltok::lbrace;
+    case '}': return lltok::rbrace;
+    case '<': return lltok::less;
+    case '>': return lltok::greater;
+    case '(': return lltok::lparen;
+    case ')': return lltok::rparen;
+    case ',': return lltok::comma;
+    case '*': return lltok::star;
+    case '|': return lltok::bar;
     }
-    return lltok::Error;
-  case ';':
-    SkipLineComment();
-    return LexToken();
-  case '!': return LexExclaim();
-  case '#': return LexHash();
-  case '0': case '1': case '2': case '3': case '4':
-  case '5': case '6': case '7': case '8': case '9':
-  case '-':
-    return LexDigitOrNegative();
-  case '=': return lltok::equal;
-  case '[': return lltok::lsquare;
-  case ']': return lltok::rsquare;
-  case '{': return lltok::lbrace;
-  case '}': return lltok::rbrace;
-  case '<': return lltok::less;
-  case '>': return lltok::greater;
-  case '(': return lltok::lparen;
-  case ')': return lltok::rparen;
-  case ',': return lltok::comma;
-  case '*': return lltok::star;
-  case '|': return lltok::bar;
   }
 }
 
@@ -443,56 +455,60 @@ lltok::Kind LLLexer::LexHash() {
   return lltok::Error;
 }
 
-/// Lex a label, integer type, keyword, or hexadecimal integer constant.
-///    Label           [-a-zA-Z$._0-9]+:
-///    IntegerType     i[0-9]+
-///    Keyword         sdiv, float, ...
-///    HexIntConstant  [us]0x[0-9A-Fa-f]+
-lltok::Kind LLLexer::LexIdentifier() {
-  const char *StartChar = CurPtr;
-  const char *IntEnd = CurPtr[-1] == 'i' ? nullptr : StartChar;
-  const char *KeywordEnd = nullptr;
-
-  for (; isLabelChar(*CurPtr); ++CurPtr) {
-    // If we decide this is an integer, remember the end of the sequence.
-    if (!IntEnd && !isdigit(static_cast<unsigned char>(*CurPtr)))
-      IntEnd = CurPtr;
-    if (!KeywordEnd && !isalnum(static_cast<unsigned char>(*CurPtr)) &&
-        *CurPtr != '_')
-      KeywordEnd = CurPtr;
+namespace {
+/// A keyword and the token it is lexed to. The instruction keywords also
+/// carry their opcode, and the type keywords their type ID.
+struct KeywordInfo {
+  StringRef Name;
+  lltok::Kind Kind;
+  unsigned Val;
+};
+
+/// KeywordTable - A perfect hash table of the keywords. Every keyword hashes
+/// to a bucket, and each bucket has a seed that sends its keywords to free
+/// slots of their own, so that looking up an identifier hashes it once and
+/// compares it with at most one keyword.
+class KeywordTable {
+  static const unsigned NumBuckets = 256;
+  static const unsigned LogNumSlots = 10;
+  std::vector<KeywordInfo> Keywords;
+  uint16_t Seeds[NumBuckets];
+  /// The index of the keyword in each slot plus one, or 0 for a free slot.
+  uint16_t Slots[1 << LogNumSlots];
+
+  static uint64_t hash(StringRef Name) {
+    uint64_t Hash = 14695981039346656037ULL;
+    for (char C : Name)
+      Hash = (Hash ^ (unsigned char)C) * 1099511628211ULL;
+    return Hash;
+  }
+  static unsigned getSlot(uint64_t Hash, unsigned Seed) {
+    Hash += Seed * 0x9E3779B97F4A7C15ULL;
+    Hash ^= Hash >> 33;
+    Hash *= 0xFF51AFD7ED558CCDULL;
+    return Hash >> (64 - LogNumSlots);
   }
 
-  // If we stopped due to a colon, this really is a label.
-  if (*CurPtr == ':') {
-    StrVal.assign(StartChar-1, CurPtr++);
-    return lltok::LabelStr;
+  void add(StringRef Name, lltok::Kind Kind, unsigned Val = 0) {
+    Keywords.push_back({Name, Kind, Val});
   }
+  void build();
 
-  // Otherwise, this wasn't a label.  If this was valid as an integer type,
-  // return it.
-  if (!IntEnd) IntEnd = CurPtr;
-  if (IntEnd != StartChar) {
-    CurPtr = IntEnd;
-    uint64_t NumBits = atoull(StartChar, CurPtr);
-    if (NumBits < IntegerType::MIN_INT_BITS ||
-        NumBits > IntegerType::MAX_INT_BITS) {
-      Error("bitwidth for integer type out of range!");
-      return lltok::Error;
-    }
-    TyVal = IntegerType::get(Context, NumBits);
-    return lltok::Type;
+public:
+  KeywordTable();
+
+  const KeywordInfo *lookup(StringRef Name) const {
+    uint64_t Hash = hash(Name);
+    unsigned Index = Slots[getSlot(Hash, Seeds[Hash % NumBuckets])];
+    if (!Index || Keywords[Index - 1].Name != Name)
+      return nullptr;
+    return &Keywords[Index - 1];
   }
+};
+}
 
-  // Otherwise, this was a letter sequence.  See which keyword this is.
-  if (!KeywordEnd) KeywordEnd = CurPtr;
-  CurPtr = KeywordEnd;
-  --StartChar;
-  StringRef Keyword(StartChar, CurPtr - StartChar);
-#define KEYWORD(STR)                                                           \
-  do {                                                                         \
-    if (Keyword == #STR)                                                       \
-      return lltok::kw_##STR;                                                  \
-  } while (0)
+KeywordTable::KeywordTable() {
+#define KEYWORD(STR) add(#STR, lltok::kw_##STR)
 
   KEYWORD(true);    KEYWORD(false);
   KEYWORD(declare); KEYWORD(define);
@@ -685,34 +701,22 @@ lltok::Kind LLLexer::LexIdentifier() {
 #undef KEYWORD
 
   // Keywords for types.
-#define TYPEKEYWORD(STR, LLVMTY)                                               \
-  do {                                                                         \
-    if (Keyword == STR) {                                                      \
-      TyVal = LLVMTY;                                                          \
-      return lltok::Type;                                                      \
-    }                                                                          \
-  } while (false)
-  TYPEKEYWORD("void",      Type::getVoidTy(Context));
-  TYPEKEYWORD("half",      Type::getHalfTy(Context));
-  TYPEKEYWORD("float",     Type::getFloatTy(Context));
-  TYPEKEYWORD("double",    Type::getDoubleTy(Context));
-  TYPEKEYWORD("x86_fp80",  Type::getX86_FP80Ty(Context));
-  TYPEKEYWORD("fp128",     Type::getFP128Ty(Context));
-  TYPEKEYWORD("ppc_fp128", Type::getPPC_FP128Ty(Context));
-  TYPEKEYWORD("label",     Type::getLabelTy(Context));
-  TYPEKEYWORD("metadata",  Type::getMetadataTy(Context));
-  TYPEKEYWORD("x86_mmx",   Type::getX86_MMXTy(Context));
-  TYPEKEYWORD("token",     Type::getTokenTy(Context));
+#define TYPEKEYWORD(STR, ID) add(STR, lltok::Type, Type::ID)
+  TYPEKEYWORD("void",      VoidTyID);
+  TYPEKEYWORD("half",      HalfTyID);
+  TYPEKEYWORD("float",     FloatTyID);
+  TYPEKEYWORD("double",    DoubleTyID);
+  TYPEKEYWORD("x86_fp80",  X86_FP80TyID);
+  TYPEKEYWORD("fp128",     FP128TyID);
+  TYPEKEYWORD("ppc_fp128", PPC_FP128TyID);
+  TYPEKEYWORD("label",     LabelTyID);
+  TYPEKEYWORD("metadata",  MetadataTyID);
+  TYPEKEYWORD("x86_mmx",   X86_MMXTyID);
+  TYPEKEYWORD("token",     TokenTyID);
 #undef TYPEKEYWORD
 
   // Keywords for instructions.
-#define INSTKEYWORD(STR, Enum)                                                 \
-  do {                                                                         \
-    if (Keyword == #STR) {                                                     \
-      UIntVal = Instruction::Enum;                                             \
-      return lltok::kw_##STR;                                                  \
-    }                                                                          \
-  } while (false)
+#define INSTKEYWORD(STR, Enum) add(#STR, lltok::kw_##STR, Instruction::Enum)
 
   INSTKEYWORD(add,   Add);  INSTKEYWORD(fadd,   FAdd);
   INSTKEYWORD(sub,   Sub);  INSTKEYWORD(fsub,   FSub);
@@ -769,6 +773,105 @@ lltok::Kind LLLexer::LexIdentifier() {
   INSTKEYWORD(cleanuppad,   CleanupPad);
 #undef INSTKEYWORD
 
+  build();
+}
+
+/// Place the largest buckets first, each with the first seed that moves all
+/// of its keywords to free slots.
+void KeywordTable::build() {
+  std::vector<SmallVector<unsigned, 4>> Buckets(NumBuckets);
+  for (unsigned I = 0, E = Keywords.size(); I != E; ++I)
+    Buckets[hash(Keywords[I].Name) % NumBuckets].push_back(I);
+
+  std::vector<unsigned> Order(NumBuckets);
+  for (unsigned B = 0; B != NumBuckets; ++B)
+    Order[B] = B;
+  std::stable_sort(Order.begin(), Order.end(), [&](unsigned L, unsigned R) {
+    return Buckets[L].size() > Buckets[R].size();
+  });
+
+  std::fill(std::begin(Seeds), std::end(Seeds), 0);
+  std::fill(std::begin(Slots), std::end(Slots), 0);
+  for (unsigned B : Order) {
+    const SmallVectorImpl<unsigned> &Bucket = Buckets[B];
+    if (Bucket.empty())
+      break;
+    SmallVector<unsigned, 4> Placed;
+    unsigned Seed = 0;
+    for (;; ++Seed) {
+      if (Seed > UINT16_MAX)
+        report_fatal_error("cannot build the keyword table of the lexer");
+      Placed.clear();
+      for (unsigned I : Bucket) {
+        unsigned S = getSlot(hash(Keywords[I].Name), Seed);
+        if (Slots[S] || std::find(Placed.begin(), Placed.end(), S) !=
+                            Placed.end())
+          break;
+        Placed.push_back(S);
+      }
+      if (Placed.size() == Bucket.size())
+        break;
+    }
+    Seeds[B] = Seed;
+    for (unsigned I = 0, E = Bucket.size(); I != E; ++I)
+      Slots[Placed[I]] = Bucket[I] + 1;
+  }
+}
+
+static ManagedStatic<KeywordTable> Keywords;
+
+/// Lex a label, integer type, keyword, or hexadecimal integer constant.
+///    Label           [-a-zA-Z$._0-9]+:
+///    IntegerType     i[0-9]+
+///    Keyword         sdiv, float, ...
+///    HexIntConstant  [us]0x[0-9A-Fa-f]+
+lltok::Kind LLLexer::LexIdentifier() {
+  const char *StartChar = CurPtr;
+  const char *IntEnd = CurPtr[-1] == 'i' ? nullptr : StartChar;
+  const char *KeywordEnd = nullptr;
+
+  for (; isLabelChar(*CurPtr); ++CurPtr) {
+    // If we decide this is an integer, remember the end of the sequence.
+    if (!IntEnd && (*CurPtr < '0' || *CurPtr > '9'))
+      IntEnd = CurPtr;
+    if (!KeywordEnd && !isKeywordChar(*CurPtr))
+      KeywordEnd = CurPtr;
+  }
+
+  // If we stopped due to a colon, this really is a label.
+  if (*CurPtr == ':') {
+    StrVal.assign(StartChar-1, CurPtr++);
+    return lltok::LabelStr;
+  }
+
+  // Otherwise, this wasn't a label.  If this was valid as an integer type,
+  // return it.
+  if (!IntEnd) IntEnd = CurPtr;
+  if (IntEnd != StartChar) {
+    CurPtr = IntEnd;
+    uint64_t NumBits = atoull(StartChar, CurPtr);
+    if (NumBits < IntegerType::MIN_INT_BITS ||
+        NumBits > IntegerType::MAX_INT_BITS) {
+      Error("bitwidth for integer type out of range!");
+      return lltok::Error;
+    }
+    TyVal = IntegerType::get(Context, NumBits);
+    return lltok::Type;
+  }
+
+  // Otherwise, this was a letter sequence.  See which keyword this is.
+  if (!KeywordEnd) KeywordEnd = CurPtr;
+  CurPtr = KeywordEnd;
+  --StartChar;
+  StringRef Keyword(StartChar, CurPtr - StartChar);
+  if (const KeywordInfo *K = Keywords->lookup(Keyword)) {
+    if (K->Kind == lltok::Type)
+      TyVal = Type::getPrimitiveType(Context, Type::TypeID(K->Val));
+    else if (K->Val)
+      UIntVal = K->Val;
+    return K->Kind;
+  }
+
 #define DWKEYWORD(TYPE, TOKEN)                                                 \
   do {                                                                         \
     if (Keyword.startswith("DW_" #TYPE "_")) {                                 \
@@ -2277,6 +2277,8 @@ bool LLParser::ParseArrayVectorType(Type *&Result, bool isVector) {
 LLParser::PerFunctionState::PerFunctionState(LLParser &p, Function &f,
                                              int functionNumber)
   : P(p), F(f), FunctionNumber(functionNumber) {
+  NumberedVals.swap(P.FunctionNumberedVals);
+  NumberedVals.clear();
 
   // Insert unnamed arguments into the NumberedVals list.
   for (Argument &A : F.args())
@@ -2302,6 +2304,9 @@ LLParser::PerFunctionState::~PerFunctionState() {
         UndefValue::get(P.second.first->getType()));
     delete P.second.first;
   }
+
+  NumberedVals.clear();
+  P.FunctionNumberedVals.swap(NumberedVals);
 }
 
 bool LLParser::PerFunctionState::FinishFunction() {
@@ -62,7 +62,7 @@ namespace llvm {
     FunctionType *FTy = nullptr;
     std::string StrVal, StrVal2;
     APSInt APSIntVal;
-    APFloat APFloatVal{0.0};
+    APFloat APFloatVal{APFloat::Bogus};
     Constant *ConstantVal;
     std::unique_ptr<Constant *[]> ConstantStructElts;
 
@@ -123,6 +123,10 @@ namespace llvm {
     std::map<unsigned, std::pair<GlobalValue*, LocTy> > ForwardRefValIDs;
     std::vector<GlobalValue*> NumberedVals;
 
+    // The storage of the numbered values of the function bodies, which every
+    // body reuses, so that it is only grown to the size of the largest one.
+    std::vector<Value*> FunctionNumberedVals;
+
     // Comdat forward reference information.
     std::map<std::string, LocTy> ForwardRefComdats;
 
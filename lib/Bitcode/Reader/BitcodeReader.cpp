@@ -8,9 +8,11 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Bitcode/BitstreamReader.h"
 #include "llvm/Bitcode/LLVMBitCodes.h"
@@ -37,6 +39,14 @@
 #include <deque>
 using namespace llvm;
 
+#define DEBUG_TYPE "bitcode-reader"
+
+STATISTIC(NumMDIndexed, "Number of module-level metadata records indexed");
+STATISTIC(NumMDParsedOnDemand,
+          "Number of indexed metadata records parsed on demand");
+STATISTIC(NumMDStringsOnDemand,
+          "Number of module-level metadata strings created on demand");
+
 namespace {
 enum {
   SWITCH_INST_MAGIC = 0x4B5 // May 2012 => 1205 => Hex
@@ -96,15 +106,13 @@ public:
 
 class BitcodeReaderMetadataList {
   unsigned NumFwdRefs;
-  bool AnyFwdRefs;
-  unsigned MinFwdRef;
-  unsigned MaxFwdRef;
+  /// The IDs that were forward referenced since cycles were last resolved.
+  SmallVector<unsigned, 16> FwdRefIDs;
   std::vector<TrackingMDRef> MetadataPtrs;
 
   LLVMContext &Context;
 public:
-  BitcodeReaderMetadataList(LLVMContext &C)
-      : NumFwdRefs(0), AnyFwdRefs(false), Context(C) {}
+  BitcodeReaderMetadataList(LLVMContext &C) : NumFwdRefs(0), Context(C) {}
 
   // vector compatibility methods
   unsigned size() const { return MetadataPtrs.size(); }
@@ -222,6 +230,33 @@ class BitcodeReader : public GVMaterializer {
   /// True if any Metadata block has been materialized.
   bool IsMetadataMaterialized = false;
 
+  /// True if module-level metadata nodes may be parsed when they are first
+  /// referenced rather than when the module is read, see parseMetadataIndex.
+  bool LazyLoadMetadataNodes = false;
+
+  /// When the module-level metadata is parsed on demand, the bit offset of
+  /// the record of each of its IDs, from the METADATA_INDEX record.
+  std::vector<uint64_t> MetadataIndex;
+
+  /// When the module-level metadata is parsed on demand, the characters of
+  /// the strings of the METADATA_STRINGS record, which come first in the IDs.
+  /// They point into the buffer of the file, and are only turned into MDStrings
+  /// when they are referenced.
+  std::vector<StringRef> MDStringRef;
+
+  /// Cursor into the module-level METADATA_BLOCK, which keeps its abbrevs
+  /// while Stream is in another block.
+  BitstreamCursor MetadataCursor;
+
+  /// The IDs of the module-level metadata being parsed on demand, which are
+  /// forward references until they are done.
+  BitVector MetadataLoading;
+
+  /// Module-level metadata IDs referenced too deep in the recursion of
+  /// lazyLoadMetadata, that are parsed when it returns to the top.
+  SmallVector<unsigned, 8> DeferredMetadataIDs;
+  unsigned MetadataLoadDepth = 0;
+
   bool StripDebugInfo = false;
 
   /// Functions that need to be matched with subprograms when upgrading old
@@ -245,6 +280,11 @@ public:
 
   void releaseBuffer();
 
+  /// Parse module-level metadata nodes when they are first referenced, if
+  /// the METADATA_BLOCK has an index of them. This pays off when only a part
+  /// of the module is going to be materialized.
+  void setLazyLoadMetadataNodes() { LazyLoadMetadataNodes = true; }
+
   std::error_code materialize(GlobalValue *GV) override;
   std::error_code materializeModule() override;
   std::vector<StructType *> getIdentifiedStructTypes() const override;
@@ -266,6 +306,7 @@ public:
 
   /// Materialize any deferred Metadata block.
   std::error_code materializeMetadata() override;
+  std::error_code materializeMetadataIDs(ArrayRef<unsigned> IDs) override;
 
   void setStripDebugInfo() override;
 
@@ -294,8 +335,9 @@ private:
     return ValueList.getValueFwdRef(ID, Ty);
   }
   Metadata *getFnMetadataByID(unsigned ID) {
-    return MetadataList.getValueFwdRef(ID);
+    return getMetadataFwdRef(ID);
   }
+  Metadata *getMetadataFwdRef(unsigned ID);
   BasicBlock *getBasicBlock(unsigned ID) const {
     if (ID >= FunctionBBs.size()) return nullptr; // Invalid ID
     return FunctionBBs[ID];
@@ -386,17 +428,28 @@ private:
   std::error_code parseOperandBundleTags();
 
   ErrorOr<Value *> recordValue(SmallVectorImpl<uint64_t> &Record,
-                               unsigned NameIndex, Triple &TT);
+                               unsigned NameIndex, Triple &TT, StringRef Blob);
   std::error_code parseValueSymbolTable(uint64_t Offset = 0);
   std::error_code parseConstants();
   std::error_code rememberAndSkipFunctionBodies();
   std::error_code rememberAndSkipFunctionBody();
   /// Save the positions of the Metadata blocks and skip parsing the blocks.
   std::error_code rememberAndSkipMetadata();
+  std::error_code parseMetadataIndex(uint64_t BlockBit, bool &HasIndex);
+  void lazyLoadMetadata(unsigned ID);
+  std::error_code parseLazyMetadataRecord(unsigned ID);
+  void lazyLoadMDString(unsigned ID);
   std::error_code parseFunctionBody(Function *F);
   std::error_code globalCleanup();
   std::error_code resolveGlobalAndAliasInits();
   std::error_code parseMetadata(bool ModuleLevel = false);
+  std::error_code parseMetadataRecord(BitstreamCursor &Cursor, unsigned Code,
+                                      SmallVectorImpl<uint64_t> &Record,
+                                      StringRef Blob, unsigned &NextMetadataNo);
+  std::error_code parseMetadataStrings(ArrayRef<uint64_t> Record,
+                                       StringRef Blob,
+                                       std::vector<StringRef> &Strings);
+  MDString *createMDString(StringRef Str);
   std::error_code parseMetadataKinds();
   std::error_code parseMetadataKindRecord(SmallVectorImpl<uint64_t> &Record);
   std::error_code parseMetadataAttachment(Function &F);
@@ -602,6 +655,8 @@ void BitcodeReader::freeState() {
   std::vector<Type*>().swap(TypeList);
   ValueList.clear();
   MetadataList.clear();
+  std::vector<uint64_t>().swap(MetadataIndex);
+  std::vector<StringRef>().swap(MDStringRef);
   std::vector<Comdat *>().swap(ComdatList);
 
   std::vector<AttributeSet>().swap(MAttributes);
@@ -1064,13 +1119,7 @@ Metadata *BitcodeReaderMetadataList::getValueFwdRef(unsigned Idx) {
     return MD;
 
   // Track forward refs to be resolved later.
-  if (AnyFwdRefs) {
-    MinFwdRef = std::min(MinFwdRef, Idx);
-    MaxFwdRef = std::max(MaxFwdRef, Idx);
-  } else {
-    AnyFwdRefs = true;
-    MinFwdRef = MaxFwdRef = Idx;
-  }
+  FwdRefIDs.push_back(Idx);
   ++NumFwdRefs;
 
   // Create and return a placeholder, which will later be RAUW'd.
@@ -1080,7 +1129,7 @@ Metadata *BitcodeReaderMetadataList::getValueFwdRef(unsigned Idx) {
 }
 
 void BitcodeReaderMetadataList::tryToResolveCycles() {
-  if (!AnyFwdRefs)
+  if (FwdRefIDs.empty())
     // Nothing to do.
     return;
 
@@ -1088,10 +1137,14 @@ void BitcodeReaderMetadataList::tryToResolveCycles() {
     // Still forward references... can't resolve cycles.
     return;
 
-  // Resolve any cycles.
-  for (unsigned I = MinFwdRef, E = MaxFwdRef + 1; I != E; ++I) {
-    auto &MD = MetadataPtrs[I];
-    auto *N = dyn_cast_or_null<MDNode>(MD);
+  // Resolve any cycles. Each of them goes through a node that was forward
+  // referenced, and resolving it resolves the nodes that depend on it, so
+  // there is no need to look at the nodes parsed in between.
+  for (unsigned I : FwdRefIDs) {
+    // Function-level IDs are dropped at the end of each function.
+    if (I >= MetadataPtrs.size())
+      continue;
+    auto *N = dyn_cast_or_null<MDNode>(MetadataPtrs[I]);
     if (!N)
       continue;
 
@@ -1100,7 +1153,7 @@ void BitcodeReaderMetadataList::tryToResolveCycles() {
   }
 
   // Make sure we return early again until there's another forward ref.
-  AnyFwdRefs = false;
+  FwdRefIDs.clear();
 }
 
 Type *BitcodeReader::getTypeByID(unsigned ID) {
@@ -1700,9 +1753,12 @@ std::error_code BitcodeReader::parseOperandBundleTags() {
   }
 }
 
-/// Associate a value with its name from the given index in the provided record.
+/// Name the value of a VST_ENTRY or VST_FNENTRY record. The name is in Blob
+/// if the record has one, and in the characters of Record from NameIndex on
+/// otherwise.
 ErrorOr<Value *> BitcodeReader::recordValue(SmallVectorImpl<uint64_t> &Record,
-                                            unsigned NameIndex, Triple &TT) {
+                                            unsigned NameIndex, Triple &TT,
+                                            StringRef Blob) {
   SmallString<128> ValueName;
   if (convertToString(Record, NameIndex, ValueName))
     return error("Invalid record");
@@ -1711,7 +1767,8 @@ ErrorOr<Value *> BitcodeReader::recordValue(SmallVectorImpl<uint64_t> &Record,
     return error("Invalid record");
   Value *V = ValueList[ValueID];
 
-  StringRef NameStr(ValueName.data(), ValueName.size());
+  StringRef NameStr =
+      Blob.data() ? Blob : StringRef(ValueName.data(), ValueName.size());
   if (NameStr.find_first_of(0) != StringRef::npos)
     return error("Invalid value name");
   V->setName(NameStr);
@@ -1792,11 +1849,12 @@ std::error_code BitcodeReader::parseValueSymbolTable(uint64_t Offset) {
 
     // Read a record.
     Record.clear();
-    switch (Stream.readRecord(Entry.ID, Record)) {
+    StringRef Blob;
+    switch (Stream.readRecord(Entry.ID, Record, &Blob)) {
     default:  // Default behavior: unknown type.
       break;
     case bitc::VST_CODE_ENTRY: {  // VST_ENTRY: [valueid, namechar x N]
-      ErrorOr<Value *> ValOrErr = recordValue(Record, 1, TT);
+      ErrorOr<Value *> ValOrErr = recordValue(Record, 1, TT, Blob);
       if (std::error_code EC = ValOrErr.getError())
         return EC;
       ValOrErr.get();
@@ -1804,7 +1862,7 @@ std::error_code BitcodeReader::parseValueSymbolTable(uint64_t Offset) {
     }
     case bitc::VST_CODE_FNENTRY: {
       // VST_FNENTRY: [valueid, offset, namechar x N]
-      ErrorOr<Value *> ValOrErr = recordValue(Record, 2, TT);
+      ErrorOr<Value *> ValOrErr = recordValue(Record, 2, TT, Blob);
       if (std::error_code EC = ValOrErr.getError())
         return EC;
       Value *V = ValOrErr.get();
@@ -1846,6 +1904,50 @@ std::error_code BitcodeReader::parseValueSymbolTable(uint64_t Offset) {
   }
 }
 
+/// Split the blob of a METADATA_STRINGS record into its strings, which refer
+/// to the characters in Blob.
+std::error_code
+BitcodeReader::parseMetadataStrings(ArrayRef<uint64_t> Record, StringRef Blob,
+                                    std::vector<StringRef> &Strings) {
+  // METADATA_STRINGS: [count, offset] blob([lengths][chars])
+  if (Record.size() != 2 || !Blob.data())
+    return error("Invalid record");
+
+  unsigned NumStrings = Record[0];
+  uint64_t StringsOffset = Record[1];
+  if (!NumStrings || StringsOffset > Blob.size() || StringsOffset % 4)
+    return error("Invalid record");
+
+  StringRef Lengths = Blob.slice(0, StringsOffset);
+  StringRef Chars = Blob.drop_front(StringsOffset);
+  BitstreamReader R((const unsigned char *)Lengths.begin(),
+                    (const unsigned char *)Lengths.end());
+  BitstreamCursor Cursor(R);
+
+  Strings.reserve(Strings.size() + NumStrings);
+  for (; NumStrings; --NumStrings) {
+    if (Cursor.AtEndOfStream())
+      return error("Invalid record");
+    uint64_t Size = Cursor.ReadVBR(6);
+    if (Size > Chars.size())
+      return error("Invalid record");
+    Strings.push_back(Chars.slice(0, Size));
+    Chars = Chars.drop_front(Size);
+  }
+  return std::error_code();
+}
+
+/// Get the MDString of the characters of a METADATA_STRINGS record. Only the
+/// strings that need an upgrade are copied first.
+MDString *BitcodeReader::createMDString(StringRef Str) {
+  if (Str.startswith("llvm.vectorizer.")) {
+    std::string String = Str;
+    llvm::UpgradeMDStringConstant(String);
+    return MDString::get(Context, String);
+  }
+  return MDString::get(Context, Str);
+}
+
 /// Parse a single METADATA_KIND record, inserting result in MDKindMap.
 std::error_code
 BitcodeReader::parseMetadataKindRecord(SmallVectorImpl<uint64_t> &Record) {
@@ -1888,23 +1990,6 @@ std::error_code BitcodeReader::parseMetadata(bool ModuleLevel) {
 
   SmallVector<uint64_t, 64> Record;
 
-  auto getMD = [&](unsigned ID) -> Metadata * {
-    return MetadataList.getValueFwdRef(ID);
-  };
-  auto getMDOrNull = [&](unsigned ID) -> Metadata *{
-    if (ID)
-      return getMD(ID - 1);
-    return nullptr;
-  };
-  auto getMDString = [&](unsigned ID) -> MDString *{
-    // This requires that the ID is not really a forward reference.  In
-    // particular, the MDString must already have been resolved.
-    return cast_or_null<MDString>(getMDOrNull(ID));
-  };
-
-#define GET_OR_DISTINCT(CLASS, DISTINCT, ARGS)                                 \
-  (DISTINCT ? CLASS::getDistinct ARGS : CLASS::get ARGS)
-
   // Read all the records.
   while (1) {
     BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
@@ -1926,455 +2011,492 @@ std::error_code BitcodeReader::parseMetadata(bool ModuleLevel) {
 
     // Read a record.
     Record.clear();
-    unsigned Code = Stream.readRecord(Entry.ID, Record);
-    bool IsDistinct = false;
-    switch (Code) {
-    default:  // Default behavior: ignore.
-      break;
-    case bitc::METADATA_NAME: {
-      // Read name of the named metadata.
-      SmallString<8> Name(Record.begin(), Record.end());
-      Record.clear();
-      Code = Stream.ReadCode();
-
-      unsigned NextBitCode = Stream.readRecord(Code, Record);
-      if (NextBitCode != bitc::METADATA_NAMED_NODE)
-        return error("METADATA_NAME not followed by METADATA_NAMED_NODE");
+    StringRef Blob;
+    unsigned Code = Stream.readRecord(Entry.ID, Record, &Blob);
+    if (std::error_code EC =
+            parseMetadataRecord(Stream, Code, Record, Blob, NextMetadataNo))
+      return EC;
+  }
+}
 
-      // Read named metadata elements.
-      unsigned Size = Record.size();
-      NamedMDNode *NMD = TheModule->getOrInsertNamedMetadata(Name);
-      for (unsigned i = 0; i != Size; ++i) {
-        MDNode *MD =
-            dyn_cast_or_null<MDNode>(MetadataList.getValueFwdRef(Record[i]));
-        if (!MD)
-          return error("Invalid record");
-        NMD->addOperand(MD);
-      }
-      break;
-    }
-    case bitc::METADATA_OLD_FN_NODE: {
-      // FIXME: Remove in 4.0.
-      // This is a LocalAsMetadata record, the only type of function-local
-      // metadata.
-      if (Record.size() % 2 == 1)
-        return error("Invalid record");
-
-      // If this isn't a LocalAsMetadata record, we're dropping it.  This used
-      // to be legal, but there's no upgrade path.
-      auto dropRecord = [&] {
-        MetadataList.assignValue(MDNode::get(Context, None), NextMetadataNo++);
-      };
-      if (Record.size() != 2) {
-        dropRecord();
-        break;
-      }
+/// Parse one record of a METADATA_BLOCK, read from Cursor along with its Blob.
+/// A record that defines a metadata value assigns it the ID NextMetadataNo.
+std::error_code
+BitcodeReader::parseMetadataRecord(BitstreamCursor &Cursor, unsigned Code,
+                                   SmallVectorImpl<uint64_t> &Record,
+                                   StringRef Blob, unsigned &NextMetadataNo) {
+  auto getMD = [&](unsigned ID) -> Metadata * {
+    return getMetadataFwdRef(ID);
+  };
+  auto getMDOrNull = [&](unsigned ID) -> Metadata *{
+    if (ID)
+      return getMD(ID - 1);
+    return nullptr;
+  };
+  auto getMDString = [&](unsigned ID) -> MDString *{
+    // This requires that the ID is not really a forward reference.  In
+    // particular, the MDString must already have been resolved.
+    return cast_or_null<MDString>(getMDOrNull(ID));
+  };
 
-      Type *Ty = getTypeByID(Record[0]);
-      if (Ty->isMetadataTy() || Ty->isVoidTy()) {
-        dropRecord();
-        break;
-      }
+#define GET_OR_DISTINCT(CLASS, DISTINCT, ARGS)                                 \
+  (DISTINCT ? CLASS::getDistinct ARGS : CLASS::get ARGS)
 
-      MetadataList.assignValue(
-          LocalAsMetadata::get(ValueList.getValueFwdRef(Record[1], Ty)),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_OLD_NODE: {
-      // FIXME: Remove in 4.0.
-      if (Record.size() % 2 == 1)
-        return error("Invalid record");
+  bool IsDistinct = false;
+  switch (Code) {
+  default:  // Default behavior: ignore.
+    break;
+  case bitc::METADATA_NAME: {
+    // Read name of the named metadata.
+    SmallString<8> Name(Record.begin(), Record.end());
+    Record.clear();
+    Code = Cursor.ReadCode();
 
-      unsigned Size = Record.size();
-      SmallVector<Metadata *, 8> Elts;
-      for (unsigned i = 0; i != Size; i += 2) {
-        Type *Ty = getTypeByID(Record[i]);
-        if (!Ty)
-          return error("Invalid record");
-        if (Ty->isMetadataTy())
-          Elts.push_back(MetadataList.getValueFwdRef(Record[i + 1]));
-        else if (!Ty->isVoidTy()) {
-          auto *MD =
-              ValueAsMetadata::get(ValueList.getValueFwdRef(Record[i + 1], Ty));
-          assert(isa<ConstantAsMetadata>(MD) &&
-                 "Expected non-function-local metadata");
-          Elts.push_back(MD);
-        } else
-          Elts.push_back(nullptr);
-      }
-      MetadataList.assignValue(MDNode::get(Context, Elts), NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_VALUE: {
-      if (Record.size() != 2)
-        return error("Invalid record");
+    unsigned NextBitCode = Cursor.readRecord(Code, Record);
+    if (NextBitCode != bitc::METADATA_NAMED_NODE)
+      return error("METADATA_NAME not followed by METADATA_NAMED_NODE");
 
-      Type *Ty = getTypeByID(Record[0]);
-      if (Ty->isMetadataTy() || Ty->isVoidTy())
+    // Read named metadata elements.
+    unsigned Size = Record.size();
+    NamedMDNode *NMD = TheModule->getOrInsertNamedMetadata(Name);
+    for (unsigned i = 0; i != Size; ++i) {
+      MDNode *MD = dyn_cast_or_null<MDNode>(getMetadataFwdRef(Record[i]));
+      if (!MD)
         return error("Invalid record");
-
-      MetadataList.assignValue(
-          ValueAsMetadata::get(ValueList.getValueFwdRef(Record[1], Ty)),
-          NextMetadataNo++);
-      break;
+      NMD->addOperand(MD);
     }
-    case bitc::METADATA_DISTINCT_NODE:
-      IsDistinct = true;
-      // fallthrough...
-    case bitc::METADATA_NODE: {
-      SmallVector<Metadata *, 8> Elts;
-      Elts.reserve(Record.size());
-      for (unsigned ID : Record)
-        Elts.push_back(ID ? MetadataList.getValueFwdRef(ID - 1) : nullptr);
-      MetadataList.assignValue(IsDistinct ? MDNode::getDistinct(Context, Elts)
-                                          : MDNode::get(Context, Elts),
-                               NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_OLD_FN_NODE: {
+    // FIXME: Remove in 4.0.
+    // This is a LocalAsMetadata record, the only type of function-local
+    // metadata.
+    if (Record.size() % 2 == 1)
+      return error("Invalid record");
+
+    // If this isn't a LocalAsMetadata record, we're dropping it.  This used
+    // to be legal, but there's no upgrade path.
+    auto dropRecord = [&] {
+      MetadataList.assignValue(MDNode::get(Context, None), NextMetadataNo++);
+    };
+    if (Record.size() != 2) {
+      dropRecord();
       break;
     }
-    case bitc::METADATA_LOCATION: {
-      if (Record.size() != 5)
-        return error("Invalid record");
 
-      unsigned Line = Record[1];
-      unsigned Column = Record[2];
-      MDNode *Scope = cast<MDNode>(MetadataList.getValueFwdRef(Record[3]));
-      Metadata *InlinedAt =
-          Record[4] ? MetadataList.getValueFwdRef(Record[4] - 1) : nullptr;
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DILocation, Record[0],
-                          (Context, Line, Column, Scope, InlinedAt)),
-          NextMetadataNo++);
+    Type *Ty = getTypeByID(Record[0]);
+    if (Ty->isMetadataTy() || Ty->isVoidTy()) {
+      dropRecord();
       break;
     }
-    case bitc::METADATA_GENERIC_DEBUG: {
-      if (Record.size() < 4)
-        return error("Invalid record");
 
-      unsigned Tag = Record[1];
-      unsigned Version = Record[2];
+    MetadataList.assignValue(
+        LocalAsMetadata::get(ValueList.getValueFwdRef(Record[1], Ty)),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_OLD_NODE: {
+    // FIXME: Remove in 4.0.
+    if (Record.size() % 2 == 1)
+      return error("Invalid record");
 
-      if (Tag >= 1u << 16 || Version != 0)
+    unsigned Size = Record.size();
+    SmallVector<Metadata *, 8> Elts;
+    for (unsigned i = 0; i != Size; i += 2) {
+      Type *Ty = getTypeByID(Record[i]);
+      if (!Ty)
         return error("Invalid record");
-
-      auto *Header = getMDString(Record[3]);
-      SmallVector<Metadata *, 8> DwarfOps;
-      for (unsigned I = 4, E = Record.size(); I != E; ++I)
-        DwarfOps.push_back(
-            Record[I] ? MetadataList.getValueFwdRef(Record[I] - 1) : nullptr);
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(GenericDINode, Record[0],
-                          (Context, Tag, Header, DwarfOps)),
-          NextMetadataNo++);
-      break;
+      if (Ty->isMetadataTy())
+        Elts.push_back(getMetadataFwdRef(Record[i + 1]));
+      else if (!Ty->isVoidTy()) {
+        auto *MD =
+            ValueAsMetadata::get(ValueList.getValueFwdRef(Record[i + 1], Ty));
+        assert(isa<ConstantAsMetadata>(MD) &&
+               "Expected non-function-local metadata");
+        Elts.push_back(MD);
+      } else
+        Elts.push_back(nullptr);
     }
-    case bitc::METADATA_SUBRANGE: {
-      if (Record.size() != 3)
-        return error("Invalid record");
+    MetadataList.assignValue(MDNode::get(Context, Elts), NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_VALUE: {
+    if (Record.size() != 2)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DISubrange, Record[0],
-                          (Context, Record[1], unrotateSign(Record[2]))),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_ENUMERATOR: {
-      if (Record.size() != 3)
-        return error("Invalid record");
+    Type *Ty = getTypeByID(Record[0]);
+    if (Ty->isMetadataTy() || Ty->isVoidTy())
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(
-              DIEnumerator, Record[0],
-              (Context, unrotateSign(Record[1]), getMDString(Record[2]))),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_BASIC_TYPE: {
-      if (Record.size() != 6)
-        return error("Invalid record");
+    MetadataList.assignValue(
+        ValueAsMetadata::get(ValueList.getValueFwdRef(Record[1], Ty)),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_DISTINCT_NODE:
+    IsDistinct = true;
+    // fallthrough...
+  case bitc::METADATA_NODE: {
+    SmallVector<Metadata *, 8> Elts;
+    Elts.reserve(Record.size());
+    for (unsigned ID : Record)
+      Elts.push_back(ID ? getMetadataFwdRef(ID - 1) : nullptr);
+    MetadataList.assignValue(IsDistinct ? MDNode::getDistinct(Context, Elts)
+                                        : MDNode::get(Context, Elts),
+                             NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_LOCATION: {
+    if (Record.size() != 5)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DIBasicType, Record[0],
-                          (Context, Record[1], getMDString(Record[2]),
-                           Record[3], Record[4], Record[5])),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_DERIVED_TYPE: {
-      if (Record.size() != 12)
-        return error("Invalid record");
+    unsigned Line = Record[1];
+    unsigned Column = Record[2];
+    MDNode *Scope = cast<MDNode>(getMetadataFwdRef(Record[3]));
+    Metadata *InlinedAt =
+        Record[4] ? getMetadataFwdRef(Record[4] - 1) : nullptr;
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DILocation, Record[0],
+                        (Context, Line, Column, Scope, InlinedAt)),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_GENERIC_DEBUG: {
+    if (Record.size() < 4)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DIDerivedType, Record[0],
-                          (Context, Record[1], getMDString(Record[2]),
-                           getMDOrNull(Record[3]), Record[4],
-                           getMDOrNull(Record[5]), getMDOrNull(Record[6]),
-                           Record[7], Record[8], Record[9], Record[10],
-                           getMDOrNull(Record[11]))),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_COMPOSITE_TYPE: {
-      if (Record.size() != 16)
-        return error("Invalid record");
+    unsigned Tag = Record[1];
+    unsigned Version = Record[2];
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DICompositeType, Record[0],
-                          (Context, Record[1], getMDString(Record[2]),
-                           getMDOrNull(Record[3]), Record[4],
-                           getMDOrNull(Record[5]), getMDOrNull(Record[6]),
-                           Record[7], Record[8], Record[9], Record[10],
-                           getMDOrNull(Record[11]), Record[12],
-                           getMDOrNull(Record[13]), getMDOrNull(Record[14]),
-                           getMDString(Record[15]))),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_SUBROUTINE_TYPE: {
-      if (Record.size() != 3)
-        return error("Invalid record");
+    if (Tag >= 1u << 16 || Version != 0)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DISubroutineType, Record[0],
-                          (Context, Record[1], getMDOrNull(Record[2]))),
-          NextMetadataNo++);
-      break;
-    }
+    auto *Header = getMDString(Record[3]);
+    SmallVector<Metadata *, 8> DwarfOps;
+    for (unsigned I = 4, E = Record.size(); I != E; ++I)
+      DwarfOps.push_back(
+          Record[I] ? getMetadataFwdRef(Record[I] - 1) : nullptr);
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(GenericDINode, Record[0],
+                        (Context, Tag, Header, DwarfOps)),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_SUBRANGE: {
+    if (Record.size() != 3)
+      return error("Invalid record");
 
-    case bitc::METADATA_MODULE: {
-      if (Record.size() != 6)
-        return error("Invalid record");
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DISubrange, Record[0],
+                        (Context, Record[1], unrotateSign(Record[2]))),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_ENUMERATOR: {
+    if (Record.size() != 3)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DIModule, Record[0],
-                          (Context, getMDOrNull(Record[1]),
-                           getMDString(Record[2]), getMDString(Record[3]),
-                           getMDString(Record[4]), getMDString(Record[5]))),
-          NextMetadataNo++);
-      break;
-    }
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(
+            DIEnumerator, Record[0],
+            (Context, unrotateSign(Record[1]), getMDString(Record[2]))),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_BASIC_TYPE: {
+    if (Record.size() != 6)
+      return error("Invalid record");
 
-    case bitc::METADATA_FILE: {
-      if (Record.size() != 3)
-        return error("Invalid record");
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DIBasicType, Record[0],
+                        (Context, Record[1], getMDString(Record[2]),
+                         Record[3], Record[4], Record[5])),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_DERIVED_TYPE: {
+    if (Record.size() != 12)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DIFile, Record[0], (Context, getMDString(Record[1]),
-                                              getMDString(Record[2]))),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_COMPILE_UNIT: {
-      if (Record.size() < 14 || Record.size() > 16)
-        return error("Invalid record");
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DIDerivedType, Record[0],
+                        (Context, Record[1], getMDString(Record[2]),
+                         getMDOrNull(Record[3]), Record[4],
+                         getMDOrNull(Record[5]), getMDOrNull(Record[6]),
+                         Record[7], Record[8], Record[9], Record[10],
+                         getMDOrNull(Record[11]))),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_COMPOSITE_TYPE: {
+    if (Record.size() != 16)
+      return error("Invalid record");
 
-      // Ignore Record[0], which indicates whether this compile unit is
-      // distinct.  It's always distinct.
-      MetadataList.assignValue(
-          DICompileUnit::getDistinct(
-              Context, Record[1], getMDOrNull(Record[2]),
-              getMDString(Record[3]), Record[4], getMDString(Record[5]),
-              Record[6], getMDString(Record[7]), Record[8],
-              getMDOrNull(Record[9]), getMDOrNull(Record[10]),
-              getMDOrNull(Record[11]), getMDOrNull(Record[12]),
-              getMDOrNull(Record[13]),
-              Record.size() <= 15 ? 0 : getMDOrNull(Record[15]),
-              Record.size() <= 14 ? 0 : Record[14]),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_SUBPROGRAM: {
-      if (Record.size() != 18 && Record.size() != 19)
-        return error("Invalid record");
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DICompositeType, Record[0],
+                        (Context, Record[1], getMDString(Record[2]),
+                         getMDOrNull(Record[3]), Record[4],
+                         getMDOrNull(Record[5]), getMDOrNull(Record[6]),
+                         Record[7], Record[8], Record[9], Record[10],
+                         getMDOrNull(Record[11]), Record[12],
+                         getMDOrNull(Record[13]), getMDOrNull(Record[14]),
+                         getMDString(Record[15]))),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_SUBROUTINE_TYPE: {
+    if (Record.size() != 3)
+      return error("Invalid record");
 
-      bool HasFn = Record.size() == 19;
-      DISubprogram *SP = GET_OR_DISTINCT(
-          DISubprogram,
-          Record[0] || Record[8], // All definitions should be distinct.
-          (Context, getMDOrNull(Record[1]), getMDString(Record[2]),
-           getMDString(Record[3]), getMDOrNull(Record[4]), Record[5],
-           getMDOrNull(Record[6]), Record[7], Record[8], Record[9],
-           getMDOrNull(Record[10]), Record[11], Record[12], Record[13],
-           Record[14], getMDOrNull(Record[15 + HasFn]),
-           getMDOrNull(Record[16 + HasFn]), getMDOrNull(Record[17 + HasFn])));
-      MetadataList.assignValue(SP, NextMetadataNo++);
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DISubroutineType, Record[0],
+                        (Context, Record[1], getMDOrNull(Record[2]))),
+        NextMetadataNo++);
+    break;
+  }
 
-      // Upgrade sp->function mapping to function->sp mapping.
-      if (HasFn && Record[15]) {
-        if (auto *CMD = dyn_cast<ConstantAsMetadata>(getMDOrNull(Record[15])))
-          if (auto *F = dyn_cast<Function>(CMD->getValue())) {
-            if (F->isMaterializable())
-              // Defer until materialized; unmaterialized functions may not have
-              // metadata.
-              FunctionsWithSPs[F] = SP;
-            else if (!F->empty())
-              F->setSubprogram(SP);
-          }
-      }
-      break;
-    }
-    case bitc::METADATA_LEXICAL_BLOCK: {
-      if (Record.size() != 5)
-        return error("Invalid record");
+  case bitc::METADATA_MODULE: {
+    if (Record.size() != 6)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DILexicalBlock, Record[0],
-                          (Context, getMDOrNull(Record[1]),
-                           getMDOrNull(Record[2]), Record[3], Record[4])),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_LEXICAL_BLOCK_FILE: {
-      if (Record.size() != 4)
-        return error("Invalid record");
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DIModule, Record[0],
+                        (Context, getMDOrNull(Record[1]),
+                         getMDString(Record[2]), getMDString(Record[3]),
+                         getMDString(Record[4]), getMDString(Record[5]))),
+        NextMetadataNo++);
+    break;
+  }
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DILexicalBlockFile, Record[0],
-                          (Context, getMDOrNull(Record[1]),
-                           getMDOrNull(Record[2]), Record[3])),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_NAMESPACE: {
-      if (Record.size() != 5)
-        return error("Invalid record");
+  case bitc::METADATA_FILE: {
+    if (Record.size() != 3)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DINamespace, Record[0],
-                          (Context, getMDOrNull(Record[1]),
-                           getMDOrNull(Record[2]), getMDString(Record[3]),
-                           Record[4])),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_MACRO: {
-      if (Record.size() != 5)
-        return error("Invalid record");
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DIFile, Record[0], (Context, getMDString(Record[1]),
+                                            getMDString(Record[2]))),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_COMPILE_UNIT: {
+    if (Record.size() < 14 || Record.size() > 16)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DIMacro, Record[0],
-                          (Context, Record[1], Record[2],
-                           getMDString(Record[3]), getMDString(Record[4]))),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_MACRO_FILE: {
-      if (Record.size() != 5)
-        return error("Invalid record");
+    // Ignore Record[0], which indicates whether this compile unit is
+    // distinct.  It's always distinct.
+    MetadataList.assignValue(
+        DICompileUnit::getDistinct(
+            Context, Record[1], getMDOrNull(Record[2]),
+            getMDString(Record[3]), Record[4], getMDString(Record[5]),
+            Record[6], getMDString(Record[7]), Record[8],
+            getMDOrNull(Record[9]), getMDOrNull(Record[10]),
+            getMDOrNull(Record[11]), getMDOrNull(Record[12]),
+            getMDOrNull(Record[13]),
+            Record.size() <= 15 ? 0 : getMDOrNull(Record[15]),
+            Record.size() <= 14 ? 0 : Record[14]),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_SUBPROGRAM: {
+    if (Record.size() != 18 && Record.size() != 19)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DIMacroFile, Record[0],
-                          (Context, Record[1], Record[2],
-                           getMDOrNull(Record[3]), getMDOrNull(Record[4]))),
-          NextMetadataNo++);
-      break;
+    bool HasFn = Record.size() == 19;
+    DISubprogram *SP = GET_OR_DISTINCT(
+        DISubprogram,
+        Record[0] || Record[8], // All definitions should be distinct.
+        (Context, getMDOrNull(Record[1]), getMDString(Record[2]),
+         getMDString(Record[3]), getMDOrNull(Record[4]), Record[5],
+         getMDOrNull(Record[6]), Record[7], Record[8], Record[9],
+         getMDOrNull(Record[10]), Record[11], Record[12], Record[13],
+         Record[14], getMDOrNull(Record[15 + HasFn]),
+         getMDOrNull(Record[16 + HasFn]), getMDOrNull(Record[17 + HasFn])));
+    MetadataList.assignValue(SP, NextMetadataNo++);
+
+    // Upgrade sp->function mapping to function->sp mapping.
+    if (HasFn && Record[15]) {
+      if (auto *CMD = dyn_cast<ConstantAsMetadata>(getMDOrNull(Record[15])))
+        if (auto *F = dyn_cast<Function>(CMD->getValue())) {
+          if (F->isMaterializable())
+            // Defer until materialized; unmaterialized functions may not have
+            // metadata.
+            FunctionsWithSPs[F] = SP;
+          else if (!F->empty())
+            F->setSubprogram(SP);
+        }
     }
-    case bitc::METADATA_TEMPLATE_TYPE: {
-      if (Record.size() != 3)
-        return error("Invalid record");
+    break;
+  }
+  case bitc::METADATA_LEXICAL_BLOCK: {
+    if (Record.size() != 5)
+      return error("Invalid record");
 
-      MetadataList.assignValue(GET_OR_DISTINCT(DITemplateTypeParameter,
-                                               Record[0],
-                                               (Context, getMDString(Record[1]),
-                                                getMDOrNull(Record[2]))),
-                               NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_TEMPLATE_VALUE: {
-      if (Record.size() != 5)
-        return error("Invalid record");
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DILexicalBlock, Record[0],
+                        (Context, getMDOrNull(Record[1]),
+                         getMDOrNull(Record[2]), Record[3], Record[4])),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_LEXICAL_BLOCK_FILE: {
+    if (Record.size() != 4)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DITemplateValueParameter, Record[0],
-                          (Context, Record[1], getMDString(Record[2]),
-                           getMDOrNull(Record[3]), getMDOrNull(Record[4]))),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_GLOBAL_VAR: {
-      if (Record.size() != 11)
-        return error("Invalid record");
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DILexicalBlockFile, Record[0],
+                        (Context, getMDOrNull(Record[1]),
+                         getMDOrNull(Record[2]), Record[3])),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_NAMESPACE: {
+    if (Record.size() != 5)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DIGlobalVariable, Record[0],
-                          (Context, getMDOrNull(Record[1]),
-                           getMDString(Record[2]), getMDString(Record[3]),
-                           getMDOrNull(Record[4]), Record[5],
-                           getMDOrNull(Record[6]), Record[7], Record[8],
-                           getMDOrNull(Record[9]), getMDOrNull(Record[10]))),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_LOCAL_VAR: {
-      // 10th field is for the obseleted 'inlinedAt:' field.
-      if (Record.size() < 8 || Record.size() > 10)
-        return error("Invalid record");
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DINamespace, Record[0],
+                        (Context, getMDOrNull(Record[1]),
+                         getMDOrNull(Record[2]), getMDString(Record[3]),
+                         Record[4])),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_MACRO: {
+    if (Record.size() != 5)
+      return error("Invalid record");
 
-      // 2nd field used to be an artificial tag, either DW_TAG_auto_variable or
-      // DW_TAG_arg_variable.
-      bool HasTag = Record.size() > 8;
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DILocalVariable, Record[0],
-                          (Context, getMDOrNull(Record[1 + HasTag]),
-                           getMDString(Record[2 + HasTag]),
-                           getMDOrNull(Record[3 + HasTag]), Record[4 + HasTag],
-                           getMDOrNull(Record[5 + HasTag]), Record[6 + HasTag],
-                           Record[7 + HasTag])),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_EXPRESSION: {
-      if (Record.size() < 1)
-        return error("Invalid record");
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DIMacro, Record[0],
+                        (Context, Record[1], Record[2],
+                         getMDString(Record[3]), getMDString(Record[4]))),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_MACRO_FILE: {
+    if (Record.size() != 5)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DIExpression, Record[0],
-                          (Context, makeArrayRef(Record).slice(1))),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_OBJC_PROPERTY: {
-      if (Record.size() != 8)
-        return error("Invalid record");
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DIMacroFile, Record[0],
+                        (Context, Record[1], Record[2],
+                         getMDOrNull(Record[3]), getMDOrNull(Record[4]))),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_TEMPLATE_TYPE: {
+    if (Record.size() != 3)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DIObjCProperty, Record[0],
-                          (Context, getMDString(Record[1]),
-                           getMDOrNull(Record[2]), Record[3],
-                           getMDString(Record[4]), getMDString(Record[5]),
-                           Record[6], getMDOrNull(Record[7]))),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_IMPORTED_ENTITY: {
-      if (Record.size() != 6)
-        return error("Invalid record");
+    MetadataList.assignValue(GET_OR_DISTINCT(DITemplateTypeParameter,
+                                             Record[0],
+                                             (Context, getMDString(Record[1]),
+                                              getMDOrNull(Record[2]))),
+                             NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_TEMPLATE_VALUE: {
+    if (Record.size() != 5)
+      return error("Invalid record");
 
-      MetadataList.assignValue(
-          GET_OR_DISTINCT(DIImportedEntity, Record[0],
-                          (Context, Record[1], getMDOrNull(Record[2]),
-                           getMDOrNull(Record[3]), Record[4],
-                           getMDString(Record[5]))),
-          NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_STRING: {
-      std::string String(Record.begin(), Record.end());
-      llvm::UpgradeMDStringConstant(String);
-      Metadata *MD = MDString::get(Context, String);
-      MetadataList.assignValue(MD, NextMetadataNo++);
-      break;
-    }
-    case bitc::METADATA_KIND: {
-      // Support older bitcode files that had METADATA_KIND records in a
-      // block with METADATA_BLOCK_ID.
-      if (std::error_code EC = parseMetadataKindRecord(Record))
-        return EC;
-      break;
-    }
-    }
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DITemplateValueParameter, Record[0],
+                        (Context, Record[1], getMDString(Record[2]),
+                         getMDOrNull(Record[3]), getMDOrNull(Record[4]))),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_GLOBAL_VAR: {
+    if (Record.size() != 11)
+      return error("Invalid record");
+
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DIGlobalVariable, Record[0],
+                        (Context, getMDOrNull(Record[1]),
+                         getMDString(Record[2]), getMDString(Record[3]),
+                         getMDOrNull(Record[4]), Record[5],
+                         getMDOrNull(Record[6]), Record[7], Record[8],
+                         getMDOrNull(Record[9]), getMDOrNull(Record[10]))),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_LOCAL_VAR: {
+    // 10th field is for the obseleted 'inlinedAt:' field.
+    if (Record.size() < 8 || Record.size() > 10)
+      return error("Invalid record");
+
+    // 2nd field used to be an artificial tag, either DW_TAG_auto_variable or
+    // DW_TAG_arg_variable.
+    bool HasTag = Record.size() > 8;
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DILocalVariable, Record[0],
+                        (Context, getMDOrNull(Record[1 + HasTag]),
+                         getMDString(Record[2 + HasTag]),
+                         getMDOrNull(Record[3 + HasTag]), Record[4 + HasTag],
+                         getMDOrNull(Record[5 + HasTag]), Record[6 + HasTag],
+                         Record[7 + HasTag])),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_EXPRESSION: {
+    if (Record.size() < 1)
+      return error("Invalid record");
+
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DIExpression, Record[0],
+                        (Context, makeArrayRef(Record).slice(1))),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_OBJC_PROPERTY: {
+    if (Record.size() != 8)
+      return error("Invalid record");
+
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DIObjCProperty, Record[0],
+                        (Context, getMDString(Record[1]),
+                         getMDOrNull(Record[2]), Record[3],
+                         getMDString(Record[4]), getMDString(Record[5]),
+                         Record[6], getMDOrNull(Record[7]))),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_IMPORTED_ENTITY: {
+    if (Record.size() != 6)
+      return error("Invalid record");
+
+    MetadataList.assignValue(
+        GET_OR_DISTINCT(DIImportedEntity, Record[0],
+                        (Context, Record[1], getMDOrNull(Record[2]),
+                         getMDOrNull(Record[3]), Record[4],
+                         getMDString(Record[5]))),
+        NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_STRING: {
+    std::string String(Record.begin(), Record.end());
+    llvm::UpgradeMDStringConstant(String);
+    Metadata *MD = MDString::get(Context, String);
+    MetadataList.assignValue(MD, NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_STRINGS: {
+    std::vector<StringRef> Strings;
+    if (std::error_code EC = parseMetadataStrings(Record, Blob, Strings))
+      return EC;
+    for (StringRef Str : Strings)
+      MetadataList.assignValue(createMDString(Str), NextMetadataNo++);
+    break;
+  }
+  case bitc::METADATA_KIND: {
+    // Support older bitcode files that had METADATA_KIND records in a
+    // block with METADATA_BLOCK_ID.
+    if (std::error_code EC = parseMetadataKindRecord(Record))
+      return EC;
+    break;
+  }
   }
 #undef GET_OR_DISTINCT
+  return std::error_code();
 }
 
 /// Parse the metadata kinds out of the METADATA_KIND_BLOCK.
@@ -3055,6 +3177,18 @@ std::error_code BitcodeReader::rememberAndSkipMetadata() {
 }
 
 std::error_code BitcodeReader::materializeMetadata() {
+  // Only the single module-level block of current bitcode can have an index.
+  if (LazyLoadMetadataNodes && DeferredMetadataInfo.size() == 1) {
+    bool HasIndex;
+    if (std::error_code EC =
+            parseMetadataIndex(DeferredMetadataInfo.front(), HasIndex))
+      return EC;
+    if (HasIndex) {
+      DeferredMetadataInfo.clear();
+      return std::error_code();
+    }
+  }
+
   for (uint64_t BitPos : DeferredMetadataInfo) {
     // Move the bit stream to the saved position.
     Stream.JumpToBit(BitPos);
@@ -3065,13 +3199,207 @@ std::error_code BitcodeReader::materializeMetadata() {
   return std::error_code();
 }
 
+/// Prepare the module-level METADATA_BLOCK at BlockBit to be parsed on demand,
+/// if it starts with a METADATA_INDEX_OFFSET record, after the strings if
+/// any, and the count of its IDs is known. The records that follow the index, such as the named metadata,
+/// are parsed now, along with the nodes they reference. The other nodes are
+/// parsed by getMetadataFwdRef when they are first referenced.
+std::error_code BitcodeReader::parseMetadataIndex(uint64_t BlockBit,
+                                                  bool &HasIndex) {
+  HasIndex = false;
+  if (!SeenModuleValuesRecord)
+    return std::error_code();
+
+  MetadataCursor.init(StreamFile.get());
+  MetadataCursor.JumpToBit(BlockBit);
+  if (MetadataCursor.EnterSubBlock(bitc::METADATA_BLOCK_ID))
+    return error("Invalid record");
+
+  // The strings come first, in a METADATA_STRINGS record if any. They are
+  // created when they are referenced, from the characters in the buffer of
+  // the file. A streamed file may move them, so they are created right away.
+  SmallVector<uint64_t, 64> Record;
+  std::vector<StringRef> Strings;
+  BitstreamEntry Entry = MetadataCursor.advanceSkippingSubblocks();
+  if (Entry.Kind != BitstreamEntry::Record)
+    return std::error_code();
+  StringRef Blob;
+  unsigned Code = MetadataCursor.readRecord(Entry.ID, Record, &Blob);
+  if (Code == bitc::METADATA_STRINGS) {
+    if (std::error_code EC = parseMetadataStrings(Record, Blob, Strings))
+      return EC;
+    Entry = MetadataCursor.advanceSkippingSubblocks();
+    if (Entry.Kind != BitstreamEntry::Record)
+      return std::error_code();
+    Record.clear();
+    Code = MetadataCursor.readRecord(Entry.ID, Record);
+  }
+  if (Code != bitc::METADATA_INDEX_OFFSET)
+    return std::error_code();
+  if (Record.size() != 2)
+    return error("Invalid record");
+  uint64_t Pos = MetadataCursor.GetCurrentBitNo();
+  uint64_t IndexBit = Pos + (Record[0] | (Record[1] << 32));
+  if (!MetadataCursor.canSkipToPos(IndexBit / 8))
+    return error("Invalid record");
+  unsigned NumStrings = Strings.size();
+  if (NumStrings > NumModuleMDs)
+    return error("Invalid record");
+
+  // Read the index, which gives the position of each other record relative
+  // to the previous one, starting from the end of the offset record.
+  MetadataCursor.JumpToBit(IndexBit);
+  Entry = MetadataCursor.advanceSkippingSubblocks();
+  if (Entry.Kind != BitstreamEntry::Record)
+    return error("Invalid record");
+  Record.clear();
+  if (MetadataCursor.readRecord(Entry.ID, Record) != bitc::METADATA_INDEX ||
+      Record.size() != NumModuleMDs - NumStrings)
+    return error("Invalid record");
+  MetadataIndex.reserve(NumModuleMDs);
+  MetadataIndex.resize(NumStrings);
+  for (uint64_t Delta : Record) {
+    Pos += Delta;
+    if (Pos >= IndexBit)
+      return error("Invalid record");
+    MetadataIndex.push_back(Pos);
+  }
+  MetadataLoading.resize(NumModuleMDs);
+  NumMDIndexed += NumModuleMDs - NumStrings;
+  HasIndex = true;
+  IsMetadataMaterialized = true;
+
+  if (Buffer)
+    MDStringRef = std::move(Strings);
+  else
+    for (unsigned ID = 0; ID != NumStrings; ++ID)
+      MetadataList.assignValue(createMDString(Strings[ID]), ID);
+
+  // Functions parsed before the metadata was materialized may have left
+  // forward references to it.
+  for (unsigned ID = 0; ID != NumModuleMDs; ++ID)
+    if (auto *N = dyn_cast_or_null<MDNode>(MetadataList[ID]))
+      if (N->isTemporary()) {
+        if (ID < MDStringRef.size())
+          lazyLoadMDString(ID);
+        else
+          lazyLoadMetadata(ID);
+      }
+
+  // Parse the rest of the block with a copy of the cursor: MetadataCursor
+  // has to stay inside of it.
+  BitstreamCursor Cursor = MetadataCursor;
+  unsigned NextMetadataNo = NumModuleMDs;
+  while (1) {
+    Entry = Cursor.advanceSkippingSubblocks();
+
+    switch (Entry.Kind) {
+    case BitstreamEntry::SubBlock: // Handled for us already.
+    case BitstreamEntry::Error:
+      return error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      MetadataList.tryToResolveCycles();
+      if (NextMetadataNo != NumModuleMDs)
+        return error("Inconsistent bitcode: METADATA_VALUES mismatch");
+      return std::error_code();
+    case BitstreamEntry::Record:
+      break;
+    }
+
+    Record.clear();
+    StringRef Blob;
+    unsigned Code = Cursor.readRecord(Entry.ID, Record, &Blob);
+    if (std::error_code EC =
+            parseMetadataRecord(Cursor, Code, Record, Blob, NextMetadataNo))
+      return EC;
+  }
+}
+
+Metadata *BitcodeReader::getMetadataFwdRef(unsigned ID) {
+  if (ID < MetadataIndex.size() && !MetadataList[ID]) {
+    if (ID < MDStringRef.size())
+      lazyLoadMDString(ID);
+    else if (!MetadataLoading[ID])
+      lazyLoadMetadata(ID);
+  }
+  return MetadataList.getValueFwdRef(ID);
+}
+
+void BitcodeReader::lazyLoadMDString(unsigned ID) {
+  MetadataList.assignValue(createMDString(MDStringRef[ID]), ID);
+  ++NumMDStringsOnDemand;
+}
+
+// The nodes referenced by a node being parsed on demand are parsed
+// recursively. Past this depth they are forward referenced and parsed after
+// the recursion unwinds instead, to bound the stack used.
+static const unsigned MaxMetadataLoadDepth = 32;
+
+/// Parse the module-level metadata ID from its record in the index, with the
+/// nodes it references that were not parsed yet, then resolve the cycles
+/// among them. A reference back to a node that is still being parsed is a
+/// forward reference, like in a sequential parse.
+void BitcodeReader::lazyLoadMetadata(unsigned ID) {
+  if (std::error_code EC = parseLazyMetadataRecord(ID))
+    report_fatal_error("Invalid module metadata: " + EC.message());
+  if (MetadataLoadDepth)
+    return;
+
+  while (!DeferredMetadataIDs.empty())
+    if (std::error_code EC =
+            parseLazyMetadataRecord(DeferredMetadataIDs.pop_back_val()))
+      report_fatal_error("Invalid module metadata: " + EC.message());
+  MetadataList.tryToResolveCycles();
+}
+
+std::error_code BitcodeReader::parseLazyMetadataRecord(unsigned ID) {
+  // The record is read in full before the nodes it references are parsed,
+  // which move the cursor.
+  MetadataCursor.JumpToBit(MetadataIndex[ID]);
+  BitstreamEntry Entry = MetadataCursor.advanceSkippingSubblocks();
+  if (Entry.Kind != BitstreamEntry::Record)
+    return error("Invalid record");
+  SmallVector<uint64_t, 64> Record;
+  StringRef Blob;
+  unsigned Code = MetadataCursor.readRecord(Entry.ID, Record, &Blob);
+
+  // Strings are needed right away and have no operands.
+  if (MetadataLoadDepth == MaxMetadataLoadDepth &&
+      Code != bitc::METADATA_STRING) {
+    DeferredMetadataIDs.push_back(ID);
+    return std::error_code();
+  }
+
+  MetadataLoading.set(ID);
+  ++MetadataLoadDepth;
+  unsigned NextMetadataNo = ID;
+  std::error_code EC =
+      parseMetadataRecord(MetadataCursor, Code, Record, Blob, NextMetadataNo);
+  if (!EC && NextMetadataNo != ID + 1)
+    EC = error("Invalid record");
+  ++NumMDParsedOnDemand;
+  --MetadataLoadDepth;
+  MetadataLoading.reset(ID);
+  return EC;
+}
+
+std::error_code BitcodeReader::materializeMetadataIDs(ArrayRef<unsigned> IDs) {
+  for (unsigned ID : IDs)
+    if (ID < MetadataIndex.size())
+      getMetadataFwdRef(ID);
+  return std::error_code();
+}
+
 void BitcodeReader::setStripDebugInfo() { StripDebugInfo = true; }
 
 void BitcodeReader::saveMetadataList(
     DenseMap<const Metadata *, unsigned> &MetadataToIDs, bool OnlyTempMD) {
   for (unsigned ID = 0; ID < MetadataList.size(); ++ID) {
     Metadata *MD = MetadataList[ID];
-    auto *N = dyn_cast_or_null<MDNode>(MD);
+    // Module-level metadata parsed on demand may not have been needed.
+    if (!MD)
+      continue;
+    auto *N = dyn_cast<MDNode>(MD);
     assert((!N || (N->isResolved() || N->isTemporary())) &&
            "Found non-resolved non-temp MDNode while saving metadata");
     // Save all values if !OnlyTempMD, otherwise just the temporary metadata.
@@ -3299,6 +3627,17 @@ std::error_code BitcodeReader::parseModule(uint64_t ResumeBit,
           break;
         }
         assert(DeferredMetadataInfo.empty() && "Unexpected deferred metadata");
+        if (LazyLoadMetadataNodes && !IsMetadataMaterialized) {
+          bool HasIndex;
+          if (std::error_code EC =
+                  parseMetadataIndex(Stream.GetCurrentBitNo(), HasIndex))
+            return EC;
+          if (HasIndex) {
+            if (Stream.SkipBlock())
+              return error("Invalid record");
+            break;
+          }
+        }
         if (std::error_code EC = parseMetadata(true))
           return EC;
         break;
@@ -3901,7 +4240,7 @@ std::error_code BitcodeReader::parseMetadataAttachment(Function &F) {
           auto K = MDKindMap.find(Record[I]);
           if (K == MDKindMap.end())
             return error("Invalid ID");
-          Metadata *MD = MetadataList.getValueFwdRef(Record[I + 1]);
+          Metadata *MD = getMetadataFwdRef(Record[I + 1]);
           F.setMetadata(K->second, cast<MDNode>(MD));
         }
         continue;
@@ -3915,7 +4254,7 @@ std::error_code BitcodeReader::parseMetadataAttachment(Function &F) {
           MDKindMap.find(Kind);
         if (I == MDKindMap.end())
           return error("Invalid ID");
-        Metadata *Node = MetadataList.getValueFwdRef(Record[i + 1]);
+        Metadata *Node = getMetadataFwdRef(Record[i + 1]);
         if (isa<LocalAsMetadata>(Node))
           // Drop the attachment.  This used to be legal, but there's no
           // upgrade path.
@@ -4082,9 +4421,9 @@ std::error_code BitcodeReader::parseFunctionBody(Function *F) {
 
       MDNode *Scope = nullptr, *IA = nullptr;
       if (ScopeID)
-        Scope = cast<MDNode>(MetadataList.getValueFwdRef(ScopeID - 1));
+        Scope = cast<MDNode>(getMetadataFwdRef(ScopeID - 1));
       if (IAID)
-        IA = cast<MDNode>(MetadataList.getValueFwdRef(IAID - 1));
+        IA = cast<MDNode>(getMetadataFwdRef(IAID - 1));
       LastLoc = DebugLoc::get(Line, Col, Scope, IA);
       I->setDebugLoc(LastLoc);
       I = nullptr;
@@ -5449,7 +5788,8 @@ std::error_code FunctionIndexBitcodeReader::parseValueSymbolTable() {
 
     // Read a record.
     Record.clear();
-    switch (Stream.readRecord(Entry.ID, Record)) {
+    StringRef Blob;
+    switch (Stream.readRecord(Entry.ID, Record, &Blob)) {
     default: // Default behavior: ignore (e.g. VST_CODE_BBENTRY records).
       break;
     case bitc::VST_CODE_FNENTRY: {
@@ -5466,7 +5806,8 @@ std::error_code FunctionIndexBitcodeReader::parseValueSymbolTable() {
         assert(SMI != SummaryMap.end() && "Summary info not found");
         FuncInfo->setFunctionSummary(std::move(SMI->second));
       }
-      TheIndex->addFunctionInfo(ValueName, std::move(FuncInfo));
+      TheIndex->addFunctionInfo(Blob.data() ? Blob : ValueName.str(),
+                                std::move(FuncInfo));
 
       ValueName.clear();
       break;
@@ -5839,6 +6180,9 @@ getBitcodeModuleImpl(std::unique_ptr<DataStreamer> Streamer, StringRef Name,
     return EC;
   };
 
+  if (!MaterializeAll)
+    R->setLazyLoadMetadataNodes();
+
   // Delay parsing Metadata if ShouldLazyLoadMetadata is true.
   if (std::error_code EC = R->parseBitcodeInto(std::move(Streamer), M.get(),
                                                ShouldLazyLoadMetadata))
@@ -33,11 +33,17 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Program.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cctype>
 #include <map>
 using namespace llvm;
 
+static cl::opt<unsigned> WriterThreads(
+    "bitcode-writer-threads", cl::Hidden, cl::init(1),
+    cl::desc("Number of threads that encode the function blocks of a module "
+             "(the output does not depend on it)"));
+
 /// These are manifest constants used by the bitcode writer. They do not need to
 /// be kept in sync with the reader, but need to be consistent within this file.
 enum {
@@ -1249,6 +1255,36 @@ static void WriteDIImportedEntity(const DIImportedEntity *N,
   Record.clear();
 }
 
+/// Write the module-level strings in a single METADATA_STRINGS record, whose
+/// blob holds their lengths as VBR6, padded to a word, followed by their
+/// characters. A reader can then refer to the characters in the buffer of the
+/// file rather than unpack each of them into a record.
+static void WriteMetadataStrings(ArrayRef<const Metadata *> Strings,
+                                 BitstreamWriter &Stream,
+                                 SmallVectorImpl<uint64_t> &Record,
+                                 unsigned StringsAbbrev) {
+  if (Strings.empty())
+    return;
+
+  // METADATA_STRINGS: [count, offset] blob([lengths][chars])
+  Record.push_back(bitc::METADATA_STRINGS);
+  Record.push_back(Strings.size());
+
+  SmallString<256> Blob;
+  {
+    BitstreamWriter W(Blob);
+    for (const Metadata *MD : Strings)
+      W.EmitVBR(cast<MDString>(MD)->getLength(), 6);
+    W.FlushToWord();
+  }
+  Record.push_back(Blob.size());
+  for (const Metadata *MD : Strings)
+    Blob.append(cast<MDString>(MD)->getString());
+
+  Stream.EmitRecordWithBlob(StringsAbbrev, Record, Blob);
+  Record.clear();
+}
+
 static void WriteModuleMetadata(const Module *M,
                                 const ValueEnumerator &VE,
                                 BitstreamWriter &Stream) {
@@ -1256,16 +1292,18 @@ static void WriteModuleMetadata(const Module *M,
   if (MDs.empty() && M->named_metadata_empty())
     return;
 
-  Stream.EnterSubblock(bitc::METADATA_BLOCK_ID, 3);
+  // The abbrevs of the index records need a fourth bit for the abbrev ids.
+  Stream.EnterSubblock(bitc::METADATA_BLOCK_ID, 4);
 
-  unsigned MDSAbbrev = 0;
+  unsigned StringsAbbrev = 0;
   if (VE.hasMDString()) {
-    // Abbrev for METADATA_STRING.
+    // Abbrev for METADATA_STRINGS.
     BitCodeAbbrev *Abbv = new BitCodeAbbrev();
-    Abbv->Add(BitCodeAbbrevOp(bitc::METADATA_STRING));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 8));
-    MDSAbbrev = Stream.EmitAbbrev(Abbv);
+    Abbv->Add(BitCodeAbbrevOp(bitc::METADATA_STRINGS));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+    StringsAbbrev = Stream.EmitAbbrev(Abbv);
   }
 
   // Initialize MDNode abbreviations.
@@ -1314,7 +1352,31 @@ static void WriteModuleMetadata(const Module *M,
   }
 
   SmallVector<uint64_t, 64> Record;
-  for (const Metadata *MD : MDs) {
+  WriteMetadataStrings(VE.getMDStrings(), Stream, Record, StringsAbbrev);
+
+  // After the strings, emit a placeholder for the offset of the
+  // METADATA_INDEX record, which follows the records of the other metadata
+  // values and gives the position of each of them, so that a lazy reader can
+  // parse them on demand. The offset is relative to the end of this record,
+  // and is patched once the index is written. It is 64-bit, split in two
+  // fixed 32-bit fields so that its size is known ahead of time. The layout
+  // and the record codes are the same as upstream's.
+  uint64_t IndexBaseBit = 0;
+  std::vector<uint64_t> IndexPos;
+  if (!MDs.empty()) {
+    BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+    Abbv->Add(BitCodeAbbrevOp(bitc::METADATA_INDEX_OFFSET));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 32));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 32));
+    unsigned OffsetAbbrev = Stream.EmitAbbrev(Abbv);
+    uint64_t Vals[] = {0, 0};
+    Stream.EmitRecord(bitc::METADATA_INDEX_OFFSET, Vals, OffsetAbbrev);
+    IndexBaseBit = Stream.GetCurrentBitNo();
+    IndexPos.reserve(VE.getNonMDStrings().size());
+  }
+
+  for (const Metadata *MD : VE.getNonMDStrings()) {
+    IndexPos.push_back(Stream.GetCurrentBitNo());
     if (const MDNode *N = dyn_cast<MDNode>(MD)) {
       assert(N->isResolved() && "Expected forward references to be resolved");
 
@@ -1328,17 +1390,24 @@ static void WriteModuleMetadata(const Module *M,
 #include "llvm/IR/Metadata.def"
       }
     }
-    if (const auto *MDC = dyn_cast<ConstantAsMetadata>(MD)) {
-      WriteValueAsMetadata(MDC, VE, Stream, Record);
-      continue;
-    }
-    const MDString *MDS = cast<MDString>(MD);
-    // Code: [strchar x N]
-    Record.append(MDS->bytes_begin(), MDS->bytes_end());
+    WriteValueAsMetadata(cast<ConstantAsMetadata>(MD), VE, Stream, Record);
+  }
 
-    // Emit the finished record.
-    Stream.EmitRecord(bitc::METADATA_STRING, Record, MDSAbbrev);
-    Record.clear();
+  // Write the index, delta encoded from the end of the offset record.
+  uint64_t IndexBit = Stream.GetCurrentBitNo();
+  if (!MDs.empty()) {
+    uint64_t PrevPos = IndexBaseBit;
+    for (uint64_t &Pos : IndexPos) {
+      uint64_t Delta = Pos - PrevPos;
+      PrevPos = Pos;
+      Pos = Delta;
+    }
+    BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+    Abbv->Add(BitCodeAbbrevOp(bitc::METADATA_INDEX));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
+    unsigned IndexAbbrev = Stream.EmitAbbrev(Abbv);
+    Stream.EmitRecord(bitc::METADATA_INDEX, IndexPos, IndexAbbrev);
   }
 
   // Write named metadata.
@@ -1357,6 +1426,13 @@ static void WriteModuleMetadata(const Module *M,
   }
 
   Stream.ExitBlock();
+
+  // Patch the offset of the index now that it has been flushed out.
+  if (!MDs.empty()) {
+    uint64_t IndexOffset = IndexBit - IndexBaseBit;
+    Stream.BackpatchWord(IndexBaseBit - 64, IndexOffset & 0xffffffff);
+    Stream.BackpatchWord(IndexBaseBit - 32, IndexOffset >> 32);
+  }
 }
 
 static void WriteFunctionLocalMetadata(const Function &F,
@@ -2240,38 +2316,26 @@ static void WriteValueSymbolTable(
 
   Stream.EnterSubblock(bitc::VALUE_SYMTAB_BLOCK_ID, 4);
 
-  // For the module-level VST, add abbrev Ids for the VST_CODE_FNENTRY
-  // records, which are not used in the per-function VSTs.
-  unsigned FnEntry8BitAbbrev;
-  unsigned FnEntry7BitAbbrev;
-  unsigned FnEntry6BitAbbrev;
+  // For the module-level VST, add abbrev Ids for the VST_CODE_ENTRY and
+  // VST_CODE_FNENTRY records with the name in a blob. Global names are long
+  // and numerous, and a reader can then take them from the buffer of the file
+  // rather than unpack each character into a record. The per-function VSTs
+  // keep the compact character arrays of the BLOCKINFO abbrevs.
+  unsigned EntryBlobAbbrev = 0;
+  unsigned FnEntryBlobAbbrev = 0;
   if (VSTOffsetPlaceholder > 0) {
-    // 8-bit fixed-width VST_FNENTRY function strings.
     BitCodeAbbrev *Abbv = new BitCodeAbbrev();
-    Abbv->Add(BitCodeAbbrevOp(bitc::VST_CODE_FNENTRY));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 8)); // value id
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 8)); // funcoffset
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 8));
-    FnEntry8BitAbbrev = Stream.EmitAbbrev(Abbv);
-
-    // 7-bit fixed width VST_FNENTRY function strings.
-    Abbv = new BitCodeAbbrev();
-    Abbv->Add(BitCodeAbbrevOp(bitc::VST_CODE_FNENTRY));
+    Abbv->Add(BitCodeAbbrevOp(bitc::VST_CODE_ENTRY));
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 8)); // value id
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 8)); // funcoffset
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 7));
-    FnEntry7BitAbbrev = Stream.EmitAbbrev(Abbv);
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+    EntryBlobAbbrev = Stream.EmitAbbrev(Abbv);
 
-    // 6-bit char6 VST_FNENTRY function strings.
     Abbv = new BitCodeAbbrev();
     Abbv->Add(BitCodeAbbrevOp(bitc::VST_CODE_FNENTRY));
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 8)); // value id
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 8)); // funcoffset
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Char6));
-    FnEntry6BitAbbrev = Stream.EmitAbbrev(Abbv);
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+    FnEntryBlobAbbrev = Stream.EmitAbbrev(Abbv);
   }
 
   // FIXME: Set up the abbrev, we know how many values there are!
@@ -2279,51 +2343,53 @@ static void WriteValueSymbolTable(
   SmallVector<unsigned, 64> NameVals;
 
   for (const ValueName &Name : VST) {
-    // Figure out the encoding to use for the name.
-    StringEncoding Bits =
-        getStringEncoding(Name.getKeyData(), Name.getKeyLength());
-
-    unsigned AbbrevToUse = VST_ENTRY_8_ABBREV;
-    NameVals.push_back(VE.getValueID(Name.getValue()));
+    if (VSTOffsetPlaceholder > 0) {
+      // VST_ENTRY:   [valueid] blob(name)
+      // VST_FNENTRY: [valueid, funcoffset] blob(name)
+      Function *F = dyn_cast<Function>(Name.getValue());
+      if (!F) {
+        // If value is an alias, need to get the aliased base object to
+        // see if it is a function.
+        auto *GA = dyn_cast<GlobalAlias>(Name.getValue());
+        if (GA && GA->getBaseObject())
+          F = dyn_cast<Function>(GA->getBaseObject());
+      }
 
-    Function *F = dyn_cast<Function>(Name.getValue());
-    if (!F) {
-      // If value is an alias, need to get the aliased base object to
-      // see if it is a function.
-      auto *GA = dyn_cast<GlobalAlias>(Name.getValue());
-      if (GA && GA->getBaseObject())
-        F = dyn_cast<Function>(GA->getBaseObject());
+      unsigned AbbrevToUse = EntryBlobAbbrev;
+      NameVals.push_back(bitc::VST_CODE_ENTRY);
+      NameVals.push_back(VE.getValueID(Name.getValue()));
+      if (F && !F->isDeclaration()) {
+        // Save the word offset of the function (from the start of the
+        // actual bitcode written to the stream).
+        assert(FunctionIndex);
+        assert(FunctionIndex->count(F) == 1);
+        uint64_t BitcodeIndex =
+            (*FunctionIndex)[F]->bitcodeIndex() - BitcodeStartBit;
+        assert((BitcodeIndex & 31) == 0 &&
+               "function block not 32-bit aligned");
+        NameVals[0] = bitc::VST_CODE_FNENTRY;
+        NameVals.push_back(BitcodeIndex / 32);
+        AbbrevToUse = FnEntryBlobAbbrev;
+      }
+      Stream.EmitRecordWithBlob(AbbrevToUse, NameVals, Name.getKey());
+      NameVals.clear();
+      continue;
     }
 
     // VST_ENTRY:   [valueid, namechar x N]
-    // VST_FNENTRY: [valueid, funcoffset, namechar x N]
     // VST_BBENTRY: [bbid, namechar x N]
+    NameVals.push_back(VE.getValueID(Name.getValue()));
+
+    // Figure out the encoding to use for the name.
+    StringEncoding Bits =
+        getStringEncoding(Name.getKeyData(), Name.getKeyLength());
+
+    unsigned AbbrevToUse = VST_ENTRY_8_ABBREV;
     unsigned Code;
     if (isa<BasicBlock>(Name.getValue())) {
       Code = bitc::VST_CODE_BBENTRY;
       if (Bits == SE_Char6)
         AbbrevToUse = VST_BBENTRY_6_ABBREV;
-    } else if (F && !F->isDeclaration()) {
-      // Must be the module-level VST, where we pass in the Index and
-      // have a VSTOffsetPlaceholder. The function-level VST should not
-      // contain any Function symbols.
-      assert(FunctionIndex);
-      assert(VSTOffsetPlaceholder > 0);
-
-      // Save the word offset of the function (from the start of the
-      // actual bitcode written to the stream).
-      assert(FunctionIndex->count(F) == 1);
-      uint64_t BitcodeIndex =
-          (*FunctionIndex)[F]->bitcodeIndex() - BitcodeStartBit;
-      assert((BitcodeIndex & 31) == 0 && "function block not 32-bit aligned");
-      NameVals.push_back(BitcodeIndex / 32);
-
-      Code = bitc::VST_CODE_FNENTRY;
-      AbbrevToUse = FnEntry8BitAbbrev;
-      if (Bits == SE_Char6)
-        AbbrevToUse = FnEntry6BitAbbrev;
-      else if (Bits == SE_Fixed7)
-        AbbrevToUse = FnEntry7BitAbbrev;
     } else {
       Code = bitc::VST_CODE_ENTRY;
       if (Bits == SE_Char6)
@@ -2800,15 +2866,18 @@ static void WritePerModuleFunctionSummary(
   unsigned FSAbbrev = Stream.EmitAbbrev(Abbv);
 
   SmallVector<unsigned, 64> NameVals;
-  for (auto &I : FunctionIndex) {
+  // Emit the records in the order of the functions, not of FunctionIndex,
+  // which is keyed on pointers, so that the output is reproducible.
+  for (const Function &F : *M) {
     // Skip anonymous functions. We will emit a function summary for
     // any aliases below.
-    if (!I.first->hasName())
+    if (F.isDeclaration() || !F.hasName())
       continue;
 
+    assert(FunctionIndex.count(&F) == 1);
     WritePerModuleFunctionSummaryRecord(
-        NameVals, I.second->functionSummary(),
-        VE.getValueID(M->getValueSymbolTable().lookup(I.first->getName())),
+        NameVals, FunctionIndex[&F]->functionSummary(),
+        VE.getValueID(M->getValueSymbolTable().lookup(F.getName())),
         FSAbbrev, Stream);
   }
 
@@ -2889,6 +2958,112 @@ static void WriteIdentificationBlock(const Module *M, BitstreamWriter &Stream) {
   Stream.ExitBlock();
 }
 
+namespace {
+/// A contiguous run of the function bodies of a module, which a thread
+/// encodes into a buffer of its own.
+struct FunctionRun {
+  ArrayRef<const Function *> Functions;
+  UseListOrderStack UseListOrders;
+  SmallVector<char, 0> Buffer;
+  /// The bit range of the function blocks in Buffer.
+  uint64_t StartBit = 0;
+  uint64_t EndBit = 0;
+  /// The positions are relative to Buffer until the run is appended.
+  DenseMap<const Function *, std::unique_ptr<FunctionInfo>> FunctionIndex;
+};
+}
+
+/// Encode the function blocks of Run with a copy of the module-level VE. They
+/// are nested in a module block with the same block info as the module
+/// stream, so that they encode the same as if they were written to it.
+static void WriteFunctionRun(FunctionRun &Run, const ValueEnumerator &ModuleVE,
+                             bool EmitFunctionSummary) {
+  ValueEnumerator VE(ModuleVE);
+  VE.UseListOrders = std::move(Run.UseListOrders);
+
+  BitstreamWriter Stream(Run.Buffer);
+  Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
+  WriteBlockInfo(VE, Stream);
+  Run.StartBit = Stream.GetCurrentBitNo();
+  for (const Function *F : Run.Functions)
+    WriteFunction(*F, VE, Stream, Run.FunctionIndex, EmitFunctionSummary);
+  Run.EndBit = Stream.GetCurrentBitNo();
+  Stream.ExitBlock();
+}
+
+/// Emit the function bodies of M. With more than one WriterThreads, they are
+/// split into contiguous runs of about the same number of instructions, which
+/// are encoded in parallel and then appended in order, so that the output
+/// does not change.
+static void WriteFunctions(
+    const Module *M, ValueEnumerator &VE, BitstreamWriter &Stream,
+    DenseMap<const Function *, std::unique_ptr<FunctionInfo>> &FunctionIndex,
+    bool EmitFunctionSummary) {
+  std::vector<const Function *> Functions;
+  std::vector<uint64_t> NumInsts;
+  uint64_t TotalInsts = 0;
+  for (const Function &F : *M) {
+    if (F.isDeclaration())
+      continue;
+    uint64_t N = 0;
+    for (const BasicBlock &BB : F)
+      N += BB.size();
+    Functions.push_back(&F);
+    NumInsts.push_back(N);
+    TotalInsts += N;
+  }
+
+  unsigned NumRuns = std::min<size_t>(WriterThreads, Functions.size());
+  if (NumRuns <= 1) {
+    for (const Function *F : Functions)
+      WriteFunction(*F, VE, Stream, FunctionIndex, EmitFunctionSummary);
+    return;
+  }
+
+  std::vector<FunctionRun> Runs(NumRuns);
+  size_t Begin = 0;
+  uint64_t Written = 0;
+  for (unsigned I = 0; I != NumRuns; ++I) {
+    size_t End = Begin + 1;
+    Written += NumInsts[Begin];
+    // Leave at least one function to each of the remaining runs.
+    while (End + (NumRuns - I - 1) < Functions.size() &&
+           (I + 1 == NumRuns || Written < TotalInsts * (I + 1) / NumRuns))
+      Written += NumInsts[End++];
+    Runs[I].Functions = makeArrayRef(Functions).slice(Begin, End - Begin);
+    Begin = End;
+  }
+
+  // The use-list orders of the function bodies are on the stack in the order
+  // of the functions, with the first one on top.
+  for (FunctionRun &Run : Runs) {
+    for (const Function *F : Run.Functions)
+      while (!VE.UseListOrders.empty() && VE.UseListOrders.back().F == F) {
+        Run.UseListOrders.push_back(std::move(VE.UseListOrders.back()));
+        VE.UseListOrders.pop_back();
+      }
+    std::reverse(Run.UseListOrders.begin(), Run.UseListOrders.end());
+  }
+
+  ThreadPool Pool(NumRuns);
+  for (unsigned I = 0; I != NumRuns; ++I)
+    Pool.async([&, I]() {
+      WriteFunctionRun(Runs[I], VE, EmitFunctionSummary);
+    });
+  Pool.wait();
+
+  for (FunctionRun &Run : Runs) {
+    uint64_t Offset = Stream.GetCurrentBitNo() - Run.StartBit;
+    Stream.AppendBlocks(StringRef(Run.Buffer.data() + Run.StartBit / 8,
+                                  (Run.EndBit - Run.StartBit) / 8));
+    for (const Function *F : Run.Functions) {
+      std::unique_ptr<FunctionInfo> &Info = Run.FunctionIndex[F];
+      Info->setBitcodeIndex(Info->bitcodeIndex() + Offset);
+      FunctionIndex[F] = std::move(Info);
+    }
+  }
+}
+
 /// WriteModule - Emit the specified module to the bitstream.
 static void WriteModule(const Module *M, BitstreamWriter &Stream,
                         bool ShouldPreserveUseListOrder,
@@ -2938,9 +3113,7 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream,
 
   // Emit function bodies.
   DenseMap<const Function *, std::unique_ptr<FunctionInfo>> FunctionIndex;
-  for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F)
-    if (!F->isDeclaration())
-      WriteFunction(*F, VE, Stream, FunctionIndex, EmitFunctionSummary);
+  WriteFunctions(M, VE, Stream, FunctionIndex, EmitFunctionSummary);
 
   // Need to write after the above call to WriteFunction which populates
   // the summary information in the index.
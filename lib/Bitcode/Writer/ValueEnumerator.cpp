@@ -280,7 +280,7 @@ static bool isIntOrIntVectorValue(const std::pair<const Value*, unsigned> &V) {
 
 ValueEnumerator::ValueEnumerator(const Module &M,
                                  bool ShouldPreserveUseListOrder)
-    : HasMDString(false), HasDILocation(false), HasGenericDINode(false),
+    : NumMDStrings(0), HasDILocation(false), HasGenericDINode(false),
       ShouldPreserveUseListOrder(ShouldPreserveUseListOrder) {
   if (ShouldPreserveUseListOrder)
     UseListOrders = predictUseListOrder(M);
@@ -375,6 +375,24 @@ ValueEnumerator::ValueEnumerator(const Module &M,
 
   // Optimize constant ordering.
   OptimizeConstants(FirstConstant, Values.size());
+
+  // Put the strings first, so that they can be written in a single table.
+  organizeMetadata();
+}
+
+ValueEnumerator::ValueEnumerator(const ValueEnumerator &VE)
+    : TypeMap(VE.TypeMap), Types(VE.Types), ValueMap(VE.ValueMap),
+      Values(VE.Values), Comdats(VE.Comdats), MDs(VE.MDs),
+      FunctionLocalMDs(VE.FunctionLocalMDs), MetadataMap(VE.MetadataMap),
+      NumMDStrings(VE.NumMDStrings), HasDILocation(VE.HasDILocation),
+      HasGenericDINode(VE.HasGenericDINode),
+      ShouldPreserveUseListOrder(VE.ShouldPreserveUseListOrder),
+      AttributeGroupMap(VE.AttributeGroupMap),
+      AttributeGroups(VE.AttributeGroups), AttributeMap(VE.AttributeMap),
+      Attribute(VE.Attribute), GlobalBasicBlockIDs(VE.GlobalBasicBlockIDs),
+      InstructionMap(VE.InstructionMap), BasicBlocks(VE.BasicBlocks) {
+  assert(FunctionLocalMDs.empty() && BasicBlocks.empty() &&
+         "Copied while a function is incorporated");
 }
 
 unsigned ValueEnumerator::getInstructionID(const Instruction *Inst) const {
@@ -531,7 +549,7 @@ void ValueEnumerator::EnumerateMetadata(const Metadata *MD) {
   else if (auto *C = dyn_cast<ConstantAsMetadata>(MD))
     EnumerateValue(C->getValue());
 
-  HasMDString |= isa<MDString>(MD);
+  NumMDStrings += isa<MDString>(MD);
   HasDILocation |= isa<DILocation>(MD);
   HasGenericDINode |= isa<GenericDINode>(MD);
 
@@ -541,6 +559,19 @@ void ValueEnumerator::EnumerateMetadata(const Metadata *MD) {
   MetadataMap[MD] = MDs.size();
 }
 
+/// Move the module-level strings ahead of the other metadata, keeping the
+/// relative order of both, and renumber them.
+void ValueEnumerator::organizeMetadata() {
+  if (!NumMDStrings)
+    return;
+
+  std::stable_partition(MDs.begin(), MDs.end(), [](const Metadata *MD) {
+    return isa<MDString>(MD);
+  });
+  for (unsigned I = 0, E = MDs.size(); I != E; ++I)
+    MetadataMap[MDs[I]] = I + 1;
+}
+
 /// EnumerateFunctionLocalMetadataa - Incorporate function-local metadata
 /// information reachable from the metadata.
 void ValueEnumerator::EnumerateFunctionLocalMetadata(
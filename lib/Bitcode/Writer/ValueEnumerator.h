@@ -14,6 +14,7 @@
 #ifndef LLVM_LIB_BITCODE_WRITER_VALUEENUMERATOR_H
 #define LLVM_LIB_BITCODE_WRITER_VALUEENUMERATOR_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/UniqueVector.h"
@@ -64,7 +65,7 @@ private:
   SmallVector<const LocalAsMetadata *, 8> FunctionLocalMDs;
   typedef DenseMap<const Metadata *, unsigned> MetadataMapType;
   MetadataMapType MetadataMap;
-  bool HasMDString;
+  unsigned NumMDStrings;
   bool HasDILocation;
   bool HasGenericDINode;
   bool ShouldPreserveUseListOrder;
@@ -100,11 +101,15 @@ private:
   unsigned FirstFuncConstantID;
   unsigned FirstInstID;
 
-  ValueEnumerator(const ValueEnumerator &) = delete;
   void operator=(const ValueEnumerator &) = delete;
 public:
   ValueEnumerator(const Module &M, bool ShouldPreserveUseListOrder);
 
+  /// Copy the module-level numbering of VE, so that function bodies can be
+  /// incorporated into each copy in parallel. The use-list orders are not
+  /// copied.
+  ValueEnumerator(const ValueEnumerator &VE);
+
   void dump() const;
   void print(raw_ostream &OS, const ValueMapType &Map, const char *Name) const;
   void print(raw_ostream &OS, const MetadataMapType &Map,
@@ -121,7 +126,7 @@ public:
   }
   unsigned numMDs() const { return MDs.size(); }
 
-  bool hasMDString() const { return HasMDString; }
+  bool hasMDString() const { return NumMDStrings; }
   bool hasDILocation() const { return HasDILocation; }
   bool hasGenericDINode() const { return HasGenericDINode; }
 
@@ -159,6 +164,15 @@ public:
 
   const ValueList &getValues() const { return Values; }
   const std::vector<const Metadata *> &getMDs() const { return MDs; }
+
+  /// The module-level strings, which come first in getMDs(), and the other
+  /// module-level metadata.
+  ArrayRef<const Metadata *> getMDStrings() const {
+    return makeArrayRef(MDs).slice(0, NumMDStrings);
+  }
+  ArrayRef<const Metadata *> getNonMDStrings() const {
+    return makeArrayRef(MDs).slice(NumMDStrings);
+  }
   const SmallVectorImpl<const LocalAsMetadata *> &getFunctionLocalMDs() const {
     return FunctionLocalMDs;
   }
@@ -190,6 +204,7 @@ public:
 
 private:
   void OptimizeConstants(unsigned CstStart, unsigned CstEnd);
+  void organizeMetadata();
 
   void EnumerateMDNodeOperands(const MDNode *N);
   void EnumerateMetadata(const Metadata *MD);
@@ -12,15 +12,13 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/CodeGen/ParallelCG.h"
-#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
-#include "llvm/Support/ErrorOr.h"
-#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/thread.h"
 #include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/SplitModule.h"
 
 using namespace llvm;
@@ -60,34 +58,29 @@ llvm::splitCodeGen(std::unique_ptr<Module> M,
   std::vector<thread> Threads;
   SplitModule(std::move(M), OSs.size(), [&](std::unique_ptr<Module> MPart) {
     // We want to clone the module in a new context to multi-thread the codegen.
-    // We do it by serializing partition modules to bitcode (while still on the
-    // main thread, in order to avoid data races) and spinning up new threads
-    // which deserialize the partitions into separate contexts.
-    // FIXME: Provide a more direct way to do this in LLVM.
-    SmallVector<char, 0> BC;
-    raw_svector_ostream BCOS(BC);
-    WriteBitcodeToFile(MPart.get(), BCOS);
+    // We do it while still on the main thread, in order to avoid data races
+    // on the context of MPart, and hand the clone and its context over to a
+    // new thread. MPart is freed right away, so only one extra copy of a
+    // partition exists at a time.
+    auto Ctx = llvm::make_unique<LLVMContext>();
+    std::unique_ptr<Module> MPartInCtx =
+        CloneModuleIntoContext(MPart.get(), *Ctx);
+    MPart.reset();
 
     llvm::raw_pwrite_stream *ThreadOS = OSs[Threads.size()];
     Threads.emplace_back(
         [TheTarget, CPU, Features, Options, RM, CM, OL, FileType,
-         ThreadOS](const SmallVector<char, 0> &BC) {
-          LLVMContext Ctx;
-          ErrorOr<std::unique_ptr<Module>> MOrErr =
-              parseBitcodeFile(MemoryBufferRef(StringRef(BC.data(), BC.size()),
-                                               "<split-module>"),
-                               Ctx);
-          if (!MOrErr)
-            report_fatal_error("Failed to read bitcode");
-          std::unique_ptr<Module> MPartInCtx = std::move(MOrErr.get());
-
+         ThreadOS](std::unique_ptr<LLVMContext> &&Ctx,
+                   std::unique_ptr<Module> &&MPartInCtx) {
           codegen(MPartInCtx.get(), *ThreadOS, TheTarget, CPU, Features,
                   Options, RM, CM, OL, FileType);
+          // The module has to go before its context.
+          MPartInCtx.reset();
         },
-        // Pass BC using std::move to ensure that it get moved rather than
-        // copied into the thread's context.
-        std::move(BC));
-  });
+        // Pass the context and the module using std::move to ensure that they
+        // get moved into the thread.
+        std::move(Ctx), std::move(MPartInCtx));
+  }, /*Balance=*/true);
 
   for (thread &T : Threads)
     T.join();
@@ -13,6 +13,7 @@
 
 
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/LegacyPassManagers.h"
@@ -27,6 +28,7 @@
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <unordered_set>
 using namespace llvm;
@@ -378,10 +380,40 @@ public:
     return PMT_ModulePassManager;
   }
 
+  /// \copydoc PassManager::setFunctionPassThreads()
+  void setFunctionPassThreads(unsigned Threads,
+                              std::function<void(PassManagerBase &)> AddPasses,
+                              ParallelFunctionRunner Runner) {
+    FunctionPassThreads = Threads;
+    FunctionPassPipeline = std::move(AddPasses);
+    FunctionPassRunner = std::move(Runner);
+  }
+
+  /// Run the function pass manager at Index on Fs, on a thread, after the
+  /// module analyses at the indices ModuleAnalyses.
+  bool runFunctionPasses(unsigned Index, Module &M, ArrayRef<Function *> Fs,
+                         ArrayRef<unsigned> ModuleAnalyses);
+
  private:
+  /// Return true if the function pass manager at Index can run on threads,
+  /// now that the pass at LastChange was the last to change the module, and
+  /// add to ModuleAnalyses the indices of the module analyses its passes use
+  /// and of those that they need, in order.
+  bool canRunOnThreads(unsigned Index, int LastChange,
+                       SmallVectorImpl<unsigned> &ModuleAnalyses);
+
+  /// Run the function pass manager at Index on threads.
+  bool runOnThreads(unsigned Index, Module &M,
+                    ArrayRef<unsigned> ModuleAnalyses);
+
   /// Collection of on the fly FPPassManagers. These managers manage
   /// function passes that are required by module passes.
   std::map<Pass *, FunctionPassManagerImpl *> OnTheFlyManagers;
+
+  /// The setup of PassManager::setFunctionPassThreads.
+  unsigned FunctionPassThreads = 1;
+  std::function<void(PassManagerBase &)> FunctionPassPipeline;
+  ParallelFunctionRunner FunctionPassRunner;
 };
 
 char MPPassManager::ID = 0;
@@ -447,6 +479,11 @@ public:
     MPPassManager *MP = static_cast<MPPassManager *>(PassManagers[N]);
     return MP;
   }
+
+  /// Run the function pass manager at Index of the module pass manager on Fs,
+  /// after the module analyses at the indices ModuleAnalyses.
+  bool runFunctionPasses(unsigned Index, Module &M, ArrayRef<Function *> Fs,
+                         ArrayRef<unsigned> ModuleAnalyses);
 };
 
 void PassManagerImpl::anchor() {}
@@ -503,6 +540,24 @@ public:
 
 static TimingInfo *TheTimeInfo;
 
+//===----------------------------------------------------------------------===//
+// PMChangeJournal implementation
+
+void PMChangeJournal::recordChange(const Function &F) {
+  LastChange[&F] = ++Generation;
+}
+
+bool PMChangeJournal::needsVerification(const Function &F) const {
+  auto I = LastVerification.find(&F);
+  if (I == LastVerification.end())
+    return true;
+  return LastModuleChange > I->second || LastChange.lookup(&F) > I->second;
+}
+
+void PMChangeJournal::recordVerified(const Function &F) {
+  LastVerification[&F] = Generation;
+}
+
 //===----------------------------------------------------------------------===//
 // PMTopLevelManager implementation
 
@@ -822,6 +877,12 @@ void PMTopLevelManager::initializeAllAnalysisInfo() {
   }
 }
 
+PMChangeJournal &PMTopLevelManager::enableChangeJournal() {
+  if (!ChangeJournal)
+    ChangeJournal.reset(new PMChangeJournal());
+  return *ChangeJournal;
+}
+
 /// Destructor
 PMTopLevelManager::~PMTopLevelManager() {
   for (SmallVectorImpl<PMDataManager *>::iterator I = PassManagers.begin(),
@@ -1551,8 +1612,11 @@ bool FPPassManager::runOnFunction(Function &F) {
     }
 
     Changed |= LocalChanged;
-    if (LocalChanged)
+    if (LocalChanged) {
       dumpPassInfo(FP, MODIFICATION_MSG, ON_FUNCTION_MSG, F.getName());
+      if (PMChangeJournal *CJ = TPM->getChangeJournal())
+        CJ->recordChange(F);
+    }
     dumpPreservedSet(FP);
     dumpUsedSet(FP);
 
@@ -1611,6 +1675,8 @@ MPPassManager::runOnModule(Module &M) {
   for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index)
     Changed |= getContainedPass(Index)->doInitialization(M);
 
+  // The index of the last pass that changed the module.
+  int LastChange = -1;
   for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index) {
     ModulePass *MP = getContainedPass(Index);
     bool LocalChanged = false;
@@ -1624,13 +1690,24 @@ MPPassManager::runOnModule(Module &M) {
       PassManagerPrettyStackEntry X(MP, M);
       TimeRegion PassTimer(getPassTimer(MP));
 
-      LocalChanged |= MP->runOnModule(M);
+      SmallVector<unsigned, 4> ModuleAnalyses;
+      if (canRunOnThreads(Index, LastChange, ModuleAnalyses))
+        LocalChanged |= runOnThreads(Index, M, ModuleAnalyses);
+      else
+        LocalChanged |= MP->runOnModule(M);
     }
 
     Changed |= LocalChanged;
-    if (LocalChanged)
+    if (LocalChanged) {
+      LastChange = Index;
       dumpPassInfo(MP, MODIFICATION_MSG, ON_MODULE_MSG,
                    M.getModuleIdentifier());
+      // The function and CGSCC pass managers record the functions they
+      // changed themselves.
+      if (PMChangeJournal *CJ = TPM->getChangeJournal())
+        if (!MP->getAsPMDataManager())
+          CJ->recordModuleChange();
+    }
     dumpPreservedSet(MP);
     dumpUsedSet(MP);
 
@@ -1656,6 +1733,162 @@ MPPassManager::runOnModule(Module &M) {
   return Changed;
 }
 
+/// Return true if P is the analysis ID, or implements it.
+static bool providesAnalysis(Pass *P, AnalysisID ID, PMTopLevelManager *TPM) {
+  if (P->getPassID() == ID)
+    return true;
+  if (const PassInfo *PI = TPM->findAnalysisPassInfo(P->getPassID()))
+    for (const PassInfo *ImplPI : PI->getInterfacesImplemented())
+      if (ImplPI->getTypeInfo() == ID)
+        return true;
+  return false;
+}
+
+bool MPPassManager::canRunOnThreads(unsigned Index, int LastChange,
+                                    SmallVectorImpl<unsigned> &ModuleAnalyses) {
+  if (FunctionPassThreads < 2 || !FunctionPassRunner)
+    return false;
+  PMDataManager *FPP = getContainedPass(Index)->getAsPMDataManager();
+  if (!FPP || FPP->getPassManagerType() != PMT_FunctionPassManager)
+    return false;
+  // The timers and the printers are not thread safe.
+  if (TimePassesIsEnabled || PassDebugging >= Executions || PrintBeforeAll ||
+      PrintAfterAll || !PrintBefore.empty() || !PrintAfter.empty())
+    return false;
+
+  // The module analyses that the function passes get from this manager,
+  // through the loop, region and basic block pass managers they contain.
+  SmallVector<Pass *, 4> Needed;
+  SmallVector<PMDataManager *, 4> Managers(1, FPP);
+  while (!Managers.empty()) {
+    for (Pass *P : Managers.pop_back_val()->getContainedPasses()) {
+      if (PMDataManager *PMD = P->getAsPMDataManager()) {
+        Managers.push_back(PMD);
+        continue;
+      }
+      AnalysisUsage *AnUsage = TPM->findAnalysisUsage(P);
+      for (const auto *IDs :
+           {&AnUsage->getRequiredSet(), &AnUsage->getRequiredTransitiveSet(),
+            &AnUsage->getUsedSet()})
+        for (AnalysisID ID : *IDs)
+          if (Pass *AP = getAvailableAnalysis()->lookup(ID))
+            Needed.push_back(AP);
+    }
+  }
+
+  // Each of them, and the analyses they need in turn, must be a module
+  // analysis of this manager computed since the module last changed, so
+  // that a thread computes it again as it is. The analyses one of them
+  // requires are the last ones to provide them before it.
+  SmallPtrSet<Pass *, 8> Visited;
+  while (!Needed.empty()) {
+    Pass *AP = Needed.pop_back_val();
+    if (!Visited.insert(AP).second)
+      continue;
+    const PassInfo *PI = TPM->findAnalysisPassInfo(AP->getPassID());
+    if (!PI || !PI->isAnalysis())
+      return false;
+    auto I = std::find(PassVector.begin(), PassVector.begin() + Index, AP);
+    if (I == PassVector.begin() + Index || I - PassVector.begin() <= LastChange)
+      return false;
+    unsigned APIndex = I - PassVector.begin();
+    ModuleAnalyses.push_back(APIndex);
+
+    AnalysisUsage *AnUsage = TPM->findAnalysisUsage(AP);
+    for (const auto *IDs :
+         {&AnUsage->getRequiredSet(), &AnUsage->getRequiredTransitiveSet()})
+      for (AnalysisID ID : *IDs) {
+        Pass *RP = TPM->findAnalysisPass(ID);
+        if (RP && RP->getAsImmutablePass())
+          continue;
+        auto RI = std::find_if(
+            PassVector.rbegin() + (PassVector.size() - APIndex),
+            PassVector.rend(),
+            [&](Pass *P) { return providesAnalysis(P, ID, TPM); });
+        if (RI == PassVector.rend())
+          return false;
+        Needed.push_back(*RI);
+      }
+  }
+  std::sort(ModuleAnalyses.begin(), ModuleAnalyses.end());
+  return true;
+}
+
+namespace {
+/// The pass manager a thread builds the pipeline again in.
+class ThreadPassManager : public PassManagerBase {
+public:
+  ThreadPassManager() { PM.setTopLevelManager(&PM); }
+
+  void add(Pass *P) override { PM.add(P); }
+
+  PassManagerImpl PM;
+};
+}
+
+bool MPPassManager::runOnThreads(unsigned Index, Module &M,
+                                 ArrayRef<unsigned> ModuleAnalyses) {
+  FPPassManager *FPP = static_cast<FPPassManager *>(getContainedPass(Index));
+  std::atomic<bool> Changed(false);
+  FunctionPassRunner(
+      M, FunctionPassThreads,
+      [&](Module &Part, ArrayRef<Function *> Fs) {
+        // The functions the runner keeps on the calling thread.
+        if (&Part == &M) {
+          for (Function *F : Fs)
+            if (FPP->runOnFunction(*F))
+              Changed = true;
+          return;
+        }
+
+        ThreadPassManager ThreadPM;
+        FunctionPassPipeline(ThreadPM);
+        MPPassManager *ThreadMPP = ThreadPM.PM.getContainedManager(0);
+        ArrayRef<Pass *> ThreadPasses = ThreadMPP->getContainedPasses();
+        if (ThreadPasses.size() <= Index ||
+            !std::equal(PassVector.begin(), PassVector.begin() + Index + 1,
+                        ThreadPasses.begin(), [](Pass *LHS, Pass *RHS) {
+                          return LHS->getPassID() == RHS->getPassID();
+                        }))
+          report_fatal_error("The passes built for a thread of the function "
+                             "pass managers differ from the pipeline");
+        if (ThreadPM.PM.runFunctionPasses(Index, Part, Fs, ModuleAnalyses))
+          Changed = true;
+      },
+      /*CloneAllDefinitions=*/!ModuleAnalyses.empty());
+
+  // Which of the functions the threads changed is not known here.
+  if (Changed)
+    if (PMChangeJournal *CJ = TPM->getChangeJournal())
+      for (Function &F : M)
+        if (!F.isDeclaration())
+          CJ->recordChange(F);
+  return Changed;
+}
+
+bool MPPassManager::runFunctionPasses(unsigned Index, Module &M,
+                                      ArrayRef<Function *> Fs,
+                                      ArrayRef<unsigned> ModuleAnalyses) {
+  bool Changed = false;
+  for (unsigned APIndex : ModuleAnalyses) {
+    ModulePass *AP = getContainedPass(APIndex);
+    initializeAnalysisImpl(AP);
+    Changed |= AP->doInitialization(M);
+    Changed |= AP->runOnModule(M);
+    recordAvailableAnalysis(AP);
+  }
+
+  FPPassManager *FPP = static_cast<FPPassManager *>(getContainedPass(Index));
+  Changed |= FPP->doInitialization(M);
+  for (Function *F : Fs)
+    Changed |= FPP->runOnFunction(*F);
+  Changed |= FPP->doFinalization(M);
+
+  for (unsigned APIndex : reverse(ModuleAnalyses))
+    Changed |= getContainedPass(APIndex)->doFinalization(M);
+  return Changed;
+}
+
 /// Add RequiredPass into list of lower level passes required by pass P.
 /// RequiredPass is run on the fly by Pass Manager when P requests it
 /// through getAnalysis interface.
@@ -1737,6 +1970,23 @@ bool PassManagerImpl::run(Module &M) {
   return Changed;
 }
 
+bool PassManagerImpl::runFunctionPasses(unsigned Index, Module &M,
+                                        ArrayRef<Function *> Fs,
+                                        ArrayRef<unsigned> ModuleAnalyses) {
+  bool Changed = false;
+  for (ImmutablePass *ImPass : getImmutablePasses())
+    Changed |= ImPass->doInitialization(M);
+
+  initializeAllAnalysisInfo();
+  Changed |=
+      getContainedManager(0)->runFunctionPasses(Index, M, Fs, ModuleAnalyses);
+
+  for (ImmutablePass *ImPass : getImmutablePasses())
+    Changed |= ImPass->doFinalization(M);
+
+  return Changed;
+}
+
 //===----------------------------------------------------------------------===//
 // PassManager implementation
 
@@ -1761,6 +2011,13 @@ bool PassManager::run(Module &M) {
   return PM->run(M);
 }
 
+void PassManager::setFunctionPassThreads(
+    unsigned Threads, std::function<void(PassManagerBase &)> AddPasses,
+    ParallelFunctionRunner Runner) {
+  PM->getContainedManager(0)->setFunctionPassThreads(
+      Threads, std::move(AddPasses), std::move(Runner));
+}
+
 //===----------------------------------------------------------------------===//
 // TimingInfo implementation
 
@@ -474,13 +474,15 @@ MDNode::MDNode(LLVMContext &Context, unsigned ID, StorageType Storage,
   this->Context.makeReplaceable(make_unique<ReplaceableMetadataImpl>(Context));
 }
 
-TempMDNode MDNode::clone() const {
+TempMDNode MDNode::clone() const { return clone(getContext()); }
+
+TempMDNode MDNode::clone(LLVMContext &Ctx) const {
   switch (getMetadataID()) {
   default:
     llvm_unreachable("Invalid MDNode subclass");
 #define HANDLE_MDNODE_LEAF(CLASS)                                              \
   case CLASS##Kind:                                                            \
-    return cast<CLASS>(this)->cloneImpl();
+    return cast<CLASS>(this)->cloneImpl(Ctx);
 #include "llvm/IR/Metadata.def"
   }
 }
@@ -50,6 +50,7 @@
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/CallSite.h"
@@ -65,6 +66,7 @@
 #include "llvm/IR/InstVisitor.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManagers.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PassManager.h"
@@ -78,8 +80,19 @@
 #include <cstdarg>
 using namespace llvm;
 
+#define DEBUG_TYPE "verify"
+
+STATISTIC(NumFunctionsVerified, "Number of functions verified");
+STATISTIC(NumFunctionsSkipped,
+          "Number of unchanged functions not verified again");
+
 static cl::opt<bool> VerifyDebugInfo("verify-debug-info", cl::init(true));
 
+static cl::opt<bool> VerifyIncremental(
+    "verify-incremental", cl::init(false),
+    cl::desc("Only verify again the functions that passes changed since the "
+             "last verifier pass, and the module once after they did"));
+
 namespace {
 struct VerifierSupport {
   raw_ostream &OS;
@@ -307,6 +320,20 @@ public:
     return !Broken;
   }
 
+  /// Check what the functions visited since the last verify(M) refer to in
+  /// the rest of the module, without checking the module itself again: the
+  /// frame indices they recover and the type references they use.
+  bool verifyFunctionReferences(const Module &M) {
+    this->M = &M;
+    Context = &M.getContext();
+    Broken = false;
+
+    verifyFrameRecoverIndices();
+    verifyTypeRefs(/*CheckBitPieces=*/false);
+
+    return !Broken;
+  }
+
 private:
   // Verification methods...
   void visitGlobalValue(const GlobalValue &GV);
@@ -444,7 +471,7 @@ private:
   void verifySiblingFuncletUnwinds();
 
   // Module-level debug info verification...
-  void verifyTypeRefs();
+  void verifyTypeRefs(bool CheckBitPieces = true);
   template <class MapTy>
   void verifyBitPieceExpression(const DbgInfoIntrinsic &I,
                                 const MapTy &TypeRefs);
@@ -1697,11 +1724,25 @@ void Verifier::VerifyStatepoint(ImmutableCallSite CS) {
   // about.  See example statepoint.ll in the verifier subdirectory
 }
 
+/// Return the number of objects passed to llvm.localescape in F.
+static unsigned getEscapedObjectCount(const Function &F) {
+  if (F.empty())
+    return 0;
+  for (const Instruction &I : F.front())
+    if (auto *II = dyn_cast<IntrinsicInst>(&I))
+      if (II->getIntrinsicID() == Intrinsic::localescape)
+        return II->getNumArgOperands();
+  return 0;
+}
+
 void Verifier::verifyFrameRecoverIndices() {
   for (auto &Counts : FrameEscapeInfo) {
     Function *F = Counts.first;
     unsigned EscapedObjectCount = Counts.second.first;
     unsigned MaxRecoveredIndex = Counts.second.second;
+    // An incremental verifier may not have visited the parent function.
+    if (MaxRecoveredIndex > EscapedObjectCount)
+      EscapedObjectCount = getEscapedObjectCount(*F);
     Assert(MaxRecoveredIndex <= EscapedObjectCount,
            "all indices passed to llvm.localrecover must be less than the "
            "number of arguments passed ot llvm.localescape in the parent "
@@ -4137,9 +4178,9 @@ void Verifier::visitUnresolvedTypeRef(const MDString *S, const MDNode *N) {
   Assert(false, "unresolved type ref", S, N);
 }
 
-void Verifier::verifyTypeRefs() {
+void Verifier::verifyTypeRefs(bool CheckBitPieces) {
   auto *CUs = M->getNamedMetadata("llvm.dbg.cu");
-  if (!CUs)
+  if (!CUs || (!CheckBitPieces && UnresolvedTypeRefs.empty()))
     return;
 
   // Visit all the compile units again to map the type references.
@@ -4157,11 +4198,12 @@ void Verifier::verifyTypeRefs() {
   // pass through the intructions, since we haven't built TypeRefs yet when
   // verifying functions, and simply queuing the DbgInfoIntrinsics to evaluate
   // later/now would queue up some that could be later deleted.
-  for (const Function &F : *M)
-    for (const BasicBlock &BB : F)
-      for (const Instruction &I : BB)
-        if (auto *DII = dyn_cast<DbgInfoIntrinsic>(&I))
-          verifyBitPieceExpression(*DII, TypeRefs);
+  if (CheckBitPieces)
+    for (const Function &F : *M)
+      for (const BasicBlock &BB : F)
+        for (const Instruction &I : BB)
+          if (auto *DII = dyn_cast<DbgInfoIntrinsic>(&I))
+            verifyBitPieceExpression(*DII, TypeRefs);
 
   // Return early if all typerefs were resolved.
   if (UnresolvedTypeRefs.empty())
@@ -4217,6 +4259,8 @@ struct VerifierLegacyPass : public FunctionPass {
 
   Verifier V;
   bool FatalErrors;
+  /// The change journal of the pass manager, with -verify-incremental.
+  PMChangeJournal *Journal = nullptr;
 
   VerifierLegacyPass() : FunctionPass(ID), V(dbgs()), FatalErrors(true) {
     initializeVerifierLegacyPassPass(*PassRegistry::getPassRegistry());
@@ -4226,16 +4270,47 @@ struct VerifierLegacyPass : public FunctionPass {
     initializeVerifierLegacyPassPass(*PassRegistry::getPassRegistry());
   }
 
+  bool doInitialization(Module &M) override {
+    if (VerifyIncremental && getResolver())
+      Journal = &getResolver()
+                     ->getPMDataManager()
+                     .getTopLevelManager()
+                     ->enableChangeJournal();
+    return false;
+  }
+
   bool runOnFunction(Function &F) override {
-    if (!V.verify(F) && FatalErrors)
-      report_fatal_error("Broken function found, compilation aborted!");
+    if (Journal && !Journal->needsVerification(F)) {
+      ++NumFunctionsSkipped;
+      return false;
+    }
+
+    ++NumFunctionsVerified;
+    if (!V.verify(F)) {
+      if (FatalErrors)
+        report_fatal_error("Broken function found, compilation aborted!");
+    } else if (Journal) {
+      Journal->recordVerified(F);
+    }
 
     return false;
   }
 
   bool doFinalization(Module &M) override {
-    if (!V.verify(M) && FatalErrors)
-      report_fatal_error("Broken module found, compilation aborted!");
+    // The verifiers of a pass manager are finalized together, so only the
+    // first of them has to check the module when verifying incrementally.
+    if (Journal && !Journal->moduleNeedsVerification()) {
+      if (!V.verifyFunctionReferences(M) && FatalErrors)
+        report_fatal_error("Broken module found, compilation aborted!");
+      return false;
+    }
+
+    if (!V.verify(M)) {
+      if (FatalErrors)
+        report_fatal_error("Broken module found, compilation aborted!");
+    } else if (Journal) {
+      Journal->recordModuleVerified();
+    }
 
     return false;
   }
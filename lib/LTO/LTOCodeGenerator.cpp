@@ -13,6 +13,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/LTO/LTOCodeGenerator.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Analysis/Passes.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
@@ -26,6 +28,7 @@
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Mangler.h"
@@ -39,8 +42,10 @@
 #include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
@@ -56,6 +61,31 @@
 #include <system_error>
 using namespace llvm;
 
+#define DEBUG_TYPE "lto"
+
+STATISTIC(NumBodiesReleased,
+          "Number of function bodies released after code generation");
+STATISTIC(NumDeadDefinitions,
+          "Number of unreachable definitions stripped before linking");
+STATISTIC(NumUnparsedBodies,
+          "Number of unreachable function bodies that were never parsed");
+
+namespace llvm {
+cl::opt<bool> LTOStreamingLink(
+    "lto-streaming-link",
+    cl::desc("Parse the function bodies of the modules to link only when the "
+             "linker needs them, and release the bodies of the merged module "
+             "as code generation finishes with them"),
+    cl::init(false));
+
+cl::opt<bool> LTODeadStrip(
+    "lto-dead-strip",
+    cl::desc("Find the definitions reachable from the symbols to preserve "
+             "before linking, parsing only the function bodies reached, and "
+             "link only those"),
+    cl::init(false));
+}
+
 const char* LTOCodeGenerator::getVersionString() {
 #ifdef LLVM_VERSION_INFO
   return PACKAGE_NAME " version " PACKAGE_VERSION ", " LLVM_VERSION_INFO;
@@ -70,7 +100,10 @@ LTOCodeGenerator::LTOCodeGenerator(LLVMContext &Context)
   initializeLTOPasses();
 }
 
-LTOCodeGenerator::~LTOCodeGenerator() {}
+LTOCodeGenerator::~LTOCodeGenerator() {
+  if (TimePassesIsEnabled)
+    printMemoryReport();
+}
 
 // Initialize LTO passes. Please keep this function in sync with
 // PassManagerBuilder::populateLTOPassManager(), and make sure all LTO
@@ -107,11 +140,28 @@ bool LTOCodeGenerator::addModule(LTOModule *Mod) {
   assert(&Mod->getModule().getContext() == &Context &&
          "Expected module in same context");
 
-  bool ret = TheLinker->linkInModule(Mod->takeModule());
+  const std::vector<const char *> &Undefs = Mod->getAsmUndefinedRefs();
+  if (LTODeadStrip) {
+    for (const char *Undef : Undefs)
+      AsmUndefinedRefs[Undef] = 1;
+    std::unique_ptr<Module> M = Mod->takeModule();
+    // The target is determined before linking, so take the triple the linker
+    // would give to the merged module.
+    if (MergedModule->getTargetTriple().empty())
+      MergedModule->setTargetTriple(M->getTargetTriple());
+    DeferredModules.push_back({Mod->takeBuffer(), std::move(M)});
+    return true;
+  }
+
+  bool ret;
+  {
+    TimeRegion T(TimePassesIsEnabled ? &LinkTimer : nullptr);
+    ret = TheLinker->linkInModule(Mod->takeModule());
+  }
+  MemoryUsageAfterLink = sampleMemoryUsage();
 
-  const std::vector<const char *> &undefs = Mod->getAsmUndefinedRefs();
-  for (int i = 0, e = undefs.size(); i != e; ++i)
-    AsmUndefinedRefs[undefs[i]] = 1;
+  for (int i = 0, e = Undefs.size(); i != e; ++i)
+    AsmUndefinedRefs[Undefs[i]] = 1;
 
   return !ret;
 }
@@ -121,10 +171,17 @@ void LTOCodeGenerator::setModule(std::unique_ptr<LTOModule> Mod) {
          "Expected module in same context");
 
   AsmUndefinedRefs.clear();
+  DeferredModules.clear();
 
   MergedModule = Mod->takeModule();
   TheLinker = make_unique<Linker>(*MergedModule);
 
+  // A lazily parsed module reads its function bodies from the bitcode that
+  // Mod owns.
+  if (std::error_code EC = MergedModule->materializeAll())
+    emitError(EC.message());
+  MemoryUsageAfterLink = sampleMemoryUsage();
+
   const std::vector<const char*> &Undefs = Mod->getAsmUndefinedRefs();
   for (int I = 0, E = Undefs.size(); I != E; ++I)
     AsmUndefinedRefs[Undefs[I]] = 1;
@@ -166,7 +223,7 @@ void LTOCodeGenerator::setOptLevel(unsigned Level) {
 }
 
 bool LTOCodeGenerator::writeMergedModules(const char *Path) {
-  if (!determineTarget())
+  if (!determineTarget() || !linkDeferredModules())
     return false;
 
   // mark which symbols can not be internalized
@@ -454,11 +511,190 @@ void LTOCodeGenerator::applyScopeRestrictions() {
   ScopeRestrictionsDone = true;
 }
 
+/// Destroy the constants that use C, which are unused themselves. Unlike
+/// Constant::removeDeadConstantUsers, this works in a module that is not fully
+/// materialized.
+static void destroyConstantUsers(Constant &C) {
+  while (C.materialized_use_begin() != C.use_end()) {
+    auto *User = cast<Constant>(*C.materialized_user_begin());
+    destroyConstantUsers(*User);
+    User->destroyConstant();
+  }
+}
+
+/// Link the modules that addModule deferred, after stripping the definitions
+/// that can't be reached from the symbols to preserve.
+bool LTOCodeGenerator::linkDeferredModules() {
+  if (DeferredModules.empty())
+    return true;
+
+  bool Failed = false;
+  {
+    TimeRegion T(TimePassesIsEnabled ? &LinkTimer : nullptr);
+    if (ShouldInternalize)
+      stripDeadDefinitions();
+    for (DeferredModule &Deferred : DeferredModules)
+      if ((Failed = TheLinker->linkInModule(std::move(Deferred.M))))
+        break;
+    DeferredModules.clear();
+  }
+  MemoryUsageAfterLink = sampleMemoryUsage();
+  return !Failed;
+}
+
+/// Remove from the deferred modules the definitions that internalization and
+/// global DCE would remove from the merged module. Only the bodies of the
+/// functions that are reached get parsed.
+///
+/// The summaries of the modules don't record what a function refers to, so the
+/// reachable set is found by walking the bodies themselves, materializing each
+/// one as it is reached. A name is resolved to every definition of it, since
+/// any of them may be the one the linker keeps.
+void LTOCodeGenerator::stripDeadDefinitions() {
+  Mangler Mangler;
+  std::vector<StringRef> Libcalls;
+  TargetLibraryInfoImpl TLII(Triple(TargetMach->getTargetTriple()));
+  TargetLibraryInfo TLI(TLII);
+  for (DeferredModule &Deferred : DeferredModules)
+    accumulateAndSortLibcalls(Libcalls, TLI, *Deferred.M, *TargetMach);
+
+  StringMap<std::vector<GlobalValue *>> Definitions;
+  DenseMap<const Comdat *, std::vector<GlobalValue *>> ComdatMembers;
+  auto AddDefinition = [&](GlobalValue &GV) {
+    if (GV.isDeclaration())
+      return;
+    if (!GV.hasLocalLinkage() && GV.hasName())
+      Definitions[GV.getName()].push_back(&GV);
+    if (const Comdat *C = GV.getComdat())
+      ComdatMembers[C].push_back(&GV);
+  };
+  auto ForEachGlobalValue = [](Module &M,
+                               std::function<void(GlobalValue &)> Callback) {
+    for (Function &F : M)
+      Callback(F);
+    for (GlobalVariable &GV : M.globals())
+      Callback(GV);
+    for (GlobalAlias &GA : M.aliases())
+      Callback(GA);
+  };
+  ForEachGlobalValue(*MergedModule, AddDefinition);
+  for (DeferredModule &Deferred : DeferredModules)
+    ForEachGlobalValue(*Deferred.M, AddDefinition);
+
+  SmallPtrSet<GlobalValue *, 64> Live;
+  std::vector<GlobalValue *> Worklist;
+  auto MarkLive = [&](GlobalValue &GV) {
+    if (GV.hasLocalLinkage() || !GV.hasName()) {
+      if (Live.insert(&GV).second)
+        Worklist.push_back(&GV);
+      return;
+    }
+    auto I = Definitions.find(GV.getName());
+    if (I == Definitions.end())
+      return;
+    for (GlobalValue *Def : I->second)
+      if (Live.insert(Def).second)
+        Worklist.push_back(Def);
+  };
+
+  // The roots are the definitions that internalization keeps external, and
+  // everything the merged module already holds.
+  auto IsRoot = [&](GlobalValue &GV) {
+    if (GV.getName().startswith("llvm.") || GV.hasAppendingLinkage())
+      return true;
+    if (GV.hasLocalLinkage() || GV.hasAvailableExternallyLinkage())
+      return false;
+    if (GV.hasDLLExportStorageClass())
+      return true;
+    SmallString<64> Buffer;
+    TargetMach->getNameWithPrefix(Buffer, &GV, Mangler);
+    if (MustPreserveSymbols.count(Buffer) || AsmUndefinedRefs.count(Buffer))
+      return true;
+    return isa<Function>(GV) &&
+           std::binary_search(Libcalls.begin(), Libcalls.end(), GV.getName());
+  };
+  ForEachGlobalValue(*MergedModule, [&](GlobalValue &GV) {
+    if (!GV.isDeclaration())
+      MarkLive(GV);
+  });
+  for (DeferredModule &Deferred : DeferredModules)
+    ForEachGlobalValue(*Deferred.M, [&](GlobalValue &GV) {
+      if (!GV.isDeclaration() && IsRoot(GV))
+        MarkLive(GV);
+    });
+
+  SmallPtrSet<const Constant *, 64> Visited;
+  std::vector<const Constant *> ConstantWorklist;
+  auto MarkOperands = [&](const User &U) {
+    for (const Value *Op : U.operands()) {
+      const auto *C = dyn_cast_or_null<Constant>(Op);
+      if (C && Visited.insert(C).second)
+        ConstantWorklist.push_back(C);
+    }
+    while (!ConstantWorklist.empty()) {
+      const Constant *C = ConstantWorklist.back();
+      ConstantWorklist.pop_back();
+      if (auto *GV = dyn_cast<GlobalValue>(C)) {
+        MarkLive(*const_cast<GlobalValue *>(GV));
+        continue;
+      }
+      // A blockaddress refers to a basic block, which is not a constant.
+      for (const Value *Op : C->operands()) {
+        const auto *OpC = dyn_cast<Constant>(Op);
+        if (OpC && Visited.insert(OpC).second)
+          ConstantWorklist.push_back(OpC);
+      }
+    }
+  };
+
+  while (!Worklist.empty()) {
+    GlobalValue *GV = Worklist.back();
+    Worklist.pop_back();
+
+    // The linker keeps or drops a comdat as a whole.
+    if (const Comdat *C = GV->getComdat())
+      for (GlobalValue *Member : ComdatMembers[C])
+        if (Live.insert(Member).second)
+          Worklist.push_back(Member);
+
+    if (std::error_code EC = GV->materialize()) {
+      emitError(EC.message());
+      return;
+    }
+    MarkOperands(*GV);
+    if (auto *F = dyn_cast<Function>(GV))
+      for (BasicBlock &BB : *F)
+        for (Instruction &I : BB)
+          MarkOperands(I);
+  }
+
+  // Dead definitions only refer to each other, so once their bodies,
+  // initializers and aliasees are dropped they can be erased.
+  std::vector<GlobalValue *> Dead;
+  for (DeferredModule &Deferred : DeferredModules)
+    ForEachGlobalValue(*Deferred.M, [&](GlobalValue &GV) {
+      if (GV.isDeclaration() || Live.count(&GV))
+        return;
+      if (GV.isMaterializable())
+        ++NumUnparsedBodies;
+      if (auto *F = dyn_cast<Function>(&GV))
+        F->dropAllReferences();
+      else
+        GV.dropAllReferences();
+      Dead.push_back(&GV);
+    });
+  for (GlobalValue *GV : Dead) {
+    destroyConstantUsers(*GV);
+    GV->eraseFromParent();
+  }
+  NumDeadDefinitions += Dead.size();
+}
+
 /// Optimize merged modules using various IPO passes
 bool LTOCodeGenerator::optimize(bool DisableVerify, bool DisableInline,
                                 bool DisableGVNLoadPRE,
                                 bool DisableVectorization) {
-  if (!this->determineTarget())
+  if (!this->determineTarget() || !linkDeferredModules())
     return false;
 
   // Mark which symbols can not be internalized
@@ -488,13 +724,45 @@ bool LTOCodeGenerator::optimize(bool DisableVerify, bool DisableInline,
   PMB.populateLTOPassManager(passes);
 
   // Run our queue of passes all at once now, efficiently.
-  passes.run(*MergedModule);
+  {
+    TimeRegion T(TimePassesIsEnabled ? &OptimizeTimer : nullptr);
+    passes.run(*MergedModule);
+  }
+  MemoryUsageAfterOptimize = sampleMemoryUsage();
 
   return true;
 }
 
+namespace {
+/// Replaces the body of a function with an unreachable once code generation
+/// has emitted it. The function stays a definition, so that the code of the
+/// functions after it refers to it as before.
+class ReleaseFunctionBodies : public FunctionPass {
+  std::function<void(Function &)> Release;
+
+public:
+  static char ID;
+  ReleaseFunctionBodies(std::function<void(Function &)> Release)
+      : FunctionPass(ID), Release(std::move(Release)) {}
+
+  bool runOnFunction(Function &F) override {
+    // A blockaddress refers to its block until the end of code generation.
+    if (any_of(F, [](const BasicBlock &BB) { return BB.hasAddressTaken(); }))
+      return false;
+    Release(F);
+    return true;
+  }
+
+  const char *getPassName() const override {
+    return "Release function bodies";
+  }
+};
+}
+
+char ReleaseFunctionBodies::ID = 0;
+
 bool LTOCodeGenerator::compileOptimized(ArrayRef<raw_pwrite_stream *> Out) {
-  if (!this->determineTarget())
+  if (!this->determineTarget() || !linkDeferredModules())
     return false;
 
   legacy::PassManager preCodeGenPasses;
@@ -504,6 +772,34 @@ bool LTOCodeGenerator::compileOptimized(ArrayRef<raw_pwrite_stream *> Out) {
   preCodeGenPasses.add(createObjCARCContractPass());
   preCodeGenPasses.run(*MergedModule);
 
+  TimeRegion T(TimePassesIsEnabled ? &CodeGenTimer : nullptr);
+
+  // In a streaming link, release the body of every function as soon as it is
+  // emitted. The merged module can no longer be written or compiled again.
+  if (LTOStreamingLink && Out.size() == 1) {
+    legacy::PassManager CodeGenPasses;
+    if (TargetMach->addPassesToEmitFile(CodeGenPasses, *Out[0], FileType)) {
+      emitError("target does not support generation of this file type");
+      return false;
+    }
+    CodeGenPasses.add(new ReleaseFunctionBodies([this](Function &F) {
+      size_t Before = sampleMemoryUsage();
+      for (BasicBlock &BB : F)
+        BB.dropAllReferences();
+      while (!F.empty())
+        F.begin()->eraseFromParent();
+      new UnreachableInst(Context, BasicBlock::Create(Context, "", &F));
+      if (TimePassesIsEnabled)
+        ReleasedBodiesMemoryUsage += Before - std::min(
+            Before, sys::Process::GetMallocUsage());
+      ++NumReleasedBodies;
+      ++NumBodiesReleased;
+    }));
+    CodeGenPasses.run(*MergedModule);
+    sampleMemoryUsage();
+    return true;
+  }
+
   // Do code generation. We need to preserve the module in case the client calls
   // writeMergedModules() after compilation, but we only need to allow this at
   // parallelism level 1. This is achieved by having splitCodeGen return the
@@ -512,10 +808,41 @@ bool LTOCodeGenerator::compileOptimized(ArrayRef<raw_pwrite_stream *> Out) {
   MergedModule =
       splitCodeGen(std::move(MergedModule), Out, MCpu, FeatureStr, Options,
                    RelocModel, CodeModel::Default, CGOptLevel, FileType);
+  sampleMemoryUsage();
 
   return true;
 }
 
+size_t LTOCodeGenerator::sampleMemoryUsage() {
+  if (!TimePassesIsEnabled)
+    return 0;
+  size_t Usage = sys::Process::GetMallocUsage();
+  PeakMemoryUsage = std::max(PeakMemoryUsage, Usage);
+  return Usage;
+}
+
+void LTOCodeGenerator::printMemoryReport() {
+  // The heap is only sampled between phases, and after each function in a
+  // streaming link, so the peak is a lower bound.
+  if (!PeakMemoryUsage)
+    return;
+  std::unique_ptr<raw_ostream> OS = CreateInfoOutputFile();
+  *OS << "===" << std::string(73, '-') << "===\n";
+  OS->indent(32) << "LTO memory usage\n";
+  *OS << "===" << std::string(73, '-') << "===\n";
+  *OS << format("  Heap in use after linking:       %14zu bytes\n",
+                MemoryUsageAfterLink);
+  *OS << format("  Heap in use after optimization:  %14zu bytes\n",
+                MemoryUsageAfterOptimize);
+  *OS << format("  Peak heap in use:                %14zu bytes\n",
+                PeakMemoryUsage);
+  if (LTOStreamingLink)
+    *OS << format("  Released after code generation:  %14zu bytes in %u "
+                  "functions\n",
+                  ReleasedBodiesMemoryUsage, NumReleasedBodies);
+  *OS << '\n';
+}
+
 /// setCodeGenDebugOptions - Set codegen debugging options to aid in debugging
 /// LTO problems.
 void LTOCodeGenerator::setCodeGenDebugOptions(const char *Options) {
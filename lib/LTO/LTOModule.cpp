@@ -50,6 +50,10 @@
 using namespace llvm;
 using namespace llvm::object;
 
+namespace llvm {
+extern cl::opt<bool> LTOStreamingLink;
+extern cl::opt<bool> LTODeadStrip;
+}
 LTOModule::LTOModule(std::unique_ptr<object::IRObjectFile> Obj,
                      llvm::TargetMachine *TM)
     : IRFile(std::move(Obj)), _target(TM) {}
@@ -108,7 +112,7 @@ LTOModule::createFromFile(LLVMContext &Context, const char *path,
   if (std::error_code EC = BufferOrErr.getError())
     return EC;
   std::unique_ptr<MemoryBuffer> Buffer = std::move(BufferOrErr.get());
-  return makeLTOModule(Buffer->getMemBufferRef(), options, &Context);
+  return makeLTOModule(std::move(Buffer), options, Context);
 }
 
 ErrorOr<std::unique_ptr<LTOModule>>
@@ -126,7 +130,7 @@ LTOModule::createFromOpenFileSlice(LLVMContext &Context, int fd,
   if (std::error_code EC = BufferOrErr.getError())
     return EC;
   std::unique_ptr<MemoryBuffer> Buffer = std::move(BufferOrErr.get());
-  return makeLTOModule(Buffer->getMemBufferRef(), options, &Context);
+  return makeLTOModule(std::move(Buffer), options, Context);
 }
 
 ErrorOr<std::unique_ptr<LTOModule>>
@@ -153,7 +157,7 @@ LTOModule::createInContext(const void *mem, size_t length,
 
 static ErrorOr<std::unique_ptr<Module>>
 parseBitcodeFileImpl(MemoryBufferRef Buffer, LLVMContext &Context,
-                     bool ShouldBeLazy) {
+                     bool ShouldBeLazy, bool ShouldLazyLoadMetadata) {
 
   // Find the buffer.
   ErrorOr<MemoryBufferRef> MBOrErr =
@@ -173,15 +177,29 @@ parseBitcodeFileImpl(MemoryBufferRef Buffer, LLVMContext &Context,
   std::unique_ptr<MemoryBuffer> LightweightBuf =
       MemoryBuffer::getMemBuffer(*MBOrErr, false);
   ErrorOr<std::unique_ptr<Module>> M = getLazyBitcodeModule(
-      std::move(LightweightBuf), Context, true /*ShouldLazyLoadMetadata*/);
+      std::move(LightweightBuf), Context, ShouldLazyLoadMetadata);
   if (std::error_code EC = M.getError())
     return EC;
   return std::move(*M);
 }
 
+ErrorOr<std::unique_ptr<LTOModule>>
+LTOModule::makeLTOModule(std::unique_ptr<MemoryBuffer> Buffer,
+                         TargetOptions options, LLVMContext &Context) {
+  if (!LTOStreamingLink && !LTODeadStrip)
+    return makeLTOModule(Buffer->getMemBufferRef(), options, &Context);
+
+  // Keep the bitcode, from which the linker materializes the bodies it needs.
+  ErrorOr<std::unique_ptr<LTOModule>> Ret = makeLTOModule(
+      Buffer->getMemBufferRef(), options, &Context, /* ShouldBeLazy */ true);
+  if (Ret && *Ret)
+    (*Ret)->OwnedBuffer = std::move(Buffer);
+  return Ret;
+}
+
 ErrorOr<std::unique_ptr<LTOModule>>
 LTOModule::makeLTOModule(MemoryBufferRef Buffer, TargetOptions options,
-                         LLVMContext *Context) {
+                         LLVMContext *Context, bool ShouldBeLazy) {
   std::unique_ptr<LLVMContext> OwnedContext;
   if (!Context) {
     OwnedContext = llvm::make_unique<LLVMContext>();
@@ -189,10 +207,11 @@ LTOModule::makeLTOModule(MemoryBufferRef Buffer, TargetOptions options,
   }
 
   // If we own a context, we know this is being used only for symbol
-  // extraction, not linking.  Be lazy in that case.
-  ErrorOr<std::unique_ptr<Module>> MOrErr =
-      parseBitcodeFileImpl(Buffer, *Context,
-                           /* ShouldBeLazy */ static_cast<bool>(OwnedContext));
+  // extraction, not linking.  Be lazy in that case, down to the metadata.
+  // A module to link keeps its metadata, which holds the linker options.
+  ErrorOr<std::unique_ptr<Module>> MOrErr = parseBitcodeFileImpl(
+      Buffer, *Context, ShouldBeLazy || OwnedContext,
+      /* ShouldLazyLoadMetadata */ static_cast<bool>(OwnedContext));
   if (std::error_code EC = MOrErr.getError())
     return EC;
   std::unique_ptr<Module> &M = *MOrErr;
@@ -454,7 +473,10 @@ void LTOModule::addDefinedSymbol(const char *Name, const GlobalValue *def,
     attr |= LTO_SYMBOL_SCOPE_HIDDEN;
   else if (def->hasProtectedVisibility())
     attr |= LTO_SYMBOL_SCOPE_PROTECTED;
-  else if (canBeOmittedFromSymbolTable(def))
+  // Whether the address of a symbol is compared is only known from function
+  // bodies, which a lazily parsed module may not have yet.
+  else if ((def->hasUnnamedAddr() || getModule().isMaterialized()) &&
+           canBeOmittedFromSymbolTable(def))
     attr |= LTO_SYMBOL_SCOPE_DEFAULT_CAN_BE_HIDDEN;
   else
     attr |= LTO_SYMBOL_SCOPE_DEFAULT;
@@ -0,0 +1,574 @@
+//===-ThinLTOCodeGenerator.cpp - LLVM Link Time Optimizer -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the ThinLTO backend driver: function importing,
+// optimization and code generation for every module of a ThinLTO link, in
+// parallel and in process, and the cache of the objects it produces.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/LTO/ThinLTOCodeGenerator.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/FunctionInfo.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/FunctionImport.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include <algorithm>
+#include <thread>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "thinlto"
+
+STATISTIC(NumCacheHits, "Number of ThinLTO modules loaded from the cache");
+STATISTIC(NumCacheMisses, "Number of ThinLTO modules missing from the cache");
+
+ThinLTOCodeGenerator::ThinLTOCodeGenerator() {}
+
+ThinLTOCodeGenerator::~ThinLTOCodeGenerator() {}
+
+void ThinLTOCodeGenerator::addModule(StringRef Identifier, StringRef Data) {
+  MemoryBufferRef Buffer(Data, Identifier);
+  bool Inserted = ModuleMap.insert(std::make_pair(Identifier, Buffer)).second;
+  (void)Inserted;
+  assert(Inserted && "Module identifiers have to be unique");
+  Modules.push_back(Buffer);
+}
+
+void ThinLTOCodeGenerator::setOptLevel(unsigned Level) {
+  OptLevel = Level;
+  switch (OptLevel) {
+  case 0:
+    CGOptLevel = CodeGenOpt::None;
+    break;
+  case 1:
+    CGOptLevel = CodeGenOpt::Less;
+    break;
+  case 2:
+    CGOptLevel = CodeGenOpt::Default;
+    break;
+  case 3:
+    CGOptLevel = CodeGenOpt::Aggressive;
+    break;
+  }
+}
+
+/// Merge the function summaries of all of the modules. Modules without a
+/// summary do not export anything, but can still import.
+std::unique_ptr<FunctionInfoIndex> ThinLTOCodeGenerator::linkCombinedIndex() {
+  auto CombinedIndex = llvm::make_unique<FunctionInfoIndex>();
+  DiagnosticHandlerFunction Handler = [this](const DiagnosticInfo &DI) {
+    DiagnosticHandler2(DI);
+  };
+  uint64_t NextModuleId = 0;
+  for (MemoryBufferRef Buffer : Modules) {
+    if (!hasFunctionSummary(Buffer, Handler))
+      continue;
+    ErrorOr<std::unique_ptr<FunctionInfoIndex>> IndexOrErr =
+        getFunctionInfoIndex(Buffer, Handler);
+    if (!IndexOrErr) {
+      emitError("error reading the function summary of '" +
+                Buffer.getBufferIdentifier().str() +
+                "': " + IndexOrErr.getError().message());
+      return nullptr;
+    }
+    CombinedIndex->mergeFrom(std::move(*IndexOrErr), ++NextModuleId);
+  }
+  return CombinedIndex;
+}
+
+std::unique_ptr<TargetMachine>
+ThinLTOCodeGenerator::createTargetMachine(Module &TheModule) {
+  std::string TripleStr = TheModule.getTargetTriple();
+  if (TripleStr.empty()) {
+    TripleStr = sys::getDefaultTargetTriple();
+    TheModule.setTargetTriple(TripleStr);
+  }
+  Triple TheTriple(TripleStr);
+
+  std::string ErrMsg;
+  const Target *TheTarget = TargetRegistry::lookupTarget(TripleStr, ErrMsg);
+  if (!TheTarget) {
+    emitError(ErrMsg);
+    return nullptr;
+  }
+
+  SubtargetFeatures Features(MAttr);
+  Features.getDefaultSubtargetFeatures(TheTriple);
+  return std::unique_ptr<TargetMachine>(TheTarget->createTargetMachine(
+      TripleStr, MCpu, Features.getString(), Options, RelocModel,
+      CodeModel::Default, CGOptLevel));
+}
+
+/// Run the per-module optimization pipeline on TheModule, after importing.
+void ThinLTOCodeGenerator::optimizeModule(Module &TheModule,
+                                          TargetMachine &TM) {
+  TheModule.setDataLayout(TM.createDataLayout());
+
+  legacy::PassManager PM;
+  PM.add(createTargetTransformInfoWrapperPass(TM.getTargetIRAnalysis()));
+
+  PassManagerBuilder PMB;
+  PMB.LibraryInfo = new TargetLibraryInfoImpl(TM.getTargetTriple());
+  PMB.Inliner = createFunctionInliningPass();
+  PMB.OptLevel = OptLevel;
+  PMB.LoopVectorize = true;
+  PMB.SLPVectorize = true;
+  PMB.VerifyInput = true;
+  PMB.VerifyOutput = false;
+  PMB.populateModulePassManager(PM);
+
+  PM.run(TheModule);
+}
+
+std::unique_ptr<MemoryBuffer>
+ThinLTOCodeGenerator::codegenModule(Module &TheModule, TargetMachine &TM) {
+  SmallString<128> OutputBuffer;
+  {
+    raw_svector_ostream OS(OutputBuffer);
+    legacy::PassManager PM;
+    if (TM.addPassesToEmitFile(PM, OS, FileType)) {
+      emitError("target does not support generation of this file type");
+      return nullptr;
+    }
+    PM.run(TheModule);
+  }
+  return MemoryBuffer::getMemBufferCopy(OutputBuffer,
+                                        TheModule.getModuleIdentifier());
+}
+
+static void addIntToHash(MD5 &Hasher, uint64_t Value) {
+  uint8_t Bytes[8];
+  for (unsigned I = 0; I != 8; ++I)
+    Bytes[I] = uint8_t(Value >> (8 * I));
+  Hasher.update(ArrayRef<uint8_t>(Bytes));
+}
+
+static void addStringToHash(MD5 &Hasher, StringRef Str) {
+  addIntToHash(Hasher, Str.size());
+  Hasher.update(Str);
+}
+
+/// Add the options that affect the generated code to the hash. Returns false
+/// if some of them can't be hashed.
+static bool addTargetOptionsToHash(MD5 &Hasher, const TargetOptions &Options) {
+  // TargetRecip has no way to enumerate its settings; only the defaults are
+  // cacheable.
+  if (!(Options.Reciprocals == TargetRecip()))
+    return false;
+
+  const uint64_t Fields[] = {
+      Options.PrintMachineCode,
+      Options.LessPreciseFPMADOption,
+      Options.UnsafeFPMath,
+      Options.NoInfsFPMath,
+      Options.NoNaNsFPMath,
+      Options.HonorSignDependentRoundingFPMathOption,
+      Options.NoZerosInBSS,
+      Options.GuaranteedTailCallOpt,
+      Options.StackAlignmentOverride,
+      Options.EnableFastISel,
+      Options.PositionIndependentExecutable,
+      Options.UseInitArray,
+      Options.DisableIntegratedAS,
+      Options.CompressDebugSections,
+      Options.FunctionSections,
+      Options.DataSections,
+      Options.UniqueSectionNames,
+      Options.TrapUnreachable,
+      Options.EmulatedTLS,
+      Options.FloatABIType,
+      Options.AllowFPOpFusion,
+      Options.JTType,
+      Options.ThreadModel,
+      uint64_t(Options.EABIVersion),
+      uint64_t(Options.DebuggerTuning),
+      Options.MCOptions.SanitizeAddress,
+      Options.MCOptions.MCRelaxAll,
+      Options.MCOptions.MCNoExecStack,
+      Options.MCOptions.MCFatalWarnings,
+      Options.MCOptions.MCNoWarn,
+      Options.MCOptions.MCSaveTempLabels,
+      Options.MCOptions.MCUseDwarfDirectory,
+      Options.MCOptions.MCIncrementalLinkerCompatible,
+      Options.MCOptions.ShowMCEncoding,
+      Options.MCOptions.ShowMCInst,
+      Options.MCOptions.AsmVerbose,
+      uint64_t(Options.MCOptions.DwarfVersion)};
+  for (uint64_t Field : Fields)
+    addIntToHash(Hasher, Field);
+  addStringToHash(Hasher, Options.MCOptions.ABIName);
+  return true;
+}
+
+/// Compute the cache key of TheModule once the functions in Imports have been
+/// imported into it from the modules in Sources. Returns an empty key if the
+/// module can't be cached.
+std::string
+ThinLTOCodeGenerator::computeCacheKey(const Module &TheModule,
+                                      const FunctionInfoIndex &Index,
+                                      std::vector<std::string> &Sources,
+                                      std::vector<std::string> &Imports) {
+  MD5 Hasher;
+  if (!addTargetOptionsToHash(Hasher, Options))
+    return std::string();
+  addStringToHash(Hasher, LLVM_VERSION_STRING);
+  addStringToHash(Hasher, sys::getDefaultTargetTriple());
+  addStringToHash(Hasher, MCpu);
+  addStringToHash(Hasher, MAttr);
+  addIntToHash(Hasher, OptLevel);
+  addIntToHash(Hasher, CGOptLevel);
+  addIntToHash(Hasher, RelocModel);
+  addIntToHash(Hasher, FileType);
+
+  // The names of the promoted locals depend on the ids of the modules in the
+  // combined index, which change when modules are added or removed.
+  StringRef Identifier = TheModule.getModuleIdentifier();
+  addStringToHash(Hasher, ModuleHashes.lookup(Identifier));
+  addIntToHash(Hasher, Index.getModuleId(Identifier));
+
+  std::sort(Sources.begin(), Sources.end());
+  Sources.erase(std::unique(Sources.begin(), Sources.end()), Sources.end());
+  addIntToHash(Hasher, Sources.size());
+  for (const std::string &Source : Sources) {
+    addStringToHash(Hasher, ModuleHashes.lookup(Source));
+    addIntToHash(Hasher, Index.getModuleId(Source));
+  }
+
+  std::sort(Imports.begin(), Imports.end());
+  addIntToHash(Hasher, Imports.size());
+  for (const std::string &Name : Imports)
+    addStringToHash(Hasher, Name);
+
+  MD5::MD5Result Result;
+  Hasher.final(Result);
+  SmallString<32> Key;
+  MD5::stringifyResult(Result, Key);
+  return Key.str();
+}
+
+static void getCacheEntryPath(StringRef CacheDir, StringRef Key,
+                              SmallVectorImpl<char> &Path) {
+  Path.clear();
+  Path.append(CacheDir.begin(), CacheDir.end());
+  sys::path::append(Path, "llvmcache-" + Key);
+}
+
+/// Load the entry of Key from the cache, or return null if there is none.
+static std::unique_ptr<MemoryBuffer> readCacheEntry(StringRef CacheDir,
+                                                    StringRef Key) {
+  SmallString<128> EntryPath;
+  getCacheEntryPath(CacheDir, Key, EntryPath);
+  int FD;
+  if (sys::fs::openFileForRead(EntryPath, FD))
+    return nullptr;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getOpenFile(FD, EntryPath, /* FileSize */ -1,
+                                /* RequiresNullTerminator */ false);
+  // The modification time orders the entries for pruning.
+  sys::fs::setLastModificationAndAccessTime(FD, sys::TimeValue::now());
+  sys::Process::SafelyCloseFileDescriptor(FD);
+  if (!BufferOrErr)
+    return nullptr;
+  return std::move(*BufferOrErr);
+}
+
+/// Store Data as the entry of Key. The entry is written to a temporary file
+/// that is renamed into place, so that concurrent links never see a partial
+/// entry. Failures only cost a cache miss in the next link.
+static void writeCacheEntry(StringRef CacheDir, StringRef Key,
+                            StringRef Data) {
+  SmallString<128> TempModel(CacheDir);
+  sys::path::append(TempModel, "llvmcache-%%%%%%%%.tmp");
+  SmallString<128> TempPath;
+  int FD;
+  if (sys::fs::createUniqueFile(TempModel, FD, TempPath))
+    return;
+  {
+    raw_fd_ostream OS(FD, /* shouldClose */ true);
+    OS << Data;
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(TempPath);
+      return;
+    }
+  }
+  SmallString<128> EntryPath;
+  getCacheEntryPath(CacheDir, Key, EntryPath);
+  if (sys::fs::rename(TempPath, EntryPath))
+    sys::fs::remove(TempPath);
+}
+
+/// Remove the least recently used entries of the cache until it takes at most
+/// SizeLimit bytes.
+static void pruneCache(StringRef CacheDir, uint64_t SizeLimit) {
+  struct CacheEntry {
+    sys::TimeValue Time;
+    uint64_t Size;
+    std::string Path;
+  };
+  std::vector<CacheEntry> Entries;
+  uint64_t TotalSize = 0;
+  std::error_code EC;
+  for (sys::fs::directory_iterator File(CacheDir, EC), FileEnd;
+       File != FileEnd && !EC; File.increment(EC)) {
+    if (!sys::path::filename(File->path()).startswith("llvmcache-"))
+      continue;
+    sys::fs::file_status Status;
+    if (File->status(Status) || !sys::fs::is_regular_file(Status))
+      continue;
+    Entries.push_back(CacheEntry{Status.getLastModificationTime(),
+                                 Status.getSize(), File->path()});
+    TotalSize += Status.getSize();
+  }
+
+  std::sort(Entries.begin(), Entries.end(),
+            [](const CacheEntry &LHS, const CacheEntry &RHS) {
+              return LHS.Time < RHS.Time;
+            });
+  for (const CacheEntry &Entry : Entries) {
+    if (TotalSize <= SizeLimit)
+      break;
+    if (!sys::fs::remove(Entry.Path))
+      TotalSize -= Entry.Size;
+  }
+  DEBUG(dbgs() << "ThinLTO cache " << CacheDir << " pruned to " << TotalSize
+               << " bytes\n");
+}
+
+/// Import into, optimize and compile the module in Buffer, in a context of
+/// its own that is freed before returning.
+std::unique_ptr<MemoryBuffer>
+ThinLTOCodeGenerator::runBackend(MemoryBufferRef Buffer,
+                                 const FunctionInfoIndex &Index) {
+  LLVMContext Context;
+  Context.setDiagnosticHandler(ThinLTOCodeGenerator::DiagnosticHandler, this,
+                               /* RespectFilters */ true);
+
+  ErrorOr<std::unique_ptr<Module>> ModuleOrErr =
+      parseBitcodeFile(Buffer, Context);
+  if (!ModuleOrErr) {
+    emitError("error loading '" + Buffer.getBufferIdentifier().str() +
+              "': " + ModuleOrErr.getError().message());
+    return nullptr;
+  }
+  Module &TheModule = **ModuleOrErr;
+
+  // Promote the local values that other modules may import, with the names
+  // they are imported with.
+  if (renameModuleForThinLTO(TheModule, &Index)) {
+    emitError("error renaming '" + TheModule.getModuleIdentifier() + "'");
+    return nullptr;
+  }
+
+  // Anything defined after the import that is not defined now is imported.
+  StringSet<> Defined;
+  for (Function &F : TheModule)
+    if (!F.isDeclaration())
+      Defined.insert(F.getName());
+
+  // The modules to import from are loaded lazily, metadata included, in the
+  // context of this backend. This runs on a worker thread, so a module that
+  // fails to load is reported through the diagnostic handler and this backend
+  // gives up.
+  std::vector<std::string> Sources;
+  bool LoadFailed = false;
+  auto ModuleLoader = [&](StringRef Identifier) -> std::unique_ptr<Module> {
+    Sources.push_back(Identifier);
+    std::unique_ptr<MemoryBuffer> Source = MemoryBuffer::getMemBuffer(
+        ModuleMap.lookup(Identifier), /* RequiresNullTerminator */ false);
+    ErrorOr<std::unique_ptr<Module>> SourceOrErr = getLazyBitcodeModule(
+        std::move(Source), Context, /* ShouldLazyLoadMetadata */ true);
+    if (!SourceOrErr) {
+      emitError("error loading '" + Identifier.str() + "' to import from: " +
+                SourceOrErr.getError().message());
+      LoadFailed = true;
+      return nullptr;
+    }
+    return std::move(*SourceOrErr);
+  };
+  FunctionImporter Importer(Index, ModuleLoader);
+  Importer.importFunctions(TheModule);
+  if (LoadFailed)
+    return nullptr;
+
+  // Importing is cheap next to optimization and code generation, and tells
+  // what the output depends on. The hashes are only computed when the cache
+  // is usable.
+  std::string CacheKey;
+  if (!ModuleHashes.empty()) {
+    std::vector<std::string> Imports;
+    for (Function &F : TheModule)
+      if (!F.isDeclaration() && !Defined.count(F.getName()))
+        Imports.push_back(F.getName());
+    CacheKey = computeCacheKey(TheModule, Index, Sources, Imports);
+  }
+  if (!CacheKey.empty()) {
+    if (std::unique_ptr<MemoryBuffer> Cached =
+            readCacheEntry(CacheDir, CacheKey)) {
+      ++NumCacheHits;
+      ++CacheHits;
+      return Cached;
+    }
+    ++NumCacheMisses;
+    ++CacheMisses;
+  }
+
+  std::unique_ptr<TargetMachine> TM = createTargetMachine(TheModule);
+  if (!TM)
+    return nullptr;
+  optimizeModule(TheModule, *TM);
+  std::unique_ptr<MemoryBuffer> Binary = codegenModule(TheModule, *TM);
+  if (Binary && !CacheKey.empty())
+    writeCacheEntry(CacheDir, CacheKey, Binary->getBuffer());
+  return Binary;
+}
+
+bool ThinLTOCodeGenerator::run() {
+  HadErrors = false;
+  ProducedBinaries.clear();
+  ProducedBinaries.resize(Modules.size());
+
+  CacheHits = 0;
+  CacheMisses = 0;
+
+  std::unique_ptr<FunctionInfoIndex> Index = linkCombinedIndex();
+  if (!Index)
+    return false;
+
+  ModuleHashes.clear();
+  if (!CacheDir.empty()) {
+    if (std::error_code EC = sys::fs::create_directories(CacheDir)) {
+      emitWarning("can't create the cache directory '" + CacheDir +
+                  "': " + EC.message());
+    } else {
+      for (MemoryBufferRef Buffer : Modules) {
+        MD5 Hasher;
+        Hasher.update(Buffer.getBuffer());
+        MD5::MD5Result Result;
+        Hasher.final(Result);
+        SmallString<32> Hash;
+        MD5::stringifyResult(Result, Hash);
+        ModuleHashes[Buffer.getBufferIdentifier()] = Hash.str();
+      }
+    }
+  }
+
+  // Every task owns the context of its module, so at most Parallelism
+  // modules, plus the sources they import from, are in memory at a time.
+  {
+    ThreadPool Pool(Parallelism ? Parallelism
+                                : std::thread::hardware_concurrency());
+    for (unsigned I = 0, E = Modules.size(); I != E; ++I)
+      Pool.async([this, I, &Index]() {
+        ProducedBinaries[I] = runBackend(Modules[I], *Index);
+      });
+  }
+
+  if (!ModuleHashes.empty() && CacheSizeLimit)
+    pruneCache(CacheDir, CacheSizeLimit);
+
+  if (HadErrors)
+    return false;
+  for (const auto &Binary : ProducedBinaries)
+    if (!Binary)
+      return false;
+  return true;
+}
+
+void ThinLTOCodeGenerator::DiagnosticHandler(const DiagnosticInfo &DI,
+                                             void *Context) {
+  ((ThinLTOCodeGenerator *)Context)->DiagnosticHandler2(DI);
+}
+
+void ThinLTOCodeGenerator::DiagnosticHandler2(const DiagnosticInfo &DI) {
+  // Map the LLVM internal diagnostic severity to the LTO diagnostic severity.
+  lto_codegen_diagnostic_severity_t Severity;
+  const char *Prefix;
+  switch (DI.getSeverity()) {
+  case DS_Error:
+    Severity = LTO_DS_ERROR;
+    Prefix = "error: ";
+    break;
+  case DS_Warning:
+    Severity = LTO_DS_WARNING;
+    Prefix = "warning: ";
+    break;
+  case DS_Remark:
+    Severity = LTO_DS_REMARK;
+    Prefix = "remark: ";
+    break;
+  case DS_Note:
+    Severity = LTO_DS_NOTE;
+    Prefix = "note: ";
+    break;
+  }
+  // Create the string that will be reported to the external diagnostic handler.
+  std::string MsgStorage;
+  raw_string_ostream Stream(MsgStorage);
+  DiagnosticPrinterRawOStream DP(Stream);
+  DI.print(DP);
+  Stream.flush();
+
+  // The backends report from their own threads.
+  std::lock_guard<std::mutex> Lock(DiagLock);
+  if (Severity == LTO_DS_ERROR)
+    HadErrors = true;
+  if (DiagHandler)
+    (*DiagHandler)(Severity, MsgStorage.c_str(), DiagContext);
+  else
+    errs() << Prefix << MsgStorage << '\n';
+}
+
+void
+ThinLTOCodeGenerator::setDiagnosticHandler(lto_diagnostic_handler_t DiagHandler,
+                                           void *Ctxt) {
+  this->DiagHandler = DiagHandler;
+  this->DiagContext = Ctxt;
+}
+
+void ThinLTOCodeGenerator::emitError(const std::string &ErrMsg) {
+  std::lock_guard<std::mutex> Lock(DiagLock);
+  HadErrors = true;
+  if (DiagHandler)
+    (*DiagHandler)(LTO_DS_ERROR, ErrMsg.c_str(), DiagContext);
+  else
+    errs() << "error: " << ErrMsg << '\n';
+}
+
+void ThinLTOCodeGenerator::emitWarning(const std::string &WarnMsg) {
+  std::lock_guard<std::mutex> Lock(DiagLock);
+  if (DiagHandler)
+    (*DiagHandler)(LTO_DS_WARNING, WarnMsg.c_str(), DiagContext);
+  else
+    errs() << "warning: " << WarnMsg << '\n';
+}
@@ -11,6 +11,7 @@
 #include "LinkDiagnosticInfo.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DebugInfo.h"
@@ -20,6 +21,14 @@
 #include "llvm/Transforms/Utils/Cloning.h"
 using namespace llvm;
 
+#define DEBUG_TYPE "irmover"
+
+STATISTIC(NumTypesMapped, "Number of struct types mapped to an existing type");
+STATISTIC(NumTypesMerged, "Number of struct types mapped to an isomorphic "
+                          "type found by the hash of its shape");
+STATISTIC(NumTypesDuplicated, "Number of struct types copied into the "
+                              "destination module");
+
 //===----------------------------------------------------------------------===//
 // TypeMap implementation.
 //===----------------------------------------------------------------------===//
@@ -44,14 +53,28 @@ class TypeMapTy : public ValueMapTypeRemapper {
   /// getting a body from the source module.
   SmallPtrSet<StructType *, 16> DstResolvedOpaqueTypes;
 
+  /// Whether a mapping may match an opaque type with a different type, which
+  /// gives a body to it if it is a type of the destination module.
+  bool MapOpaqueTypes = true;
+
 public:
   TypeMapTy(IRMover::IdentifiedStructTypeSet &DstStructTypesSet)
       : DstStructTypesSet(DstStructTypesSet) {}
 
   IRMover::IdentifiedStructTypeSet &DstStructTypesSet;
   /// Indicate that the specified type in the destination module is conceptually
-  /// equivalent to the specified type in the source module.
-  void addTypeMapping(Type *DstTy, Type *SrcTy);
+  /// equivalent to the specified type in the source module. Return false if
+  /// they are not isomorphic, in which case no mapping is added.
+  bool addTypeMapping(Type *DstTy, Type *SrcTy);
+
+  /// Map the non opaque struct type SrcTy to an isomorphic type of the
+  /// destination module that is not a type of the source module, if there is
+  /// one. Unlike addTypeMapping, this never matches an opaque type with another
+  /// type, since the types aren't known to be related.
+  bool addIsomorphicTypeMapping(StructType *SrcTy,
+                                const SmallPtrSetImpl<StructType *> &SrcTypes);
+
+  bool hasTypeMapping(Type *SrcTy) const { return MappedTypes.count(SrcTy); }
 
   /// Produce a body for an opaque type in the dest module from a type
   /// definition in the source module.
@@ -75,13 +98,14 @@ private:
 };
 }
 
-void TypeMapTy::addTypeMapping(Type *DstTy, Type *SrcTy) {
+bool TypeMapTy::addTypeMapping(Type *DstTy, Type *SrcTy) {
   assert(SpeculativeTypes.empty());
   assert(SpeculativeDstOpaqueTypes.empty());
 
   // Check to see if these types are recursively isomorphic and establish a
   // mapping between them if so.
-  if (!areTypesIsomorphic(DstTy, SrcTy)) {
+  bool Isomorphic = areTypesIsomorphic(DstTy, SrcTy);
+  if (!Isomorphic) {
     // Oops, they aren't isomorphic.  Just discard this request by rolling out
     // any speculative mappings we've established.
     for (Type *Ty : SpeculativeTypes)
@@ -92,13 +116,39 @@ void TypeMapTy::addTypeMapping(Type *DstTy, Type *SrcTy) {
     for (StructType *Ty : SpeculativeDstOpaqueTypes)
       DstResolvedOpaqueTypes.erase(Ty);
   } else {
+    // The mapping is committed. Opaque types are only left alone by
+    // addIsomorphicTypeMapping, so count its structs as merged by shape.
     for (Type *Ty : SpeculativeTypes)
-      if (auto *STy = dyn_cast<StructType>(Ty))
+      if (auto *STy = dyn_cast<StructType>(Ty)) {
+        if (!STy->isLiteral()) {
+          if (MapOpaqueTypes)
+            ++NumTypesMapped;
+          else
+            ++NumTypesMerged;
+        }
         if (STy->hasName())
           STy->setName("");
+      }
   }
   SpeculativeTypes.clear();
   SpeculativeDstOpaqueTypes.clear();
+  return Isomorphic;
+}
+
+bool TypeMapTy::addIsomorphicTypeMapping(
+    StructType *SrcTy, const SmallPtrSetImpl<StructType *> &SrcTypes) {
+  MapOpaqueTypes = false;
+  bool Mapped = false;
+  for (StructType *DstTy : DstStructTypesSet.findIsomorphicCandidates(SrcTy)) {
+    if (SrcTypes.count(DstTy))
+      continue;
+    if (addTypeMapping(DstTy, SrcTy)) {
+      Mapped = true;
+      break;
+    }
+  }
+  MapOpaqueTypes = true;
+  return Mapped;
 }
 
 /// Recursively walk this pair of types, returning true if they are isomorphic,
@@ -124,6 +174,10 @@ bool TypeMapTy::areTypesIsomorphic(Type *DstTy, Type *SrcTy) {
 
   // If this is an opaque struct type, special case it.
   if (StructType *SSTy = dyn_cast<StructType>(SrcTy)) {
+    if (!MapOpaqueTypes &&
+        (SSTy->isOpaque() || cast<StructType>(DstTy)->isOpaque()))
+      return false;
+
     // Mapping an opaque type to any struct, just keep the dest struct.
     if (SSTy->isOpaque()) {
       Entry = DstTy;
@@ -208,6 +262,7 @@ void TypeMapTy::linkDefinedTypeBodies() {
 
 void TypeMapTy::finishType(StructType *DTy, StructType *STy,
                            ArrayRef<Type *> ETypes) {
+  ++NumTypesDuplicated;
   DTy->setBody(ETypes, STy->isPacked());
 
   // Steal STy's name.
@@ -313,11 +368,13 @@ Type *TypeMapTy::get(Type *Ty, SmallPtrSet<StructType *, 8> &Visited) {
 
     if (StructType *OldT =
             DstStructTypesSet.findNonOpaque(ElementTypes, IsPacked)) {
+      ++NumTypesMapped;
       STy->setName("");
       return *Entry = OldT;
     }
 
     if (!AnyChange) {
+      ++NumTypesDuplicated;
       DstStructTypesSet.addNonOpaque(STy);
       return *Entry = Ty;
     }
@@ -857,6 +914,16 @@ void IRLinker::computeTypeMapping() {
       TypeMap.addTypeMapping(DST, ST);
   }
 
+  // Then look for a type isomorphic to each of the remaining source types
+  // among the destination types, whatever their name. Mapping the elements of
+  // a type first, as TypeMapTy::get does, finds isomorphic types that are not
+  // recursive, but a recursive type would be copied into the destination
+  // module again.
+  SmallPtrSet<StructType *, 16> SrcTypes(Types.begin(), Types.end());
+  for (StructType *ST : Types)
+    if (!ST->isOpaque() && !TypeMap.hasTypeMapping(ST))
+      TypeMap.addIsomorphicTypeMapping(ST, SrcTypes);
+
   // Now that we have discovered all of the type equivalences, get a body for
   // any 'opaque' types in the dest module that are now resolved.
   TypeMap.linkDefinedTypeBodies();
@@ -1551,9 +1618,16 @@ bool IRLinker::run() {
     // any are referenced by metadata. IRLinker::shouldLink ensures that
     // we don't actually link anything from source.
     if (IsMetadataLinkingPostpass) {
-      // Ensure metadata materialized
+      // Ensure metadata materialized, including what the imported functions
+      // reference.
       if (SrcM.getMaterializer()->materializeMetadata())
         return true;
+      SmallVector<unsigned, 64> TempMDIDs;
+      for (auto &I : *ValIDToTempMDMap)
+        TempMDIDs.push_back(I.first);
+      std::sort(TempMDIDs.begin(), TempMDIDs.end());
+      if (SrcM.getMaterializer()->materializeMetadataIDs(TempMDIDs))
+        return true;
       SrcM.getMaterializer()->saveMetadataList(MetadataToIDs,
                                                /* OnlyTempMD = */ false);
     }
@@ -1637,14 +1711,62 @@ bool IRMover::StructTypeKeyInfo::isEqual(const StructType *LHS,
   return KeyTy(LHS) == KeyTy(RHS);
 }
 
+/// Hash the shape of Ty: what is left of it when the identity of the
+/// identified structures it contains is ignored. Types that are isomorphic
+/// have the same shape. Only the packedness and the number of elements of a
+/// nested identified structure are hashed, which keeps the hash of a
+/// recursive type finite.
+static hash_code getShapeHash(Type *Ty) {
+  auto *STy = dyn_cast<StructType>(Ty);
+  if (STy && !STy->isLiteral())
+    return hash_combine(Type::StructTyID, STy->isPacked(),
+                        STy->getNumElements());
+
+  hash_code Hash = hash_value(Ty->getTypeID());
+  if (auto *ITy = dyn_cast<IntegerType>(Ty))
+    Hash = hash_combine(Hash, ITy->getBitWidth());
+  else if (auto *PTy = dyn_cast<PointerType>(Ty))
+    Hash = hash_combine(Hash, PTy->getAddressSpace());
+  else if (auto *FTy = dyn_cast<FunctionType>(Ty))
+    Hash = hash_combine(Hash, FTy->isVarArg());
+  else if (STy)
+    Hash = hash_combine(Hash, STy->isPacked());
+  else if (auto *SeqTy = dyn_cast<ArrayType>(Ty))
+    Hash = hash_combine(Hash, SeqTy->getNumElements());
+  else if (auto *SeqTy = dyn_cast<VectorType>(Ty))
+    Hash = hash_combine(Hash, SeqTy->getNumElements());
+
+  for (Type *ElTy : Ty->subtypes())
+    Hash = hash_combine(Hash, getShapeHash(ElTy));
+  return Hash;
+}
+
+/// Hash the body of the identified structure STy by its shape. The result is
+/// never one of the empty and tombstone keys of a DenseMap<unsigned, ...>.
+static unsigned getBodyShapeHash(StructType *STy) {
+  hash_code Hash = hash_value(STy->isPacked());
+  for (Type *ElTy : STy->elements())
+    Hash = hash_combine(Hash, getShapeHash(ElTy));
+  unsigned Key = Hash;
+  if (Key == DenseMapInfo<unsigned>::getEmptyKey() ||
+      Key == DenseMapInfo<unsigned>::getTombstoneKey())
+    Key = 0;
+  return Key;
+}
+
 void IRMover::IdentifiedStructTypeSet::addNonOpaque(StructType *Ty) {
   assert(!Ty->isOpaque());
   NonOpaqueStructTypes.insert(Ty);
+  TinyPtrVector<StructType *> &Bucket =
+      NonOpaqueStructTypesByShape[getBodyShapeHash(Ty)];
+  if (std::find(Bucket.begin(), Bucket.end(), Ty) == Bucket.end())
+    Bucket.push_back(Ty);
 }
 
 void IRMover::IdentifiedStructTypeSet::switchToNonOpaque(StructType *Ty) {
   assert(!Ty->isOpaque());
   NonOpaqueStructTypes.insert(Ty);
+  NonOpaqueStructTypesByShape[getBodyShapeHash(Ty)].push_back(Ty);
   bool Removed = OpaqueStructTypes.erase(Ty);
   (void)Removed;
   assert(Removed);
@@ -1665,6 +1787,14 @@ IRMover::IdentifiedStructTypeSet::findNonOpaque(ArrayRef<Type *> ETypes,
   return *I;
 }
 
+ArrayRef<StructType *>
+IRMover::IdentifiedStructTypeSet::findIsomorphicCandidates(StructType *Ty) {
+  auto I = NonOpaqueStructTypesByShape.find(getBodyShapeHash(Ty));
+  if (I == NonOpaqueStructTypesByShape.end())
+    return None;
+  return I->second;
+}
+
 bool IRMover::IdentifiedStructTypeSet::hasType(StructType *Ty) {
   if (Ty->isOpaque())
     return OpaqueStructTypes.count(Ty);
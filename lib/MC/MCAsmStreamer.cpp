@@ -210,6 +210,7 @@ public:
   void EmitCFIRememberState() override;
   void EmitCFIRestoreState() override;
   void EmitCFISameValue(int64_t Register) override;
+  void EmitCFIRestore(int64_t Register) override;
   void EmitCFIRelOffset(int64_t Register, int64_t Offset) override;
   void EmitCFIAdjustCfaOffset(int64_t Adjustment) override;
   void EmitCFIEscape(StringRef Values) override;
@@ -1090,6 +1091,13 @@ void MCAsmStreamer::EmitCFISameValue(int64_t Register) {
   EmitEOL();
 }
 
+void MCAsmStreamer::EmitCFIRestore(int64_t Register) {
+  MCStreamer::EmitCFIRestore(Register);
+  OS << "\t.cfi_restore ";
+  EmitRegisterName(Register);
+  EmitEOL();
+}
+
 void MCAsmStreamer::EmitCFIRelOffset(int64_t Register, int64_t Offset) {
   MCStreamer::EmitCFIRelOffset(Register, Offset);
   OS << "\t.cfi_rel_offset ";
@@ -497,6 +497,9 @@ void ScalarEnumerationTraits<ELFYAML::ELF_REL>::enumeration(
   case ELF::EM_HEXAGON:
 #include "llvm/Support/ELFRelocs/Hexagon.def"
     break;
+  case ELF::EM_ALTERA_NIOS2:
+#include "llvm/Support/ELFRelocs/Nios2.def"
+    break;
   case ELF::EM_386:
   case ELF::EM_IAMCU:
 #include "llvm/Support/ELFRelocs/i386.def"
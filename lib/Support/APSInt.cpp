@@ -22,7 +22,19 @@ APSInt::APSInt(StringRef Str) {
 
   // (Over-)estimate the required number of bits.
   unsigned NumBits = ((Str.size() * 64) / 19) + 2;
-  APInt Tmp(NumBits, Str, /*Radix=*/10);
+  APInt Tmp;
+  StringRef Digits = Str.drop_front(Str[0] == '-' || Str[0] == '+');
+  if (Digits.size() <= 18) {
+    // The value fits in 63 bits, so skip the APInt arithmetic of fromString.
+    uint64_t Val = 0;
+    for (char C : Digits) {
+      assert(C >= '0' && C <= '9' && "Invalid character in digit string");
+      Val = Val * 10 + (C - '0');
+    }
+    Tmp = APInt(NumBits, Str[0] == '-' ? -Val : Val, /*isSigned=*/true);
+  } else {
+    Tmp = APInt(NumBits, Str, /*Radix=*/10);
+  }
   if (Str[0] == '-') {
     unsigned MinBits = Tmp.getMinSignedBits();
     if (MinBits > 0 && MinBits < NumBits)
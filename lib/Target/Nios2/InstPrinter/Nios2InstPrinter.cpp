@@ -94,12 +94,16 @@ void Nios2InstPrinter::printInst(const MCInst *MI, raw_ostream &O,
 static void printExpr(const MCExpr *Expr, raw_ostream &OS) {
   int Offset = 0;
   const MCSymbolRefExpr *SRE;
+  const MCSymbolRefExpr *SubSRE = nullptr;
 
   if (const MCBinaryExpr *BE = dyn_cast<MCBinaryExpr>(Expr)) {
     SRE = dyn_cast<MCSymbolRefExpr>(BE->getLHS());
+    SubSRE = dyn_cast<MCSymbolRefExpr>(BE->getRHS());
     const MCConstantExpr *CE = dyn_cast<MCConstantExpr>(BE->getRHS());
-    assert(SRE && CE && "Binary expression must be sym+const.");
-    Offset = CE->getValue();
+    assert(SRE && (CE || (SubSRE && BE->getOpcode() == MCBinaryExpr::Sub)) &&
+           "Binary expression must be sym+const or sym-sym.");
+    if (CE)
+      Offset = CE->getValue();
   }
   else if (!(SRE = dyn_cast<MCSymbolRefExpr>(Expr)))
     assert(false && "Unexpected MCExpr type.");
@@ -111,10 +115,23 @@ static void printExpr(const MCExpr *Expr, raw_ostream &OS) {
   case MCSymbolRefExpr::VK_None:           break;
   case MCSymbolRefExpr::VK_Nios2_HIADJ16:   OS << "%hiadj(";     break;
   case MCSymbolRefExpr::VK_Nios2_LO16:      OS << "%lo(";     break;
+  case MCSymbolRefExpr::VK_Nios2_PCREL_HA:  OS << "%hiadj(";  break;
+  case MCSymbolRefExpr::VK_Nios2_PCREL_LO:  OS << "%lo(";     break;
+  case MCSymbolRefExpr::VK_Nios2_GOT16:     OS << "%got(";    break;
+  case MCSymbolRefExpr::VK_Nios2_CALL16:    OS << "%call(";   break;
+  case MCSymbolRefExpr::VK_Nios2_GOTOFF_HA: OS << "%gotoff_hiadj("; break;
+  case MCSymbolRefExpr::VK_Nios2_GOTOFF_LO: OS << "%gotoff_lo(";    break;
+  case MCSymbolRefExpr::VK_Nios2_GOT_HA:    OS << "%got_hiadj(";    break;
+  case MCSymbolRefExpr::VK_Nios2_GOT_LO:    OS << "%got_lo(";       break;
+  case MCSymbolRefExpr::VK_Nios2_CALL_HA:   OS << "%call_hiadj(";   break;
+  case MCSymbolRefExpr::VK_Nios2_CALL_LO:   OS << "%call_lo(";      break;
   }
 
   OS << SRE->getSymbol();
 
+  if (SubSRE)
+    OS << '-' << SubSRE->getSymbol();
+
   if (Offset) {
     if (Offset > 0)
       OS << '+';
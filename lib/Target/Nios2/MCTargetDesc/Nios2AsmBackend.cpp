@@ -21,6 +21,7 @@
 #include "llvm/MC/MCFixupKindInfo.h"
 #include "llvm/MC/MCObjectWriter.h"
 #include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -33,49 +34,39 @@ static unsigned adjustFixupValue(unsigned Kind, uint64_t Value) {
   switch (Kind) {
   default:
     return 0;
-  case FK_GPRel_4:
+  case FK_Data_1:
+  case FK_Data_2:
   case FK_Data_4:
   case FK_Data_8:
-  case Nios2::fixup_Nios2_LO16:
+  case Nios2::fixup_Nios2_16:
+  case Nios2::fixup_Nios2_32:
+  case Nios2::fixup_Nios2_SHIFT5:
+  case Nios2::fixup_Nios2_SHIFT6:
   case Nios2::fixup_Nios2_GPREL16:
-  case Nios2::fixup_Nios2_GPOFF_HI:
-  case Nios2::fixup_Nios2_GPOFF_LO:
-  case Nios2::fixup_Nios2_GOT_PAGE:
-  case Nios2::fixup_Nios2_GOT_OFST:
-  case Nios2::fixup_Nios2_GOT_DISP:
+    break;
+  case Nios2::fixup_Nios2_LO16:
   case Nios2::fixup_Nios2_GOT_LO16:
   case Nios2::fixup_Nios2_CALL_LO16:
+  case Nios2::fixup_Nios2_GOTOFF_LO:
+    Value &= 0xffff;
     break;
   case Nios2::fixup_Nios2_PC16:
-    // So far we are only using this type for branches.
-    // For branches we start 1 instruction after the branch
-    // so the displacement will be one instruction size less.
+  case Nios2::fixup_Nios2_Branch_PCRel:
+    // Branch offsets are in bytes and relative to the instruction following
+    // the branch.
     Value -= 4;
-    // The displacement is then divided by 4 to give us an 18 bit
-    // address range.
-    Value >>= 2;
     break;
   case Nios2::fixup_Nios2_26:
-    // So far we are only using this type for jumps.
-    // The displacement is then divided by 4 to give us an 28 bit
-    // address range.
+    // Calls and jumps hold bits 27-2 of the absolute target address.
     Value >>= 2;
     break;
   case Nios2::fixup_Nios2_HI16:
-  case Nios2::fixup_Nios2_GOT_Local:
   case Nios2::fixup_Nios2_GOT_HI16:
   case Nios2::fixup_Nios2_CALL_HI16:
-    // Get the 2nd 16-bits. Also add 1 if bit 15 is 1.
+  case Nios2::fixup_Nios2_GOTOFF_HA:
+    // %hiadj: get the 2nd 16-bits. Also add 1 if bit 15 is 1.
     Value = ((Value + 0x8000) >> 16) & 0xffff;
     break;
-  case Nios2::fixup_Nios2_HIGHER:
-    // Get the 3rd 16-bits.
-    Value = ((Value + 0x80008000LL) >> 32) & 0xffff;
-    break;
-  case Nios2::fixup_Nios2_HIGHEST:
-    // Get the 4th 16-bits.
-    Value = ((Value + 0x800080008000LL) >> 48) & 0xffff;
-    break;
   }
 
   return Value;
@@ -108,42 +99,26 @@ public:
     if (!Value)
       return; // Doesn't change encoding.
 
-    // Where do we start in the object
     unsigned Offset = Fixup.getOffset();
-    // Number of bytes we need to fixup
-    unsigned NumBytes = (getFixupKindInfo(Kind).TargetSize + 7) / 8;
-    // Used to point to big endian bytes
-    unsigned FullSize;
 
-    switch ((unsigned)Kind) {
-    case Nios2::fixup_Nios2_16:
-      FullSize = 2;
-      break;
-    case Nios2::fixup_Nios2_64:
-      FullSize = 8;
-      break;
-    default:
-      FullSize = 4;
-      break;
+    // Data fixups are plain little-endian values.
+    if (Kind < FirstTargetFixupKind) {
+      unsigned NumBytes = getFixupKindInfo(Kind).TargetSize / 8;
+      assert(Offset + NumBytes <= DataSize && "Invalid fixup offset!");
+      for (unsigned i = 0; i != NumBytes; ++i)
+        Data[Offset + i] |= uint8_t((Value >> (i * 8)) & 0xff);
+      return;
     }
 
-    // Grab current value, if any, from bits.
-    uint64_t CurVal = 0;
-
-    for (unsigned i = 0; i != NumBytes; ++i) {
-      unsigned Idx = IsLittle ? i : (FullSize - 1 - i);
-      CurVal |= (uint64_t)((uint8_t)Data[Offset + Idx]) << (i*8);
-    }
-
-    uint64_t Mask = ((uint64_t)(-1) >>
-                     (64 - getFixupKindInfo(Kind).TargetSize));
-    CurVal |= Value & Mask;
-
-    // Write out the fixed up bytes back to the code/data bits.
-    for (unsigned i = 0; i != NumBytes; ++i) {
-      unsigned Idx = IsLittle ? i : (FullSize - 1 - i);
-      Data[Offset + Idx] = (uint8_t)((CurVal >> (i*8)) & 0xff);
-    }
+    // Every target fixup patches a field of one instruction word, so read,
+    // modify and write the whole word at once.
+    const MCFixupKindInfo &Info = getFixupKindInfo(Kind);
+    assert(Offset + 4 <= DataSize && "Invalid fixup offset!");
+    uint32_t Mask = uint32_t(~0ULL >> (64 - Info.TargetSize))
+                    << Info.TargetOffset;
+    uint32_t CurVal = support::endian::read32le(Data + Offset);
+    CurVal |= (uint32_t(Value) << Info.TargetOffset) & Mask;
+    support::endian::write32le(Data + Offset, CurVal);
   }
 
   unsigned getNumFixupKinds() const override { return Nios2::NumTargetFixupKinds; }
@@ -154,41 +129,43 @@ public:
       // Nios2FixupKinds.h.
       //
       // name                    offset  bits  flags
-      { "fixup_Nios2_16",           0,     16,   0 },
+      { "fixup_Nios2_16",           6,     16,   0 },
       { "fixup_Nios2_32",           0,     32,   0 },
       { "fixup_Nios2_REL32",        0,     32,   0 },
-      { "fixup_Nios2_26",           0,     26,   0 },
-      { "fixup_Nios2_HI16",         0,     16,   0 },
-      { "fixup_Nios2_LO16",         0,     16,   0 },
-      { "fixup_Nios2_GPREL16",      0,     16,   0 },
-      { "fixup_Nios2_LITERAL",      0,     16,   0 },
-      { "fixup_Nios2_GOT_Global",   0,     16,   0 },
-      { "fixup_Nios2_GOT_Local",    0,     16,   0 },
-      { "fixup_Nios2_PC16",         0,     16,  MCFixupKindInfo::FKF_IsPCRel },
-      { "fixup_Nios2_CALL16",       0,     16,   0 },
+      { "fixup_Nios2_26",           6,     26,   0 },
+      { "fixup_Nios2_HI16",         6,     16,   0 },
+      { "fixup_Nios2_LO16",         6,     16,   0 },
+      { "fixup_Nios2_GPREL16",      6,     16,   0 },
+      { "fixup_Nios2_LITERAL",      6,     16,   0 },
+      { "fixup_Nios2_GOT_Global",   6,     16,   0 },
+      { "fixup_Nios2_GOT_Local",    6,     16,   0 },
+      { "fixup_Nios2_PC16",         6,     16,  MCFixupKindInfo::FKF_IsPCRel },
+      { "fixup_Nios2_CALL16",       6,     16,   0 },
       { "fixup_Nios2_GPREL32",      0,     32,   0 },
       { "fixup_Nios2_SHIFT5",       6,      5,   0 },
-      { "fixup_Nios2_SHIFT6",       6,      5,   0 },
+      { "fixup_Nios2_SHIFT6",       6,      6,   0 },
       { "fixup_Nios2_64",           0,     64,   0 },
-      { "fixup_Nios2_TLSGD",        0,     16,   0 },
-      { "fixup_Nios2_GOTTPREL",     0,     16,   0 },
-      { "fixup_Nios2_TPREL_HI",     0,     16,   0 },
-      { "fixup_Nios2_TPREL_LO",     0,     16,   0 },
-      { "fixup_Nios2_TLSLDM",       0,     16,   0 },
-      { "fixup_Nios2_DTPREL_HI",    0,     16,   0 },
-      { "fixup_Nios2_DTPREL_LO",    0,     16,   0 },
-      { "fixup_Nios2_Branch_PCRel", 0,     16,  MCFixupKindInfo::FKF_IsPCRel },
-      { "fixup_Nios2_GPOFF_HI",     0,     16,   0 },
-      { "fixup_Nios2_GPOFF_LO",     0,     16,   0 },
-      { "fixup_Nios2_GOT_PAGE",     0,     16,   0 },
-      { "fixup_Nios2_GOT_OFST",     0,     16,   0 },
-      { "fixup_Nios2_GOT_DISP",     0,     16,   0 },
-      { "fixup_Nios2_HIGHER",       0,     16,   0 },
-      { "fixup_Nios2_HIGHEST",      0,     16,   0 },
-      { "fixup_Nios2_GOT_HI16",     0,     16,   0 },
-      { "fixup_Nios2_GOT_LO16",     0,     16,   0 },
-      { "fixup_Nios2_CALL_HI16",    0,     16,   0 },
-      { "fixup_Nios2_CALL_LO16",    0,     16,   0 }
+      { "fixup_Nios2_TLSGD",        6,     16,   0 },
+      { "fixup_Nios2_GOTTPREL",     6,     16,   0 },
+      { "fixup_Nios2_TPREL_HI",     6,     16,   0 },
+      { "fixup_Nios2_TPREL_LO",     6,     16,   0 },
+      { "fixup_Nios2_TLSLDM",       6,     16,   0 },
+      { "fixup_Nios2_DTPREL_HI",    6,     16,   0 },
+      { "fixup_Nios2_DTPREL_LO",    6,     16,   0 },
+      { "fixup_Nios2_Branch_PCRel", 6,     16,  MCFixupKindInfo::FKF_IsPCRel },
+      { "fixup_Nios2_GPOFF_HI",     6,     16,   0 },
+      { "fixup_Nios2_GPOFF_LO",     6,     16,   0 },
+      { "fixup_Nios2_GOT_PAGE",     6,     16,   0 },
+      { "fixup_Nios2_GOT_OFST",     6,     16,   0 },
+      { "fixup_Nios2_GOT_DISP",     6,     16,   0 },
+      { "fixup_Nios2_HIGHER",       6,     16,   0 },
+      { "fixup_Nios2_HIGHEST",      6,     16,   0 },
+      { "fixup_Nios2_GOT_HI16",     6,     16,   0 },
+      { "fixup_Nios2_GOT_LO16",     6,     16,   0 },
+      { "fixup_Nios2_CALL_HI16",    6,     16,   0 },
+      { "fixup_Nios2_CALL_LO16",    6,     16,   0 },
+      { "fixup_Nios2_GOTOFF_HA",    6,     16,   0 },
+      { "fixup_Nios2_GOTOFF_LO",    6,     16,   0 }
     };
 
     if (Kind < FirstTargetFixupKind)
@@ -243,9 +220,10 @@ public:
     // We shouldn't be using a hard coded number for instruction size.
     if (Count % 4) return false;
 
+    // "nop" is "add zero, zero, zero".
     uint64_t NumNops = Count / 4;
     for (uint64_t i = 0; i != NumNops; ++i)
-      OW->write32(0);
+      OW->write32(0x0001883a);
     return true;
   }
 }; // class Nios2AsmBackend
@@ -19,6 +19,7 @@
 #include "llvm/MC/MCExpr.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MathExtras.h"
 
 namespace llvm {
 
@@ -84,7 +85,20 @@ namespace Nios2II {
     /// MO_HIGHER/HIGHEST - Represents the highest or higher half word of a
     /// 64-bit symbol address.
     MO_HIGHER,
-    MO_HIGHEST
+    MO_HIGHEST,
+
+    /// MO_GOTOFF_HA/LO - Represents the adjusted hi and the low part of the
+    /// offset of a symbol from the GOT pointer (%gotoff_hiadj, %gotoff_lo).
+    MO_GOTOFF_HA,
+    MO_GOTOFF_LO,
+
+    /// MO_GOT_HA/LO, MO_CALL_HA/LO - Represent the adjusted hi and the low
+    /// part of the offset of a symbol's GOT entry when the GOT is larger than
+    /// 64KB (%got_hiadj, %got_lo, %call_hiadj, %call_lo).
+    MO_GOT_HA,
+    MO_GOT_LO,
+    MO_CALL_HA,
+    MO_CALL_LO
   };
 
   enum {
@@ -184,6 +198,42 @@ inline static unsigned getNios2RegisterNumbering(unsigned RegEnum)
   }
 }
 
+/// Nios2ImmInst - One instruction of a constant materialization sequence,
+/// "Opcode $dst, $src, ImmOpnd". The first instruction of a sequence reads
+/// $zero, the second one the result of the first. ImmOpnd is signed for
+/// ADDi and unsigned for ORi and ORhi.
+struct Nios2ImmInst {
+  unsigned Opcode;
+  int32_t ImmOpnd;
+};
+
+/// getNios2ImmSeq - Fill Seq with the shortest sequence that materializes
+/// Imm in a register and return its length. This is shared by instruction
+/// selection, frame lowering and the cost model, so that they agree on what
+/// a constant costs:
+///   addi  $dst, $zero, imm        (sign-extended 16-bit)
+///   ori   $dst, $zero, imm        (movui, zero-extended 16-bit)
+///   orhi  $dst, $zero, imm >> 16  (movhi, low half clear)
+///   orhi + ori                    (anything else)
+inline static unsigned getNios2ImmSeq(int32_t Imm, Nios2ImmInst Seq[2]) {
+  uint32_t UImm = Imm;
+
+  if (isInt<16>(Imm)) {
+    Seq[0] = {Nios2::ADDi, Imm};
+    return 1;
+  }
+  if (isUInt<16>(UImm)) {
+    Seq[0] = {Nios2::ORi, int32_t(UImm)};
+    return 1;
+  }
+
+  Seq[0] = {Nios2::ORhi, int32_t(UImm >> 16)};
+  if (!(UImm & 0xffff))
+    return 1;
+  Seq[1] = {Nios2::ORi, int32_t(UImm & 0xffff)};
+  return 2;
+}
+
 inline static std::pair<const MCSymbolRefExpr*, int64_t>
 Nios2GetSymAndOffset(const MCFixup &Fixup) {
   MCFixupKind FixupKind = Fixup.getKind();
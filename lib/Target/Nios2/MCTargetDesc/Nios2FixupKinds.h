@@ -128,6 +128,12 @@ namespace Nios2 {
     // resulting in - R_NIOS2_CALL_LO16
     fixup_Nios2_CALL_LO16,
 
+    // resulting in - R_NIOS2_GOTOFF_HA
+    fixup_Nios2_GOTOFF_HA,
+
+    // resulting in - R_NIOS2_GOTOFF_LO
+    fixup_Nios2_GOTOFF_LO,
+
     // Marker
     LastTargetFixupKind,
     NumTargetFixupKinds = LastTargetFixupKind - FirstTargetFixupKind
@@ -23,6 +23,7 @@
 #include "llvm/MC/MCInstrInfo.h"
 #include "llvm/MC/MCRegisterInfo.h"
 #include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/Support/EndianStream.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
@@ -97,18 +98,16 @@ class Nios2MCCodeEmitter : public MCCodeEmitter {
   void operator=(const Nios2MCCodeEmitter &) = delete;
   const MCInstrInfo &MCII;
   MCContext &Ctx;
-  bool IsLittleEndian;
 
 public:
   Nios2MCCodeEmitter(const MCInstrInfo &mcii, MCContext &Ctx_, bool IsLittle) 
-    : MCII(mcii), Ctx(Ctx_), IsLittleEndian(IsLittle) {}
+    : MCII(mcii), Ctx(Ctx_) {
+    assert(IsLittle && "Nios2 is little endian only");
+  }
 
   ~Nios2MCCodeEmitter() {}
 
-  void EmitByte(unsigned char C, raw_ostream &OS) const;
-
-  void EmitInstruction(uint64_t Val, unsigned Size, const MCSubtargetInfo &STI,
-                       raw_ostream &OS) const;
+  void EmitInstruction(uint32_t Val, raw_ostream &OS) const;
 
   void encodeInstruction(const MCInst &MI, raw_ostream &OS,
                          SmallVectorImpl<MCFixup> &Fixups,
@@ -159,70 +158,37 @@ MCCodeEmitter *llvm::createNios2MCCodeEmitter(const MCInstrInfo &MCII,
   return new Nios2MCCodeEmitter(MCII, Ctx, true);
 }
 
-void Nios2MCCodeEmitter::EmitByte(unsigned char C, raw_ostream &OS) const {
-  OS << (char)C;
-}
-
-void Nios2MCCodeEmitter::EmitInstruction(uint64_t Val, unsigned Size,
-                                         const MCSubtargetInfo &STI,
-                                         raw_ostream &OS) const {
-  // Output the instruction encoding in little endian byte order.
-  // Little-endian byte ordering:
-  //   nios2:   4 | 3 | 2 | 1
-  for (unsigned i = 0; i < Size; ++i) {
-    unsigned Shift = IsLittleEndian ? i * 8 : (Size - 1 - i) * 8;
-    EmitByte((Val >> Shift) & 0xff, OS);
-  }
+/// EmitInstruction - Write one 32-bit instruction word. Nios2 is always
+/// little endian and every R1 instruction is one word, so the whole
+/// instruction is a single 4-byte write. OS is the streamer's scratch buffer
+/// for this instruction; MCELFStreamer copies it into the fragment.
+void Nios2MCCodeEmitter::EmitInstruction(uint32_t Val, raw_ostream &OS) const {
+  support::endian::Writer<support::little>(OS).write<uint32_t>(Val);
 }
 
 /// EncodeInstruction - Emit the instruction.
-/// Size the instruction (currently only 4 bytes
+/// Size the instruction (currently only 4 bytes)
 void Nios2MCCodeEmitter::
 encodeInstruction(const MCInst &MI, raw_ostream &OS,
                   SmallVectorImpl<MCFixup> &Fixups,
                   const MCSubtargetInfo &STI) const {
+  unsigned NumFixups = Fixups.size();
+  uint32_t Binary = getBinaryCodeForInstr(MI, Fixups, STI);
 
-  // Non-pseudo instructions that get changed for direct object
-  // only based on operand values.
-  // If this list of instructions get much longer we will move
-  // the check to a function call. Until then, this is more efficient.
-  MCInst TmpInst = MI;
-  //switch (MI.getOpcode()) {
-  //// If shift amount is >= 32 it the inst needs to be lowered further
-  //case Nios2::DSLL:
-  //case Nios2::DSRL:
-  //case Nios2::DSRA:
-  //  LowerLargeShift(TmpInst);
-  //  break;
-  //  // Double extract instruction is chosen by pos and size operands
-  //case Nios2::DEXT:
-  //case Nios2::DINS:
-  //  LowerDextDins(TmpInst);
-  //}
-
-  uint32_t Binary = getBinaryCodeForInstr(TmpInst, Fixups, STI);
-
-  // Check for unimplemented opcodes.
-  // Unfortunately in NIOS2 both NOP and SLL will come in with Binary == 0
-  // so we have to special check for them.
-  unsigned Opcode = TmpInst.getOpcode();
-  if ((Opcode != Nios2::NOP) && !Binary)
+  // Check for unimplemented opcodes. "call" has opcode 0, so a zero encoding
+  // is only suspicious if the target is not left to a fixup.
+  unsigned Opcode = MI.getOpcode();
+  if ((Opcode != Nios2::NOP) && !Binary && Fixups.size() == NumFixups)
     llvm_unreachable("unimplemented opcode in EncodeInstruction()");
 
-  const MCInstrDesc &Desc = MCII.get(TmpInst.getOpcode());
-  uint64_t TSFlags = Desc.TSFlags;
-
   // Pseudo instructions don't get encoded and shouldn't be here
   // in the first place!
-  if ((TSFlags & Nios2II::FormMask) == Nios2II::Pseudo)
+  const MCInstrDesc &Desc = MCII.get(Opcode);
+  if ((Desc.TSFlags & Nios2II::FormMask) == Nios2II::Pseudo)
     llvm_unreachable("Pseudo opcode found in EncodeInstruction()");
+  assert(Desc.getSize() == 4 && "Nios2 R1 instructions are 4 bytes");
 
-  // Get byte count of instruction
-  unsigned Size = Desc.getSize();
-  if (!Size)
-    llvm_unreachable("Desc.getSize() returns 0");
-
-  EmitInstruction(Binary, Size, STI, OS);
+  EmitInstruction(Binary, OS);
 }
 
 /// getBranchTargetOpValue - Return binary encoding of the branch
@@ -304,6 +270,47 @@ getMachineOpValue(const MCInst &MI, const MCOperand &MO,
   switch(cast<MCSymbolRefExpr>(Expr)->getKind()) {
   default: llvm_unreachable("Unknown fixup kind!");
     break;
+  case MCSymbolRefExpr::VK_Nios2_HIADJ16:
+    FixupKind = Nios2::fixup_Nios2_HI16;
+    break;
+  case MCSymbolRefExpr::VK_Nios2_LO16:
+    FixupKind = Nios2::fixup_Nios2_LO16;
+    break;
+  case MCSymbolRefExpr::VK_Nios2_GPREL:
+    FixupKind = Nios2::fixup_Nios2_GPREL16;
+    break;
+  case MCSymbolRefExpr::VK_Nios2_GOT16:
+    FixupKind = Nios2::fixup_Nios2_GOT_Global;
+    break;
+  case MCSymbolRefExpr::VK_Nios2_CALL16:
+    FixupKind = Nios2::fixup_Nios2_CALL16;
+    break;
+  case MCSymbolRefExpr::VK_Nios2_GOTOFF_HA:
+    FixupKind = Nios2::fixup_Nios2_GOTOFF_HA;
+    break;
+  case MCSymbolRefExpr::VK_Nios2_GOTOFF_LO:
+    FixupKind = Nios2::fixup_Nios2_GOTOFF_LO;
+    break;
+  case MCSymbolRefExpr::VK_Nios2_GOT_HA:
+    FixupKind = Nios2::fixup_Nios2_GOT_HI16;
+    break;
+  case MCSymbolRefExpr::VK_Nios2_GOT_LO:
+    FixupKind = Nios2::fixup_Nios2_GOT_LO16;
+    break;
+  case MCSymbolRefExpr::VK_Nios2_CALL_HA:
+    FixupKind = Nios2::fixup_Nios2_CALL_HI16;
+    break;
+  case MCSymbolRefExpr::VK_Nios2_CALL_LO:
+    FixupKind = Nios2::fixup_Nios2_CALL_LO16;
+    break;
+  // "sym - label" expressions; the writer turns these into PC-relative
+  // relocations.
+  case MCSymbolRefExpr::VK_Nios2_PCREL_HA:
+    FixupKind = Nios2::fixup_Nios2_HI16;
+    break;
+  case MCSymbolRefExpr::VK_Nios2_PCREL_LO:
+    FixupKind = Nios2::fixup_Nios2_LO16;
+    break;
   case MCSymbolRefExpr::VK_Mips_GPOFF_HI :
     FixupKind = Nios2::fixup_Nios2_GPOFF_HI;
     break;
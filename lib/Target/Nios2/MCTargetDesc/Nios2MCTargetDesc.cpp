@@ -15,11 +15,14 @@
 #include "Nios2MCTargetDesc.h"
 #include "InstPrinter/Nios2InstPrinter.h"
 #include "llvm/MC/MachineLocation.h"
+#include "llvm/MC/MCAssembler.h"
 #include "llvm/MC/MCCodeGenInfo.h"
+#include "llvm/MC/MCELFStreamer.h"
 #include "llvm/MC/MCInstrInfo.h"
 #include "llvm/MC/MCRegisterInfo.h"
 #include "llvm/MC/MCStreamer.h"
 #include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/Support/ELF.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/TargetRegistry.h"
 
@@ -82,6 +85,25 @@ static MCInstPrinter *createNios2MCInstPrinter(const Triple &T,
   return new Nios2InstPrinter(MAI, MII, MRI);
 }
 
+namespace {
+/// Nios2TargetELFStreamer - Records the instruction set in the ELF header of
+/// Nios2 objects.
+class Nios2TargetELFStreamer : public MCTargetStreamer {
+public:
+  Nios2TargetELFStreamer(MCStreamer &S, const MCSubtargetInfo &STI)
+    : MCTargetStreamer(S) {
+    // Only the R1 encodings are implemented, so never claim R2.
+    MCAssembler &MCA = static_cast<MCELFStreamer &>(S).getAssembler();
+    MCA.setELFHeaderEFlags(ELF::EF_NIOS2_ARCH_R1);
+  }
+};
+} // end of anonymous namespace
+
+static MCTargetStreamer *
+createNios2ObjectTargetStreamer(MCStreamer &S, const MCSubtargetInfo &STI) {
+  return new Nios2TargetELFStreamer(S, STI);
+}
+
 extern "C" void LLVMInitializeNios2TargetMC() {
   // Register the MC asm info.
   RegisterMCAsmInfoFn X(TheNios2StdTarget, createNios2MCAsmInfo);
@@ -111,5 +133,9 @@ extern "C" void LLVMInitializeNios2TargetMC() {
   // Register the MCInstPrinter.
   TargetRegistry::RegisterMCInstPrinter(TheNios2StdTarget,
                                         createNios2MCInstPrinter);
+
+  // Register the object target streamer.
+  TargetRegistry::RegisterObjectTargetStreamer(TheNios2StdTarget,
+                                               createNios2ObjectTargetStreamer);
 }
 
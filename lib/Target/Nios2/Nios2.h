@@ -23,6 +23,8 @@ namespace llvm {
   class FunctionPass;
 
   FunctionPass *createNios2ISelDag(Nios2TargetMachine &TM);
+  FunctionPass *createNios2HiBaseReuse(Nios2TargetMachine &TM);
+  FunctionPass *createNios2MachineOutliner(Nios2TargetMachine &TM);
 } // end namespace llvm;
 
 #endif
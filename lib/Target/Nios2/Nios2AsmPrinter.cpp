@@ -19,6 +19,7 @@
 #include "Nios2MCInstLower.h"
 #include "InstPrinter/Nios2InstPrinter.h"
 #include "MCTargetDesc/Nios2BaseInfo.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/Twine.h"
@@ -28,14 +29,19 @@
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstr.h"
 #include "llvm/CodeGen/MachineMemOperand.h"
+#include "llvm/CodeGen/TargetSchedule.h"
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Mangler.h"
 #include "llvm/MC/MachineLocation.h"
 #include "llvm/MC/MCAsmInfo.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCExpr.h"
 #include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCInstBuilder.h"
 #include "llvm/MC/MCStreamer.h"
 #include "llvm/MC/MCSymbol.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Target/TargetLoweringObjectFile.h"
@@ -43,6 +49,13 @@
 
 using namespace llvm;
 
+static cl::opt<bool> PrintCycles(
+  "nios2-print-cycles",
+  cl::init(false),
+  cl::desc("NIOS2: Print a static cycle estimate at the end of each function "
+           "in the assembly output."),
+  cl::Hidden);
+
 bool Nios2AsmPrinter::runOnMachineFunction(MachineFunction &MF) {
   Subtarget = &MF.getSubtarget<Nios2Subtarget>();
   Nios2FI = MF.getInfo<Nios2FunctionInfo>();
@@ -63,12 +76,49 @@ void Nios2AsmPrinter::EmitInstruction(const MachineInstr *MI) {
   MachineBasicBlock::const_instr_iterator E = MI->getParent()->instr_end();
 
   do {
+    if (I->getOpcode() == Nios2::LOAD_GOT_PTR) {
+      EmitLoadGOTPtr(&*I);
+      continue;
+    }
+
     MCInst TmpInst0;
     MCInstLowering.Lower(&*I, TmpInst0);
     EmitToStreamer(*OutStreamer, TmpInst0);
   } while ((++I != E) && I->isInsideBundle()); // Delay slot check
 }
 
+/// Expand LOAD_GOT_PTR. The GOT pointer is computed PC-relatively from
+/// _gp_got, which the linker defines 0x8000 bytes into the GOT.
+void Nios2AsmPrinter::EmitLoadGOTPtr(const MachineInstr *MI) {
+  unsigned DstReg = MI->getOperand(0).getReg();
+  MCSymbol *PCSym = OutContext.createTempSymbol();
+  MCSymbol *GOTSym = OutContext.getOrCreateSymbol("_gp_got");
+  // The modifier sits on the first symbol of the difference.
+  const MCExpr *Hi = MCBinaryExpr::createSub(
+      MCSymbolRefExpr::create(GOTSym, MCSymbolRefExpr::VK_Nios2_PCREL_HA,
+                              OutContext),
+      MCSymbolRefExpr::create(PCSym, OutContext), OutContext);
+  const MCExpr *Lo = MCBinaryExpr::createSub(
+      MCSymbolRefExpr::create(GOTSym, MCSymbolRefExpr::VK_Nios2_PCREL_LO,
+                              OutContext),
+      MCSymbolRefExpr::create(PCSym, OutContext), OutContext);
+
+  EmitToStreamer(*OutStreamer, MCInstBuilder(Nios2::NEXTPC).addReg(DstReg));
+  OutStreamer->EmitLabel(PCSym);
+  EmitToStreamer(*OutStreamer, MCInstBuilder(Nios2::ORhi)
+                                   .addReg(Nios2::AT)
+                                   .addReg(Nios2::ZERO)
+                                   .addExpr(Hi));
+  EmitToStreamer(*OutStreamer, MCInstBuilder(Nios2::ADDi)
+                                   .addReg(Nios2::AT)
+                                   .addReg(Nios2::AT)
+                                   .addExpr(Lo));
+  EmitToStreamer(*OutStreamer, MCInstBuilder(Nios2::ADD)
+                                   .addReg(DstReg)
+                                   .addReg(DstReg)
+                                   .addReg(Nios2::AT));
+}
+
 //===----------------------------------------------------------------------===//
 //
 //  Nios2 Asm Directives
@@ -119,6 +169,48 @@ void Nios2AsmPrinter::EmitFunctionBodyStart() {
   //}
 }
 
+/// Estimate the cycles of one pass through every block of MF on an in-order,
+/// single issue pipeline: each instruction issues once its operands are
+/// ready, and its results are ready after the itinerary latency.
+static unsigned estimateCycles(const MachineFunction &MF) {
+  const TargetSubtargetInfo &STI = MF.getSubtarget();
+  TargetSchedModel SchedModel;
+  SchedModel.init(STI.getSchedModel(), &STI, STI.getInstrInfo());
+
+  unsigned Total = 0;
+  for (const MachineBasicBlock &MBB : MF) {
+    DenseMap<unsigned, unsigned> Ready;
+    unsigned Cycle = 0;
+    for (const MachineInstr &MI : MBB) {
+      if (MI.isDebugValue() || MI.isCFIInstruction() || MI.isLabel() ||
+          MI.isKill() || MI.isImplicitDef())
+        continue;
+
+      unsigned Issue = Cycle;
+      for (const MachineOperand &MO : MI.operands())
+        if (MO.isReg() && MO.isUse() && MO.getReg())
+          Issue = std::max(Issue, Ready.lookup(MO.getReg()));
+
+      // Pseudos expanded by the printer issue one cycle per instruction.
+      unsigned Latency = std::max(1U, SchedModel.computeInstrLatency(&MI));
+      Cycle = Issue + std::max(1U, MI.getDesc().getSize() / 4);
+      for (const MachineOperand &MO : MI.operands())
+        if (MO.isReg() && MO.isDef() && MO.getReg())
+          Ready[MO.getReg()] = Issue + Latency;
+    }
+    Total += Cycle;
+  }
+  return Total;
+}
+
+/// EmitFunctionBodyEnd - Print the cycle estimate used by the codegen
+/// regression harness, if requested.
+void Nios2AsmPrinter::EmitFunctionBodyEnd() {
+  if (PrintCycles)
+    OutStreamer->emitRawComment(" static cycles: " +
+                                Twine(estimateCycles(*MF)));
+}
+
 //===----------------------------------------------------------------------===//
 // Mask directives
 //===----------------------------------------------------------------------===//
@@ -187,6 +279,11 @@ void Nios2AsmPrinter::emitFrameDirective() {
 /// the predecessor and this block is a fall-through.
 bool Nios2AsmPrinter::isBlockOnlyReachableByFallthrough(const MachineBasicBlock*
                                                        MBB) const {
+  // If this is a landing pad, it isn't a fall through.  If it has no preds,
+  // then nothing falls through to it.
+  if (MBB->isEHPad() || MBB->pred_empty())
+    return false;
+
   // The predecessor has to be immediately before this block.
   const MachineBasicBlock *Pred = *MBB->pred_begin();
 
@@ -196,11 +293,6 @@ bool Nios2AsmPrinter::isBlockOnlyReachableByFallthrough(const MachineBasicBlock*
     if (isa<SwitchInst>(bb->getTerminator()))
       return false;
 
-  // If this is a landing pad, it isn't a fall through.  If it has no preds,
-  // then nothing falls through to it.
-  if (MBB->isEHPad() || MBB->pred_empty())
-    return false;
-
   // If there isn't exactly one predecessor, it can't be a fall through.
   MachineBasicBlock::const_pred_iterator PI = MBB->pred_begin(), PI2 = PI;
   ++PI2;
@@ -31,6 +31,7 @@ class raw_ostream;
 class LLVM_LIBRARY_VISIBILITY Nios2AsmPrinter : public AsmPrinter {
 
   void EmitInstrWithMacroNoAT(const MachineInstr *MI);
+  void EmitLoadGOTPtr(const MachineInstr *MI);
 
 public:
 
@@ -51,6 +52,7 @@ public:
 
   void EmitInstruction(const MachineInstr *MI);
   virtual void EmitFunctionBodyStart();
+  void EmitFunctionBodyEnd() override;
   void printSavedRegsBitmask(raw_ostream &O);
   void printHex32(unsigned int Value, raw_ostream &O);
   void emitFrameDirective();
@@ -14,6 +14,7 @@
 #include "Nios2FrameLowering.h"
 #include "Nios2InstrInfo.h"
 #include "Nios2MachineFunction.h"
+#include "Nios2RegisterInfo.h"
 #include "Nios2TargetMachine.h"
 #include "Nios2TargetObjectFile.h"
 #include "MCTargetDesc/Nios2BaseInfo.h"
@@ -23,8 +24,10 @@
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/RegisterScavenging.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
 
 using namespace llvm;
 
@@ -120,16 +123,37 @@ void Nios2FrameLowering::emitPrologue(MachineFunction &MF, MachineBasicBlock &MB
     unsigned CFIIndex = MMI.addFrameInst(MCCFIInstruction::createDefCfaRegister(nullptr, MRI->getDwarfRegNum(FP, true)));
     BuildMI(MBB, MBBI, dl, TII.get(TargetOpcode::CFI_INSTRUCTION))
       .addCFIIndex(CFIIndex);
+
+    // Realign the stack for over-aligned locals. $fp keeps the unaligned
+    // value for the incoming arguments, the callee-saved registers and the
+    // epilogue. Clearing the low bits with two shifts needs no scratch
+    // register.
+    if (RegInfo.needsStackRealignment(MF)) {
+      unsigned Shift = Log2_32(MFI->getMaxAlignment());
+
+      BuildMI(MBB, MBBI, dl, TII.get(Nios2::SRLi), SP).addReg(SP)
+        .addImm(Shift).setMIFlag(MachineInstr::FrameSetup);
+      BuildMI(MBB, MBBI, dl, TII.get(Nios2::SLLi), SP).addReg(SP)
+        .addImm(Shift).setMIFlag(MachineInstr::FrameSetup);
+
+      // "move $bp, $sp" keeps the aligned locals addressable once variable
+      // sized objects move $sp.
+      if (hasBP(MF))
+        BuildMI(MBB, MBBI, dl, TII.get(ADDu), RegInfo.getBaseRegister())
+          .addReg(SP).addReg(ZERO).setMIFlag(MachineInstr::FrameSetup);
+    }
   }
 }
 
 void Nios2FrameLowering::emitEpilogue(MachineFunction &MF,
                                       MachineBasicBlock &MBB) const {
-  MachineBasicBlock::iterator MBBI = MBB.getLastNonDebugInstr();
+  // With shrink-wrapping the restore point need not end in a return, so
+  // insert before the terminators like PEI does for the CSR reloads.
+  MachineBasicBlock::iterator MBBI = MBB.getFirstTerminator();
   MachineFrameInfo *MFI            = MF.getFrameInfo();
   const Nios2InstrInfo &TII =
     *static_cast<const Nios2InstrInfo*>(MF.getSubtarget().getInstrInfo());
-  DebugLoc dl = MBBI->getDebugLoc();
+  DebugLoc dl = MBBI != MBB.end() ? MBBI->getDebugLoc() : DebugLoc();
   unsigned SP = Nios2::SP;
   unsigned FP = Nios2::FP;
   unsigned ZERO = Nios2::ZERO;
@@ -229,11 +253,69 @@ eliminateCallFramePseudoInstr(MachineFunction &MF, MachineBasicBlock &MBB,
   MBB.erase(I);
 }
 
+// determineCalleeSaves - $ra is saved whenever the function makes a call,
+// since "call" overwrites it. $fp and the base pointer are only written by the
+// prologue, so they have to be marked explicitly when they are used.
+void Nios2FrameLowering::determineCalleeSaves(MachineFunction &MF,
+                                              BitVector &SavedRegs,
+                                              RegScavenger *RS) const {
+  TargetFrameLowering::determineCalleeSaves(MF, SavedRegs, RS);
+
+  if (MF.getFrameInfo()->hasCalls())
+    SavedRegs.set(Nios2::RA);
+
+  if (hasFP(MF))
+    SavedRegs.set(Nios2::FP);
+
+  if (hasBP(MF))
+    SavedRegs.set(Nios2RegisterInfo::getBaseRegister());
+
+  // Frame offsets that do not fit the 16-bit immediate are materialized in a
+  // scavenged register, which may need an emergency spill slot. Place it
+  // close to $sp, where it is always reachable.
+  MachineFrameInfo *MFI = MF.getFrameInfo();
+  uint64_t MaxOffset = MFI->estimateStackSize(MF) + MFI->getMaxAlignment();
+
+  if (RS && !isInt<16>(MaxOffset)) {
+    const TargetRegisterClass *RC = &Nios2::CPURegsRegClass;
+    int FI = MFI->CreateStackObject(RC->getSize(), RC->getAlignment(), false);
+    RS->addScavengingFrameIndex(FI);
+  }
+}
+
+// enableShrinkWrapping - The prologue and epilogue only depend on the block
+// they are inserted into, so the save and restore points can be moved off the
+// entry and return blocks. Early-exit paths then run without a frame.
+bool Nios2FrameLowering::enableShrinkWrapping(const MachineFunction &MF) const {
+  // The epilogue CFI does not use .cfi_remember_state/.cfi_restore_state, so
+  // it only describes the frame correctly when the restore point is the last
+  // framed block. The AsmPrinter emits CFI for functions with debug info or an
+  // unwind table entry only; keep the frame in the entry block for those.
+  return !MF.getMMI().hasDebugInfo() &&
+         !MF.getFunction()->needsUnwindTableEntry();
+}
+
 // hasFP - Return true if the specified function should have a dedicated frame
 // pointer register.  This is true if the function has variable sized allocas or
 // if frame pointer elimination is disabled.
 bool Nios2FrameLowering::hasFP(const MachineFunction &MF) const {
   const MachineFrameInfo *MFI = MF.getFrameInfo();
+  const TargetRegisterInfo *TRI = STI.getRegisterInfo();
   return MF.getTarget().Options.DisableFramePointerElim(MF) ||
-      MFI->hasVarSizedObjects() || MFI->isFrameAddressTaken();
+      MFI->hasVarSizedObjects() || MFI->isFrameAddressTaken() ||
+      TRI->needsStackRealignment(MF);
+}
+
+bool Nios2FrameLowering::hasBP(const MachineFunction &MF) const {
+  const MachineFrameInfo *MFI = MF.getFrameInfo();
+  const TargetRegisterInfo *TRI = STI.getRegisterInfo();
+  return MFI->hasVarSizedObjects() && TRI->needsStackRealignment(MF);
+}
+
+// hasReservedCallFrame - Reserve the outgoing argument area in the fixed frame
+// unless variable sized objects move $sp. Locals addressed relative to $sp
+// then stay valid inside call sequences.
+bool Nios2FrameLowering::hasReservedCallFrame(const MachineFunction &MF) const {
+  const MachineFrameInfo *MFI = MF.getFrameInfo();
+  return isInt<16>(MFI->getMaxCallFrameSize()) && !MFI->hasVarSizedObjects();
 }
@@ -32,6 +32,14 @@ public:
 
   bool hasFP(const MachineFunction &MF) const override;
 
+  /// hasBP - Return true if locals have to be addressed through the base
+  /// pointer, because the stack is realigned and $sp moves dynamically.
+  bool hasBP(const MachineFunction &MF) const;
+
+  bool hasReservedCallFrame(const MachineFunction &MF) const override;
+
+  bool isFPCloseToIncomingSP() const override { return false; }
+
   void eliminateCallFramePseudoInstr(MachineFunction &MF,
                                      MachineBasicBlock &MBB,
                                      MachineBasicBlock::iterator I) const override;
@@ -40,6 +48,11 @@ public:
   /// the function.
   void emitPrologue(MachineFunction &MF, MachineBasicBlock &MBB) const override;
   void emitEpilogue(MachineFunction &MF, MachineBasicBlock &MBB) const override;
+
+  void determineCalleeSaves(MachineFunction &MF, BitVector &SavedRegs,
+                            RegScavenger *RS) const override;
+
+  bool enableShrinkWrapping(const MachineFunction &MF) const override;
 };
 
 } // End llvm namespace
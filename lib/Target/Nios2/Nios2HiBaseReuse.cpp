@@ -0,0 +1,258 @@
+//===-- Nios2HiBaseReuse.cpp - Share %hiadj bases between accesses --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Every global access is selected as
+//
+//   orhi  $1, $zero, %hiadj(sym+off)
+//   ldw   $2, %lo(sym+off)($1)
+//
+// and the "orhi" is only shared by accesses to the same symbol and offset
+// that the DAG or MachineCSE happen to see together. After GlobalMerge has
+// packed the module's globals into one symbol, most accesses in a function
+// differ only in their offset. This pass materializes the address of such a
+// symbol once, in a block that dominates all of its accesses:
+//
+//   orhi  $1, $zero, %hiadj(sym+min)
+//   addi  $1, $1, %lo(sym+min)
+//   ldw   $2, off-min($1)
+//
+// It runs on SSA form before register allocation.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Nios2.h"
+#include "Nios2InstrInfo.h"
+#include "MCTargetDesc/Nios2BaseInfo.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "nios2-hi-base-reuse"
+
+STATISTIC(NumHiRemoved, "Number of orhi instructions removed");
+STATISTIC(NumLoFolded,  "Number of %lo operands folded into an offset");
+
+static cl::opt<bool> DisableHiBaseReuse(
+  "disable-nios2-hi-base-reuse",
+  cl::init(false),
+  cl::desc("NIOS2: Don't share %hiadj bases between global accesses."),
+  cl::Hidden);
+
+namespace {
+  class Nios2HiBaseReuse : public MachineFunctionPass {
+  public:
+    static char ID;
+    Nios2HiBaseReuse() : MachineFunctionPass(ID) {}
+
+    const char *getPassName() const override {
+      return "Nios2 %hi Base Reuse";
+    }
+
+    void getAnalysisUsage(AnalysisUsage &AU) const override {
+      AU.setPreservesCFG();
+      AU.addRequired<MachineDominatorTree>();
+      AU.addPreserved<MachineDominatorTree>();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
+    bool runOnMachineFunction(MachineFunction &F) override;
+
+  private:
+    typedef SmallVector<MachineInstr *, 8> InstrList;
+
+    bool isHiOfGlobal(const MachineInstr &MI) const;
+    bool collectUses(const InstrList &His, InstrList &Uses,
+                     int64_t &MinOffset, int64_t &MaxOffset) const;
+    MachineBasicBlock::iterator getInsertPoint(const InstrList &His,
+                                               MachineBasicBlock *&MBB) const;
+    bool shareBase(const GlobalValue *GV, const InstrList &His);
+
+    const Nios2InstrInfo *TII;
+    MachineRegisterInfo *MRI;
+    MachineDominatorTree *MDT;
+  };
+  char Nios2HiBaseReuse::ID = 0;
+} // end of anonymous namespace
+
+/// Return true if MI is "orhi $r, $zero, %hiadj(global)".
+bool Nios2HiBaseReuse::isHiOfGlobal(const MachineInstr &MI) const {
+  if (MI.getOpcode() != Nios2::ORhi || MI.getOperand(1).getReg() != Nios2::ZERO)
+    return false;
+
+  const MachineOperand &MO = MI.getOperand(2);
+  return MO.isGlobal() && MO.getTargetFlags() == Nios2II::MO_HIADJ16 &&
+         TargetRegisterInfo::isVirtualRegister(MI.getOperand(0).getReg());
+}
+
+/// Return the operand index of the %lo operand if Reg is used as the base
+/// of a %lo addressed access or "addi" in MI, or -1 otherwise.
+static int getLoOperandIdx(const MachineInstr &MI, unsigned Reg) {
+  switch (MI.getOpcode()) {
+  default:
+    return -1;
+  case Nios2::LDB: case Nios2::LDBu: case Nios2::LDH: case Nios2::LDHu:
+  case Nios2::LDW: case Nios2::STB:  case Nios2::STH: case Nios2::STW:
+  case Nios2::ADDi:
+    break;
+  }
+
+  // Stores also read Reg as their value operand, which cannot be rewritten.
+  if (MI.getOperand(0).getReg() == Reg || MI.getOperand(1).getReg() != Reg)
+    return -1;
+
+  const MachineOperand &Lo = MI.getOperand(2);
+  if (!Lo.isGlobal() || Lo.getTargetFlags() != Nios2II::MO_LO16)
+    return -1;
+
+  return 2;
+}
+
+/// Collect the users of all orhi's in His. Every user has to add %lo of the
+/// same symbol, so that the absolute offsets are known.
+bool Nios2HiBaseReuse::collectUses(const InstrList &His, InstrList &Uses,
+                                   int64_t &MinOffset,
+                                   int64_t &MaxOffset) const {
+  MinOffset = INT64_MAX;
+  MaxOffset = INT64_MIN;
+
+  for (MachineInstr *Hi : His) {
+    unsigned Reg = Hi->getOperand(0).getReg();
+    const GlobalValue *GV = Hi->getOperand(2).getGlobal();
+
+    for (MachineInstr &UseMI : MRI->use_nodbg_instructions(Reg)) {
+      int Idx = getLoOperandIdx(UseMI, Reg);
+      if (Idx < 0)
+        return false;
+
+      const MachineOperand &Lo = UseMI.getOperand(Idx);
+      if (Lo.getGlobal() != GV)
+        return false;
+
+      MinOffset = std::min(MinOffset, Lo.getOffset());
+      MaxOffset = std::max(MaxOffset, Lo.getOffset());
+      Uses.push_back(&UseMI);
+    }
+  }
+
+  return !Uses.empty();
+}
+
+/// Find a point that dominates every instruction in His.
+MachineBasicBlock::iterator
+Nios2HiBaseReuse::getInsertPoint(const InstrList &His,
+                                 MachineBasicBlock *&MBB) const {
+  MBB = His.front()->getParent();
+  for (MachineInstr *Hi : His)
+    MBB = MDT->findNearestCommonDominator(MBB, Hi->getParent());
+
+  // Insert before the first orhi of the dominating block, if it has one,
+  // and before its terminators otherwise.
+  MachineBasicBlock::iterator I = MBB->getFirstTerminator();
+  for (MachineInstr *Hi : His)
+    if (Hi->getParent() == MBB)
+      for (MachineBasicBlock::iterator J = MBB->begin(); J != I; ++J)
+        if (&*J == Hi) {
+          I = J;
+          break;
+        }
+
+  return I;
+}
+
+bool Nios2HiBaseReuse::shareBase(const GlobalValue *GV, const InstrList &His) {
+  // The new base costs an "orhi" and an "addi", so there must be at least
+  // three orhi's to replace.
+  if (His.size() < 3)
+    return false;
+
+  InstrList Uses;
+  int64_t MinOffset, MaxOffset;
+  if (!collectUses(His, Uses, MinOffset, MaxOffset) ||
+      !isInt<16>(MaxOffset - MinOffset))
+    return false;
+
+  DEBUG(dbgs() << "Sharing %hiadj base of " << GV->getName() << " across "
+               << His.size() << " orhi's\n");
+
+  MachineBasicBlock *MBB;
+  MachineBasicBlock::iterator I = getInsertPoint(His, MBB);
+  DebugLoc DL = I != MBB->end() ? I->getDebugLoc() : DebugLoc();
+  const TargetRegisterClass *RC = &Nios2::CPURegsRegClass;
+  unsigned HiReg = MRI->createVirtualRegister(RC);
+  unsigned BaseReg = MRI->createVirtualRegister(RC);
+
+  BuildMI(*MBB, I, DL, TII->get(Nios2::ORhi), HiReg).addReg(Nios2::ZERO)
+    .addGlobalAddress(GV, MinOffset, Nios2II::MO_HIADJ16);
+  BuildMI(*MBB, I, DL, TII->get(Nios2::ADDi), BaseReg).addReg(HiReg)
+    .addGlobalAddress(GV, MinOffset, Nios2II::MO_LO16);
+
+  for (MachineInstr *UseMI : Uses) {
+    MachineOperand &Lo = UseMI->getOperand(2);
+    int64_t Offset = Lo.getOffset() - MinOffset;
+
+    // An "addi" of %lo(sym+min) computes the new base itself.
+    if (UseMI->getOpcode() == Nios2::ADDi && Offset == 0) {
+      MRI->replaceRegWith(UseMI->getOperand(0).getReg(), BaseReg);
+      UseMI->eraseFromParent();
+      ++NumLoFolded;
+      continue;
+    }
+
+    UseMI->getOperand(1).setReg(BaseReg);
+    UseMI->getOperand(1).setIsKill(false);
+    Lo.ChangeToImmediate(Offset);
+    Lo.setTargetFlags(0);
+    ++NumLoFolded;
+  }
+
+  for (MachineInstr *Hi : His)
+    Hi->eraseFromParent();
+
+  // The uses of the erased "addi"s may have killed their result.
+  MRI->clearKillFlags(BaseReg);
+
+  NumHiRemoved += His.size() - 1;
+  return true;
+}
+
+bool Nios2HiBaseReuse::runOnMachineFunction(MachineFunction &F) {
+  if (DisableHiBaseReuse)
+    return false;
+
+  TII = static_cast<const Nios2InstrInfo *>(F.getSubtarget().getInstrInfo());
+  MRI = &F.getRegInfo();
+  MDT = &getAnalysis<MachineDominatorTree>();
+
+  // Group the orhi's by symbol, in program order so the output is stable.
+  MapVector<const GlobalValue *, InstrList> HiDefs;
+  for (MachineBasicBlock &MBB : F)
+    for (MachineInstr &MI : MBB)
+      if (isHiOfGlobal(MI))
+        HiDefs[MI.getOperand(2).getGlobal()].push_back(&MI);
+
+  bool Changed = false;
+  for (auto &KV : HiDefs)
+    Changed |= shareBase(KV.first, KV.second);
+
+  return Changed;
+}
+
+/// createNios2HiBaseReuse - Returns a pass that shares one %hiadj base
+/// between the accesses to a global symbol in a function.
+FunctionPass *llvm::createNios2HiBaseReuse(Nios2TargetMachine &TM) {
+  return new Nios2HiBaseReuse();
+}
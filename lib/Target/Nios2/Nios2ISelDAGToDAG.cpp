@@ -94,9 +94,7 @@ private:
 };
 
 // Insert instructions to initialize the global base register in the
-// first MBB of the function. When the ABI is O32 and the relocation model is
-// PIC, the necessary instructions are emitted later to prevent optimization
-// passes from moving them.
+// first MBB of the function.
 void Nios2DAGToDAGISel::InitGlobalBaseReg(MachineFunction &MF) {
   Nios2FunctionInfo *Nios2FI = MF.getInfo<Nios2FunctionInfo>();
 
@@ -108,48 +106,44 @@ void Nios2DAGToDAGISel::InitGlobalBaseReg(MachineFunction &MF) {
   MachineRegisterInfo &RegInfo = MF.getRegInfo();
   const TargetInstrInfo &TII = *MF.getSubtarget().getInstrInfo();
   DebugLoc DL = I != MBB.end() ? I->getDebugLoc() : DebugLoc();
-  unsigned V0, GlobalBaseReg = Nios2FI->getGlobalBaseReg();
-  const TargetRegisterClass *RC;
-
-  RC = (const TargetRegisterClass*)&Nios2::CPURegsRegClass;
-
-  V0 = RegInfo.createVirtualRegister(RC);
+  unsigned GlobalBaseReg = Nios2FI->getGlobalBaseReg();
 
   if (MF.getTarget().getRelocationModel() == Reloc::Static) {
+    unsigned V0 = RegInfo.createVirtualRegister(&Nios2::CPURegsRegClass);
+
     // Set global register to __gnu_local_gp.
     //
     // lui   $v0, %hi(__gnu_local_gp)
     // addiu $globalbasereg, $v0, %lo(__gnu_local_gp)
-    BuildMI(MBB, I, DL, TII.get(Nios2::ORhi), V0)
+    BuildMI(MBB, I, DL, TII.get(Nios2::ORhi), V0).addReg(Nios2::ZERO)
       .addExternalSymbol("__gnu_local_gp", Nios2II::MO_HIADJ16);
     BuildMI(MBB, I, DL, TII.get(Nios2::ADDi), GlobalBaseReg).addReg(V0)
       .addExternalSymbol("__gnu_local_gp", Nios2II::MO_LO16);
     return;
   }
 
-  MF.getRegInfo().addLiveIn(Nios2::GP);
-  MBB.addLiveIn(Nios2::GP);
-  // For O32 ABI, the following instruction sequence is emitted to initialize
-  // the global base register:
+  // In PIC code the GOT pointer is computed PC-relatively:
   //
-  //  0. lui   $2, %hi(_gp_disp)
-  //  1. addiu $2, $2, %lo(_gp_disp)
-  //  2. addu  $globalbasereg, $2, $t9
+  //   nextpc $globalbasereg
+  // 1:
+  //   orhi   $at, $zero, %hiadj(_gp_got - 1b)
+  //   addi   $at, $at, %lo(_gp_got - 1b)
+  //   add    $globalbasereg, $globalbasereg, $at
   //
-  // We emit only the last instruction here.
-  //
-  // GNU linker requires that the first two instructions appear at the beginning
-  // of a function and no instructions be inserted before or between them.
-  // The two instructions are emitted during lowering to MC layer in order to
-  // avoid any reordering.
-  //
-  // Register $2 (Nios2::V0) is added to the list of live-in registers to ensure
-  // the value instruction 1 (addiu) defines is valid when instruction 2 (addu)
-  // reads it.
-  MF.getRegInfo().addLiveIn(Nios2::R2);
-  MBB.addLiveIn(Nios2::R2);
-  BuildMI(MBB, I, DL, TII.get(Nios2::ADD), GlobalBaseReg)
-    .addReg(Nios2::R2).addReg(Nios2::GP);
+  // The sequence is kept in one pseudo until the AsmPrinter so that nothing
+  // is scheduled between "nextpc" and the label.
+  BuildMI(MBB, I, DL, TII.get(Nios2::LOAD_GOT_PTR), GlobalBaseReg);
+
+  // Callees that are not called through the PLT have their GOT entry loaded
+  // here once. The entries are constant after relocation, so the loads can
+  // be rematerialized instead of spilled.
+  for (const auto &KV : Nios2FI->getGOTCallees()) {
+    MachineMemOperand *MMO = MF.getMachineMemOperand(
+        MachinePointerInfo::getGOT(MF),
+        MachineMemOperand::MOLoad | MachineMemOperand::MOInvariant, 4, 4);
+    BuildMI(MBB, I, DL, TII.get(Nios2::LDW), KV.second).addReg(GlobalBaseReg)
+      .addGlobalAddress(KV.first, 0, Nios2II::MO_GOT16).addMemOperand(MMO);
+  }
 }
 
 bool Nios2DAGToDAGISel::replaceUsesWithZeroReg(MachineRegisterInfo *MRI,
@@ -270,7 +264,7 @@ SelectAddr(SDNode *Parent, SDValue Addr, SDValue &Base, SDValue &Offset) {
         Addr.getOperand(1).getOpcode() == Nios2ISD::GPRel) {
       SDValue Opnd0 = Addr.getOperand(1).getOperand(0);
       if (isa<ConstantPoolSDNode>(Opnd0) || isa<GlobalAddressSDNode>(Opnd0) ||
-          isa<JumpTableSDNode>(Opnd0)) {
+          isa<JumpTableSDNode>(Opnd0) || isa<ExternalSymbolSDNode>(Opnd0)) {
         Base = Addr.getOperand(0);
         Offset = Opnd0;
         return true;
@@ -360,7 +354,7 @@ SelectInlineAsmMemoryOperand(const SDValue &Op, unsigned ConstraintCode,
 
 /// createNios2ISelDag - This pass converts a legalized DAG into a
 /// NIOS2-specific DAG, ready for instruction scheduling.
-FunctionPass *llvm::createNios2ISelDag(Nios2TargetMachine &TM) {
+FunctionPass *createNios2ISelDag(Nios2TargetMachine &TM) {
   return new Nios2DAGToDAGISel(TM);
 }
 
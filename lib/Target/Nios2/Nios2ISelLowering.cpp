@@ -19,6 +19,7 @@
 #include "InstPrinter/Nios2InstPrinter.h"
 #include "MCTargetDesc/Nios2BaseInfo.h"
 #include "llvm/ADT/StringSwitch.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalVariable.h"
@@ -28,10 +29,12 @@
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineJumpTableInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/SelectionDAGISel.h"
 #include "llvm/CodeGen/TargetLoweringObjectFileImpl.h"
 #include "llvm/CodeGen/ValueTypes.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
@@ -40,6 +43,45 @@ using namespace llvm;
 
 #define DEBUG_TYPE "nios2-lower"
 
+static cl::opt<bool> NoPLT(
+  "nios2-no-plt",
+  cl::init(false),
+  cl::desc("NIOS2: Load the addresses of preemptible callees from the GOT "
+           "once per function instead of calling them through the PLT."),
+  cl::Hidden);
+
+static cl::opt<bool> LargeGOT(
+  "nios2-xgot",
+  cl::init(false),
+  cl::desc("NIOS2: Use 32-bit GOT offsets (%got_hiadj/%got_lo)."),
+  cl::Hidden);
+
+static cl::opt<bool> DisableBitManip(
+  "disable-nios2-bitmanip-lowering",
+  cl::init(false),
+  cl::desc("NIOS2: Expand rotates, bswap, ctz, clz and ctpop generically."),
+  cl::Hidden);
+
+// Custom instruction slots (the N field of "custom") implementing a bit
+// manipulation operation on rA. A negative slot means there is none.
+static cl::opt<int> CustomBSwap(
+  "nios2-custom-bswap", cl::init(-1),
+  cl::desc("NIOS2: Custom instruction slot computing bswap."), cl::Hidden);
+
+static cl::opt<int> CustomCTZ(
+  "nios2-custom-ctz", cl::init(-1),
+  cl::desc("NIOS2: Custom instruction slot computing cttz, 32 for zero."),
+  cl::Hidden);
+
+static cl::opt<int> CustomCLZ(
+  "nios2-custom-clz", cl::init(-1),
+  cl::desc("NIOS2: Custom instruction slot computing ctlz, 32 for zero."),
+  cl::Hidden);
+
+static cl::opt<int> CustomPopCount(
+  "nios2-custom-popcount", cl::init(-1),
+  cl::desc("NIOS2: Custom instruction slot computing ctpop."), cl::Hidden);
+
 // If I is a shifted mask, set the size (Size) and the first bit of the
 // mask (Pos), and return true.
 // For example, if I is 0x003ff800, (Pos, Size) = (11, 11).
@@ -57,6 +99,79 @@ static SDValue GetGlobalReg(SelectionDAG &DAG, EVT Ty) {
   return DAG.getRegister(FI->getGlobalBaseReg(), Ty);
 }
 
+/// Return true if GV cannot be preempted, so PIC code may address it
+/// relative to the GOT pointer or call it directly.
+static bool isLocalToDSO(const GlobalValue *GV) {
+  if (GV->hasLocalLinkage())
+    return true;
+  return !GV->hasDefaultVisibility() && !GV->hasExternalWeakLinkage();
+}
+
+static SDValue getTargetNode(GlobalAddressSDNode *N, EVT Ty, SelectionDAG &DAG,
+                             unsigned Flag) {
+  return DAG.getTargetGlobalAddress(N->getGlobal(), SDLoc(N), Ty,
+                                    N->getOffset(), Flag);
+}
+
+static SDValue getTargetNode(ExternalSymbolSDNode *N, EVT Ty,
+                             SelectionDAG &DAG, unsigned Flag) {
+  return DAG.getTargetExternalSymbol(N->getSymbol(), Ty, Flag);
+}
+
+static SDValue getTargetNode(JumpTableSDNode *N, EVT Ty, SelectionDAG &DAG,
+                             unsigned Flag) {
+  return DAG.getTargetJumpTable(N->getIndex(), Ty, Flag);
+}
+
+static SDValue getTargetNode(ConstantPoolSDNode *N, EVT Ty, SelectionDAG &DAG,
+                             unsigned Flag) {
+  return DAG.getTargetConstantPool(N->getConstVal(), Ty, N->getAlignment(),
+                                   N->getOffset(), Flag);
+}
+
+/// Address of a DSO-local N in PIC code:
+///   (add (add %gotoff_hiadj(N), GOT), %gotoff_lo(N))
+/// The %gotoff_lo part folds into the offset of a load or store.
+template <class NodeTy>
+static SDValue getAddrGOTOff(NodeTy *N, EVT Ty, SelectionDAG &DAG) {
+  SDLoc DL(N);
+  SDValue Hi = DAG.getNode(Nios2ISD::Hi, DL, Ty,
+                           getTargetNode(N, Ty, DAG, Nios2II::MO_GOTOFF_HA));
+  SDValue Lo = DAG.getNode(Nios2ISD::Lo, DL, Ty,
+                           getTargetNode(N, Ty, DAG, Nios2II::MO_GOTOFF_LO));
+  Hi = DAG.getNode(ISD::ADD, DL, Ty, Hi, GetGlobalReg(DAG, Ty));
+  return DAG.getNode(ISD::ADD, DL, Ty, Hi, Lo);
+}
+
+/// Load the GOT entry of N: %got for data and %call for lazily bound calls,
+/// or their %hiadj/%lo halves with -nios2-xgot. GOT entries do not change
+/// after relocation, so the load is invariant.
+template <class NodeTy>
+static SDValue getAddrGlobal(NodeTy *N, EVT Ty, SelectionDAG &DAG,
+                             SDValue Chain, bool IsCall) {
+  SDLoc DL(N);
+  SDValue Addr;
+
+  if (LargeGOT) {
+    unsigned HiFlag = IsCall ? Nios2II::MO_CALL_HA : Nios2II::MO_GOT_HA;
+    unsigned LoFlag = IsCall ? Nios2II::MO_CALL_LO : Nios2II::MO_GOT_LO;
+    SDValue Hi = DAG.getNode(Nios2ISD::Hi, DL, Ty,
+                             getTargetNode(N, Ty, DAG, HiFlag));
+    SDValue Lo = DAG.getNode(Nios2ISD::Lo, DL, Ty,
+                             getTargetNode(N, Ty, DAG, LoFlag));
+    Hi = DAG.getNode(ISD::ADD, DL, Ty, Hi, GetGlobalReg(DAG, Ty));
+    Addr = DAG.getNode(ISD::ADD, DL, Ty, Hi, Lo);
+  } else {
+    unsigned Flag = IsCall ? Nios2II::MO_GOT_CALL : Nios2II::MO_GOT16;
+    Addr = DAG.getNode(Nios2ISD::Wrapper, DL, Ty, GetGlobalReg(DAG, Ty),
+                       getTargetNode(N, Ty, DAG, Flag));
+  }
+
+  return DAG.getLoad(Ty, DL, Chain, Addr,
+                     MachinePointerInfo::getGOT(DAG.getMachineFunction()),
+                     false, false, /*isInvariant=*/true, 0);
+}
+
 const char *Nios2TargetLowering::getTargetNodeName(unsigned Opcode) const {
   switch (Opcode) {
   case Nios2ISD::Hi:                return "Nios2ISD::Hi";
@@ -66,6 +181,7 @@ const char *Nios2TargetLowering::getTargetNodeName(unsigned Opcode) const {
   case Nios2ISD::Wrapper:           return "Nios2ISD::Wrapper";
   case Nios2ISD::JmpLink:           return "Nios2ISD::JmpLink";
   case Nios2ISD::Select:            return "Nios2ISD::Select";
+  case Nios2ISD::CustomOp:          return "Nios2ISD::CustomOp";
   default:                          return NULL;
   }
 }
@@ -99,7 +215,7 @@ Nios2TargetLowering::Nios2TargetLowering(const Nios2TargetMachine &TM,
   setOperationAction(ISD::GlobalAddress,      MVT::i32,   Custom);
   setOperationAction(ISD::BlockAddress,       MVT::i32,   Custom);
   //setOperationAction(ISD::GlobalTLSAddress,   MVT::i32,   Custom);
-  //setOperationAction(ISD::JumpTable,          MVT::i32,   Custom);
+  setOperationAction(ISD::JumpTable,          MVT::i32,   Custom);
   //setOperationAction(ISD::ConstantPool,       MVT::i32,   Custom);
   setOperationAction(ISD::SELECT,             MVT::i32,   Expand);
   //setOperationAction(ISD::BRCOND,             MVT::Other, Custom);
@@ -112,6 +228,12 @@ Nios2TargetLowering::Nios2TargetLowering(const Nios2TargetMachine &TM,
   setOperationAction(ISD::UDIVREM, MVT::i32, Expand);
   setOperationAction(ISD::ADDC, MVT::i32, Expand);
   setOperationAction(ISD::SUBC, MVT::i32, Expand);
+
+  // Nios2 has no carry flag. i64 add/sub are expanded through UADDO/USUBO,
+  // whose carry is computed with a single cmpltu and added to the high word.
+  setOperationAction(ISD::UADDO,              MVT::i32,   Custom);
+  setOperationAction(ISD::USUBO,              MVT::i32,   Custom);
+  setOperationAction(ISD::SETCC,              MVT::i64,   Custom);
   setOperationAction(ISD::UMUL_LOHI,          MVT::i32,   Expand);
   setOperationAction(ISD::SMUL_LOHI,          MVT::i32,   Expand);
   setOperationAction(ISD::SHL_PARTS,          MVT::i32,   Custom);
@@ -127,11 +249,6 @@ Nios2TargetLowering::Nios2TargetLowering(const Nios2TargetMachine &TM,
   setOperationAction(ISD::SIGN_EXTEND_INREG, MVT::i1,    Expand);
   setOperationAction(ISD::SIGN_EXTEND_INREG, MVT::i8,    Expand);
   setOperationAction(ISD::SIGN_EXTEND_INREG, MVT::i16,   Expand);
-  setOperationAction(ISD::CTPOP,             MVT::i32,   Expand);
-  setOperationAction(ISD::CTTZ,              MVT::i32,   Expand);
-  setOperationAction(ISD::CTTZ_ZERO_UNDEF,   MVT::i32,   Expand);
-  setOperationAction(ISD::CTLZ_ZERO_UNDEF,   MVT::i32,   Expand);
-  setOperationAction(ISD::ROTL,              MVT::i32,   Expand);
   setOperationAction(ISD::DYNAMIC_STACKALLOC, MVT::i32,  Expand);
 
   setOperationAction(ISD::VAARG,             MVT::Other, Expand);
@@ -147,8 +264,27 @@ Nios2TargetLowering::Nios2TargetLowering(const Nios2TargetMachine &TM,
 
   setInsertFencesForAtomic(true);
 
-  setOperationAction(ISD::CTLZ, MVT::i32, Expand);
-  setOperationAction(ISD::BSWAP, MVT::i32, Expand);
+  // Rotates are native. The other bit manipulation operations are lowered to
+  // short branchless sequences, or to a custom instruction if one is mapped.
+  // Whether a multiplier is available is only known once the subtarget
+  // features are parsed, so the lowerings fall back to the generic
+  // expansion themselves.
+  if (DisableBitManip) {
+    setOperationAction(ISD::ROTL,            MVT::i32,   Expand);
+    setOperationAction(ISD::BSWAP,           MVT::i32,   Expand);
+    setOperationAction(ISD::CTPOP,           MVT::i32,   Expand);
+    setOperationAction(ISD::CTTZ,            MVT::i32,   Expand);
+    setOperationAction(ISD::CTTZ_ZERO_UNDEF, MVT::i32,   Expand);
+    setOperationAction(ISD::CTLZ,            MVT::i32,   Expand);
+    setOperationAction(ISD::CTLZ_ZERO_UNDEF, MVT::i32,   Expand);
+  } else {
+    setOperationAction(ISD::BSWAP,           MVT::i32,   Custom);
+    setOperationAction(ISD::CTPOP,           MVT::i32,   Custom);
+    setOperationAction(ISD::CTTZ,            MVT::i32,   Custom);
+    setOperationAction(ISD::CTTZ_ZERO_UNDEF, MVT::i32,   Custom);
+    setOperationAction(ISD::CTLZ,            MVT::i32,   Custom);
+    setOperationAction(ISD::CTLZ_ZERO_UNDEF, MVT::i32,   Custom);
+  }
 
   setMinFunctionAlignment(2);
 
@@ -335,6 +471,25 @@ EVT Nios2TargetLowering::getSetCCResultType(const DataLayout &DL,
 //  return DAG.getNode(ISD::ADD, DL, ValTy, Add1, Lo);
 //}
 
+// The *_PARTS lowerings pick between two results depending on bit 5 of the
+// shift amount. A SELECT would become a branch, so build an all-ones mask
+// from that bit, by shifting it into the sign bit and back, and select with
+// logic operations instead.
+static SDValue getShamtMask(SelectionDAG &DAG, SDLoc DL, SDValue Shamt) {
+  SDValue Bit = DAG.getNode(ISD::SHL, DL, MVT::i32, Shamt,
+                            DAG.getConstant(26, DL, MVT::i32));
+  return DAG.getNode(ISD::SRA, DL, MVT::i32, Bit,
+                     DAG.getConstant(31, DL, MVT::i32));
+}
+
+// Mask ? T : F, for an all-ones or all-zeros Mask.
+static SDValue selectWithMask(SelectionDAG &DAG, SDLoc DL, SDValue Mask,
+                              SDValue T, SDValue F) {
+  SDValue Diff = DAG.getNode(ISD::XOR, DL, MVT::i32, T, F);
+  Diff = DAG.getNode(ISD::AND, DL, MVT::i32, Diff, Mask);
+  return DAG.getNode(ISD::XOR, DL, MVT::i32, F, Diff);
+}
+
 SDValue Nios2TargetLowering::lowerShiftLeftParts(SDValue Op,
                                                 SelectionDAG &DAG) const {
   SDLoc DL(Op);
@@ -356,11 +511,10 @@ SDValue Nios2TargetLowering::lowerShiftLeftParts(SDValue Op,
   SDValue ShiftLeftHi = DAG.getNode(ISD::SHL, DL, MVT::i32, Hi, Shamt);
   SDValue Or = DAG.getNode(ISD::OR, DL, MVT::i32, ShiftLeftHi, ShiftRightLo);
   SDValue ShiftLeftLo = DAG.getNode(ISD::SHL, DL, MVT::i32, Lo, Shamt);
-  SDValue Cond = DAG.getNode(ISD::AND, DL, MVT::i32, Shamt,
-                             DAG.getConstant(0x20, DL, MVT::i32));
-  Lo = DAG.getNode(ISD::SELECT, DL, MVT::i32, Cond,
-                   DAG.getConstant(0, DL, MVT::i32), ShiftLeftLo);
-  Hi = DAG.getNode(ISD::SELECT, DL, MVT::i32, Cond, ShiftLeftLo, Or);
+  SDValue Mask = getShamtMask(DAG, DL, Shamt);
+  SDValue NotMask = DAG.getNOT(DL, Mask, MVT::i32);
+  Lo = DAG.getNode(ISD::AND, DL, MVT::i32, ShiftLeftLo, NotMask);
+  Hi = selectWithMask(DAG, DL, Mask, ShiftLeftLo, Or);
 
   SDValue Ops[2] = {Lo, Hi};
   return DAG.getMergeValues(Ops, DL);
@@ -394,14 +548,17 @@ SDValue Nios2TargetLowering::lowerShiftRightParts(SDValue Op, SelectionDAG &DAG,
   SDValue Or = DAG.getNode(ISD::OR, DL, MVT::i32, ShiftLeftHi, ShiftRightLo);
   SDValue ShiftRightHi = DAG.getNode(IsSRA ? ISD::SRA : ISD::SRL, DL, MVT::i32,
                                      Hi, Shamt);
-  SDValue Cond = DAG.getNode(ISD::AND, DL, MVT::i32, Shamt,
-                             DAG.getConstant(0x20, DL, MVT::i32));
-  SDValue Shift31 = DAG.getNode(ISD::SRA, DL, MVT::i32, Hi,
-                                DAG.getConstant(31, DL, MVT::i32));
-  Lo = DAG.getNode(ISD::SELECT, DL, MVT::i32, Cond, ShiftRightHi, Or);
-  Hi = DAG.getNode(ISD::SELECT, DL, MVT::i32, Cond,
-                   IsSRA ? Shift31 : DAG.getConstant(0, DL, MVT::i32),
-                   ShiftRightHi);
+  SDValue Mask = getShamtMask(DAG, DL, Shamt);
+  Lo = selectWithMask(DAG, DL, Mask, ShiftRightHi, Or);
+  // For shift amounts of 32 and more, shifting the high word by a further 31
+  // leaves only copies of its sign bit.
+  if (IsSRA)
+    Hi = DAG.getNode(ISD::SRA, DL, MVT::i32, ShiftRightHi,
+                     DAG.getNode(ISD::AND, DL, MVT::i32, Mask,
+                                 DAG.getConstant(31, DL, MVT::i32)));
+  else
+    Hi = DAG.getNode(ISD::AND, DL, MVT::i32, ShiftRightHi,
+                     DAG.getNOT(DL, Mask, MVT::i32));
 
   SDValue Ops[2] = {Lo, Hi};
   return DAG.getMergeValues(Ops, DL);
@@ -419,6 +576,239 @@ SDValue Nios2TargetLowering::lowerSELECT_CC(SDValue Op,
                      Op.getOperand(3));
 }
 
+// Lower UADDO/USUBO, used to expand i64 add/sub, to the operation and a
+// compare that recovers the carry or borrow:
+//   add  lo, a, b          sub    lo, a, b
+//   cmpltu c, lo, a        cmpltu c, a, b
+SDValue Nios2TargetLowering::lowerUADDSUBO(SDValue Op,
+                                           SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  SDValue LHS = Op.getOperand(0), RHS = Op.getOperand(1);
+  SDValue Res, Carry;
+
+  if (Op.getOpcode() == ISD::UADDO) {
+    Res = DAG.getNode(ISD::ADD, DL, MVT::i32, LHS, RHS);
+    Carry = DAG.getSetCC(DL, MVT::i32, Res, LHS, ISD::SETULT);
+  } else {
+    Res = DAG.getNode(ISD::SUB, DL, MVT::i32, LHS, RHS);
+    Carry = DAG.getSetCC(DL, MVT::i32, LHS, RHS, ISD::SETULT);
+  }
+
+  SDValue Ops[2] = {Res, Carry};
+  return DAG.getMergeValues(Ops, DL);
+}
+
+// Lower an ordered i64 compare without branches:
+//   (hi CC' hi) | ((hi == hi) & (lo CCu lo))
+// where CC' is the strict form of CC and CCu its unsigned form. The generic
+// expansion selects between the two compares, which costs a branch on Nios2.
+// Equality compares are left to the generic xor/or expansion.
+SDValue Nios2TargetLowering::lowerSETCC(SDValue Op, SelectionDAG &DAG) const {
+  SDValue LHS = Op.getOperand(0), RHS = Op.getOperand(1);
+  ISD::CondCode CC = cast<CondCodeSDNode>(Op.getOperand(2))->get();
+
+  if (LHS.getValueType() != MVT::i64 || CC == ISD::SETEQ || CC == ISD::SETNE)
+    return SDValue();
+
+  ISD::CondCode HiCC, LoCC;
+  switch (CC) {
+  default: llvm_unreachable("Unexpected i64 condition code");
+  case ISD::SETLT:  HiCC = ISD::SETLT;  LoCC = ISD::SETULT; break;
+  case ISD::SETLE:  HiCC = ISD::SETLT;  LoCC = ISD::SETULE; break;
+  case ISD::SETGT:  HiCC = ISD::SETGT;  LoCC = ISD::SETUGT; break;
+  case ISD::SETGE:  HiCC = ISD::SETGT;  LoCC = ISD::SETUGE; break;
+  case ISD::SETULT: HiCC = ISD::SETULT; LoCC = ISD::SETULT; break;
+  case ISD::SETULE: HiCC = ISD::SETULT; LoCC = ISD::SETULE; break;
+  case ISD::SETUGT: HiCC = ISD::SETUGT; LoCC = ISD::SETUGT; break;
+  case ISD::SETUGE: HiCC = ISD::SETUGT; LoCC = ISD::SETUGE; break;
+  }
+
+  SDLoc DL(Op);
+  SDValue Zero = DAG.getConstant(0, DL, MVT::i32);
+  SDValue One = DAG.getConstant(1, DL, MVT::i32);
+  SDValue LHSLo = DAG.getNode(ISD::EXTRACT_ELEMENT, DL, MVT::i32, LHS, Zero);
+  SDValue LHSHi = DAG.getNode(ISD::EXTRACT_ELEMENT, DL, MVT::i32, LHS, One);
+  SDValue RHSLo = DAG.getNode(ISD::EXTRACT_ELEMENT, DL, MVT::i32, RHS, Zero);
+  SDValue RHSHi = DAG.getNode(ISD::EXTRACT_ELEMENT, DL, MVT::i32, RHS, One);
+
+  SDValue HiCmp = DAG.getSetCC(DL, MVT::i32, LHSHi, RHSHi, HiCC);
+  SDValue HiEq = DAG.getSetCC(DL, MVT::i32, LHSHi, RHSHi, ISD::SETEQ);
+  SDValue LoCmp = DAG.getSetCC(DL, MVT::i32, LHSLo, RHSLo, LoCC);
+  SDValue Res = DAG.getNode(ISD::OR, DL, MVT::i32, HiCmp,
+                            DAG.getNode(ISD::AND, DL, MVT::i32, HiEq, LoCmp));
+  return DAG.getZExtOrTrunc(Res, DL, Op.getValueType());
+}
+
+// Compute the operation of Op with custom instruction slot N.
+static SDValue getCustomOp(SDValue Op, SelectionDAG &DAG, int N) {
+  SDLoc DL(Op);
+  return DAG.getNode(Nios2ISD::CustomOp, DL, MVT::i32,
+                     DAG.getTargetConstant(N, DL, MVT::i32),
+                     Op.getOperand(0));
+}
+
+// bswap with two rotates and a byte mask select:
+//   a = roli x, 8          (bytes 2 and 0 in place)
+//   b = roli x, 24         (bytes 3 and 1 in place)
+//   r = b ^ ((a ^ b) & 0x00ff00ff)
+SDValue Nios2TargetLowering::lowerBSWAP(SDValue Op, SelectionDAG &DAG) const {
+  if (CustomBSwap >= 0)
+    return getCustomOp(Op, DAG, CustomBSwap);
+
+  SDLoc DL(Op);
+  SDValue X = Op.getOperand(0);
+  SDValue A = DAG.getNode(ISD::ROTL, DL, MVT::i32, X,
+                          DAG.getConstant(8, DL, MVT::i32));
+  SDValue B = DAG.getNode(ISD::ROTL, DL, MVT::i32, X,
+                          DAG.getConstant(24, DL, MVT::i32));
+  return selectWithMask(DAG, DL, DAG.getConstant(0x00ff00ff, DL, MVT::i32),
+                        A, B);
+}
+
+// Load the byte at Table[Idx], with Table placed in the constant pool.
+SDValue Nios2TargetLowering::getByteTableEntry(ArrayRef<uint8_t> Table,
+                                               SDValue Idx, SDLoc DL,
+                                               SelectionDAG &DAG) const {
+  MachineFunction &MF = DAG.getMachineFunction();
+  Constant *C = ConstantDataArray::get(*DAG.getContext(), Table);
+  SDValue Addr = LowerConstantPool(DAG.getConstantPool(C, MVT::i32, 1), DAG);
+
+  // Add the index before the %lo part, so that it folds into the load.
+  if (Addr.getOpcode() == ISD::ADD &&
+      Addr.getOperand(1).getOpcode() == Nios2ISD::Lo) {
+    SDValue Base = DAG.getNode(ISD::ADD, DL, MVT::i32, Addr.getOperand(0),
+                               Idx);
+    Addr = DAG.getNode(ISD::ADD, DL, MVT::i32, Base, Addr.getOperand(1));
+  } else
+    Addr = DAG.getNode(ISD::ADD, DL, MVT::i32, Addr, Idx);
+
+  return DAG.getExtLoad(ISD::ZEXTLOAD, DL, MVT::i32, DAG.getEntryNode(), Addr,
+                        MachinePointerInfo::getConstantPool(MF), MVT::i8,
+                        false, false, true, 1);
+}
+
+// The top five bits of a de Bruijn sequence multiplied by a power of two, or
+// by a mask of the low bits, are distinct for each of the 32 inputs.
+static const uint32_t DeBruijnCTZ = 0x077CB531;
+static const uint32_t DeBruijnCLZ = 0x07C4ACDD;
+
+// ctz with the multiplier, by isolating the lowest set bit and looking up
+// its position:
+//   r = table[((x & -x) * DeBruijnCTZ) >> 27] + ((x == 0) << 5)
+SDValue Nios2TargetLowering::lowerCTTZ(SDValue Op, SelectionDAG &DAG) const {
+  if (CustomCTZ >= 0)
+    return getCustomOp(Op, DAG, CustomCTZ);
+  if (!Subtarget.hasHWMul())
+    return SDValue();
+
+  uint8_t Table[32];
+  for (unsigned I = 0; I < 32; ++I)
+    Table[(DeBruijnCTZ << I) >> 27] = I;
+
+  SDLoc DL(Op);
+  SDValue X = Op.getOperand(0);
+  SDValue Zero = DAG.getConstant(0, DL, MVT::i32);
+  SDValue LowBit = DAG.getNode(ISD::AND, DL, MVT::i32, X,
+                               DAG.getNode(ISD::SUB, DL, MVT::i32, Zero, X));
+  SDValue Mul = DAG.getNode(ISD::MUL, DL, MVT::i32, LowBit,
+                            DAG.getConstant(DeBruijnCTZ, DL, MVT::i32));
+  SDValue Idx = DAG.getNode(ISD::SRL, DL, MVT::i32, Mul,
+                            DAG.getConstant(27, DL, MVT::i32));
+  SDValue Res = getByteTableEntry(Table, Idx, DL, DAG);
+  if (Op.getOpcode() == ISD::CTTZ_ZERO_UNDEF)
+    return Res;
+
+  // x == 0 looks up entry 0, which is 0, so add 32.
+  SDValue IsZero = DAG.getSetCC(DL, MVT::i32, X, Zero, ISD::SETEQ);
+  return DAG.getNode(ISD::ADD, DL, MVT::i32, Res,
+                     DAG.getNode(ISD::SHL, DL, MVT::i32, IsZero,
+                                 DAG.getConstant(5, DL, MVT::i32)));
+}
+
+// clz with the multiplier, by smearing the highest set bit to the right and
+// looking up its position:
+//   r = table[(smear(x) * DeBruijnCLZ) >> 27] + (x == 0)
+SDValue Nios2TargetLowering::lowerCTLZ(SDValue Op, SelectionDAG &DAG) const {
+  if (CustomCLZ >= 0)
+    return getCustomOp(Op, DAG, CustomCLZ);
+
+  SDLoc DL(Op);
+  SDValue X = Op.getOperand(0);
+  SDValue Smeared = X;
+  for (unsigned Shift = 1; Shift < 32; Shift <<= 1)
+    Smeared = DAG.getNode(ISD::OR, DL, MVT::i32, Smeared,
+                          DAG.getNode(ISD::SRL, DL, MVT::i32, Smeared,
+                                      DAG.getConstant(Shift, DL, MVT::i32)));
+
+  // Without the multiplier count the zeros above the smeared bits. Leaving
+  // this to the generic expansion would loop: it turns CTLZ into a select
+  // over CTLZ_ZERO_UNDEF, which is Custom, and back.
+  if (!Subtarget.hasHWMul())
+    return DAG.getNode(ISD::CTPOP, DL, MVT::i32,
+                       DAG.getNOT(DL, Smeared, MVT::i32));
+
+  uint8_t Table[32];
+  for (unsigned I = 0; I < 32; ++I) {
+    uint32_t Smear = I == 31 ? ~0U : (2U << I) - 1;
+    Table[(Smear * DeBruijnCLZ) >> 27] = 31 - I;
+  }
+
+  SDValue Mul = DAG.getNode(ISD::MUL, DL, MVT::i32, Smeared,
+                            DAG.getConstant(DeBruijnCLZ, DL, MVT::i32));
+  SDValue Idx = DAG.getNode(ISD::SRL, DL, MVT::i32, Mul,
+                            DAG.getConstant(27, DL, MVT::i32));
+  SDValue Res = getByteTableEntry(Table, Idx, DL, DAG);
+  if (Op.getOpcode() == ISD::CTLZ_ZERO_UNDEF)
+    return Res;
+
+  // x == 0 looks up the entry of x == 1, which is 31.
+  SDValue IsZero = DAG.getSetCC(DL, MVT::i32, X,
+                                DAG.getConstant(0, DL, MVT::i32), ISD::SETEQ);
+  return DAG.getNode(ISD::ADD, DL, MVT::i32, Res, IsZero);
+}
+
+// popcount with the multiplier is left to the generic expansion, which sums
+// the bytes with a multiply by 0x01010101. mul is selected whether or not
+// the core has a multiplier, so without one sum them with shifts instead:
+//   v = x - ((x >> 1) & 0x55555555)
+//   v = (v & 0x33333333) + ((v >> 2) & 0x33333333)
+//   v = (v + (v >> 4)) & 0x0f0f0f0f
+//   v = v + (v >> 8)
+//   r = (v + (v >> 16)) & 0x3f
+SDValue Nios2TargetLowering::lowerCTPOP(SDValue Op, SelectionDAG &DAG) const {
+  if (CustomPopCount >= 0)
+    return getCustomOp(Op, DAG, CustomPopCount);
+  if (Subtarget.hasHWMul())
+    return SDValue();
+
+  SDLoc DL(Op);
+  SDValue V = Op.getOperand(0);
+  auto Srl = [&](SDValue X, unsigned Shift) {
+    return DAG.getNode(ISD::SRL, DL, MVT::i32, X,
+                       DAG.getConstant(Shift, DL, MVT::i32));
+  };
+  auto And = [&](SDValue X, uint32_t Mask) {
+    return DAG.getNode(ISD::AND, DL, MVT::i32, X,
+                       DAG.getConstant(Mask, DL, MVT::i32));
+  };
+
+  V = DAG.getNode(ISD::SUB, DL, MVT::i32, V, And(Srl(V, 1), 0x55555555));
+  V = DAG.getNode(ISD::ADD, DL, MVT::i32, And(V, 0x33333333),
+                  And(Srl(V, 2), 0x33333333));
+  V = And(DAG.getNode(ISD::ADD, DL, MVT::i32, V, Srl(V, 4)), 0x0f0f0f0f);
+  V = DAG.getNode(ISD::ADD, DL, MVT::i32, V, Srl(V, 8));
+  V = DAG.getNode(ISD::ADD, DL, MVT::i32, V, Srl(V, 16));
+  return And(V, 0x3f);
+}
+
+bool Nios2TargetLowering::isCheapToSpeculateCttz() const {
+  return !DisableBitManip && (CustomCTZ >= 0 || Subtarget.hasHWMul());
+}
+
+bool Nios2TargetLowering::isCheapToSpeculateCtlz() const {
+  return !DisableBitManip && (CustomCLZ >= 0 || Subtarget.hasHWMul());
+}
+
 SDValue Nios2TargetLowering::
 LowerOperation(SDValue Op, SelectionDAG &DAG) const
 {
@@ -432,10 +822,18 @@ LowerOperation(SDValue Op, SelectionDAG &DAG) const
     case ISD::SRL_PARTS:          return lowerShiftRightParts(Op, DAG, false);
     //case ISD::BlockAddress:       return LowerBlockAddress(Op, DAG);
     //case ISD::GlobalTLSAddress:   return LowerGlobalTLSAddress(Op, DAG);
-    //case ISD::JumpTable:          return LowerJumpTable(Op, DAG);
+    case ISD::JumpTable:          return lowerJumpTable(Op, DAG);
     //case ISD::SELECT:             return LowerSELECT(Op, DAG);
     case ISD::SELECT_CC:          return lowerSELECT_CC(Op, DAG);
-    //case ISD::SETCC:              return LowerSETCC(Op, DAG);
+    case ISD::SETCC:              return lowerSETCC(Op, DAG);
+    case ISD::UADDO:
+    case ISD::USUBO:              return lowerUADDSUBO(Op, DAG);
+    case ISD::BSWAP:              return lowerBSWAP(Op, DAG);
+    case ISD::CTTZ:
+    case ISD::CTTZ_ZERO_UNDEF:    return lowerCTTZ(Op, DAG);
+    case ISD::CTLZ:
+    case ISD::CTLZ_ZERO_UNDEF:    return lowerCTLZ(Op, DAG);
+    case ISD::CTPOP:              return lowerCTPOP(Op, DAG);
     case ISD::VASTART:            return LowerVASTART(Op, DAG);
     //case ISD::FCOPYSIGN:          return LowerFCOPYSIGN(Op, DAG);
     //case ISD::FRAMEADDR:          return LowerFRAMEADDR(Op, DAG);
@@ -465,7 +863,14 @@ SDValue Nios2TargetLowering::lowerGlobalAddress(SDValue Op,
                                                SelectionDAG &DAG) const {
   // FIXME there isn't actually debug info here
   SDLoc dl(Op);
-  const GlobalValue *GV = cast<GlobalAddressSDNode>(Op)->getGlobal();
+  GlobalAddressSDNode *N = cast<GlobalAddressSDNode>(Op);
+  const GlobalValue *GV = N->getGlobal();
+
+  if (getTargetMachine().getRelocationModel() == Reloc::PIC_) {
+    if (isLocalToDSO(GV))
+      return getAddrGOTOff(N, MVT::i32, DAG);
+    return getAddrGlobal(N, MVT::i32, DAG, DAG.getEntryNode(), false);
+  }
 
   // %hi/%lo relocation
   SDValue GAHi = DAG.getTargetGlobalAddress(GV, dl, MVT::i32, 0,
@@ -586,34 +991,23 @@ SDValue Nios2TargetLowering::lowerGlobalAddress(SDValue Op,
 //  return DAG.getNode(ISD::ADD, dl, PtrVT, ThreadPointer, Offset);
 //}
 
-//SDValue Nios2TargetLowering::
-//LowerJumpTable(SDValue Op, SelectionDAG &DAG) const
-//{
-//  SDValue HiPart, JTI, JTILo;
-//  // FIXME there isn't actually debug info here
-//  DebugLoc dl = Op.getDebugLoc();
-//  bool IsPIC = getTargetMachine().getRelocationModel() == Reloc::PIC_;
-//  EVT PtrVT = Op.getValueType();
-//  JumpTableSDNode *JT = cast<JumpTableSDNode>(Op);
-//
-//  if (!IsPIC && !IsN64) {
-//    JTI = DAG.getTargetJumpTable(JT->getIndex(), PtrVT, Nios2II::MO_ABS_HI);
-//    HiPart = DAG.getNode(Nios2ISD::Hi, dl, PtrVT, JTI);
-//    JTILo = DAG.getTargetJumpTable(JT->getIndex(), PtrVT, Nios2II::MO_ABS_LO);
-//  } else {// Emit Load from Global Pointer
-//    unsigned GOTFlag = HasNios264 ? Nios2II::MO_GOT_PAGE : Nios2II::MO_GOT;
-//    unsigned OfstFlag = HasNios264 ? Nios2II::MO_GOT_OFST : Nios2II::MO_ABS_LO;
-//    JTI = DAG.getTargetJumpTable(JT->getIndex(), PtrVT, GOTFlag);
-//    JTI = DAG.getNode(Nios2ISD::Wrapper, dl, PtrVT, GetGlobalReg(DAG, PtrVT),
-//                      JTI);
-//    HiPart = DAG.getLoad(PtrVT, dl, DAG.getEntryNode(), JTI,
-//                         MachinePointerInfo(), false, false, false, 0);
-//    JTILo = DAG.getTargetJumpTable(JT->getIndex(), PtrVT, OfstFlag);
-//  }
-//
-//  SDValue Lo = DAG.getNode(Nios2ISD::Lo, dl, PtrVT, JTILo);
-//  return DAG.getNode(ISD::ADD, dl, PtrVT, HiPart, Lo);
-//}
+SDValue Nios2TargetLowering::lowerJumpTable(SDValue Op,
+                                            SelectionDAG &DAG) const {
+  SDLoc dl(Op);
+  JumpTableSDNode *N = cast<JumpTableSDNode>(Op);
+
+  // Jump tables are always local to the DSO.
+  if (getTargetMachine().getRelocationModel() == Reloc::PIC_)
+    return getAddrGOTOff(N, MVT::i32, DAG);
+
+  SDValue JTHi = DAG.getTargetJumpTable(N->getIndex(), MVT::i32,
+                                        Nios2II::MO_HIADJ16);
+  SDValue JTLo = DAG.getTargetJumpTable(N->getIndex(), MVT::i32,
+                                        Nios2II::MO_LO16);
+  SDValue HiPart = DAG.getNode(Nios2ISD::Hi, dl, MVT::i32, JTHi);
+  SDValue Lo = DAG.getNode(Nios2ISD::Lo, dl, MVT::i32, JTLo);
+  return DAG.getNode(ISD::ADD, dl, MVT::i32, HiPart, Lo);
+}
 
 SDValue Nios2TargetLowering::
 LowerConstantPool(SDValue Op, SelectionDAG &DAG) const
@@ -642,21 +1036,8 @@ LowerConstantPool(SDValue Op, SelectionDAG &DAG) const
     SDValue HiPart = DAG.getNode(Nios2ISD::Hi, dl, MVT::i32, CPHi);
     SDValue Lo = DAG.getNode(Nios2ISD::Lo, dl, MVT::i32, CPLo);
     ResNode = DAG.getNode(ISD::ADD, dl, MVT::i32, HiPart, Lo);
-  } else {
-    EVT ValTy = Op.getValueType();
-    unsigned GOTFlag = Nios2II::MO_GOT;
-    unsigned OFSTFlag = Nios2II::MO_LO16;
-    SDValue CP = DAG.getTargetConstantPool(C, ValTy, N->getAlignment(),
-                                           N->getOffset(), GOTFlag);
-    CP = DAG.getNode(Nios2ISD::Wrapper, dl, ValTy, GetGlobalReg(DAG, ValTy), CP);
-    SDValue Load = DAG.getLoad(ValTy, dl, DAG.getEntryNode(), CP,
-                               MachinePointerInfo::getConstantPool(DAG.getMachineFunction()), false,
-                               false, false, 0);
-    SDValue CPLo = DAG.getTargetConstantPool(C, ValTy, N->getAlignment(),
-                                             N->getOffset(), OFSTFlag);
-    SDValue Lo = DAG.getNode(Nios2ISD::Lo, dl, ValTy, CPLo);
-    ResNode = DAG.getNode(ISD::ADD, dl, ValTy, Load, Lo);
-  }
+  } else
+    ResNode = getAddrGOTOff(N, Op.getValueType(), DAG);
 
   return ResNode;
 }
@@ -1280,62 +1661,51 @@ Nios2TargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
   // If the callee is a GlobalAddress/ExternalSymbol node (quite common, every
   // direct call is) turn it into a TargetGlobalAddress/TargetExternalSymbol
   // node so that legalize doesn't hack it.
-  unsigned char OpFlag;
-  bool IsPICCall = IsPIC; // true if calls are translated to jalr $25
-  bool GlobalOrExternal = false;
-  SDValue CalleeLo;
+  //
+  // "call" encodes an absolute address, so PIC code cannot use it. Callees
+  // that cannot be preempted are called through their address relative to
+  // the GOT. Other callees are called indirectly through their %call GOT
+  // entry, which points to a lazy binding PLT entry until first use. With
+  // -nios2-no-plt, or for a callee marked nonlazybind, the final address is
+  // instead read from its %got entry once in the entry block and kept in a
+  // register.
+  EVT PtrTy = getPointerTy(DAG.getDataLayout());
+  bool IsLazyCall = false;
 
   if (GlobalAddressSDNode *G = dyn_cast<GlobalAddressSDNode>(Callee)) {
-    if (IsPICCall && G->getGlobal()->hasInternalLinkage()) {
-      OpFlag = Nios2II::MO_GOT_PAGE;
-      unsigned char LoFlag = Nios2II::MO_LO16;
-      Callee = DAG.getTargetGlobalAddress(G->getGlobal(), dl, getPointerTy(DAG.getDataLayout()), 0,
-                                          OpFlag);
-      CalleeLo = DAG.getTargetGlobalAddress(G->getGlobal(), dl, getPointerTy(DAG.getDataLayout()),
-                                            0, LoFlag);
+    const GlobalValue *GV = G->getGlobal();
+    const Function *F = dyn_cast<Function>(GV);
+
+    if (!IsPIC)
+      Callee = DAG.getTargetGlobalAddress(GV, dl, PtrTy, 0,
+                                          Nios2II::MO_NO_FLAG);
+    else if (isLocalToDSO(GV))
+      Callee = getAddrGOTOff(G, PtrTy, DAG);
+    else if (NoPLT || (F && F->hasFnAttribute(Attribute::NonLazyBind))) {
+      GetGlobalReg(DAG, PtrTy);
+      Callee = DAG.getCopyFromReg(DAG.getEntryNode(), dl,
+                                  Nios2FI->getGOTCalleeReg(GV), PtrTy);
     } else {
-      OpFlag = IsPICCall ? Nios2II::MO_GOT_CALL : Nios2II::MO_NO_FLAG;
-      Callee = DAG.getTargetGlobalAddress(G->getGlobal(), dl,
-                                          getPointerTy(DAG.getDataLayout()), 0, OpFlag);
+      Callee = getAddrGlobal(G, PtrTy, DAG, DAG.getEntryNode(), true);
+      IsLazyCall = true;
     }
-
-    GlobalOrExternal = true;
   }
   else if (ExternalSymbolSDNode *S = dyn_cast<ExternalSymbolSDNode>(Callee)) {
-    OpFlag = Nios2II::MO_NO_FLAG;
-    Callee = DAG.getTargetExternalSymbol(S->getSymbol(), getPointerTy(DAG.getDataLayout()),
-                                         OpFlag);
-    GlobalOrExternal = true;
+    if (!IsPIC)
+      Callee = DAG.getTargetExternalSymbol(S->getSymbol(), PtrTy,
+                                           Nios2II::MO_NO_FLAG);
+    else {
+      Callee = getAddrGlobal(S, PtrTy, DAG, DAG.getEntryNode(), true);
+      IsLazyCall = true;
+    }
   }
 
   SDValue InFlag;
 
-  // Create nodes that load address of callee and copy it to T9
-  if (IsPICCall) {
-    if (GlobalOrExternal) {
-      // Load callee address
-      Callee = DAG.getNode(Nios2ISD::Wrapper, dl, getPointerTy(DAG.getDataLayout()),
-                           GetGlobalReg(DAG, getPointerTy(DAG.getDataLayout())), Callee);
-      SDValue LoadValue = DAG.getLoad(getPointerTy(DAG.getDataLayout()), dl, DAG.getEntryNode(),
-                                      Callee, MachinePointerInfo::getGOT(DAG.getMachineFunction()),
-                                      false, false, false, 0);
-
-      // Use GOT+LO if callee has internal linkage.
-      if (CalleeLo.getNode()) {
-        SDValue Lo = DAG.getNode(Nios2ISD::Lo, dl, getPointerTy(DAG.getDataLayout()), CalleeLo);
-        Callee = DAG.getNode(ISD::ADD, dl, getPointerTy(DAG.getDataLayout()), LoadValue, Lo);
-      } else
-        Callee = LoadValue;
-    }
-  }
-
-  // Insert node "GP copy globalreg" before call to function.
-  // Lazy-binding stubs require GP to point to the GOT.
-  if (IsPICCall) {
-    unsigned GPReg = Nios2::GP;
-    EVT Ty = MVT::i32;
-    RegsToPass.push_back(std::make_pair(GPReg, GetGlobalReg(DAG, Ty)));
-  }
+  // The PLT entries of a shared object find the GOT through r22.
+  if (IsLazyCall)
+    RegsToPass.push_back(std::make_pair(unsigned(Nios2::R22),
+                                        GetGlobalReg(DAG, PtrTy)));
 
   // Build a sequence of copy-to-reg nodes chained together with token
   // chain and flag operands which copy the outgoing args into registers.
@@ -2011,6 +2381,14 @@ void Nios2TargetLowering::LowerAsmOperandForConstraint(SDValue Op,
 }
 
 
+/// PIC jump tables hold the offsets of the targets from the table itself;
+/// the generic choice would be .gpword, which the Nios2 assembler lacks.
+unsigned Nios2TargetLowering::getJumpTableEncoding() const {
+  if (getTargetMachine().getRelocationModel() == Reloc::PIC_)
+    return MachineJumpTableInfo::EK_LabelDifference32;
+  return TargetLowering::getJumpTableEncoding();
+}
+
 bool
 Nios2TargetLowering::isOffsetFoldingLegal(const GlobalAddressSDNode *GA) const {
   // The Nios2 target isn't yet aware of offsets.
@@ -2072,7 +2450,7 @@ Nios2TargetLowering::EmitInstrWithCustomInserter(MachineInstr *MI,
       MF->insert(FIt, BB2);
       MF->insert(FIt, ExitBB);
 
-      BuildMI(*BB, I, DL, TII->get(Nios2::BEQ))
+      BuildMI(*BB, I, DL, TII->get(Nios2::BNE))
         .addOperand(a).addReg(Nios2::ZERO).addMBB(BB1);
       BuildMI(*BB, I, DL, TII->get(Nios2::BR))
         .addMBB(BB2);
@@ -2084,8 +2462,8 @@ Nios2TargetLowering::EmitInstrWithCustomInserter(MachineInstr *MI,
         .addReg(resx, RegState::Define).addOperand(x);
       BuildMI(BB1, DL, TII->get(Nios2::BR))
         .addMBB(ExitBB);
-      /* BB1:
-       * resy = COPY x
+      /* BB2:
+       * resy = COPY y
        * br ExitBB
        */
       BuildMI(BB2, DL, TII->get(TargetOpcode::COPY))
@@ -46,6 +46,9 @@ namespace llvm {
 
       Sync,
 
+      // Custom instruction: slot number, source register
+      CustomOp,
+
       // Read and write control registers
       ReadCtrl,
       WriteCtrl
@@ -77,6 +80,21 @@ namespace llvm {
     EVT getSetCCResultType(const DataLayout &DL, 
                            LLVMContext &Context, EVT VT) const override;
 
+    /// addi and the compare immediates take a signed 16-bit field.
+    bool isLegalAddImmediate(int64_t Imm) const override {
+      return isInt<16>(Imm);
+    }
+    bool isLegalICmpImmediate(int64_t Imm) const override {
+      return isInt<16>(Imm);
+    }
+
+    unsigned getJumpTableEncoding() const override;
+
+    /// Without a branch around the zero case, cttz and ctlz are as short as
+    /// their ZERO_UNDEF forms plus a compare, or a single custom instruction.
+    bool isCheapToSpeculateCttz() const override;
+    bool isCheapToSpeculateCtlz() const override;
+
   private:
     // Subtarget Info
     const Nios2Subtarget &Subtarget;
@@ -94,9 +112,8 @@ namespace llvm {
     SDValue lowerGlobalAddress(SDValue Op, SelectionDAG &DAG) const;
     //SDValue LowerBlockAddress(SDValue Op, SelectionDAG &DAG) const;
     //SDValue LowerGlobalTLSAddress(SDValue Op, SelectionDAG &DAG) const;
-    //SDValue LowerJumpTable(SDValue Op, SelectionDAG &DAG) const;
+    SDValue lowerJumpTable(SDValue Op, SelectionDAG &DAG) const;
     //SDValue LowerSELECT(SDValue Op, SelectionDAG &DAG) const;
-    //SDValue LowerSETCC(SDValue Op, SelectionDAG &DAG) const;
     SDValue LowerVASTART(SDValue Op, SelectionDAG &DAG) const;
     //SDValue LowerFRAMEADDR(SDValue Op, SelectionDAG &DAG) const;
     //SDValue LowerRETURNADDR(SDValue Op, SelectionDAG &DAG) const;
@@ -106,6 +123,14 @@ namespace llvm {
                                                  bool IsSRA) const;
     SDValue lowerShiftLeftParts(SDValue Op, SelectionDAG &DAG) const;
     SDValue lowerSELECT_CC(SDValue Op, SelectionDAG &DAG) const;
+    SDValue lowerSETCC(SDValue Op, SelectionDAG &DAG) const;
+    SDValue lowerUADDSUBO(SDValue Op, SelectionDAG &DAG) const;
+    SDValue lowerBSWAP(SDValue Op, SelectionDAG &DAG) const;
+    SDValue lowerCTTZ(SDValue Op, SelectionDAG &DAG) const;
+    SDValue lowerCTLZ(SDValue Op, SelectionDAG &DAG) const;
+    SDValue lowerCTPOP(SDValue Op, SelectionDAG &DAG) const;
+    SDValue getByteTableEntry(ArrayRef<uint8_t> Table, SDValue Idx, SDLoc DL,
+                              SelectionDAG &DAG) const;
 
     virtual SDValue
       LowerFormalArguments(SDValue Chain,
@@ -16,6 +16,7 @@
 #include "Nios2MachineFunction.h"
 #include "Nios2TargetObjectFile.h"
 #include "InstPrinter/Nios2InstPrinter.h"
+#include "MCTargetDesc/Nios2BaseInfo.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
@@ -90,7 +91,7 @@ void Nios2InstrInfo::AnalyzeCondBr(const MachineInstr *Inst, unsigned Opc,
 unsigned Nios2InstrInfo::GetAnalyzableBrOpc(unsigned Opc) const {
   return (Opc == Nios2::BEQ   || Opc == Nios2::BNE   || Opc == Nios2::BGT   ||
           Opc == Nios2::BGE   || Opc == Nios2::BLT   || Opc == Nios2::BLE   ||
-          Opc == Nios2::BR    || Opc == Nios2::JMP) ?
+          Opc == Nios2::BR) ?
          Opc : 0;
 }
 
@@ -293,25 +294,36 @@ Nios2InstrInfo::loadImmediate(int32_t Imm, MachineBasicBlock &MBB,
   unsigned ZEROReg = Nios2::ZERO;
   unsigned ATReg = Nios2::AT;
 
-  if (isInt<16>(Imm)) {
-    BuildMI(MBB, II, DL, get(Nios2::ADD), ATReg).addReg(ZEROReg)
-      .addImm(Imm);
-    if (NewImm)
-      *NewImm = 0;
-    return ATReg;
-  }
-
-  BuildMI(MBB, II, DL, get(Nios2::ORhi), ATReg).addReg(ZEROReg)
-    .addImm(Imm >> 16);
-  if (NewImm) {
+  // The caller adds the returned low half as a signed immediate, so the
+  // high half has to compensate for its sign (%hiadj).
+  if (NewImm && !isInt<16>(Imm)) {
+    BuildMI(MBB, II, DL, get(Nios2::ORhi), ATReg).addReg(ZEROReg)
+      .addImm(((Imm + 0x8000) >> 16) & 0xffffU);
     *NewImm = Imm & 0xffffU;
     return ATReg;
   }
-  BuildMI(MBB, II, DL, get(Nios2::ORi), ATReg).addReg(ZEROReg)
-    .addImm(Imm & 0xffffU);
+
+  if (NewImm)
+    *NewImm = 0;
+  materializeImm(Imm, ATReg, MBB, II, DL);
   return ATReg;
 }
 
+/// Build Imm in DstReg with the sequence getNios2ImmSeq picks.
+void Nios2InstrInfo::materializeImm(int32_t Imm, unsigned DstReg,
+                                    MachineBasicBlock &MBB,
+                                    MachineBasicBlock::iterator II,
+                                    DebugLoc DL) const {
+  Nios2ImmInst Seq[2];
+  unsigned SrcReg = Nios2::ZERO;
+
+  for (unsigned i = 0, e = getNios2ImmSeq(Imm, Seq); i != e; ++i) {
+    BuildMI(MBB, II, DL, get(Seq[i].Opcode), DstReg).addReg(SrcReg)
+      .addImm(Seq[i].ImmOpnd);
+    SrcReg = DstReg;
+  }
+}
+
 /// Adjust SP by Amount bytes.
 void Nios2InstrInfo::adjustStackPtr(unsigned SP, int64_t Amount,
                                      MachineBasicBlock &MBB,
@@ -338,6 +350,10 @@ bool Nios2InstrInfo::expandPostRAPseudo(MachineBasicBlock::iterator MI) const {
   case Nios2::RetRA:
     BuildMI(MBB, MI, MI->getDebugLoc(), get(Nios2::RET)).addReg(Nios2::RA);
     break;
+  case Nios2::LoadImm32:
+    materializeImm(MI->getOperand(1).getImm(), MI->getOperand(0).getReg(),
+                   MBB, MI, MI->getDebugLoc());
+    break;
   }
 
   MBB.erase(MI);
@@ -99,6 +99,10 @@ public:
                          MachineBasicBlock::iterator II, DebugLoc DL,
                          unsigned *NewImm) const;
 
+  /// Emit the shortest sequence that builds Imm in DstReg.
+  void materializeImm(int32_t Imm, unsigned DstReg, MachineBasicBlock &MBB,
+                      MachineBasicBlock::iterator II, DebugLoc DL) const;
+
 protected:
   bool isZeroImm(const MachineOperand &op) const;
 
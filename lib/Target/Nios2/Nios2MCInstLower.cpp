@@ -46,6 +46,14 @@ MCOperand Nios2MCInstLower::LowerSymbolOperand(const MachineOperand &MO,
   case Nios2II::MO_NO_FLAG:   Kind = MCSymbolRefExpr::VK_None; break;
   case Nios2II::MO_HIADJ16:   Kind = MCSymbolRefExpr::VK_Nios2_HIADJ16; break;
   case Nios2II::MO_LO16:      Kind = MCSymbolRefExpr::VK_Nios2_LO16; break;
+  case Nios2II::MO_GOT16:     Kind = MCSymbolRefExpr::VK_Nios2_GOT16; break;
+  case Nios2II::MO_GOT_CALL:  Kind = MCSymbolRefExpr::VK_Nios2_CALL16; break;
+  case Nios2II::MO_GOTOFF_HA: Kind = MCSymbolRefExpr::VK_Nios2_GOTOFF_HA; break;
+  case Nios2II::MO_GOTOFF_LO: Kind = MCSymbolRefExpr::VK_Nios2_GOTOFF_LO; break;
+  case Nios2II::MO_GOT_HA:    Kind = MCSymbolRefExpr::VK_Nios2_GOT_HA; break;
+  case Nios2II::MO_GOT_LO:    Kind = MCSymbolRefExpr::VK_Nios2_GOT_LO; break;
+  case Nios2II::MO_CALL_HA:   Kind = MCSymbolRefExpr::VK_Nios2_CALL_HA; break;
+  case Nios2II::MO_CALL_LO:   Kind = MCSymbolRefExpr::VK_Nios2_CALL_LO; break;
   }
 
   switch (MOTy) {
@@ -77,6 +85,11 @@ MCOperand Nios2MCInstLower::LowerSymbolOperand(const MachineOperand &MO,
     Offset += MO.getOffset();
     break;
 
+  case MachineOperand::MO_MCSymbol:
+    Symbol = MO.getMCSymbol();
+    Offset += MO.getOffset();
+    break;
+
   default:
     llvm_unreachable("<unknown operand type>");
   }
@@ -124,6 +137,7 @@ MCOperand Nios2MCInstLower::LowerOperand(const MachineOperand &MO,
   case MachineOperand::MO_JumpTableIndex:
   case MachineOperand::MO_ConstantPoolIndex:
   case MachineOperand::MO_BlockAddress:
+  case MachineOperand::MO_MCSymbol:
     return LowerSymbolOperand(MO, MOTy, offset);
   case MachineOperand::MO_RegisterMask:
     break;
@@ -132,6 +146,18 @@ MCOperand Nios2MCInstLower::LowerOperand(const MachineOperand &MO,
   return MCOperand();
 }
 
+/// Return the branch that implements the pseudo branch Opc with its register
+/// operands swapped, or 0 if Opc is not one.
+static unsigned getSwappedBranchOpc(unsigned Opc) {
+  switch (Opc) {
+  default:          return 0;
+  case Nios2::BGT:  return Nios2::BLT;
+  case Nios2::BGTU: return Nios2::BLTU;
+  case Nios2::BLE:  return Nios2::BGE;
+  case Nios2::BLEU: return Nios2::BGEU;
+  }
+}
+
 void Nios2MCInstLower::Lower(const MachineInstr *MI, MCInst &OutMI) const {
   OutMI.setOpcode(MI->getOpcode());
 
@@ -142,5 +168,14 @@ void Nios2MCInstLower::Lower(const MachineInstr *MI, MCInst &OutMI) const {
     if (MCOp.isValid())
       OutMI.addOperand(MCOp);
   }
+
+  // bgt, bgtu, ble and bleu are assembler macros without an encoding of
+  // their own, so emit the real branch with the operands swapped.
+  if (unsigned Opc = getSwappedBranchOpc(OutMI.getOpcode())) {
+    MCOperand RA = OutMI.getOperand(0);
+    OutMI.setOpcode(Opc);
+    OutMI.getOperand(0) = OutMI.getOperand(1);
+    OutMI.getOperand(1) = RA;
+  }
 }
 
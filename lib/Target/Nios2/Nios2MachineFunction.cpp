@@ -31,5 +31,12 @@ unsigned Nios2FunctionInfo::getGlobalBaseReg() {
   return GlobalBaseReg = MF.getRegInfo().createVirtualRegister(RC);
 }
 
+unsigned Nios2FunctionInfo::getGOTCalleeReg(const GlobalValue *GV) {
+  unsigned &Reg = GOTCallees[GV];
+  if (!Reg)
+    Reg = MF.getRegInfo().createVirtualRegister(&Nios2::CPURegsRegClass);
+  return Reg;
+}
+
 void Nios2FunctionInfo::anchor() { }
 
@@ -15,6 +15,7 @@
 #define NIOS2_MACHINE_FUNCTION_INFO_H
 
 #include "Nios2Subtarget.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/Target/TargetFrameLowering.h"
@@ -39,6 +40,11 @@ class Nios2FunctionInfo : public MachineFunctionInfo {
   /// relocation models.
   unsigned GlobalBaseReg;
 
+  /// GOTCallees - Callees whose address is loaded from the GOT once per
+  /// function instead of being called through a PLT entry, and the virtual
+  /// registers holding those addresses.
+  MapVector<const GlobalValue *, unsigned> GOTCallees;
+
   /// VarArgsFrameIndex - FrameIndex for start of varargs area.
   int VarArgsFrameIndex;
 
@@ -82,6 +88,12 @@ public:
 
   bool globalBaseRegSet() const;
   unsigned getGlobalBaseReg();
+
+  unsigned getGOTCalleeReg(const GlobalValue *GV);
+  const MapVector<const GlobalValue *, unsigned> &getGOTCallees() const {
+    return GOTCallees;
+  }
+
   bool getEmitNOAT() const { return EmitNOAT; }
   void setEmitNOAT() { EmitNOAT = true; }
   unsigned getMaxCallFrameSize() const { return MaxCallFrameSize; }
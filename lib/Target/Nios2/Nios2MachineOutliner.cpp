@@ -0,0 +1,523 @@
+//===-- Nios2MachineOutliner.cpp - Outline repeated instruction sequences -===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass replaces repeated sequences of machine instructions with calls to
+// shared thunks that end in "ret". It runs after register allocation and
+// prologue/epilogue insertion, so prologue fragments and common store
+// sequences are candidates too.
+//
+// Code generation runs function by function, so the search is incremental:
+// every straight-line run of outlinable instructions is inserted into a
+// depth-limited suffix trie that lives for the whole module. A trie node
+// spells one instruction sequence and remembers how often it was seen in the
+// functions compiled so far and, once outlined, the function of its thunk.
+// Functions placed in different sections get separate tries, so a thunk is
+// only called from the section it is emitted in.
+//
+// Each thunk is a new internal function appended to the module. Its IR body
+// is a bare "ret"; when code generation reaches it, this pass inserts the
+// outlined instructions in front of that return. The thunk is naked and runs
+// in the frame of its caller, so it gets its own symbol, section and FDE
+// like any other function. A sequence never contains a call, branch or
+// return, so every thunk returns to its caller.
+//
+// The "call" overwrites $ra, so a sequence is only outlined where the return
+// address has already been spilled by the prologue and is not yet reloaded.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Nios2.h"
+#include "Nios2InstrInfo.h"
+#include "Nios2MachineFunction.h"
+#include "Nios2Subtarget.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/CodeGen/LivePhysRegs.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <map>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "nios2-outliner"
+
+STATISTIC(NumOutlined, "Number of instruction sequences outlined");
+STATISTIC(NumThunks,   "Number of outlined thunks created");
+STATISTIC(NumInstrsSaved, "Number of instructions removed by outlining");
+
+static cl::opt<bool> EnableOutliner(
+  "nios2-enable-outliner",
+  cl::init(false),
+  cl::desc("NIOS2: Outline repeated instruction sequences in all functions "
+           "(functions marked minsize are always outlined)."),
+  cl::Hidden);
+
+static cl::opt<unsigned> OutlinerMaxLength(
+  "nios2-outliner-max-length",
+  cl::init(12),
+  cl::desc("NIOS2: Longest instruction sequence considered for outlining."),
+  cl::Hidden);
+
+namespace {
+  /// One node of the module-wide suffix trie.
+  struct TrieNode {
+    DenseMap<unsigned, unsigned> Children;
+    /// Length of the sequence spelled by the path from the root.
+    unsigned Depth;
+    /// Number of occurrences found in functions compiled earlier.
+    unsigned Count;
+    /// Function of the thunk, once the sequence has been outlined.
+    Function *Thunk;
+
+    TrieNode(unsigned D) : Depth(D), Count(0), Thunk(nullptr) {}
+  };
+
+  /// All occurrences of one trie node in the current function.
+  struct Candidate {
+    unsigned Node;
+    std::vector<unsigned> Starts;
+    int Benefit;
+  };
+
+  /// One instruction of a thunk that is not compiled yet. The function it
+  /// was taken from is gone by then, so only the opcode and the operands
+  /// are kept.
+  struct ThunkInstr {
+    unsigned Opcode;
+    SmallVector<MachineOperand, 4> Operands;
+  };
+
+  class Nios2MachineOutliner : public MachineFunctionPass {
+  public:
+    static char ID;
+    Nios2MachineOutliner() : MachineFunctionPass(ID) {}
+
+    const char *getPassName() const override {
+      return "Nios2 Machine Outliner";
+    }
+
+    bool doInitialization(Module &M) override;
+    bool runOnMachineFunction(MachineFunction &F) override;
+
+  private:
+    static const unsigned IllegalID = ~0U;
+
+    bool isOutlinable(const MachineInstr &MI) const;
+    unsigned getInstrID(const MachineInstr &MI);
+    unsigned getTrieRoot(const Function &Fn);
+    void collectInstrs(MachineFunction &F);
+    int getBenefit(const TrieNode &N, unsigned Occurrences) const;
+    Function *createThunk(const Function &Caller, unsigned Start,
+                          unsigned Len);
+    void emitThunkBody(MachineFunction &F, ArrayRef<ThunkInstr> Body);
+    void replaceWithCall(unsigned Start, unsigned Len, Function *Thunk);
+
+    const Nios2InstrInfo *TII;
+    Module *M;
+    /// Whether any function of the module may be outlined. If not, the pass
+    /// does not even build the trie.
+    bool Enabled;
+
+    /// Instruction encodings seen so far, keyed by opcode and operands.
+    std::map<std::vector<uint64_t>, unsigned> InstrIDs;
+    std::vector<TrieNode> Trie;
+    /// Root node of the trie of each section; "" is the default section.
+    StringMap<unsigned> TrieRoots;
+
+    /// Bodies of the thunks created so far whose functions have not been
+    /// compiled yet.
+    DenseMap<const Function *, std::vector<ThunkInstr> > PendingThunks;
+    unsigned NumCreated;
+
+    /// Instructions of the current function and their IDs. Block
+    /// boundaries and non-outlinable instructions get IllegalID.
+    std::vector<MachineInstr *> Instrs;
+    std::vector<unsigned> IDs;
+  };
+  char Nios2MachineOutliner::ID = 0;
+  const unsigned Nios2MachineOutliner::IllegalID;
+} // end of anonymous namespace
+
+bool Nios2MachineOutliner::doInitialization(Module &Mod) {
+  M = &Mod;
+  Enabled = EnableOutliner ||
+            any_of(Mod, [](const Function &F) { return F.optForMinSize(); });
+  InstrIDs.clear();
+  Trie.clear();
+  TrieRoots.clear();
+  PendingThunks.clear();
+  NumCreated = 0;
+  return false;
+}
+
+/// Return true if MI can be executed from a thunk instead of its original
+/// position. The thunk runs with the same $sp, so stack accesses are fine,
+/// but anything that depends on the pc or on $ra is not. The FDE of a thunk
+/// describes $sp as it was on entry, so the thunk must not move it.
+bool Nios2MachineOutliner::isOutlinable(const MachineInstr &MI) const {
+  if (MI.isDebugValue() || MI.isCFIInstruction() || MI.isLabel() ||
+      MI.isInlineAsm() || MI.isCall() || MI.isTerminator() ||
+      MI.isBranch() || MI.isReturn() || MI.isPseudo() ||
+      MI.hasUnmodeledSideEffects())
+    return false;
+
+  for (const MachineOperand &MO : MI.operands()) {
+    if (!MO.isReg())
+      continue;
+    if (MO.getReg() == Nios2::RA || MO.getReg() == Nios2::PC)
+      return false;
+    if (MO.isDef() && MO.getReg() == Nios2::SP)
+      return false;
+  }
+
+  return true;
+}
+
+/// Map MI to an ID that is stable across the functions of a module, so that
+/// identical instructions in different functions share trie edges.
+unsigned Nios2MachineOutliner::getInstrID(const MachineInstr &MI) {
+  if (!isOutlinable(MI))
+    return IllegalID;
+
+  std::vector<uint64_t> Key;
+  Key.push_back(MI.getOpcode());
+
+  for (const MachineOperand &MO : MI.operands()) {
+    Key.push_back(MO.getType());
+
+    switch (MO.getType()) {
+    case MachineOperand::MO_Register:
+      Key.push_back(MO.getReg());
+      Key.push_back(MO.isDef());
+      Key.push_back(MO.isImplicit());
+      break;
+    case MachineOperand::MO_Immediate:
+      Key.push_back(MO.getImm());
+      break;
+    case MachineOperand::MO_GlobalAddress:
+      Key.push_back(reinterpret_cast<uintptr_t>(MO.getGlobal()));
+      Key.push_back(MO.getOffset());
+      Key.push_back(MO.getTargetFlags());
+      break;
+    default:
+      // Frame indices, block references and external symbols either are
+      // function local or do not outlive the MachineFunction.
+      return IllegalID;
+    }
+  }
+
+  unsigned NextID = InstrIDs.size();
+  return InstrIDs.insert(std::make_pair(Key, NextID)).first->second;
+}
+
+/// Return the root of the trie for the section of Fn. A thunk is emitted in
+/// the section of the function that creates it, and code in another section
+/// may run where that one is not mapped, so sections never share thunks.
+unsigned Nios2MachineOutliner::getTrieRoot(const Function &Fn) {
+  auto Root = TrieRoots.insert(std::make_pair(Fn.getSection(), Trie.size()));
+  if (Root.second)
+    Trie.push_back(TrieNode(0));
+  return Root.first->second;
+}
+
+/// Fill Instrs and IDs for F. A sequence containing IllegalID is never
+/// outlined, so IllegalID is also used to separate basic blocks and to mark
+/// every point where $ra holds a live return address.
+void Nios2MachineOutliner::collectInstrs(MachineFunction &F) {
+  const TargetRegisterInfo *TRI = F.getSubtarget().getRegisterInfo();
+  LivePhysRegs LiveRegs(TRI);
+
+  Instrs.clear();
+  IDs.clear();
+
+  for (MachineBasicBlock &MBB : F) {
+    if (MBB.isEHPad())
+      continue;
+
+    // $ra is reserved and never appears in live-in lists, so walking each
+    // block backwards from an empty set is enough: it is live exactly
+    // between a reload and the "ret" that reads it, or before the spill in
+    // the prologue.
+    SmallVector<bool, 32> RALive;
+    LiveRegs.clear();
+    for (auto I = MBB.rbegin(), E = MBB.rend(); I != E; ++I) {
+      RALive.push_back(LiveRegs.contains(Nios2::RA));
+      LiveRegs.stepBackward(*I);
+    }
+
+    unsigned Idx = RALive.size();
+    for (MachineInstr &MI : MBB) {
+      Instrs.push_back(&MI);
+      IDs.push_back(RALive[--Idx] ? IllegalID : getInstrID(MI));
+    }
+
+    Instrs.push_back(nullptr);
+    IDs.push_back(IllegalID);
+  }
+}
+
+/// Estimate the number of instructions saved by outlining a sequence that
+/// occurs Occurrences times in the current function. Each call replaces Len
+/// instructions; a new thunk costs Len instructions plus the "ret". Earlier
+/// functions were compiled before the thunk existed, so their occurrences
+/// only count as a prediction of how often later functions will reuse it.
+int Nios2MachineOutliner::getBenefit(const TrieNode &N,
+                                     unsigned Occurrences) const {
+  int Len = N.Depth;
+  int Saved = Occurrences * (Len - 1);
+
+  if (N.Thunk)
+    return Saved;
+
+  return (Occurrences + N.Count) * (Len - 1) - (Len + 1);
+}
+
+/// Create the function of a thunk for Instrs[Start, Start + Len). It is
+/// appended to the module, so code generation reaches it after all of its
+/// callers, and its body is only filled in then.
+Function *Nios2MachineOutliner::createThunk(const Function &Caller,
+                                            unsigned Start, unsigned Len) {
+  LLVMContext &Ctx = M->getContext();
+  Function *Thunk =
+    Function::Create(FunctionType::get(Type::getVoidTy(Ctx), false),
+                     GlobalValue::InternalLinkage,
+                     "OUTLINED_FUNCTION_" + Twine(NumCreated++), M);
+  ReturnInst::Create(Ctx, BasicBlock::Create(Ctx, "entry", Thunk));
+
+  if (Caller.hasSection())
+    Thunk->setSection(Caller.getSection());
+
+  // The thunk must not get a frame of its own: it reaches the locals of its
+  // caller through $sp.
+  Thunk->addFnAttr(Attribute::Naked);
+  Thunk->addFnAttr(Attribute::NoInline);
+  Thunk->addFnAttr(Attribute::NoUnwind);
+  Thunk->addFnAttr(Attribute::MinSize);
+  Thunk->addFnAttr(Attribute::OptimizeForSize);
+
+  std::vector<ThunkInstr> &Body = PendingThunks[Thunk];
+  for (unsigned I = Start; I != Start + Len; ++I) {
+    ThunkInstr TI;
+    TI.Opcode = Instrs[I]->getOpcode();
+    TI.Operands.append(Instrs[I]->operands_begin(), Instrs[I]->operands_end());
+    Body.push_back(TI);
+  }
+
+  ++NumThunks;
+  return Thunk;
+}
+
+/// Insert the outlined instructions in front of the return that instruction
+/// selection produced for the body of a thunk. Debug locations are dropped:
+/// they belong to the scope of another function.
+void Nios2MachineOutliner::emitThunkBody(MachineFunction &F,
+                                         ArrayRef<ThunkInstr> Body) {
+  const MachineRegisterInfo &MRI = F.getRegInfo();
+  const TargetRegisterInfo *TRI = F.getSubtarget().getRegisterInfo();
+  MachineBasicBlock &MBB = F.front();
+  MachineBasicBlock::iterator Ret = MBB.getFirstTerminator();
+  assert(Ret != MBB.end() && Ret->isReturn() && "Thunk must end in a return");
+
+  // Registers read before the thunk writes them are live on entry.
+  BitVector Defined(TRI->getNumRegs());
+
+  for (const ThunkInstr &TI : Body) {
+    MachineInstr *MI = F.CreateMachineInstr(TII->get(TI.Opcode), DebugLoc(),
+                                            /*NoImp=*/true);
+    MBB.insert(Ret, MI);
+
+    for (const MachineOperand &MO : TI.Operands) {
+      MI->addOperand(F, MO);
+
+      if (!MO.isReg() || !MO.getReg() || MRI.isReserved(MO.getReg()))
+        continue;
+      if (MO.isDef())
+        Defined.set(MO.getReg());
+      else if (!Defined.test(MO.getReg()) && !MBB.isLiveIn(MO.getReg()))
+        MBB.addLiveIn(MO.getReg());
+    }
+  }
+}
+
+/// Replace Instrs[Start, Start + Len) with a call to Thunk. The call carries
+/// the registers of the sequence as implicit operands so that liveness stays
+/// accurate for the passes that still follow.
+void Nios2MachineOutliner::replaceWithCall(unsigned Start, unsigned Len,
+                                           Function *Thunk) {
+  MachineInstr *First = Instrs[Start];
+  MachineBasicBlock &MBB = *First->getParent();
+  MachineInstrBuilder MIB =
+    BuildMI(MBB, First, First->getDebugLoc(), TII->get(Nios2::CALL))
+      .addGlobalAddress(Thunk);
+
+  SmallVector<unsigned, 8> Defs, Uses;
+  for (unsigned I = Start; I != Start + Len; ++I)
+    for (const MachineOperand &MO : Instrs[I]->operands()) {
+      if (!MO.isReg() || !MO.getReg())
+        continue;
+      SmallVectorImpl<unsigned> &Regs = MO.isDef() ? Defs : Uses;
+      if (std::find(Regs.begin(), Regs.end(), MO.getReg()) == Regs.end())
+        Regs.push_back(MO.getReg());
+    }
+
+  for (unsigned Reg : Uses)
+    MIB.addReg(Reg, RegState::Implicit);
+  for (unsigned Reg : Defs)
+    MIB.addReg(Reg, RegState::ImplicitDefine);
+
+  for (unsigned I = Start; I != Start + Len; ++I)
+    Instrs[I]->eraseFromParent();
+
+  ++NumOutlined;
+  NumInstrsSaved += Len - 1;
+}
+
+bool Nios2MachineOutliner::runOnMachineFunction(MachineFunction &F) {
+  if (!Enabled)
+    return false;
+
+  TII = static_cast<const Nios2InstrInfo *>(F.getSubtarget().getInstrInfo());
+  const Function &Fn = *F.getFunction();
+
+  auto Pending = PendingThunks.find(&Fn);
+  if (Pending != PendingThunks.end()) {
+    emitThunkBody(F, Pending->second);
+    PendingThunks.erase(Pending);
+    return true;
+  }
+
+  // Every call to a thunk clobbers $ra, which is only safe once the
+  // prologue has saved it.
+  const MachineFrameInfo *MFI = F.getFrameInfo();
+  const std::vector<CalleeSavedInfo> &CSI = MFI->getCalleeSavedInfo();
+  bool SavesRA = false;
+  for (const CalleeSavedInfo &Info : CSI)
+    SavesRA |= Info.getReg() == Nios2::RA;
+
+  if (MFI->getSavePoint() && MFI->getSavePoint() != &F.front())
+    SavesRA = false;
+  if (MFI->getRestorePoint() && !MFI->getRestorePoint()->isReturnBlock())
+    SavesRA = false;
+
+  bool Transform = SavesRA && (EnableOutliner || Fn.optForMinSize());
+
+  collectInstrs(F);
+  unsigned Root = getTrieRoot(Fn);
+
+  // Walk every suffix of every outlinable run down the trie, creating the
+  // missing nodes, and record where each sequence of two or more
+  // instructions starts.
+  std::map<unsigned, Candidate> Candidates;
+  for (unsigned Start = 0, E = IDs.size(); Start != E; ++Start) {
+    unsigned Node = Root;
+
+    for (unsigned I = Start;
+         I != E && IDs[I] != IllegalID && I - Start < OutlinerMaxLength; ++I) {
+      unsigned Child = Trie[Node].Children.lookup(IDs[I]);
+      if (!Child) {
+        Child = Trie.size();
+        Trie[Node].Children[IDs[I]] = Child;
+        Trie.push_back(TrieNode(I - Start + 1));
+      }
+      Node = Child;
+
+      if (Trie[Node].Depth >= 2) {
+        Candidate &C = Candidates[Node];
+        C.Node = Node;
+        C.Starts.push_back(Start);
+      }
+    }
+  }
+
+  bool Changed = false;
+
+  if (Transform) {
+    std::vector<Candidate *> Worklist;
+    for (auto &KV : Candidates) {
+      Candidate &C = KV.second;
+      C.Benefit = getBenefit(Trie[C.Node], C.Starts.size());
+      if (C.Benefit > 0)
+        Worklist.push_back(&C);
+    }
+
+    std::stable_sort(Worklist.begin(), Worklist.end(),
+                     [this](const Candidate *A, const Candidate *B) {
+      if (A->Benefit != B->Benefit)
+        return A->Benefit > B->Benefit;
+      return Trie[A->Node].Depth > Trie[B->Node].Depth;
+    });
+
+    std::vector<bool> Taken(IDs.size(), false);
+    std::vector<std::pair<unsigned, unsigned> > Selected;
+
+    for (Candidate *C : Worklist) {
+      TrieNode &N = Trie[C->Node];
+
+      // Drop occurrences that overlap a sequence chosen earlier, including
+      // overlapping occurrences of this very sequence.
+      std::vector<unsigned> Starts;
+      for (unsigned S : C->Starts)
+        if (std::find(Taken.begin() + S, Taken.begin() + S + N.Depth, true) ==
+            Taken.begin() + S + N.Depth) {
+          std::fill(Taken.begin() + S, Taken.begin() + S + N.Depth, true);
+          Starts.push_back(S);
+        }
+
+      if (Starts.empty())
+        continue;
+
+      if (getBenefit(N, Starts.size()) <= 0) {
+        for (unsigned S : Starts)
+          std::fill(Taken.begin() + S, Taken.begin() + S + N.Depth, false);
+        continue;
+      }
+
+      if (!N.Thunk)
+        N.Thunk = createThunk(Fn, Starts.front(), N.Depth);
+
+      // Unwinding through the thunk needs an FDE if it does for any caller.
+      if (Fn.needsUnwindTableEntry())
+        N.Thunk->addFnAttr(Attribute::UWTable);
+
+      for (unsigned S : Starts)
+        Selected.push_back(std::make_pair(S, C->Node));
+    }
+
+    for (auto &Sel : Selected) {
+      DEBUG(dbgs() << "Outlining " << Trie[Sel.second].Depth
+                   << " instructions in " << F.getName() << " at "
+                   << *Instrs[Sel.first]);
+      replaceWithCall(Sel.first, Trie[Sel.second].Depth,
+                      Trie[Sel.second].Thunk);
+      Changed = true;
+    }
+  }
+
+  // The occurrences of this function become the history for the next ones.
+  for (auto &KV : Candidates)
+    Trie[KV.first].Count += KV.second.Starts.size();
+
+  return Changed;
+}
+
+/// createNios2MachineOutliner - Returns a pass that outlines repeated
+/// instruction sequences into shared thunks.
+FunctionPass *llvm::createNios2MachineOutliner(Nios2TargetMachine &TM) {
+  return new Nios2MachineOutliner();
+}
@@ -13,6 +13,7 @@
 
 #include "Nios2RegisterInfo.h"
 #include "Nios2.h"
+#include "Nios2FrameLowering.h"
 #include "Nios2InstrInfo.h"
 #include "Nios2Subtarget.h"
 #include "Nios2MachineFunction.h"
@@ -25,6 +26,7 @@
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
@@ -45,6 +47,8 @@ Nios2RegisterInfo::Nios2RegisterInfo(): Nios2GenRegisterInfo(Nios2::RA) {}
 
 unsigned Nios2RegisterInfo::getPICCallReg() { return Nios2::GP; }
 
+unsigned Nios2RegisterInfo::getBaseRegister() { return Nios2::R23; }
+
 //===----------------------------------------------------------------------===//
 // Callee Saved Registers methods
 //===----------------------------------------------------------------------===//
@@ -78,13 +82,30 @@ getReservedRegs(const MachineFunction &MF) const {
   for (unsigned I = 0; I < array_lengthof(ReservedCPURegs); ++I)
     Reserved.set(ReservedCPURegs[I]);
 
+  const Nios2FrameLowering *TFI =
+    static_cast<const Nios2FrameLowering *>(
+      MF.getSubtarget().getFrameLowering());
+
   // Reserve FP if this function should have a dedicated frame pointer register.
-  if (MF.getSubtarget().getFrameLowering()->hasFP(MF))
+  if (TFI->hasFP(MF))
     Reserved.set(Nios2::FP);
 
+  // Reserve the base pointer if the stack is realigned around variable sized
+  // objects.
+  if (TFI->hasBP(MF))
+    Reserved.set(getBaseRegister());
+
   return Reserved;
 }
 
+/// getPointerRegClass - Frame base registers created by
+/// LocalStackSlotAllocation are ordinary CPU registers.
+const TargetRegisterClass *
+Nios2RegisterInfo::getPointerRegClass(const MachineFunction &MF,
+                                      unsigned Kind) const {
+  return &Nios2::CPURegsRegClass;
+}
+
 bool
 Nios2RegisterInfo::requiresRegisterScavenging(const MachineFunction &MF) const {
   return true;
@@ -95,6 +116,85 @@ Nios2RegisterInfo::trackLivenessAfterRegAlloc(const MachineFunction &MF) const {
   return true;
 }
 
+bool Nios2RegisterInfo::
+requiresFrameIndexScavenging(const MachineFunction &MF) const {
+  return true;
+}
+
+bool Nios2RegisterInfo::
+requiresVirtualBaseRegisters(const MachineFunction &MF) const {
+  return true;
+}
+
+/// Return the immediate added to the frame index operand Idx of MI. Every
+/// instruction that takes a frame index encodes it as (FI, imm).
+int64_t Nios2RegisterInfo::
+getFrameIndexInstrOffset(const MachineInstr *MI, int Idx) const {
+  return MI->getOperand(Idx + 1).getImm();
+}
+
+/// needsFrameBaseReg - Return true if the final offset of the local at
+/// Offset in the local block probably won't fit the 16-bit immediate of MI,
+/// so that LocalStackSlotAllocation should address it through a virtual base
+/// register shared with the neighbouring locals.
+bool Nios2RegisterInfo::
+needsFrameBaseReg(MachineInstr *MI, int64_t Offset) const {
+  if (!MI->mayLoad() && !MI->mayStore() && MI->getOpcode() != Nios2::ADDi)
+    return false;
+
+  unsigned Idx = 0;
+  while (!MI->getOperand(Idx).isFI())
+    ++Idx;
+
+  // Locals are addressed upwards from the bottom of the frame. Offset is
+  // relative to the top of the local block; below it there will be the
+  // spill slots and the outgoing arguments. The spill slots are only known
+  // after register allocation, so assume room for 32 of them, as ARM does.
+  const int64_t SpillAreaEstimate = 32 * 4;
+  const MachineFunction &MF = *MI->getParent()->getParent();
+  const MachineFrameInfo *MFI = MF.getFrameInfo();
+  const Nios2FunctionInfo *Nios2FI = MF.getInfo<Nios2FunctionInfo>();
+  int64_t FrameOffset = Offset + MFI->getLocalFrameSize() + SpillAreaEstimate +
+                        Nios2FI->getMaxCallFrameSize();
+
+  return !isInt<16>(FrameOffset + getFrameIndexInstrOffset(MI, Idx));
+}
+
+/// Insert "addi $BaseReg, FrameIdx, Offset" at the start of MBB.
+void Nios2RegisterInfo::
+materializeFrameBaseRegister(MachineBasicBlock *MBB, unsigned BaseReg,
+                             int FrameIdx, int64_t Offset) const {
+  MachineBasicBlock::iterator I = MBB->begin();
+  DebugLoc DL = I != MBB->end() ? I->getDebugLoc() : DebugLoc();
+  const TargetInstrInfo &TII = *MBB->getParent()->getSubtarget().getInstrInfo();
+
+  BuildMI(*MBB, I, DL, TII.get(Nios2::ADDi), BaseReg).addFrameIndex(FrameIdx)
+    .addImm(Offset);
+}
+
+void Nios2RegisterInfo::
+resolveFrameIndex(MachineInstr &MI, unsigned BaseReg, int64_t Offset) const {
+  unsigned Idx = 0;
+  while (!MI.getOperand(Idx).isFI())
+    ++Idx;
+
+  Offset += MI.getOperand(Idx + 1).getImm();
+  assert(isInt<16>(Offset) && "Frame base register out of range!");
+
+  MI.getOperand(Idx).ChangeToRegister(BaseReg, false);
+  MI.getOperand(Idx + 1).ChangeToImmediate(Offset);
+}
+
+bool Nios2RegisterInfo::
+isFrameOffsetLegal(const MachineInstr *MI, unsigned BaseReg,
+                   int64_t Offset) const {
+  unsigned Idx = 0;
+  while (!MI->getOperand(Idx).isFI())
+    ++Idx;
+
+  return isInt<16>(Offset + MI->getOperand(Idx + 1).getImm());
+}
+
 // FrameIndex represent objects inside a abstract stack.
 // We must replace FrameIndex with an stack/frame pointer
 // direct reference.
@@ -142,12 +242,25 @@ void Nios2RegisterInfo::eliminateFI(MachineBasicBlock::iterator II,
   //  3. Locations for callee-saved registers.
   // Everything else is referenced relative to whatever register
   // getFrameRegister() returns.
+  // When the stack is realigned, $sp (or the base pointer, if there are
+  // variable sized objects) is aligned for the locals, while $fp holds the
+  // unaligned value that $sp had when the callee-saved registers were spilled.
+  // The spills run before $fp is set and the reloads after $sp is restored
+  // from it, so they still use $sp.
   unsigned FrameReg;
+  bool IsCSFI = FrameIndex >= MinCSFI && FrameIndex <= MaxCSFI;
+  const Nios2FrameLowering *TFI =
+    static_cast<const Nios2FrameLowering *>(
+      MF.getSubtarget().getFrameLowering());
 
-  if (Nios2FI->isOutArgFI(FrameIndex) ||
-      (FrameIndex >= MinCSFI && FrameIndex <= MaxCSFI))
+  if (Nios2FI->isOutArgFI(FrameIndex) || IsCSFI)
     FrameReg = Nios2::SP;
-  else
+  else if (needsStackRealignment(MF)) {
+    if (MFI->isFixedObjectIndex(FrameIndex))
+      FrameReg = Nios2::FP;
+    else
+      FrameReg = TFI->hasBP(MF) ? getBaseRegister() : Nios2::SP;
+  } else
     FrameReg = getFrameRegister(MF);
 
   // Calculate final offset.
@@ -169,26 +282,36 @@ void Nios2RegisterInfo::eliminateFI(MachineBasicBlock::iterator II,
   DEBUG(errs() << "Offset     : " << Offset << "\n" << "<--------->\n");
 
   // If MI is not a debug value, make sure Offset fits in the 16-bit immediate
-  // field.
+  // field. Add the high part of the offset to the frame register in a
+  // scratch register and leave the low part in MI. LocalStackSlotAllocation
+  // already gave most out of range locals a shared base register, so this
+  // only remains for the accesses it could not cover.
+  bool IsKill = false;
+
   if (!MI.isDebugValue() && !isInt<16>(Offset)) {
     MachineBasicBlock &MBB = *MI.getParent();
     DebugLoc DL = II->getDebugLoc();
-    unsigned ATReg = Nios2::AT;
-    unsigned NewImm;
-
-    Nios2FI->setEmitNOAT();
-    const Nios2InstrInfo &TII =
-      *static_cast<const Nios2InstrInfo *>(
-        MBB.getParent()->getSubtarget().getInstrInfo());
-    unsigned Reg = TII.loadImmediate(Offset, MBB, II, DL, &NewImm);
-    BuildMI(MBB, II, DL, TII.get(Nios2::ADD), ATReg).addReg(FrameReg)
-      .addReg(Reg);
-
-    FrameReg = ATReg;
-    Offset = SignExtend64<16>(NewImm);
+    const TargetInstrInfo &TII = *MF.getSubtarget().getInstrInfo();
+
+    // An "addi" that computes a frame address can build it in its own
+    // destination; everything else gets a register from the scavenger.
+    unsigned Reg;
+    if (MI.getOpcode() == Nios2::ADDi)
+      Reg = MI.getOperand(0).getReg();
+    else
+      Reg = MF.getRegInfo().createVirtualRegister(&Nios2::CPURegsRegClass);
+
+    BuildMI(MBB, II, DL, TII.get(Nios2::ORhi), Reg).addReg(Nios2::ZERO)
+      .addImm(((Offset + 0x8000) >> 16) & 0xffff);
+    BuildMI(MBB, II, DL, TII.get(Nios2::ADD), Reg).addReg(Reg)
+      .addReg(FrameReg);
+
+    FrameReg = Reg;
+    IsKill = true;
+    Offset = SignExtend64<16>(Offset & 0xffff);
   }
 
-  MI.getOperand(OpNo).ChangeToRegister(FrameReg, false);
+  MI.getOperand(OpNo).ChangeToRegister(FrameReg, false, false, IsKill);
   MI.getOperand(OpNo + 1).ChangeToImmediate(Offset);
 }
 
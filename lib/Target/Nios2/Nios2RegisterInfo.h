@@ -32,6 +32,10 @@ public:
   /// Get PIC indirect call register
   static unsigned getPICCallReg();
 
+  /// Get the register that addresses locals when the stack is realigned
+  /// and has variable sized objects.
+  static unsigned getBaseRegister();
+
   /// Adjust the Nios2 stack frame.
   void adjustNios2StackFrame(MachineFunction &MF) const;
 
@@ -42,10 +46,29 @@ public:
 
   BitVector getReservedRegs(const MachineFunction &MF) const;
 
+  const TargetRegisterClass *
+  getPointerRegClass(const MachineFunction &MF,
+                     unsigned Kind = 0) const override;
+
   virtual bool requiresRegisterScavenging(const MachineFunction &MF) const;
 
   virtual bool trackLivenessAfterRegAlloc(const MachineFunction &MF) const;
 
+  bool requiresFrameIndexScavenging(const MachineFunction &MF) const override;
+
+  /// Frame base registers for locals out of reach of the 16-bit offset.
+  bool requiresVirtualBaseRegisters(const MachineFunction &MF) const override;
+  int64_t getFrameIndexInstrOffset(const MachineInstr *MI,
+                                   int Idx) const override;
+  bool needsFrameBaseReg(MachineInstr *MI, int64_t Offset) const override;
+  void materializeFrameBaseRegister(MachineBasicBlock *MBB, unsigned BaseReg,
+                                    int FrameIdx,
+                                    int64_t Offset) const override;
+  void resolveFrameIndex(MachineInstr &MI, unsigned BaseReg,
+                         int64_t Offset) const override;
+  bool isFrameOffsetLegal(const MachineInstr *MI, unsigned BaseReg,
+                          int64_t Offset) const override;
+
   /// Stack Frame Processing Methods
   virtual void eliminateFrameIndex(MachineBasicBlock::iterator II,
                            int SPAdj, unsigned FIOperandNum,
@@ -16,11 +16,18 @@
 #include "Nios2FrameLowering.h"
 #include "Nios2InstrInfo.h"
 #include "Nios2TargetObjectFile.h"
+#include "Nios2TargetTransformInfo.h"
 #include "llvm/CodeGen/Passes.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Transforms/Scalar.h"
 using namespace llvm;
 
+static cl::opt<cl::boolOrDefault>
+EnableGlobalMerge("nios2-global-merge", cl::Hidden,
+                  cl::desc("Enable the global merge pass"));
+
 extern "C" void LLVMInitializeNios2Target() {
   // Register the target.
   RegisterTargetMachine<Nios2StdTargetMachine> X(TheNios2StdTarget);
@@ -38,6 +45,8 @@ Nios2TargetMachine(const Target &T, const Triple &TT, StringRef CPU, StringRef F
   initAsmInfo();
 }
 
+Nios2TargetMachine::~Nios2TargetMachine() {}
+
 void Nios2StdTargetMachine::anchor() { }
 
 Nios2StdTargetMachine::
@@ -63,7 +72,10 @@ public:
     return *getNios2TargetMachine().getSubtargetImpl();
   }
 
+  bool addPreISel() override;
   bool addInstSelector() override;
+  void addPreRegAlloc() override;
+  void addPreEmitPass() override;
 };
 } // namespace
 
@@ -71,6 +83,28 @@ TargetPassConfig *Nios2TargetMachine::createPassConfig(PassManagerBase &PM) {
   return new Nios2PassConfig(this, PM);
 }
 
+TargetIRAnalysis Nios2TargetMachine::getTargetIRAnalysis() {
+  return TargetIRAnalysis([this](const Function &F) {
+    return TargetTransformInfo(Nios2TTIImpl(this, F));
+  });
+}
+
+// Merge globals so that accesses to different variables can share one %hiadj
+// base. Offsets from that base must fit the signed 16-bit immediate of the
+// load/store instructions. Merging external globals changes the symbols other
+// modules and the linker see, so it is only done with -nios2-global-merge.
+bool Nios2PassConfig::addPreISel() {
+  bool OnlyOptimizeForSize = false;
+  bool MergeExternalByDefault = EnableGlobalMerge == cl::BOU_TRUE;
+  if ((TM->getOptLevel() != CodeGenOpt::None &&
+       EnableGlobalMerge == cl::BOU_UNSET) ||
+      EnableGlobalMerge == cl::BOU_TRUE)
+    addPass(createGlobalMergePass(TM, 32767, OnlyOptimizeForSize,
+                                  MergeExternalByDefault));
+
+  return false;
+}
+
 // Install an instruction selector pass using
 // the ISelDag to gen Nios2 code.
 bool Nios2PassConfig::addInstSelector() {
@@ -78,3 +112,16 @@ bool Nios2PassConfig::addInstSelector() {
   return false;
 }
 
+void Nios2PassConfig::addPreRegAlloc() {
+  if (getOptLevel() != CodeGenOpt::None)
+    addPass(createNios2HiBaseReuse(getNios2TargetMachine()));
+}
+
+// Outline repeated instruction sequences once the final layout is known. The
+// outliner only changes minsize functions, unless -nios2-enable-outliner is
+// given, and is not worth its compile time at -O0.
+void Nios2PassConfig::addPreEmitPass() {
+  if (getOptLevel() != CodeGenOpt::None)
+    addPass(createNios2MachineOutliner(getNios2TargetMachine()));
+}
+
@@ -21,6 +21,14 @@ public:
   void Initialize(MCContext &Ctx, const TargetMachine &TM) override {
     TargetLoweringObjectFileELF::Initialize(Ctx, TM);
   }
+
+  /// The label differences of a PIC jump table have to be resolved by the
+  /// assembler, since Nios2 has no 32-bit PC-relative data relocation. Keep
+  /// such tables in the section of their function.
+  bool shouldPutJumpTableInFunctionSection(bool UsesLabelDifference,
+                                           const Function &F) const override {
+    return UsesLabelDifference;
+  }
 };
 } // end namespace llvm
 
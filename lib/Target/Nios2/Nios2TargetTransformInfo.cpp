@@ -0,0 +1,116 @@
+//===-- Nios2TargetTransformInfo.cpp - Nios2 specific TTI -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Nios2TargetTransformInfo.h"
+#include "MCTargetDesc/Nios2BaseInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/CodeGen/BasicTTIImpl.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Target/TargetLowering.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "nios2tti"
+
+static cl::opt<bool> DisableNios2ConstHoist("disable-nios2-constant-hoisting",
+  cl::desc("NIOS2: Disable constant hoisting."), cl::init(false), cl::Hidden);
+
+//===----------------------------------------------------------------------===//
+//
+// Nios2 cost model.
+//
+//===----------------------------------------------------------------------===//
+
+/// The cost of building Imm in a register: one instruction per element of
+/// its materialization sequence, for each 32-bit half of wider types.
+int Nios2TTIImpl::getIntImmCost(const APInt &Imm, Type *Ty) {
+  if (DisableNios2ConstHoist)
+    return BaseT::getIntImmCost(Imm, Ty);
+
+  assert(Ty->isIntegerTy());
+
+  unsigned BitSize = Ty->getPrimitiveSizeInBits();
+  if (BitSize == 0 || BitSize > 64)
+    return ~0U;
+
+  int64_t Val = Imm.sextOrTrunc(64).getSExtValue();
+  Nios2ImmInst Seq[2];
+  int Cost = 0;
+
+  if (Val)
+    Cost += getNios2ImmSeq(int32_t(Val), Seq);
+  if (BitSize > 32 && (Val >> 32))
+    Cost += getNios2ImmSeq(int32_t(Val >> 32), Seq);
+
+  return Cost * TTI::TCC_Basic;
+}
+
+/// Immediates that fit the 16-bit field of the instruction using them are
+/// free; anything else costs what it takes to build it.
+int Nios2TTIImpl::getIntImmCost(unsigned Opcode, unsigned Idx,
+                                const APInt &Imm, Type *Ty) {
+  if (DisableNios2ConstHoist)
+    return BaseT::getIntImmCost(Opcode, Idx, Imm, Ty);
+
+  assert(Ty->isIntegerTy());
+
+  unsigned BitSize = Ty->getPrimitiveSizeInBits();
+  if (BitSize == 0)
+    return ~0U;
+
+  // $zero is free everywhere.
+  if (Imm == 0)
+    return TTI::TCC_Free;
+
+  if (Idx == 1 && BitSize <= 32) {
+    int64_t Val = Imm.getSExtValue();
+    uint32_t UVal = Imm.getZExtValue();
+
+    switch (Opcode) {
+    default:
+      break;
+    case Instruction::Add:
+    case Instruction::Mul:
+    case Instruction::ICmp:
+      if (isInt<16>(Val))
+        return TTI::TCC_Free;
+      break;
+    case Instruction::Sub:
+      if (isInt<16>(-Val))
+        return TTI::TCC_Free;
+      break;
+    case Instruction::And:
+    case Instruction::Or:
+    case Instruction::Xor:
+      // andi/ori/xori and their "hi" forms.
+      if (isUInt<16>(UVal) || !(UVal & 0xffff))
+        return TTI::TCC_Free;
+      break;
+    case Instruction::Shl:
+    case Instruction::LShr:
+    case Instruction::AShr:
+      return TTI::TCC_Free;
+    }
+  }
+
+  switch (Opcode) {
+  default:
+    return TTI::TCC_Free;
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::ICmp:
+  case Instruction::Store:
+  case Instruction::Select:
+  case Instruction::Ret:
+    return Nios2TTIImpl::getIntImmCost(Imm, Ty);
+  }
+}
@@ -0,0 +1,62 @@
+//===-- Nios2TargetTransformInfo.h - Nios2 specific TTI ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+/// \file
+/// This file a TargetTransformInfo::Concept conforming object specific to the
+/// Nios2 target machine. It describes what immediates cost, so that constant
+/// hoisting keeps 32-bit constants that need an orhi/ori pair out of loops.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_TARGET_NIOS2_NIOS2TARGETTRANSFORMINFO_H
+#define LLVM_LIB_TARGET_NIOS2_NIOS2TARGETTRANSFORMINFO_H
+
+#include "Nios2.h"
+#include "Nios2TargetMachine.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/CodeGen/BasicTTIImpl.h"
+#include "llvm/Target/TargetLowering.h"
+
+namespace llvm {
+
+class Nios2TTIImpl : public BasicTTIImplBase<Nios2TTIImpl> {
+  typedef BasicTTIImplBase<Nios2TTIImpl> BaseT;
+  typedef TargetTransformInfo TTI;
+  friend BaseT;
+
+  const Nios2Subtarget *ST;
+  const Nios2TargetLowering *TLI;
+
+  const Nios2Subtarget *getST() const { return ST; }
+  const Nios2TargetLowering *getTLI() const { return TLI; }
+
+public:
+  explicit Nios2TTIImpl(const Nios2TargetMachine *TM, const Function &F)
+      : BaseT(TM, F.getParent()->getDataLayout()), ST(TM->getSubtargetImpl(F)),
+        TLI(ST->getTargetLowering()) {}
+
+  // Provide value semantics. MSVC requires that we spell all of these out.
+  Nios2TTIImpl(const Nios2TTIImpl &Arg)
+      : BaseT(static_cast<const BaseT &>(Arg)), ST(Arg.ST), TLI(Arg.TLI) {}
+  Nios2TTIImpl(Nios2TTIImpl &&Arg)
+      : BaseT(std::move(static_cast<BaseT &>(Arg))), ST(std::move(Arg.ST)),
+        TLI(std::move(Arg.TLI)) {}
+
+  /// \name Scalar TTI Implementations
+  /// @{
+
+  using BaseT::getIntImmCost;
+  int getIntImmCost(const APInt &Imm, Type *Ty);
+  int getIntImmCost(unsigned Opcode, unsigned Idx, const APInt &Imm, Type *Ty);
+
+  /// @}
+};
+
+} // end namespace llvm
+
+#endif
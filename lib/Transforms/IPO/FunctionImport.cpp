@@ -70,8 +70,9 @@ public:
       std::unique_ptr<Module>(StringRef FileName)> createLazyModule)
       : createLazyModule(createLazyModule) {}
 
-  /// Retrieve a Module from the cache or lazily load it on demand.
-  Module &operator()(StringRef FileName);
+  /// Retrieve a Module from the cache or lazily load it on demand. Returns
+  /// nullptr if the module cannot be loaded; the failure is cached too.
+  Module *operator()(StringRef FileName);
 
   std::unique_ptr<Module> takeModule(StringRef FileName) {
     auto I = ModuleMap.find(FileName);
@@ -83,11 +84,13 @@ public:
 };
 
 // Get a Module for \p FileName from the cache, or load it lazily.
-Module &ModuleLazyLoaderCache::operator()(StringRef Identifier) {
+Module *ModuleLazyLoaderCache::operator()(StringRef Identifier) {
+  auto I = ModuleMap.find(Identifier);
+  if (I != ModuleMap.end())
+    return I->second.get();
   auto &Module = ModuleMap[Identifier];
-  if (!Module)
-    Module = createLazyModule(Identifier);
-  return *Module;
+  Module = createLazyModule(Identifier);
+  return Module.get();
 }
 } // anonymous namespace
 
@@ -206,7 +209,14 @@ static void GetImportList(Module &DestModule,
     DEBUG(dbgs() << DestModule.getModuleIdentifier() << ": Importing "
                  << CalledFunctionName << " from " << ModuleIdentifier << "\n");
 
-    auto &SrcModule = ModuleLoaderCache(ModuleIdentifier);
+    Module *SrcModulePtr = ModuleLoaderCache(ModuleIdentifier);
+    if (!SrcModulePtr) {
+      DEBUG(dbgs() << DestModule.getModuleIdentifier() << ": Skip import of "
+                   << CalledFunctionName << ", can't load "
+                   << ModuleIdentifier << "\n");
+      continue;
+    }
+    Module &SrcModule = *SrcModulePtr;
 
     // The function that we will import!
     GlobalValue *SGV = SrcModule.getNamedValue(CalledFunctionName);
@@ -325,8 +335,12 @@ bool FunctionImporter::importFunctions(Module &DestModule) {
   // Now link in metadata for all modules from which we imported functions.
   for (StringMapEntry<std::unique_ptr<DenseMap<unsigned, MDNode *>>> &SME :
        ModuleToTempMDValsMap) {
-    // Load the specified source module.
-    auto &SrcModule = ModuleLoaderCache(SME.getKey());
+    // Load the specified source module. The copy loaded for the import was
+    // handed to the linker, so it is loaded again and that can fail.
+    Module *SrcModulePtr = ModuleLoaderCache(SME.getKey());
+    if (!SrcModulePtr)
+      return false;
+    Module &SrcModule = *SrcModulePtr;
     // The modules were created with lazy metadata loading. Materialize it
     // now, before linking it.
     SrcModule.materializeMetadata();
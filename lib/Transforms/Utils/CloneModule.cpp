@@ -13,11 +13,17 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 #include "llvm-c/Core.h"
+#include <algorithm>
 using namespace llvm;
 
 /// This is not as easy as it might seem because we have to worry about making
@@ -167,6 +173,517 @@ std::unique_ptr<Module> llvm::CloneModule(
   return New;
 }
 
+namespace {
+/// Maps the types of a module into another context, keeping the names and
+/// bodies of identified structs.
+class ContextTypeMapper : public ValueMapTypeRemapper {
+  LLVMContext &Ctx;
+  /// If set, identified structs map to the types of the same name in the
+  /// context of this module, when it has one.
+  const Module *NamedTypes;
+  DenseMap<Type *, Type *> MappedTypes;
+
+public:
+  ContextTypeMapper(LLVMContext &Ctx, const Module *NamedTypes = nullptr)
+      : Ctx(Ctx), NamedTypes(NamedTypes) {}
+
+  /// Map SrcTy, and the types it is made of, to the existing type DstTy.
+  void addMapping(Type *SrcTy, Type *DstTy);
+
+  Type *remapType(Type *SrcTy) override;
+  LLVMContext *getDestinationContext() override { return &Ctx; }
+};
+}
+
+void ContextTypeMapper::addMapping(Type *SrcTy, Type *DstTy) {
+  if (&SrcTy->getContext() == &Ctx ||
+      SrcTy->getTypeID() != DstTy->getTypeID() ||
+      SrcTy->getNumContainedTypes() != DstTy->getNumContainedTypes() ||
+      !MappedTypes.insert(std::make_pair(SrcTy, DstTy)).second)
+    return;
+  for (unsigned I = 0, E = SrcTy->getNumContainedTypes(); I != E; ++I)
+    addMapping(SrcTy->getContainedType(I), DstTy->getContainedType(I));
+}
+
+Type *ContextTypeMapper::remapType(Type *SrcTy) {
+  if (&SrcTy->getContext() == &Ctx)
+    return SrcTy;
+  if (Type *Ty = MappedTypes.lookup(SrcTy))
+    return Ty;
+
+  Type *Ty;
+  switch (SrcTy->getTypeID()) {
+  default:
+    Ty = Type::getPrimitiveType(Ctx, SrcTy->getTypeID());
+    break;
+  case Type::IntegerTyID:
+    Ty = IntegerType::get(Ctx, SrcTy->getIntegerBitWidth());
+    break;
+  case Type::FunctionTyID: {
+    FunctionType *FTy = cast<FunctionType>(SrcTy);
+    SmallVector<Type *, 8> Params;
+    for (Type *Param : FTy->params())
+      Params.push_back(remapType(Param));
+    Ty = FunctionType::get(remapType(FTy->getReturnType()), Params,
+                           FTy->isVarArg());
+    break;
+  }
+  case Type::StructTyID: {
+    StructType *STy = cast<StructType>(SrcTy);
+    SmallVector<Type *, 8> Elements;
+    if (STy->isLiteral()) {
+      for (Type *Element : STy->elements())
+        Elements.push_back(remapType(Element));
+      Ty = StructType::get(Ctx, Elements, STy->isPacked());
+      break;
+    }
+    if (NamedTypes && STy->hasName())
+      if (StructType *Existing = NamedTypes->getTypeByName(STy->getName()))
+        return MappedTypes[SrcTy] = Existing;
+    // Map an identified struct before its body, which may refer to it.
+    StructType *NewSTy = StructType::create(Ctx, STy->getName());
+    MappedTypes[SrcTy] = NewSTy;
+    if (!STy->isOpaque()) {
+      for (Type *Element : STy->elements())
+        Elements.push_back(remapType(Element));
+      NewSTy->setBody(Elements, STy->isPacked());
+    }
+    return NewSTy;
+  }
+  case Type::ArrayTyID:
+    Ty = ArrayType::get(remapType(SrcTy->getArrayElementType()),
+                        SrcTy->getArrayNumElements());
+    break;
+  case Type::PointerTyID:
+    Ty = PointerType::get(remapType(SrcTy->getPointerElementType()),
+                          SrcTy->getPointerAddressSpace());
+    break;
+  case Type::VectorTyID:
+    Ty = VectorType::get(remapType(SrcTy->getVectorElementType()),
+                         SrcTy->getVectorNumElements());
+    break;
+  }
+
+  return MappedTypes[SrcTy] = Ty;
+}
+
+/// Recreate the attribute set Attrs in Ctx.
+static AttributeSet mapAttributes(AttributeSet Attrs, LLVMContext &Ctx) {
+  SmallVector<AttributeSet, 4> Sets;
+  for (unsigned I = 0, E = Attrs.getNumSlots(); I != E; ++I) {
+    unsigned Index = Attrs.getSlotIndex(I);
+    Sets.push_back(AttributeSet::get(Ctx, Index, AttrBuilder(Attrs, Index)));
+  }
+  return AttributeSet::get(Ctx, Sets);
+}
+
+static void copyComdat(GlobalObject *New, const GlobalObject *Old) {
+  if (const Comdat *C = Old->getComdat())
+    New->setComdat(New->getParent()->getOrInsertComdat(C->getName()));
+}
+
+static bool hasMetadataOperand(const Instruction &I) {
+  for (const Use &Op : I.operands())
+    if (isa<MetadataAsValue>(Op))
+      return true;
+  return false;
+}
+
+/// Give the arguments, blocks and instructions of NewF the order of the use
+/// lists of the ones of OldF, which the result of passes can depend on.
+static void copyUseListOrder(const Function *OldF, ValueToValueMapTy &VMap) {
+  DenseMap<std::pair<const User *, unsigned>, unsigned> Order;
+  auto CopyOrder = [&](const Value &V) {
+    if (!V.hasNUsesOrMore(2))
+      return;
+    Order.clear();
+    unsigned N = 0;
+    for (const Use &U : V.uses()) {
+      Value *NewUser = isa<Instruction>(U.getUser())
+                           ? VMap.lookup(U.getUser())
+                           : nullptr;
+      if (!NewUser)
+        return;
+      Order[std::make_pair(cast<User>(NewUser), U.getOperandNo())] = N++;
+    }
+    Value *NewV = VMap.lookup(&V);
+    if (!NewV || NewV->getNumUses() != N)
+      return;
+    NewV->sortUseList([&](const Use &L, const Use &R) {
+      return Order.lookup(std::make_pair(L.getUser(), L.getOperandNo())) <
+             Order.lookup(std::make_pair(R.getUser(), R.getOperandNo()));
+    });
+  };
+  for (const Argument &Arg : OldF->args())
+    CopyOrder(Arg);
+  for (const BasicBlock &BB : *OldF) {
+    CopyOrder(BB);
+    for (const Instruction &I : BB)
+      CopyOrder(I);
+  }
+}
+
+/// Copy the instructions of OldF into NewF, whose blocks and arguments are
+/// already in VMap.
+static void cloneFunctionBodyIntoContext(Function *NewF, const Function *OldF,
+                                         ValueToValueMapTy &VMap,
+                                         ContextTypeMapper &TypeMapper,
+                                         ArrayRef<unsigned> MDKinds) {
+  LLVMContext &Ctx = NewF->getContext();
+  SmallVector<std::pair<const Instruction *, Instruction *>, 64> Cloned;
+
+  for (const BasicBlock &BB : *OldF) {
+    BasicBlock *NewBB = cast<BasicBlock>(VMap[&BB]);
+    for (const Instruction &I : BB) {
+      // Attached metadata, names and value handles are all keyed on the
+      // context of the instruction, which is the one of its type. Drop the
+      // metadata, which is attached again below, and move the clone to Ctx
+      // before it is named or put in VMap.
+      Instruction *NewI = I.clone();
+      NewI->dropUnknownNonDebugMetadata();
+      NewI->mutateType(TypeMapper.remapType(I.getType()));
+      // A GEP checks its result element type against its type.
+      if (auto *GEP = dyn_cast<GetElementPtrInst>(NewI)) {
+        GEP->setSourceElementType(
+            TypeMapper.remapType(GEP->getSourceElementType()));
+        GEP->setResultElementType(TypeMapper.remapType(
+            cast<GetElementPtrInst>(I).getResultElementType()));
+      }
+      NewBB->getInstList().push_back(NewI);
+      if (I.hasName())
+        NewI->setName(I.getName());
+      VMap[&I] = NewI;
+      Cloned.push_back(std::make_pair(&I, NewI));
+    }
+  }
+
+  // Metadata operands can refer to any local value, which has to be in Ctx
+  // by the time it is wrapped, so remap the instructions using them last.
+  std::stable_partition(
+      Cloned.begin(), Cloned.end(),
+      [](const std::pair<const Instruction *, Instruction *> &P) {
+        return !hasMetadataOperand(*P.first);
+      });
+
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  SmallVector<OperandBundleDef, 2> Bundles;
+  for (auto &P : Cloned) {
+    const Instruction *I = P.first;
+    Instruction *NewI = P.second;
+    RemapInstruction(NewI, VMap, RF_None, &TypeMapper);
+
+    if (CallSite CS = CallSite(NewI)) {
+      CS.setAttributes(mapAttributes(CS.getAttributes(), Ctx));
+
+      // The tags of operand bundles are interned in the context, so rebuild
+      // a call that has any.
+      if (CS.hasOperandBundles()) {
+        Bundles.clear();
+        CS.getOperandBundlesAsDefs(Bundles);
+        Instruction *NewCall;
+        if (auto *CI = dyn_cast<CallInst>(NewI))
+          NewCall = CallInst::Create(CI, Bundles, NewI);
+        else
+          NewCall = InvokeInst::Create(cast<InvokeInst>(NewI), Bundles, NewI);
+        NewCall->takeName(NewI);
+        NewCall->setDebugLoc(NewI->getDebugLoc());
+        NewI->replaceAllUsesWith(NewCall);
+        NewI->eraseFromParent();
+        VMap[I] = NewI = NewCall;
+      }
+    }
+
+    MDs.clear();
+    I->getAllMetadataOtherThanDebugLoc(MDs);
+    for (const auto &MD : MDs)
+      NewI->setMetadata(MDKinds[MD.first],
+                        MapMetadata(MD.second, VMap, RF_None, &TypeMapper));
+  }
+
+  copyUseListOrder(OldF, VMap);
+}
+
+/// Create a copy of the global variable GV in New, without its initializer.
+static GlobalVariable *createGlobalInContext(Module &New,
+                                             const GlobalVariable &GV,
+                                             ContextTypeMapper &TypeMapper) {
+  auto *NewGV = new GlobalVariable(
+      New, TypeMapper.remapType(GV.getValueType()), GV.isConstant(),
+      GV.getLinkage(), nullptr, GV.getName(), nullptr,
+      GV.getThreadLocalMode(), GV.getType()->getAddressSpace());
+  NewGV->copyAttributesFrom(&GV);
+  return NewGV;
+}
+
+/// Create a copy of F in New, without its body.
+static Function *createFunctionInContext(Module &New, const Function &F,
+                                         ContextTypeMapper &TypeMapper) {
+  Function *NewF = Function::Create(
+      cast<FunctionType>(TypeMapper.remapType(F.getFunctionType())),
+      F.getLinkage(), F.getName(), &New);
+  // Function::copyAttributesFrom would share the attributes and the
+  // prefix, prologue and personality constants of the old context.
+  NewF->GlobalObject::copyAttributesFrom(&F);
+  NewF->setCallingConv(F.getCallingConv());
+  NewF->setAttributes(mapAttributes(F.getAttributes(), New.getContext()));
+  if (F.hasGC())
+    NewF->setGC(F.getGC());
+  return NewF;
+}
+
+/// Create a copy of the alias GA in New, without its aliasee.
+static GlobalAlias *createAliasInContext(Module &New, const GlobalAlias &GA,
+                                         ContextTypeMapper &TypeMapper) {
+  auto *NewGA = GlobalAlias::create(TypeMapper.remapType(GA.getValueType()),
+                                    GA.getType()->getPointerAddressSpace(),
+                                    GA.getLinkage(), GA.getName(), &New);
+  NewGA->copyAttributesFrom(&GA);
+  NewGA->setThreadLocalMode(GA.getThreadLocalMode());
+  return NewGA;
+}
+
+/// Map the IDs of the metadata kinds of From to the ones of To.
+static void mapMDKinds(LLVMContext &From, LLVMContext &To,
+                       SmallVectorImpl<unsigned> &MDKinds) {
+  SmallVector<StringRef, 16> MDKindNames;
+  From.getMDKindNames(MDKindNames);
+  for (StringRef Name : MDKindNames)
+    MDKinds.push_back(To.getMDKindID(Name));
+}
+
+/// Copy the personality, prefix, prologue and attached metadata of OldF to
+/// NewF, once the body of NewF is cloned.
+static void cloneFunctionDataIntoContext(Function *NewF, const Function *OldF,
+                                         ValueToValueMapTy &VMap,
+                                         ContextTypeMapper &TypeMapper,
+                                         ArrayRef<unsigned> MDKinds) {
+  if (OldF->hasPersonalityFn())
+    NewF->setPersonalityFn(
+        MapValue(OldF->getPersonalityFn(), VMap, RF_None, &TypeMapper));
+  if (OldF->hasPrefixData())
+    NewF->setPrefixData(
+        MapValue(OldF->getPrefixData(), VMap, RF_None, &TypeMapper));
+  if (OldF->hasPrologueData())
+    NewF->setPrologueData(
+        MapValue(OldF->getPrologueData(), VMap, RF_None, &TypeMapper));
+
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  OldF->getAllMetadata(MDs);
+  for (const auto &MD : MDs)
+    NewF->setMetadata(MDKinds[MD.first],
+                      MapMetadata(MD.second, VMap, RF_None, &TypeMapper));
+}
+
+std::unique_ptr<Module> llvm::CloneModuleIntoContext(const Module *M,
+                                                     LLVMContext &Ctx) {
+  ValueToValueMapTy VMap;
+  return CloneModuleIntoContext(M, Ctx, VMap,
+                                [](const GlobalValue *GV) { return true; });
+}
+
+std::unique_ptr<Module> llvm::CloneModuleIntoContext(
+    const Module *M, LLVMContext &Ctx, ValueToValueMapTy &VMap,
+    std::function<bool(const GlobalValue *)> ShouldCloneDefinition) {
+  std::unique_ptr<Module> New =
+      llvm::make_unique<Module>(M->getModuleIdentifier(), Ctx);
+  New->setDataLayout(M->getDataLayout());
+  New->setTargetTriple(M->getTargetTriple());
+  New->setModuleInlineAsm(M->getModuleInlineAsm());
+
+  ContextTypeMapper TypeMapper(Ctx);
+
+  // Metadata kinds are numbered per context.
+  SmallVector<unsigned, 16> MDKinds;
+  mapMDKinds(M->getContext(), Ctx, MDKinds);
+
+  for (const auto &C : M->getComdatSymbolTable())
+    New->getOrInsertComdat(C.getKey())
+        ->setSelectionKind(C.getValue().getSelectionKind());
+
+  // Create all globals first, as in CloneModule. The ones whose definition
+  // is not cloned become external declarations.
+  for (const GlobalVariable &GV : M->globals()) {
+    GlobalVariable *NewGV = createGlobalInContext(*New, GV, TypeMapper);
+    if (ShouldCloneDefinition(&GV))
+      copyComdat(NewGV, &GV);
+    else
+      NewGV->setLinkage(GlobalValue::ExternalLinkage);
+    VMap[&GV] = NewGV;
+  }
+
+  for (const Function &F : M->functions()) {
+    Function *NewF = createFunctionInContext(*New, F, TypeMapper);
+    VMap[&F] = NewF;
+    if (!ShouldCloneDefinition(&F)) {
+      NewF->setLinkage(GlobalValue::ExternalLinkage);
+      continue;
+    }
+    copyComdat(NewF, &F);
+
+    // Create the blocks of all functions up front, so that block addresses
+    // can refer to blocks of functions cloned later.
+    Function::arg_iterator NewArg = NewF->arg_begin();
+    for (const Argument &Arg : F.args()) {
+      NewArg->setName(Arg.getName());
+      VMap[&Arg] = &*NewArg++;
+    }
+    for (const BasicBlock &BB : F)
+      VMap[&BB] = BasicBlock::Create(Ctx, BB.getName(), NewF);
+  }
+
+  for (const GlobalAlias &GA : M->aliases()) {
+    if (!ShouldCloneDefinition(&GA)) {
+      // An alias cannot act as an external reference, so declare a function
+      // or a global variable instead, as CloneModule does.
+      Type *ValueTy = TypeMapper.remapType(GA.getValueType());
+      GlobalValue *GV;
+      if (ValueTy->isFunctionTy())
+        GV = Function::Create(cast<FunctionType>(ValueTy),
+                              GlobalValue::ExternalLinkage, GA.getName(),
+                              New.get());
+      else
+        GV = new GlobalVariable(
+            *New, ValueTy, false, GlobalValue::ExternalLinkage, nullptr,
+            GA.getName(), nullptr, GA.getThreadLocalMode(),
+            GA.getType()->getAddressSpace());
+      VMap[&GA] = GV;
+      continue;
+    }
+    VMap[&GA] = createAliasInContext(*New, GA, TypeMapper);
+  }
+
+  for (const Function &F : M->functions()) {
+    if (!ShouldCloneDefinition(&F))
+      continue;
+    Function *NewF = cast<Function>(VMap[&F]);
+    cloneFunctionBodyIntoContext(NewF, &F, VMap, TypeMapper, MDKinds);
+    cloneFunctionDataIntoContext(NewF, &F, VMap, TypeMapper, MDKinds);
+  }
+
+  for (const GlobalVariable &GV : M->globals())
+    if (GV.hasInitializer() && ShouldCloneDefinition(&GV))
+      cast<GlobalVariable>(VMap[&GV])->setInitializer(
+          MapValue(GV.getInitializer(), VMap, RF_None, &TypeMapper));
+
+  for (const GlobalAlias &GA : M->aliases())
+    if (ShouldCloneDefinition(&GA))
+      if (const Constant *C = GA.getAliasee())
+        cast<GlobalAlias>(VMap[&GA])->setAliasee(
+            MapValue(C, VMap, RF_None, &TypeMapper));
+
+  for (const NamedMDNode &NMD : M->named_metadata()) {
+    NamedMDNode *NewNMD = New->getOrInsertNamedMetadata(NMD.getName());
+    for (const MDNode *Op : NMD.operands())
+      NewNMD->addOperand(MapMetadata(Op, VMap, RF_None, &TypeMapper));
+  }
+
+  return New;
+}
+
+void llvm::CopyFunctionBodiesFromContext(Module &M, ArrayRef<Function *> Fs,
+                                         ValueToValueMapTy &VMap) {
+  if (Fs.empty())
+    return;
+  LLVMContext &Ctx = M.getContext();
+  const Module *Clone = cast<Function>(VMap[Fs.front()])->getParent();
+
+  // Map the copies back to the globals and metadata of M, and the types of
+  // the copies back to the existing types of M.
+  ValueToValueMapTy RMap;
+  ContextTypeMapper TypeMapper(Ctx, &M);
+  for (const auto &P : VMap) {
+    const auto *GV = dyn_cast<GlobalValue>(P.first);
+    if (!GV || !P.second)
+      continue;
+    RMap[P.second] = const_cast<GlobalValue *>(GV);
+    TypeMapper.addMapping(P.second->getType(), GV->getType());
+  }
+  if (VMap.hasMD())
+    for (const auto &P : VMap.MD())
+      if (P.second)
+        RMap.MD()[P.second.get()].reset(const_cast<Metadata *>(P.first));
+
+  SmallVector<unsigned, 16> MDKinds;
+  mapMDKinds(Clone->getContext(), Ctx, MDKinds);
+
+  // Add the globals that were created in the clone, such as the declarations
+  // of library functions and the constants used by simplified calls. Named
+  // ones that M already has are reused.
+  std::vector<const Function *> NewDefs;
+  std::vector<const GlobalVariable *> NewGVs;
+  std::vector<const GlobalAlias *> NewGAs;
+  for (const GlobalVariable &GV : Clone->globals()) {
+    if (RMap.count(&GV))
+      continue;
+    GlobalValue *Existing =
+        GV.hasLocalLinkage() ? nullptr : M.getNamedValue(GV.getName());
+    if (!Existing) {
+      GlobalVariable *NewGV = createGlobalInContext(M, GV, TypeMapper);
+      copyComdat(NewGV, &GV);
+      NewGVs.push_back(&GV);
+      Existing = NewGV;
+    }
+    RMap[&GV] = Existing;
+  }
+  for (const Function &F : Clone->functions()) {
+    if (RMap.count(&F))
+      continue;
+    GlobalValue *Existing =
+        F.hasLocalLinkage() ? nullptr : M.getNamedValue(F.getName());
+    if (!Existing) {
+      Function *NewF = createFunctionInContext(M, F, TypeMapper);
+      copyComdat(NewF, &F);
+      if (!F.isDeclaration())
+        NewDefs.push_back(&F);
+      Existing = NewF;
+    }
+    RMap[&F] = Existing;
+  }
+  for (const GlobalAlias &GA : Clone->aliases()) {
+    if (RMap.count(&GA))
+      continue;
+    GlobalValue *Existing =
+        GA.hasLocalLinkage() ? nullptr : M.getNamedValue(GA.getName());
+    if (!Existing) {
+      Existing = createAliasInContext(M, GA, TypeMapper);
+      NewGAs.push_back(&GA);
+    }
+    RMap[&GA] = Existing;
+  }
+
+  // Replace the bodies. Function::dropAllReferences also drops the
+  // personality, prefix, prologue and attached metadata, which are copied
+  // back along with the body.
+  auto CopyBody = [&](Function *F, const Function *CloneF) {
+    F->dropAllReferences();
+    F->setAttributes(mapAttributes(CloneF->getAttributes(), Ctx));
+    Function::arg_iterator Arg = F->arg_begin();
+    for (const Argument &CloneArg : CloneF->args())
+      RMap[&CloneArg] = &*Arg++;
+    for (const BasicBlock &BB : *CloneF)
+      RMap[&BB] = BasicBlock::Create(Ctx, BB.getName(), F);
+    cloneFunctionBodyIntoContext(F, CloneF, RMap, TypeMapper, MDKinds);
+    cloneFunctionDataIntoContext(F, CloneF, RMap, TypeMapper, MDKinds);
+  };
+  for (Function *F : Fs) {
+    assert(!any_of(*F, [](const BasicBlock &BB) {
+             return BB.hasAddressTaken();
+           }) && "Blocks of F are referred to outside of it");
+    CopyBody(F, cast<Function>(VMap[F]));
+  }
+  for (const Function *CloneF : NewDefs)
+    CopyBody(cast<Function>(RMap[CloneF]), CloneF);
+
+  for (const GlobalVariable *GV : NewGVs)
+    if (GV->hasInitializer())
+      cast<GlobalVariable>(RMap[GV])->setInitializer(
+          MapValue(GV->getInitializer(), RMap, RF_None, &TypeMapper));
+  for (const GlobalAlias *GA : NewGAs)
+    if (const Constant *C = GA->getAliasee())
+      cast<GlobalAlias>(RMap[GA])->setAliasee(
+          MapValue(C, RMap, RF_None, &TypeMapper));
+}
+
 extern "C" {
 
 LLVMModuleRef LLVMCloneModule(LLVMModuleRef M) {
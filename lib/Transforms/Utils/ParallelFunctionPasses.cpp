@@ -0,0 +1,146 @@
+//===- ParallelFunctionPasses.cpp - Run function passes on threads --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements llvm::runFunctionPassesInParallel. Contexts are not
+// thread safe, so every thread works on a copy of its functions in a context
+// of its own, and the results are copied back into the original context on
+// the calling thread.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/Utils/ParallelFunctionPasses.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+#include <algorithm>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "parallel-function-passes"
+
+STATISTIC(NumParallelFunctions, "Number of functions processed on threads");
+STATISTIC(NumSerialFunctions,
+          "Number of functions processed on the calling thread");
+
+namespace {
+/// A group of functions, and their copy in a context of their own.
+struct Partition {
+  std::vector<Function *> Functions;
+  uint64_t Cost = 0;
+
+  // Declared in this order so that the map goes before the clone, and the
+  // clone before its context.
+  std::unique_ptr<LLVMContext> Ctx;
+  std::unique_ptr<Module> Clone;
+  ValueToValueMapTy VMap;
+  std::vector<Function *> ClonedFunctions;
+};
+}
+
+/// The blocks of F can only be replaced if nothing outside of F refers to
+/// them.
+static bool hasAddressTakenBlock(const Function &F) {
+  return any_of(F, [](const BasicBlock &BB) { return BB.hasAddressTaken(); });
+}
+
+void llvm::runFunctionPassesInParallel(
+    Module &M, unsigned Threads,
+    std::function<void(Module &M, ArrayRef<Function *> Fs)> RunPasses,
+    bool CloneAllDefinitions) {
+  std::vector<Function *> Serial;
+  std::vector<std::pair<uint64_t, Function *>> Candidates;
+  for (Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    if (Threads > 1 && !hasAddressTakenBlock(F))
+      Candidates.push_back(std::make_pair(estimateCodeGenCost(F), &F));
+    else
+      Serial.push_back(&F);
+  }
+
+  Threads = std::min<size_t>(Threads, Candidates.size());
+  if (Threads < 2) {
+    for (auto &C : Candidates)
+      Serial.push_back(C.second);
+    Candidates.clear();
+  }
+
+  // Assign the most expensive functions first, each to the cheapest
+  // partition so far. Each partition keeps the order of the module.
+  std::vector<std::unique_ptr<Partition>> Partitions;
+  if (!Candidates.empty()) {
+    DenseMap<const Function *, unsigned> Order;
+    for (unsigned I = 0, E = Candidates.size(); I != E; ++I)
+      Order[Candidates[I].second] = I;
+    std::stable_sort(Candidates.begin(), Candidates.end(),
+                     [](const std::pair<uint64_t, Function *> &LHS,
+                        const std::pair<uint64_t, Function *> &RHS) {
+                       return LHS.first > RHS.first;
+                     });
+    for (unsigned I = 0; I != Threads; ++I)
+      Partitions.push_back(llvm::make_unique<Partition>());
+    for (auto &C : Candidates) {
+      Partition &P = **std::min_element(
+          Partitions.begin(), Partitions.end(),
+          [](const std::unique_ptr<Partition> &LHS,
+             const std::unique_ptr<Partition> &RHS) {
+            return LHS->Cost < RHS->Cost;
+          });
+      P.Functions.push_back(C.second);
+      P.Cost += C.first;
+    }
+    for (auto &P : Partitions)
+      std::sort(P->Functions.begin(), P->Functions.end(),
+                [&](const Function *LHS, const Function *RHS) {
+                  return Order[LHS] < Order[RHS];
+                });
+  }
+
+  if (!Partitions.empty()) {
+    ThreadPool Pool(Threads);
+    for (auto &P : Partitions) {
+      // Clone on this thread, which owns the context of M, and hand the clone
+      // over to a thread of the pool.
+      SmallPtrSet<const GlobalValue *, 32> InPartition(P->Functions.begin(),
+                                                       P->Functions.end());
+      P->Ctx = llvm::make_unique<LLVMContext>();
+      P->Clone = CloneModuleIntoContext(
+          &M, *P->Ctx, P->VMap, [&](const GlobalValue *GV) {
+            return CloneAllDefinitions || !isa<Function>(GV) ||
+                   InPartition.count(GV);
+          });
+      for (Function *F : P->Functions)
+        P->ClonedFunctions.push_back(cast<Function>(P->VMap[F]));
+      DEBUG(dbgs() << "Partition of " << P->Functions.size()
+                   << " functions, cost " << P->Cost << "\n");
+
+      Partition *Part = P.get();
+      Pool.async([Part, &RunPasses]() {
+        RunPasses(*Part->Clone, Part->ClonedFunctions);
+      });
+    }
+  }
+
+  for (auto &P : Partitions) {
+    CopyFunctionBodiesFromContext(M, P->Functions, P->VMap);
+    NumParallelFunctions += P->Functions.size();
+    P.reset();
+  }
+
+  if (!Serial.empty()) {
+    RunPasses(M, Serial);
+    NumSerialFunctions += Serial.size();
+  }
+}
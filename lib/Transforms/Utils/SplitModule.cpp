@@ -14,30 +14,85 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Transforms/Utils/SplitModule.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/EquivalenceClasses.h"
 #include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalAlias.h"
 #include "llvm/IR/GlobalObject.h"
 #include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/Support/MD5.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include <algorithm>
+#include <climits>
+#include <queue>
 
 using namespace llvm;
 
-static void externalize(GlobalValue *GV) {
-  if (GV->hasLocalLinkage()) {
-    GV->setLinkage(GlobalValue::ExternalLinkage);
-    GV->setVisibility(GlobalValue::HiddenVisibility);
+#define DEBUG_TYPE "split-module"
+
+STATISTIC(NumPartitions, "Number of partitions created");
+STATISTIC(NumClusters, "Number of clusters of globals balanced");
+STATISTIC(TotalPartitionCost, "Estimated codegen cost of all partitions");
+STATISTIC(MaxPartitionCost, "Estimated codegen cost of the largest partition");
+
+// Relative weights of the parts of a function in estimateCodeGenCost. Every
+// block is scheduled and laid out on its own, and every line of inline asm is
+// parsed by the integrated assembler.
+static const uint64_t InstructionCost = 1;
+static const uint64_t BasicBlockCost = 2;
+static const uint64_t InlineAsmLineCost = 1;
+
+uint64_t llvm::estimateCodeGenCost(const Function &F) {
+  uint64_t Cost = 0;
+  for (const BasicBlock &BB : F) {
+    Cost += BasicBlockCost;
+    for (const Instruction &I : BB) {
+      Cost += InstructionCost;
+      ImmutableCallSite CS(&I);
+      if (!CS)
+        continue;
+      if (const InlineAsm *IA = dyn_cast<InlineAsm>(CS.getCalledValue())) {
+        StringRef Asm = IA->getAsmString();
+        Cost += InlineAsmLineCost * (1 + Asm.count('\n'));
+      }
+    }
   }
+  return Cost;
+}
+
+uint64_t llvm::estimateCodeGenCost(const Module &M) {
+  uint64_t Cost = 0;
+  for (const Function &F : M)
+    Cost += estimateCodeGenCost(F);
+  return Cost;
+}
 
+static void nameUnnamed(GlobalValue *GV) {
   // Unnamed entities must be named consistently between modules. setName will
   // give a distinct name to each such entity.
   if (!GV->hasName())
     GV->setName("__llvmsplit_unnamed");
 }
 
+static void externalize(GlobalValue *GV) {
+  if (GV->hasLocalLinkage()) {
+    GV->setLinkage(GlobalValue::ExternalLinkage);
+    GV->setVisibility(GlobalValue::HiddenVisibility);
+  }
+
+  nameUnnamed(GV);
+}
+
 // Returns whether GV should be in partition (0-based) I of N.
 static bool isInPartition(const GlobalValue *GV, unsigned I, unsigned N) {
   if (auto GA = dyn_cast<GlobalAlias>(GV))
@@ -60,26 +115,162 @@ static bool isInPartition(const GlobalValue *GV, unsigned I, unsigned N) {
   return (R[0] | (R[1] << 8)) % N == I;
 }
 
+typedef EquivalenceClasses<const GlobalValue *> ClusterMapType;
+
+// Puts GV in the same cluster as the globals that use V, looking through
+// constant expressions. Globals with appending linkage, such as llvm.used and
+// llvm.global_ctors, refer to symbols from all over the module and would merge
+// them all into one cluster, so they are skipped; returns false if V has such
+// a user.
+static bool addGlobalValueUsers(ClusterMapType &Clusters, const GlobalValue *GV,
+                                const Value *V) {
+  bool Clustered = true;
+  SmallVector<const User *, 8> Worklist(V->user_begin(), V->user_end());
+  while (!Worklist.empty()) {
+    const User *U = Worklist.pop_back_val();
+    if (const Instruction *I = dyn_cast<Instruction>(U))
+      Clusters.unionSets(GV, I->getParent()->getParent());
+    else if (const GlobalValue *UGV = dyn_cast<GlobalValue>(U)) {
+      if (UGV->hasAppendingLinkage())
+        Clustered = false;
+      else
+        Clusters.unionSets(GV, UGV);
+    } else
+      Worklist.append(U->user_begin(), U->user_end());
+  }
+  return Clustered;
+}
+
+// Assigns each global definition of M to a partition, keeping together the
+// globals that cannot be separated and balancing the estimated cost of the
+// partitions.
+static void findPartitions(Module &M, unsigned N,
+                           DenseMap<const GlobalValue *, unsigned> &Partition) {
+  ClusterMapType Clusters;
+  DenseMap<const Comdat *, const GlobalValue *> ComdatMembers;
+  std::vector<const GlobalValue *> Globals;
+
+  auto RecordGlobal = [&](GlobalValue &GV) {
+    if (GV.isDeclaration())
+      return;
+    nameUnnamed(&GV);
+    Globals.push_back(&GV);
+    Clusters.insert(&GV);
+
+    // Members of a comdat are discarded or kept together by the linker.
+    if (const Comdat *C = GV.getComdat()) {
+      const GlobalValue *&Member = ComdatMembers[C];
+      if (Member)
+        Clusters.unionSets(Member, &GV);
+      else
+        Member = &GV;
+    }
+
+    // An alias must be defined in the same module as its aliasee.
+    if (auto *GA = dyn_cast<GlobalAlias>(&GV))
+      if (const GlobalObject *Base = GA->getBaseObject())
+        Clusters.unionSets(&GV, Base);
+
+    // A blockaddress can only refer to a function defined in the module.
+    if (auto *F = dyn_cast<Function>(&GV))
+      for (const User *U : F->users())
+        if (isa<BlockAddress>(U))
+          addGlobalValueUsers(Clusters, F, U);
+
+    // Local symbols go with all of their users, and only those referred to
+    // by an appending global have to be externalized.
+    if (GV.hasLocalLinkage() && !addGlobalValueUsers(Clusters, &GV, &GV))
+      externalize(&GV);
+  };
+
+  for (Function &F : M)
+    RecordGlobal(F);
+  for (GlobalVariable &GV : M.globals())
+    RecordGlobal(GV);
+  for (GlobalAlias &GA : M.aliases())
+    RecordGlobal(GA);
+
+  // Sum up the cost of each cluster, in module order so that the assignment
+  // below does not depend on pointer values.
+  MapVector<const GlobalValue *, uint64_t> ClusterCosts;
+  for (const GlobalValue *GV : Globals) {
+    uint64_t &Cost = ClusterCosts[Clusters.getLeaderValue(GV)];
+    if (const Function *F = dyn_cast<Function>(GV))
+      Cost += estimateCodeGenCost(*F);
+  }
+  NumClusters += ClusterCosts.size();
+
+  // Give the most expensive remaining cluster to the cheapest partition so
+  // far. Ties go to the lowest numbered partition.
+  std::vector<std::pair<const GlobalValue *, uint64_t>> Sorted(
+      ClusterCosts.begin(), ClusterCosts.end());
+  std::stable_sort(Sorted.begin(), Sorted.end(),
+                   [](const std::pair<const GlobalValue *, uint64_t> &A,
+                      const std::pair<const GlobalValue *, uint64_t> &B) {
+                     return A.second > B.second;
+                   });
+
+  typedef std::pair<uint64_t, unsigned> LoadType;
+  std::priority_queue<LoadType, std::vector<LoadType>, std::greater<LoadType>>
+      Loads;
+  for (unsigned I = 0; I != N; ++I)
+    Loads.push(std::make_pair(0, I));
+
+  DenseMap<const GlobalValue *, unsigned> LeaderPartition;
+  for (const auto &Cluster : Sorted) {
+    LoadType Load = Loads.top();
+    Loads.pop();
+    LeaderPartition[Cluster.first] = Load.second;
+    Load.first += Cluster.second;
+    Loads.push(Load);
+  }
+
+  for (const GlobalValue *GV : Globals)
+    Partition[GV] = LeaderPartition[Clusters.getLeaderValue(GV)];
+}
+
 void llvm::SplitModule(
     std::unique_ptr<Module> M, unsigned N,
-    std::function<void(std::unique_ptr<Module> MPart)> ModuleCallback) {
-  for (Function &F : *M)
-    externalize(&F);
-  for (GlobalVariable &GV : M->globals())
-    externalize(&GV);
-  for (GlobalAlias &GA : M->aliases())
-    externalize(&GA);
+    std::function<void(std::unique_ptr<Module> MPart)> ModuleCallback,
+    bool Balance) {
+  DenseMap<const GlobalValue *, unsigned> Partition;
+  if (Balance) {
+    findPartitions(*M, N, Partition);
+  } else {
+    for (Function &F : *M)
+      externalize(&F);
+    for (GlobalVariable &GV : M->globals())
+      externalize(&GV);
+    for (GlobalAlias &GA : M->aliases())
+      externalize(&GA);
+  }
 
   // FIXME: We should be able to reuse M as the last partition instead of
   // cloning it.
   for (unsigned I = 0; I != N; ++I) {
     ValueToValueMapTy VMap;
     std::unique_ptr<Module> MPart(
-        CloneModule(M.get(), VMap, [=](const GlobalValue *GV) {
-          return isInPartition(GV, I, N);
+        CloneModule(M.get(), VMap, [&](const GlobalValue *GV) {
+          if (!Balance)
+            return isInPartition(GV, I, N);
+          // Keep the linkage of declarations, such as extern_weak.
+          auto It = Partition.find(GV);
+          return It == Partition.end() || It->second == I;
         }));
     if (I != 0)
       MPart->setModuleInlineAsm("");
+
+    uint64_t Cost = estimateCodeGenCost(*MPart);
+    DEBUG(dbgs() << "Partition " << I << " of " << N << ": estimated cost "
+                 << Cost << "\n");
+    ++NumPartitions;
+    // Statistics are unsigned. Saturate instead of wrapping around for very
+    // large modules.
+    unsigned StatCost = std::min<uint64_t>(Cost, UINT_MAX);
+    TotalPartitionCost += std::min(StatCost, UINT_MAX - TotalPartitionCost);
+    if (StatCost > MaxPartitionCost)
+      MaxPartitionCost = StatCost;
+
     ModuleCallback(std::move(MPart));
   }
 }
@@ -28,6 +28,53 @@ void ValueMaterializer::anchor() {}
 void ValueMaterializer::materializeInitFor(GlobalValue *New, GlobalValue *Old) {
 }
 
+/// Return the context that metadata is mapped into, if it is not the source
+/// context.
+static LLVMContext *getDestinationContext(ValueMapTypeRemapper *TypeMapper) {
+  return TypeMapper ? TypeMapper->getDestinationContext() : nullptr;
+}
+
+template <typename T>
+static ArrayRef<T> getRawElements(const ConstantDataSequential *CDS) {
+  StringRef Raw = CDS->getRawDataValues();
+  return makeArrayRef(reinterpret_cast<const T *>(Raw.data()),
+                      CDS->getNumElements());
+}
+
+template <typename T>
+static Constant *getDataSequential(const ConstantDataSequential *CDS,
+                                   Type *NewTy) {
+  LLVMContext &Ctx = NewTy->getContext();
+  ArrayRef<T> Elts = getRawElements<T>(CDS);
+  if (CDS->getElementType()->isFloatingPointTy())
+    return isa<ArrayType>(NewTy) ? ConstantDataArray::getFP(Ctx, Elts)
+                                 : ConstantDataVector::getFP(Ctx, Elts);
+  return isa<ArrayType>(NewTy) ? ConstantDataArray::get(Ctx, Elts)
+                               : ConstantDataVector::get(Ctx, Elts);
+}
+
+/// Recreate the array or vector of raw data CDS with the remapped type NewTy,
+/// which lives in another context.
+static Constant *mapDataSequential(const ConstantDataSequential *CDS,
+                                   Type *NewTy) {
+  switch (CDS->getElementByteSize()) {
+  default:
+    llvm_unreachable("Unexpected element size");
+  case 1: {
+    ArrayRef<uint8_t> Elts = getRawElements<uint8_t>(CDS);
+    return isa<ArrayType>(NewTy)
+               ? ConstantDataArray::get(NewTy->getContext(), Elts)
+               : ConstantDataVector::get(NewTy->getContext(), Elts);
+  }
+  case 2:
+    return getDataSequential<uint16_t>(CDS, NewTy);
+  case 4:
+    return getDataSequential<uint32_t>(CDS, NewTy);
+  case 8:
+    return getDataSequential<uint64_t>(CDS, NewTy);
+  }
+}
+
 Value *llvm::MapValue(const Value *V, ValueToValueMapTy &VM, RemapFlags Flags,
                       ValueMapTypeRemapper *TypeMapper,
                       ValueMaterializer *Materializer) {
@@ -91,7 +138,10 @@ Value *llvm::MapValue(const Value *V, ValueToValueMapTy &VM, RemapFlags Flags,
     //
     //    assert((MappedMD || (Flags & RF_NullMapMissingGlobalValues)) &&
     //           "Referenced metadata value not in value map");
-    return VM[V] = MetadataAsValue::get(V->getContext(), MappedMD);
+    LLVMContext *DestCtx = getDestinationContext(TypeMapper);
+    return VM[V] =
+               MetadataAsValue::get(DestCtx ? *DestCtx : V->getContext(),
+                                    MappedMD);
   }
 
   // Okay, this either must be a constant (which may or may not be mappable) or
@@ -162,6 +212,15 @@ Value *llvm::MapValue(const Value *V, ValueToValueMapTy &VM, RemapFlags Flags,
     return VM[V] = UndefValue::get(NewTy);
   if (isa<ConstantAggregateZero>(C))
     return VM[V] = ConstantAggregateZero::get(NewTy);
+  // The remaining leaves only change when mapping into another context.
+  if (auto *CI = dyn_cast<ConstantInt>(C))
+    return VM[V] = ConstantInt::get(NewTy, CI->getValue());
+  if (auto *CFP = dyn_cast<ConstantFP>(C))
+    return VM[V] = ConstantFP::get(NewTy->getContext(), CFP->getValueAPF());
+  if (auto *CDS = dyn_cast<ConstantDataSequential>(C))
+    return VM[V] = mapDataSequential(CDS, NewTy);
+  if (isa<ConstantTokenNone>(C))
+    return VM[V] = ConstantTokenNone::get(NewTy->getContext());
   assert(isa<ConstantPointerNull>(C));
   return VM[V] = ConstantPointerNull::get(cast<PointerType>(NewTy));
 }
@@ -283,7 +342,9 @@ static Metadata *mapDistinctNode(const MDNode *Node,
   assert(Node->isDistinct() && "Expected distinct node");
 
   MDNode *NewMD;
-  if (Flags & RF_MoveDistinctMDs)
+  if (LLVMContext *DestCtx = getDestinationContext(TypeMapper))
+    NewMD = MDNode::replaceWithDistinct(Node->clone(*DestCtx));
+  else if (Flags & RF_MoveDistinctMDs)
     NewMD = const_cast<MDNode *>(Node);
   else
     NewMD = MDNode::replaceWithDistinct(Node->clone());
@@ -306,11 +367,13 @@ static Metadata *mapUniquedNode(const MDNode *Node,
 
   // Create a temporary node and map it upfront in case we have a uniquing
   // cycle.  If necessary, this mapping will get updated by RAUW logic before
-  // returning.
-  auto ClonedMD = Node->clone();
+  // returning.  A node mapped into another context is always recreated,
+  // even if it has no operands.
+  LLVMContext *DestCtx = getDestinationContext(TypeMapper);
+  auto ClonedMD = DestCtx ? Node->clone(*DestCtx) : Node->clone();
   mapToMetadata(VM, Node, ClonedMD.get(), Materializer, Flags);
   if (!remapOperands(*ClonedMD, DistinctWorklist, VM, Flags, TypeMapper,
-                     Materializer)) {
+                     Materializer) && !DestCtx) {
     // No operands changed, so use the original.
     ClonedMD->replaceAllUsesWith(const_cast<MDNode *>(Node));
     // Even though replaceAllUsesWith would have replaced the value map
@@ -335,8 +398,12 @@ static Metadata *MapMetadataImpl(const Metadata *MD,
   if (Metadata *NewMD = VM.MD().lookup(MD).get())
     return NewMD;
 
-  if (isa<MDString>(MD))
+  if (auto *S = dyn_cast<MDString>(MD)) {
+    if (LLVMContext *DestCtx = getDestinationContext(TypeMapper))
+      return mapToMetadata(VM, MD, MDString::get(*DestCtx, S->getString()),
+                           Materializer, Flags);
     return mapToSelf(VM, MD, Materializer, Flags);
+  }
 
   if (isa<ConstantAsMetadata>(MD))
     if ((Flags & RF_NoModuleLevelChanges))
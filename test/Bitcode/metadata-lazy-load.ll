@@ -0,0 +1,56 @@
+; The strings of the module-level metadata block are in a single record ahead
+; of the others, and are not indexed. The offset of an index of the other
+; records follows them; the index follows the records and precedes the named
+; metadata. The record codes are upstream's.
+; RUN: llvm-as < %s | llvm-bcanalyzer -dump | FileCheck %s -check-prefix=BLOCK
+; BLOCK:      <METADATA_BLOCK
+; BLOCK-NEXT:   <STRINGS abbrevid={{[0-9]+}} op0=4 op1={{[0-9]+}}/> blob data
+; BLOCK-NEXT:   <INDEX_OFFSET abbrevid={{[0-9]+}} op0={{[0-9]+}} op1=0/>
+; BLOCK:        <INDEX
+; BLOCK-NEXT:   <NAME
+; BLOCK-NEXT:   <NAMED_NODE
+; BLOCK-NEXT: </METADATA_BLOCK>
+
+; A lazily loaded module parses the nodes on demand, which must give the same
+; result as parsing all of them.
+; RUN: llvm-as < %s -o %t.bc
+; RUN: llvm-dis < %t.bc | FileCheck %s
+; RUN: opt -S < %t.bc | FileCheck %s
+; CHECK: !llvm.ident = !{!0}
+; CHECK: !0 = !{!"ident"}
+; CHECK: !1 = !{!2, !2, i64 0}
+; CHECK: !2 = !{!"int", !3, i64 0}
+; CHECK: !3 = !{!"tbaa root"}
+; CHECK: !4 = !{i32 0, i32 10}
+; CHECK: !5 = !{!"unused"}
+
+; Extracting @f does not parse the metadata of @g, nor create its string.
+; RUN: llvm-extract -func f %t.bc -S -o - -stats 2>&1 | FileCheck %s -check-prefix=EXTRACT
+; EXTRACT: load i32, i32* %p, !tbaa !1
+; EXTRACT-NOT: !range
+; EXTRACT: !3 = !{!"tbaa root"}
+; EXTRACT-NOT: i32 10
+; EXTRACT-NOT: unused
+; EXTRACT: 5 bitcode-reader - Number of indexed metadata records parsed on demand
+; EXTRACT: 9 bitcode-reader - Number of module-level metadata records indexed
+; EXTRACT: 3 bitcode-reader - Number of module-level metadata strings created on demand
+; REQUIRES: asserts
+
+define i32 @f(i32* %p) {
+  %v = load i32, i32* %p, !tbaa !1
+  ret i32 %v
+}
+
+define i32 @g(i32* %p) {
+  %v = load i32, i32* %p, !range !4, !note !5
+  ret i32 %v
+}
+
+!llvm.ident = !{!0}
+
+!0 = !{!"ident"}
+!1 = !{!2, !2, i64 0}
+!2 = !{!"int", !3, i64 0}
+!3 = !{!"tbaa root"}
+!4 = !{i32 0, i32 10}
+!5 = !{!"unused"}
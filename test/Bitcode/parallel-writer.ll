@@ -0,0 +1,79 @@
+; The function blocks encoded on several threads are the same as the ones
+; written serially, also with use-list orders, debug locations and a function
+; summary, whose VST entries point into the appended blocks.
+; RUN: llvm-as < %s > %t.bc
+; RUN: llvm-as -bitcode-writer-threads=3 < %s > %t.par.bc
+; RUN: cmp %t.bc %t.par.bc
+; RUN: llvm-as -bitcode-writer-threads=8 < %s > %t.par.bc
+; RUN: cmp %t.bc %t.par.bc
+; RUN: llvm-as -preserve-bc-uselistorder < %s > %t.bc
+; RUN: llvm-as -preserve-bc-uselistorder -bitcode-writer-threads=3 < %s > %t.par.bc
+; RUN: cmp %t.bc %t.par.bc
+; RUN: llvm-as -function-summary < %s > %t.bc
+; RUN: llvm-as -function-summary -bitcode-writer-threads=3 < %s > %t.par.bc
+; RUN: cmp %t.bc %t.par.bc
+; RUN: llvm-dis < %t.par.bc | FileCheck %s
+
+@g = global i32 0
+
+; CHECK: define i32 @add(i32 %a, i32 %b)
+; CHECK-NEXT: %sum = add i32 %a, %b
+define i32 @add(i32 %a, i32 %b) {
+  %sum = add i32 %a, %b
+  ret i32 %sum
+}
+
+; CHECK: define i32 @loop(i32 %n)
+define i32 @loop(i32 %n) {
+entry:
+  br label %body
+
+body:
+  %i = phi i32 [ 0, %entry ], [ %next, %body ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %body ]
+  %acc.next = call i32 @add(i32 %acc, i32 %i)
+  %next = add i32 %i, 1
+  %done = icmp eq i32 %next, %n
+  br i1 %done, label %exit, label %body
+
+exit:
+  ret i32 %acc.next
+}
+
+; CHECK: define void @store(i32 %x)
+; CHECK-NEXT: store i32 %x, i32* @g, !dbg [[LOC:![0-9]+]]
+define void @store(i32 %x) !dbg !4 {
+  store i32 %x, i32* @g, !dbg !7
+  ret void
+}
+
+; CHECK: define internal i32 @load()
+define internal i32 @load() {
+  %v = load i32, i32* @g
+  %w = add i32 %v, %v
+  %z = mul i32 %w, %v
+  ret i32 %z
+}
+
+; CHECK: define i32 @callers()
+; CHECK-NEXT: call i32 @load()
+; CHECK-NEXT: call i32 @loop(i32 %a)
+; CHECK: [[LOC]] = !DILocation(line: 2, scope: !{{[0-9]+}})
+define i32 @callers() {
+  %a = call i32 @load()
+  %b = call i32 @loop(i32 %a)
+  call void @store(i32 %b)
+  ret i32 %b
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, subprograms: !2)
+!1 = !DIFile(filename: "parallel.c", directory: "/")
+!2 = !{!4}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!4 = distinct !DISubprogram(name: "store", scope: !1, file: !1, line: 1, type: !5, isDefinition: true)
+!5 = !DISubroutineType(types: !6)
+!6 = !{null}
+!7 = !DILocation(line: 2, scope: !4)
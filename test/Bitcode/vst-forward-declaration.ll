@@ -1,9 +1,11 @@
 ; RUN: llvm-as < %s | llvm-bcanalyzer -dump | FileCheck %s -check-prefix=BC
 ; Check for VST forward declaration record and VST function index records.
+; The module-level names are blobs.
 
 ; BC: <VSTOFFSET
-; BC: <FNENTRY
-; BC: <FNENTRY
+; BC-DAG: <FNENTRY {{.*}} blob data = 'foo'
+; BC-DAG: <FNENTRY {{.*}} blob data = 'bar'
+; BC-DAG: <ENTRY {{.*}} blob data = 'baz'
 
 ; RUN: llvm-as < %s | llvm-dis | FileCheck %s
 ; Check that this round-trips correctly.
@@ -27,3 +29,6 @@ define i32 @bar(i32 %x) #0 {
 entry:
   ret i32 %x
 }
+
+; CHECK: declare void @baz()
+declare void @baz()
@@ -0,0 +1,193 @@
+; RUN: llc -march=nios2 -verify-machineinstrs < %s \
+; RUN:   | FileCheck %s --check-prefix=CHECK --check-prefix=MUL
+; RUN: llc -march=nios2 -mattr=-hw-mul -verify-machineinstrs < %s \
+; RUN:   | FileCheck %s --check-prefix=CHECK --check-prefix=NOMUL
+; RUN: llc -march=nios2 -nios2-custom-bswap=5 -nios2-custom-ctz=6 \
+; RUN:   -nios2-custom-clz=7 -nios2-custom-popcount=8 -verify-machineinstrs < %s \
+; RUN:   | FileCheck %s --check-prefix=CUSTOM
+; RUN: llc -march=nios2 -mattr=-hw-mul -nios2-custom-bswap=5 -show-mc-encoding < %s \
+; RUN:   | FileCheck %s --check-prefix=ENC
+
+; Rotates are native, and a rotate right by an immediate is roli by its
+; complement.
+
+; CHECK-LABEL: rotl:
+; CHECK: rol r2, r4, r5
+; CHECK-NEXT: ret
+; ENC: rol r2, r4, r5 # encoding: [0x3a,0x18,0x44,0x21]
+define i32 @rotl(i32 %a, i32 %s) {
+  %l = shl i32 %a, %s
+  %n = sub i32 32, %s
+  %r = lshr i32 %a, %n
+  %o = or i32 %l, %r
+  ret i32 %o
+}
+
+; CHECK-LABEL: rotr:
+; CHECK: ror r2, r4, r5
+; CHECK-NEXT: ret
+; ENC: ror r2, r4, r5 # encoding: [0x3a,0x58,0x44,0x21]
+define i32 @rotr(i32 %a, i32 %s) {
+  %l = lshr i32 %a, %s
+  %n = sub i32 32, %s
+  %r = shl i32 %a, %n
+  %o = or i32 %l, %r
+  ret i32 %o
+}
+
+; CHECK-LABEL: rotli:
+; CHECK: roli r2, r4, 5
+; CHECK-NEXT: ret
+; ENC: roli r2, r4, 5 # encoding: [0x7a,0x11,0x04,0x20]
+define i32 @rotli(i32 %a) {
+  %l = shl i32 %a, 5
+  %r = lshr i32 %a, 27
+  %o = or i32 %l, %r
+  ret i32 %o
+}
+
+; CHECK-LABEL: rotri:
+; CHECK: roli r2, r4, 27
+; CHECK-NEXT: ret
+; ENC: roli r2, r4, 27 # encoding: [0xfa,0x16,0x04,0x20]
+define i32 @rotri(i32 %a) {
+  %l = lshr i32 %a, 5
+  %r = shl i32 %a, 27
+  %o = or i32 %l, %r
+  ret i32 %o
+}
+
+; bswap is two rotates and a select with the mask 0x00ff00ff.
+; CHECK-LABEL: bswap:
+; CHECK: roli [[B:r[0-9]+]], r4, 24
+; CHECK-NEXT: roli [[A:r[0-9]+]], r4, 8
+; CHECK-NEXT: xor [[D:r[0-9]+]], [[A]], [[B]]
+; CHECK-NEXT: orhi [[M:r[0-9]+]], zero, 255
+; CHECK-NEXT: ori [[M]], [[M]], 255
+; CHECK-NEXT: and [[D]], [[D]], [[M]]
+; CHECK-NEXT: xor r2, [[B]], [[D]]
+; CHECK-NEXT: ret
+; CUSTOM-LABEL: bswap:
+; CUSTOM: custom 5, r2, r4, zero
+; CUSTOM-NEXT: ret
+; ENC: custom 5, r2, r4, zero # encoding: [0x72,0xc1,0x05,0x20]
+define i32 @bswap(i32 %a) {
+  %r = call i32 @llvm.bswap.i32(i32 %a)
+  ret i32 %r
+}
+
+; With the multiplier, ctz isolates the lowest set bit and looks up its
+; position with a de Bruijn multiply. A zero input adds 32 without a branch.
+; Without the multiplier, it counts the bits below the lowest set bit.
+; CHECK-LABEL: cttz:
+; MUL-NOT: LBB
+; MUL: sub [[N:r[0-9]+]], zero, r4
+; MUL-NEXT: and [[LOW:r[0-9]+]], r4, [[N]]
+; MUL-NEXT: orhi [[K:r[0-9]+]], zero, 1916
+; MUL-NEXT: ori [[K]], [[K]], 46385
+; MUL-NEXT: mul [[P:r[0-9]+]], [[LOW]], [[K]]
+; MUL-NEXT: srli [[IDX:r[0-9]+]], [[P]], 27
+; MUL-NEXT: orhi [[T:r[0-9]+]], zero, %hiadj([[TAB:CPI[0-9_]+]])
+; MUL-NEXT: add [[E:r[0-9]+]], [[T]], [[IDX]]
+; MUL-NEXT: ldbu [[R:r[0-9]+]], %lo([[TAB]])([[E]])
+; MUL-NEXT: cmpeqi [[Z:r[0-9]+]], r4, 0
+; MUL-NEXT: slli [[Z]], [[Z]], 5
+; MUL-NEXT: add r2, [[R]], [[Z]]
+; MUL-NEXT: ret
+; NOMUL: beq r4, zero, [[EXIT:LBB[0-9_]+]]
+; NOMUL: addi [[M1:r[0-9]+]], r4, -1
+; NOMUL-NEXT: nor [[NX:r[0-9]+]], r4, zero
+; NOMUL-NEXT: and {{r[0-9]+}}, [[NX]], [[M1]]
+; NOMUL-NOT: mul
+; NOMUL: [[EXIT]]:
+; CUSTOM-LABEL: cttz:
+; CUSTOM: custom 6, r2, r4, zero
+; CUSTOM-NEXT: ret
+define i32 @cttz(i32 %a) {
+  %r = call i32 @llvm.cttz.i32(i32 %a, i1 false)
+  ret i32 %r
+}
+
+; CHECK-LABEL: cttz_undef:
+; MUL: mul
+; MUL-NOT: cmpeqi
+; MUL: ret
+; CUSTOM-LABEL: cttz_undef:
+; CUSTOM: custom 6, r2, r4, zero
+; CUSTOM-NEXT: ret
+define i32 @cttz_undef(i32 %a) {
+  %r = call i32 @llvm.cttz.i32(i32 %a, i1 true)
+  ret i32 %r
+}
+
+; clz smears the highest set bit to the right, then looks up its position
+; with a de Bruijn multiply, or counts the clear bits without the multiplier.
+; A zero input looks up 31 and adds one.
+; CHECK-LABEL: ctlz:
+; MUL-NOT: LBB
+; CHECK: srli [[S1:r[0-9]+]], r4, 1
+; CHECK-NEXT: or [[X:r[0-9]+]], r4, [[S1]]
+; CHECK-NEXT: srli [[S2:r[0-9]+]], [[X]], 2
+; CHECK-NEXT: or [[X]], [[X]], [[S2]]
+; CHECK-NEXT: srli [[S4:r[0-9]+]], [[X]], 4
+; CHECK-NEXT: or [[X]], [[X]], [[S4]]
+; CHECK-NEXT: srli [[S8:r[0-9]+]], [[X]], 8
+; CHECK-NEXT: or [[X]], [[X]], [[S8]]
+; CHECK-NEXT: srli [[S16:r[0-9]+]], [[X]], 16
+; MUL-NEXT: or [[X]], [[X]], [[S16]]
+; MUL-NEXT: orhi [[K:r[0-9]+]], zero, 1988
+; MUL-NEXT: ori [[K]], [[K]], 44253
+; MUL-NEXT: mul
+; MUL: cmpeqi [[Z:r[0-9]+]], r4, 0
+; MUL-NEXT: ldbu [[R:r[0-9]+]], %lo(CPI
+; MUL-NEXT: add r2, [[R]], [[Z]]
+; MUL-NEXT: ret
+; NOMUL-NEXT: nor [[X]], [[X]], [[S16]]
+; NOMUL-NOT: mul
+; NOMUL: andi r2, {{r[0-9]+}}, 63
+; CUSTOM-LABEL: ctlz:
+; CUSTOM: custom 7, r2, r4, zero
+; CUSTOM-NEXT: ret
+define i32 @ctlz(i32 %a) {
+  %r = call i32 @llvm.ctlz.i32(i32 %a, i1 false)
+  ret i32 %r
+}
+
+; CUSTOM-LABEL: ctlz_undef:
+; CUSTOM: custom 7, r2, r4, zero
+; CUSTOM-NEXT: ret
+define i32 @ctlz_undef(i32 %a) {
+  %r = call i32 @llvm.ctlz.i32(i32 %a, i1 true)
+  ret i32 %r
+}
+
+; With the multiplier, popcount sums the bytes with a multiply by 0x01010101.
+; Without it, they are summed with shifts.
+; CHECK-LABEL: ctpop:
+; MUL: orhi [[K:r[0-9]+]], zero, 257
+; MUL-NEXT: ori [[K]], [[K]], 257
+; MUL-NEXT: mul [[P:r[0-9]+]], {{r[0-9]+}}, [[K]]
+; MUL-NEXT: srli r2, [[P]], 24
+; MUL-NEXT: ret
+; NOMUL-NOT: mul
+; NOMUL: orhi [[K:r[0-9]+]], zero, 3855
+; NOMUL-NEXT: ori [[K]], [[K]], 3855
+; NOMUL-NEXT: and [[V:r[0-9]+]], [[V]], [[K]]
+; NOMUL-NEXT: srli [[T:r[0-9]+]], [[V]], 8
+; NOMUL-NEXT: add [[V]], [[V]], [[T]]
+; NOMUL-NEXT: srli [[T]], [[V]], 16
+; NOMUL-NEXT: add [[V]], [[V]], [[T]]
+; NOMUL-NEXT: andi r2, [[V]], 63
+; NOMUL-NEXT: ret
+; CUSTOM-LABEL: ctpop:
+; CUSTOM: custom 8, r2, r4, zero
+; CUSTOM-NEXT: ret
+define i32 @ctpop(i32 %a) {
+  %r = call i32 @llvm.ctpop.i32(i32 %a)
+  ret i32 %r
+}
+
+declare i32 @llvm.bswap.i32(i32)
+declare i32 @llvm.cttz.i32(i32, i1)
+declare i32 @llvm.ctlz.i32(i32, i1)
+declare i32 @llvm.ctpop.i32(i32)
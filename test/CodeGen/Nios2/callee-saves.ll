@@ -0,0 +1,47 @@
+; RUN: llc -march=nios2 < %s | FileCheck %s
+
+; "call" overwrites $ra, so a function that makes calls saves it.
+; CHECK-LABEL: nonleaf:
+; CHECK: addi sp, sp, -24
+; CHECK: .cfi_def_cfa_offset 24
+; CHECK-NEXT: stw ra, 20(sp)
+; CHECK: .cfi_offset ra, -4
+; CHECK-NEXT: call g
+; CHECK-NEXT: ldw ra, 20(sp)
+; CHECK-NEXT: addi sp, sp, 24
+; CHECK-NEXT: ret
+define void @nonleaf() {
+  call void @g()
+  ret void
+}
+
+; $fp is callee-saved in the Nios II ABI; the prologue saves it before
+; pointing it at the frame.
+; CHECK-LABEL: framepointer:
+; CHECK: stw ra, 4(sp)
+; CHECK-NEXT: stw fp, 0(sp)
+; CHECK: .cfi_offset ra, -4
+; CHECK: .cfi_offset fp, -8
+; CHECK-NEXT: add fp, sp, zero
+; CHECK: add sp, fp, zero
+; CHECK-NEXT: ldw fp, 0(sp)
+; CHECK-NEXT: ldw ra, 4(sp)
+; CHECK-NEXT: addi sp, sp, 8
+; CHECK-NEXT: ret
+define void @framepointer(i32 %n) "no-frame-pointer-elim"="true" {
+  %a = alloca i32, i32 %n
+  call void @h(i32* %a)
+  ret void
+}
+
+; A leaf function keeps its return address in $ra.
+; CHECK-LABEL: leaf:
+; CHECK-NOT: ra
+; CHECK: ret
+define i32 @leaf(i32 %x) {
+  %y = add i32 %x, 1
+  ret i32 %y
+}
+
+declare void @g()
+declare void @h(i32*)
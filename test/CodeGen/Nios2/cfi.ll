@@ -0,0 +1,106 @@
+; RUN: llc -march=nios2 < %s | FileCheck %s
+
+; A frame set up in the entry block is described once, after the saves.
+; CHECK-LABEL: full:
+; CHECK: .cfi_startproc
+; CHECK: addi sp, sp, -32
+; CHECK: .cfi_def_cfa_offset 32
+; CHECK-NEXT: stw ra, 28(sp)
+; CHECK-NEXT: stw r16, 24(sp)
+; CHECK-NEXT: stw r17, 20(sp)
+; CHECK: .cfi_offset ra, -4
+; CHECK: .cfi_offset r16, -8
+; CHECK: .cfi_offset r17, -12
+; CHECK-NOT: .cfi_
+; CHECK: .cfi_endproc
+define void @full(i32 %x, i32* %p) {
+entry:
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %exit, label %call
+call:
+  %r = call i32 @f(i32 %x)
+  store volatile i32 %r, i32* %p
+  %r2 = call i32 @f(i32 %r)
+  store volatile i32 %r2, i32* %p
+  br label %exit
+exit:
+  store volatile i32 %x, i32* %p
+  ret void
+}
+
+; Without nounwind the function needs an unwind table entry, so the frame is
+; kept in the entry block where its CFI is right for every block.
+; CHECK-LABEL: shrinkwrap:
+; CHECK: .cfi_startproc
+; CHECK-NEXT: # BB#0:
+; CHECK-NEXT: addi sp, sp, -24
+; CHECK: .cfi_def_cfa_offset 24
+; CHECK: beq r4, zero, [[EXIT:LBB[0-9_]+]]
+; CHECK: [[EXIT]]:
+; CHECK-NEXT: ldw ra, 20(sp)
+; CHECK-NEXT: addi sp, sp, 24
+; CHECK-NEXT: ret
+; CHECK: .cfi_endproc
+define i32 @shrinkwrap(i32 %x) {
+entry:
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %exit, label %call
+call:
+  %r = call i32 @f(i32 %x)
+  br label %exit
+exit:
+  %v = phi i32 [ 0, %entry ], [ %r, %call ]
+  ret i32 %v
+}
+
+; A nounwind function without debug info gets no CFI and is shrink-wrapped:
+; the early exit runs without a frame.
+; CHECK-LABEL: shrinkwrap_nounwind:
+; CHECK-NOT: .cfi_
+; CHECK: beq r4, zero, [[EXIT:LBB[0-9_]+]]
+; CHECK: addi sp, sp, -24
+; CHECK-NEXT: stw ra, 20(sp)
+; CHECK-NEXT: call f
+; CHECK-NEXT: ldw ra, 20(sp)
+; CHECK-NEXT: addi sp, sp, 24
+; CHECK-NEXT: [[EXIT]]:
+; CHECK-NEXT: ret
+; CHECK-NOT: .cfi_
+; CHECK: .size shrinkwrap_nounwind
+define i32 @shrinkwrap_nounwind(i32 %x) nounwind {
+entry:
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %exit, label %call
+call:
+  %r = call i32 @f(i32 %x)
+  br label %exit
+exit:
+  %v = phi i32 [ 0, %entry ], [ %r, %call ]
+  ret i32 %v
+}
+
+; Functions with a personality are not shrink-wrapped.
+; CHECK-LABEL: eh:
+; CHECK: .cfi_startproc
+; CHECK-NEXT: .cfi_personality
+; CHECK-NEXT: .cfi_lsda
+; CHECK-NEXT: # BB#0:
+; CHECK-NEXT: addi sp, sp, -24
+; CHECK-NOT: .cfi_restore
+; CHECK: .cfi_endproc
+define i32 @eh(i32 %x) personality i32 (...)* @__gxx_personality_v0 {
+entry:
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %exit, label %call
+call:
+  %r = invoke i32 @f(i32 %x) to label %exit unwind label %lpad
+lpad:
+  %l = landingpad { i8*, i32 } cleanup
+  ret i32 -1
+exit:
+  %v = phi i32 [ 0, %entry ], [ %r, %call ]
+  ret i32 %v
+}
+
+declare i32 @f(i32)
+declare i32 @__gxx_personality_v0(...)
@@ -0,0 +1,83 @@
+; RUN: llc -march=nios2 -verify-machineinstrs < %s | FileCheck %s
+; RUN: llc -march=nios2 -nios2-global-merge=false \
+; RUN:   -disable-nios2-hi-base-reuse < %s | FileCheck %s --check-prefix=OFF
+; RUN: llc -march=nios2 -nios2-global-merge=true < %s \
+; RUN:   | FileCheck %s --check-prefix=EXT
+
+@a = internal global i32 0
+@b = internal global i32 0
+@c = internal global i32 0
+
+; GlobalMerge packs @a, @b and @c into one symbol, so a single %hiadj base
+; reaches all three.
+; CHECK-LABEL: merged:
+; CHECK: orhi r2, zero, %hiadj(_MergedGlobals)
+; CHECK-NEXT: stw r4, %lo(_MergedGlobals)(r2)
+; CHECK-NEXT: addi r2, r2, %lo(_MergedGlobals)
+; CHECK-NEXT: stw r4, 4(r2)
+; CHECK-NEXT: stw r4, 8(r2)
+; CHECK-NEXT: ret
+; OFF-LABEL: merged:
+; OFF: orhi r2, zero, %hiadj(a)
+; OFF: orhi r2, zero, %hiadj(b)
+; OFF: orhi r2, zero, %hiadj(c)
+define void @merged(i32 %x) {
+  store i32 %x, i32* @a
+  store i32 %x, i32* @b
+  store i32 %x, i32* @c
+  ret void
+}
+
+@e1 = global i32 0
+@e2 = global i32 0
+
+; External globals keep their own symbols unless -nios2-global-merge is given.
+; CHECK-LABEL: external:
+; CHECK: orhi r2, zero, %hiadj(e1)
+; CHECK: orhi r2, zero, %hiadj(e2)
+; EXT-LABEL: external:
+; EXT: orhi r2, zero, %hiadj(_MergedGlobals
+; EXT-NOT: %hiadj
+; EXT: ret
+define void @external(i32 %x) {
+  store i32 %x, i32* @e1
+  store i32 %x, i32* @e2
+  ret void
+}
+
+@g = global [4 x i32] zeroinitializer
+
+; The accesses to @g sit in sibling blocks, where MachineCSE cannot share
+; their orhi. One base is built in the dominating block instead.
+; CHECK-LABEL: reuse:
+; CHECK: orhi r2, zero, %hiadj(g)
+; CHECK-NEXT: addi r2, r2, %lo(g)
+; CHECK-NOT: %hiadj
+; CHECK: stw r5, 0(r2)
+; CHECK-NOT: %hiadj
+; CHECK: stw r5, 8(r2)
+; CHECK-NOT: %hiadj
+; CHECK: stw r5, 4(r2)
+; CHECK: .cfi_endproc
+; OFF-LABEL: reuse:
+; OFF: orhi r2, zero, %hiadj(g)
+; OFF-NEXT: stw r5, %lo(g)(r2)
+; OFF: orhi r2, zero, %hiadj(g)
+; OFF: orhi r2, zero, %hiadj(g)
+define void @reuse(i32 %s, i32 %x) {
+entry:
+  switch i32 %s, label %exit [ i32 0, label %a
+                               i32 1, label %b
+                               i32 2, label %c ]
+a:
+  store volatile i32 %x, i32* getelementptr ([4 x i32], [4 x i32]* @g, i32 0, i32 0)
+  br label %exit
+b:
+  store volatile i32 %x, i32* getelementptr ([4 x i32], [4 x i32]* @g, i32 0, i32 1)
+  br label %exit
+c:
+  store volatile i32 %x, i32* getelementptr ([4 x i32], [4 x i32]* @g, i32 0, i32 2)
+  br label %exit
+exit:
+  ret void
+}
@@ -0,0 +1,192 @@
+; RUN: llc -march=nios2 -verify-machineinstrs < %s | FileCheck %s
+
+; Nios2 has no carry flag. The carry of an i64 add and the borrow of an i64
+; sub are recovered with one cmpltu each.
+
+; CHECK-LABEL: add64:
+; CHECK: add r3, r5, r7
+; CHECK-NEXT: add r2, r4, r6
+; CHECK-NEXT: cmpltu [[C:r[0-9]+]], r2, r4
+; CHECK-NEXT: add r3, r3, [[C]]
+; CHECK-NEXT: ret
+define i64 @add64(i64 %a, i64 %b) {
+  %r = add i64 %a, %b
+  ret i64 %r
+}
+
+; CHECK-LABEL: sub64:
+; CHECK: sub [[HI:r[0-9]+]], r5, r7
+; CHECK-NEXT: cmpltu [[B:r[0-9]+]], r4, r6
+; CHECK-NEXT: sub r3, [[HI]], [[B]]
+; CHECK-NEXT: sub r2, r4, r6
+; CHECK-NEXT: ret
+define i64 @sub64(i64 %a, i64 %b) {
+  %r = sub i64 %a, %b
+  ret i64 %r
+}
+
+; CHECK-LABEL: uaddo:
+; CHECK: add r2, r4, r5
+; CHECK-NEXT: cmpltu [[C:r[0-9]+]], r2, r4
+; CHECK-NEXT: stb [[C]], 0(r6)
+define i32 @uaddo(i32 %a, i32 %b, i1* %o) {
+  %s = call {i32, i1} @llvm.uadd.with.overflow.i32(i32 %a, i32 %b)
+  %v = extractvalue {i32, i1} %s, 0
+  %c = extractvalue {i32, i1} %s, 1
+  store i1 %c, i1* %o
+  ret i32 %v
+}
+
+; CHECK-LABEL: usubo:
+; CHECK: cmpltu [[B:r[0-9]+]], r4, r5
+; CHECK-NEXT: stb [[B]], 0(r6)
+; CHECK-NEXT: sub r2, r4, r5
+define i32 @usubo(i32 %a, i32 %b, i1* %o) {
+  %s = call {i32, i1} @llvm.usub.with.overflow.i32(i32 %a, i32 %b)
+  %v = extractvalue {i32, i1} %s, 0
+  %c = extractvalue {i32, i1} %s, 1
+  store i1 %c, i1* %o
+  ret i32 %v
+}
+
+; Ordered i64 compares are (hi CC' hi) | ((hi == hi) & (lo CCu lo)), with
+; no branch.
+
+; CHECK-LABEL: slt64:
+; CHECK-NOT: LBB
+; CHECK: cmpltu [[LO:r[0-9]+]], r4, r6
+; CHECK-NEXT: cmpeq [[EQ:r[0-9]+]], r5, r7
+; CHECK-NEXT: and [[LO]], [[EQ]], [[LO]]
+; CHECK-NEXT: cmplt [[HI:r[0-9]+]], r5, r7
+; CHECK-NEXT: or r2, [[HI]], [[LO]]
+; CHECK-NEXT: ret
+define i1 @slt64(i64 %a, i64 %b) {
+  %r = icmp slt i64 %a, %b
+  ret i1 %r
+}
+
+; CHECK-LABEL: sge64:
+; CHECK: cmpgeu [[LO:r[0-9]+]], r4, r6
+; CHECK-NEXT: cmpeq [[EQ:r[0-9]+]], r5, r7
+; CHECK-NEXT: and [[LO]], [[EQ]], [[LO]]
+; CHECK-NEXT: cmplt [[HI:r[0-9]+]], r7, r5
+; CHECK-NEXT: or r2, [[HI]], [[LO]]
+; CHECK-NEXT: ret
+define i1 @sge64(i64 %a, i64 %b) {
+  %r = icmp sge i64 %a, %b
+  ret i1 %r
+}
+
+; CHECK-LABEL: ult64:
+; CHECK: cmpltu [[LO:r[0-9]+]], r4, r6
+; CHECK-NEXT: cmpeq [[EQ:r[0-9]+]], r5, r7
+; CHECK-NEXT: and [[LO]], [[EQ]], [[LO]]
+; CHECK-NEXT: cmpltu [[HI:r[0-9]+]], r5, r7
+; CHECK-NEXT: or r2, [[HI]], [[LO]]
+; CHECK-NEXT: ret
+define i1 @ult64(i64 %a, i64 %b) {
+  %r = icmp ult i64 %a, %b
+  ret i1 %r
+}
+
+; CHECK-LABEL: ugt64:
+; CHECK: cmpltu [[LO:r[0-9]+]], r6, r4
+; CHECK-NEXT: cmpeq [[EQ:r[0-9]+]], r5, r7
+; CHECK-NEXT: and [[LO]], [[EQ]], [[LO]]
+; CHECK-NEXT: cmpltu [[HI:r[0-9]+]], r7, r5
+; CHECK-NEXT: or r2, [[HI]], [[LO]]
+; CHECK-NEXT: ret
+define i1 @ugt64(i64 %a, i64 %b) {
+  %r = icmp ugt i64 %a, %b
+  ret i1 %r
+}
+
+; Equality compares keep the generic xor/or expansion.
+; CHECK-LABEL: eq64:
+; CHECK: xor [[HI:r[0-9]+]], r5, r7
+; CHECK-NEXT: xor [[LO:r[0-9]+]], r4, r6
+; CHECK-NEXT: or [[X:r[0-9]+]], [[LO]], [[HI]]
+; CHECK-NEXT: cmpeqi r2, [[X]], 0
+; CHECK-NEXT: ret
+define i1 @eq64(i64 %a, i64 %b) {
+  %r = icmp eq i64 %a, %b
+  ret i1 %r
+}
+
+; A branch on an i64 compare tests the combined value once.
+; CHECK-LABEL: br64:
+; CHECK: cmpltu [[LO:r[0-9]+]], r6, r4
+; CHECK-NEXT: cmpeq [[EQ:r[0-9]+]], r5, r7
+; CHECK-NEXT: and [[LO]], [[EQ]], [[LO]]
+; CHECK-NEXT: cmplt [[HI:r[0-9]+]], r7, r5
+; CHECK-NEXT: or [[GT:r[0-9]+]], [[HI]], [[LO]]
+; CHECK-NEXT: bne [[GT]], zero, [[EXIT:LBB[0-9_]+]]
+; CHECK: call g
+; CHECK: [[EXIT]]:
+; CHECK-NEXT: ret
+define void @br64(i64 %a, i64 %b) nounwind {
+entry:
+  %c = icmp sle i64 %a, %b
+  br i1 %c, label %t, label %f
+t:
+  call void @g()
+  ret void
+f:
+  ret void
+}
+
+; Variable i64 shifts pick between the two *_PARTS results with a mask made
+; from bit 5 of the shift amount, again with no branch.
+
+; CHECK-LABEL: shl64:
+; CHECK-NOT: LBB
+; CHECK: sll [[LO:r[0-9]+]], r4, r6
+; CHECK-NEXT: slli [[T:r[0-9]+]], r6, 26
+; CHECK-NEXT: srai [[M:r[0-9]+]], [[T]], 31
+; CHECK-NEXT: xor
+; CHECK-NEXT: and {{r[0-9]+}}, {{r[0-9]+}}, [[M]]
+; CHECK-NEXT: xor r3
+; CHECK-NEXT: nor [[NM:r[0-9]+]], [[M]], zero
+; CHECK-NEXT: and r2, [[LO]], [[NM]]
+; CHECK-NEXT: ret
+define i64 @shl64(i64 %a, i64 %s) {
+  %r = shl i64 %a, %s
+  ret i64 %r
+}
+
+; CHECK-LABEL: lshr64:
+; CHECK-NOT: LBB
+; CHECK: srl [[HI:r[0-9]+]], r5, r6
+; CHECK-NEXT: slli [[T:r[0-9]+]], r6, 26
+; CHECK-NEXT: srai [[M:r[0-9]+]], [[T]], 31
+; CHECK-NEXT: xor
+; CHECK-NEXT: and {{r[0-9]+}}, {{r[0-9]+}}, [[M]]
+; CHECK-NEXT: xor r2
+; CHECK-NEXT: nor [[NM:r[0-9]+]], [[M]], zero
+; CHECK-NEXT: and r3, [[HI]], [[NM]]
+; CHECK-NEXT: ret
+define i64 @lshr64(i64 %a, i64 %s) {
+  %r = lshr i64 %a, %s
+  ret i64 %r
+}
+
+; For shift amounts of 32 and more, the high word is shifted by a further 31.
+; CHECK-LABEL: ashr64:
+; CHECK-NOT: LBB
+; CHECK: sra [[HI:r[0-9]+]], r5, r6
+; CHECK-NEXT: slli [[T:r[0-9]+]], r6, 26
+; CHECK-NEXT: srai [[M:r[0-9]+]], [[T]], 31
+; CHECK-NEXT: xor
+; CHECK-NEXT: and {{r[0-9]+}}, {{r[0-9]+}}, [[M]]
+; CHECK-NEXT: xor r2
+; CHECK-NEXT: andi [[S:r[0-9]+]], [[M]], 31
+; CHECK-NEXT: sra r3, [[HI]], [[S]]
+; CHECK-NEXT: ret
+define i64 @ashr64(i64 %a, i64 %s) {
+  %r = ashr i64 %a, %s
+  ret i64 %r
+}
+
+declare void @g()
+declare {i32, i1} @llvm.uadd.with.overflow.i32(i32, i32)
+declare {i32, i1} @llvm.usub.with.overflow.i32(i32, i32)
@@ -0,0 +1,98 @@
+; RUN: llc -march=nios2 -verify-machineinstrs < %s \
+; RUN:   | FileCheck %s --check-prefix=CHECK --check-prefix=STATIC
+; RUN: llc -march=nios2 -relocation-model=pic -verify-machineinstrs < %s \
+; RUN:   | FileCheck %s --check-prefix=CHECK --check-prefix=PIC
+; RUN: llc -march=nios2 -relocation-model=pic -filetype=obj < %s \
+; RUN:   | llvm-readobj -r | FileCheck %s --check-prefix=OBJ
+
+; A static jump table holds the addresses of the targets and is addressed
+; like any other local symbol.
+
+; STATIC-LABEL: sw:
+; STATIC: bltu {{r[0-9]+}}, r4, [[DEF:LBB[0-9_]+]]
+; STATIC: orhi [[HI:r[0-9]+]], zero, %hiadj([[JT:JTI[0-9_]+]])
+; STATIC-NEXT: addi [[BASE:r[0-9]+]], [[HI]], %lo([[JT]])
+; STATIC-NEXT: slli [[OFF:r[0-9]+]], r4, 2
+; STATIC-NEXT: add [[ADDR:r[0-9]+]], [[OFF]], [[BASE]]
+; STATIC-NEXT: ldw [[DEST:r[0-9]+]], 0([[ADDR]])
+; STATIC-NEXT: jmp [[DEST]]
+
+; A PIC jump table holds the offsets of the targets from the table, which is
+; found through the GOT pointer.
+
+; PIC-LABEL: sw:
+; PIC: nextpc [[GOT:r[0-9]+]]
+; PIC: bltu {{r[0-9]+}}, r4, [[DEF:LBB[0-9_]+]]
+; PIC: orhi [[HI:r[0-9]+]], zero, %gotoff_hiadj([[JT:JTI[0-9_]+]])
+; PIC-NEXT: add [[GOT]], [[HI]], [[GOT]]
+; PIC-NEXT: addi [[BASE:r[0-9]+]], [[GOT]], %gotoff_lo([[JT]])
+; PIC-NEXT: add [[ADDR:r[0-9]+]], {{r[0-9]+}}, [[BASE]]
+; PIC-NEXT: ldw [[ENTRY:r[0-9]+]], 0([[ADDR]])
+; PIC-NEXT: add [[DEST:r[0-9]+]], [[ENTRY]], [[BASE]]
+; PIC-NEXT: jmp [[DEST]]
+
+; The indirect jmp is not an analyzable branch, so the blocks after it stay
+; in place as the table's targets.
+; CHECK-NEXT: [[A:LBB[0-9_]+]]: # %a
+; CHECK: [[B:LBB[0-9_]+]]: # %b
+; CHECK: [[C:LBB[0-9_]+]]: # %c
+; CHECK: [[D:LBB[0-9_]+]]: # %d
+; CHECK: [[E:LBB[0-9_]+]]: # %e
+; CHECK: [[DEF]]: # %def
+; CHECK: .size sw
+
+; STATIC: .section .rodata
+; STATIC-NEXT: .align 2
+; STATIC-NEXT: [[JT]]:
+; STATIC-NEXT: .4byte [[A]]
+; STATIC-NEXT: .4byte [[B]]
+; STATIC-NEXT: .4byte [[C]]
+; STATIC-NEXT: .4byte [[D]]
+; STATIC-NEXT: .4byte [[E]]
+
+; Nios2 has no 32-bit PC-relative data relocation, so the PIC table stays in
+; the function's section, where the assembler resolves the differences.
+; PIC-NOT: .section
+; PIC: .align 2
+; PIC-NEXT: [[JT]]:
+; PIC-NEXT: .4byte [[A]]-[[JT]]
+; PIC-NEXT: .4byte [[B]]-[[JT]]
+; PIC-NEXT: .4byte [[C]]-[[JT]]
+; PIC-NEXT: .4byte [[D]]-[[JT]]
+; PIC-NEXT: .4byte [[E]]-[[JT]]
+
+; OBJ: Section ({{[0-9]+}}) .rela.text {
+; OBJ-NEXT: R_NIOS2_PCREL_HA _gp_got
+; OBJ-NEXT: R_NIOS2_PCREL_LO _gp_got
+; OBJ-NEXT: R_NIOS2_GOTOFF_HA .text
+; OBJ-NEXT: R_NIOS2_GOTOFF_LO .text
+; OBJ-NEXT: }
+; OBJ-NOT: .rela.rodata
+
+define i32 @sw(i32 %x, i32* %p) {
+entry:
+  switch i32 %x, label %def [
+    i32 0, label %a
+    i32 1, label %b
+    i32 2, label %c
+    i32 3, label %d
+    i32 4, label %e
+  ]
+a:
+  store volatile i32 10, i32* %p
+  br label %def
+b:
+  store volatile i32 11, i32* %p
+  br label %def
+c:
+  store volatile i32 12, i32* %p
+  br label %def
+d:
+  store volatile i32 13, i32* %p
+  br label %def
+e:
+  store volatile i32 14, i32* %p
+  br label %def
+def:
+  ret i32 0
+}
@@ -0,0 +1,62 @@
+; RUN: llc -march=nios2 < %s | FileCheck %s
+
+; Each constant is built with the shortest sequence: a sign-extended addi,
+; a zero-extended ori, a lone orhi when the low half is clear, or orhi+ori.
+
+; CHECK-LABEL: neg8:
+; CHECK: addi r2, zero, -8
+; CHECK-NEXT: ret
+define i32 @neg8() {
+  ret i32 -8
+}
+
+; CHECK-LABEL: minus32768:
+; CHECK: addi r2, zero, -32768
+; CHECK-NEXT: ret
+define i32 @minus32768() {
+  ret i32 -32768
+}
+
+; CHECK-LABEL: u16:
+; CHECK: ori r2, zero, 65528
+; CHECK-NEXT: ret
+define i32 @u16() {
+  ret i32 65528
+}
+
+; CHECK-LABEL: hi_only:
+; CHECK: orhi r2, zero, 2
+; CHECK-NEXT: ret
+define i32 @hi_only() {
+  ret i32 131072
+}
+
+; CHECK-LABEL: full:
+; CHECK: orhi r2, zero, 4660
+; CHECK-NEXT: ori r2, r2, 22136
+; CHECK-NEXT: ret
+define i32 @full() {
+  ret i32 305419896
+}
+
+; CHECK-LABEL: negative:
+; CHECK: orhi r2, zero, 65534
+; CHECK-NEXT: ori r2, r2, 31072
+; CHECK-NEXT: add r2, r4, r2
+define i32 @negative(i32 %x) {
+  %r = add i32 %x, -100000
+  ret i32 %r
+}
+
+; A LoadImm32 constant is rebuilt where it is needed instead of being
+; spilled across the call.
+; CHECK-LABEL: remat:
+; CHECK-NOT: stw {{r[0-9]+}}, {{[0-9]+}}(sp)
+; CHECK: call g
+; CHECK: orhi [[R:r[0-9]+]], zero, 4660
+; CHECK-NEXT: ori [[R]], [[R]], 22136
+declare void @g(i32)
+define i32 @remat(i32 %x) {
+  call void @g(i32 305419896)
+  ret i32 305419896
+}
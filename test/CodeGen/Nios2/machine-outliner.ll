@@ -0,0 +1,100 @@
+; RUN: llc -march=nios2 -verify-machineinstrs < %s | FileCheck %s
+; RUN: llc -march=nios2 -O0 < %s | FileCheck --check-prefix=O0 %s
+
+; The stores repeated between the calls are outlined into a function of their
+; own, which runs in the frame of its caller and returns with "ret". Nothing is
+; outlined at -O0.
+
+; O0-NOT: OUTLINED_FUNCTION
+
+; CHECK-LABEL: first:
+; CHECK: call g
+; CHECK-NEXT: call OUTLINED_FUNCTION_0
+; CHECK-NEXT: call g
+; CHECK-NEXT: call OUTLINED_FUNCTION_0
+; CHECK-NEXT: call g
+define void @first(i32* %p) minsize {
+entry:
+  store volatile i32 1, i32* %p
+  store volatile i32 2, i32* %p
+  store volatile i32 3, i32* %p
+  call void @g(i32* %p)
+  store volatile i32 1, i32* %p
+  store volatile i32 2, i32* %p
+  store volatile i32 3, i32* %p
+  call void @g(i32* %p)
+  store volatile i32 1, i32* %p
+  store volatile i32 2, i32* %p
+  store volatile i32 3, i32* %p
+  call void @g(i32* %p)
+  ret void
+}
+
+; $ra holds the return address throughout a leaf function, so a call would
+; clobber it.
+; CHECK-LABEL: leaf:
+; CHECK-NOT: call
+; CHECK: ret
+define void @leaf(i32* %p) minsize {
+entry:
+  store volatile i32 1, i32* %p
+  store volatile i32 2, i32* %p
+  store volatile i32 3, i32* %p
+  store volatile i32 1, i32* %p
+  store volatile i32 2, i32* %p
+  store volatile i32 3, i32* %p
+  store volatile i32 1, i32* %p
+  store volatile i32 2, i32* %p
+  store volatile i32 3, i32* %p
+  ret void
+}
+
+; The same code in another section gets a thunk in that section instead of
+; calling the one in .text.
+; CHECK: .section .boot.text
+; CHECK-LABEL: boot:
+; CHECK-NOT: OUTLINED_FUNCTION_0
+; CHECK: call OUTLINED_FUNCTION_1
+; CHECK-NOT: OUTLINED_FUNCTION_0
+; CHECK: call OUTLINED_FUNCTION_1
+; CHECK: .cfi_endproc
+define void @boot(i32* %p) minsize section ".boot.text" {
+entry:
+  store volatile i32 1, i32* %p
+  store volatile i32 2, i32* %p
+  store volatile i32 3, i32* %p
+  call void @g(i32* %p)
+  store volatile i32 1, i32* %p
+  store volatile i32 2, i32* %p
+  store volatile i32 3, i32* %p
+  call void @g(i32* %p)
+  store volatile i32 1, i32* %p
+  store volatile i32 2, i32* %p
+  store volatile i32 3, i32* %p
+  call void @g(i32* %p)
+  ret void
+}
+
+; CHECK: .text
+; CHECK-NEXT: .align 2
+; CHECK-NEXT: .type OUTLINED_FUNCTION_0,@function
+; CHECK-NEXT: OUTLINED_FUNCTION_0:
+; CHECK-NEXT: .cfi_startproc
+; CHECK-NEXT: # BB#0:
+; CHECK-NEXT: stw r17, 0(r16)
+; CHECK-NEXT: stw r18, 0(r16)
+; CHECK-NEXT: stw r19, 0(r16)
+; CHECK-NEXT: or r4, r16, zero
+; CHECK-NEXT: ret
+; CHECK: .cfi_endproc
+
+; CHECK: .section .boot.text
+; CHECK-NEXT: .align 2
+; CHECK-NEXT: .type OUTLINED_FUNCTION_1,@function
+; CHECK-NEXT: OUTLINED_FUNCTION_1:
+; CHECK-NEXT: .cfi_startproc
+; CHECK-NOT: sp
+; CHECK: ret
+; CHECK: .cfi_endproc
+
+declare void @g(i32*)
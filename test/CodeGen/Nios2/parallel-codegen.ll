@@ -0,0 +1,79 @@
+; RUN: llc -march=nios2 -j2 -o %t.s %s
+; RUN: FileCheck %s < %t.s
+
+; The output is the same from one run to the next.
+; RUN: llc -march=nios2 -j2 -o %t2.s %s
+; RUN: cmp %t.s %t2.s
+
+; Nios2 has no assembly parser to join the partitions into one object, so an
+; object file is compiled serially.
+; RUN: llc -march=nios2 -j2 -filetype=obj -o %t.o %s
+; RUN: llc -march=nios2 -filetype=obj -o %t.serial.o %s
+; RUN: cmp %t.serial.o %t.o
+
+; RUN: not llc -march=nios2 -j2 -compile-twice -o %t3 %s 2>&1 \
+; RUN:     | FileCheck --check-prefix=ERR %s
+; ERR: -j can't be used with {{.*}}-compile-twice
+
+; The most expensive function gets a partition of its own; the others share
+; the second one, with the local they both call. Both partitions go to the
+; one output. The labels the second partition numbers privately get a suffix
+; so that they do not clash with the ones of the first.
+; CHECK: big:
+; CHECK: beq r4, zero, [[BIG_ZERO:LBB0_[0-9]+]]
+; CHECK: [[BIG_ZERO]]:
+; CHECK: .LCfunc_end0:
+; CHECK-NEXT: .size big, .LCfunc_end0-big
+; CHECK: .text
+; CHECK: helper:
+; CHECK: .LCfunc_end0.p1:
+; CHECK-NEXT: .size helper, .LCfunc_end0.p1-helper
+; CHECK: small1:
+; CHECK: beq r4, zero, [[SMALL_ZERO:LBB[0-9]+_[0-9]+]].p1
+; CHECK: call helper
+; CHECK: [[SMALL_ZERO]].p1:
+; CHECK: small2:
+; CHECK: call helper
+
+define i32 @big(i32 %a, i32 %b) {
+entry:
+  %c = icmp eq i32 %a, 0
+  br i1 %c, label %zero, label %work
+zero:
+  ret i32 %b
+work:
+  %0 = mul i32 %a, %b
+  %1 = add i32 %0, %a
+  %2 = xor i32 %1, %b
+  %3 = mul i32 %2, %2
+  %4 = sub i32 %3, %a
+  %5 = and i32 %4, %b
+  %6 = or i32 %5, %0
+  %7 = shl i32 %6, 3
+  %8 = add i32 %7, %1
+  %9 = mul i32 %8, %3
+  ret i32 %9
+}
+
+define internal i32 @helper(i32 %a) noinline {
+entry:
+  %0 = add i32 %a, 1
+  ret i32 %0
+}
+
+define i32 @small1(i32 %a) {
+entry:
+  %c = icmp eq i32 %a, 0
+  br i1 %c, label %zero, label %call
+zero:
+  ret i32 0
+call:
+  %0 = call i32 @helper(i32 %a)
+  ret i32 %0
+}
+
+define i32 @small2(i32 %a) {
+entry:
+  %0 = call i32 @helper(i32 %a)
+  ret i32 %0
+}
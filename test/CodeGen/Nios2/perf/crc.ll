@@ -0,0 +1,98 @@
+; CRC-32 kernels: the bitwise form is shift and xor bound, the table form is
+; load bound.
+; RUN: %python %p/../../../../utils/Target/Nios2/codegen-perf.py --llc llc %s
+
+target triple = "nios2"
+
+@crc32_table = external constant [256 x i32]
+
+define i32 @crc32_bitwise(i8* %p, i32 %n, i32 %crc) {
+entry:
+  %init = xor i32 %crc, -1
+  %empty = icmp eq i32 %n, 0
+  br i1 %empty, label %exit, label %bytes
+
+bytes:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %bits.done ]
+  %c = phi i32 [ %init, %entry ], [ %c.bits, %bits.done ]
+  %addr = getelementptr inbounds i8, i8* %p, i32 %i
+  %b = load i8, i8* %addr, align 1
+  %bz = zext i8 %b to i32
+  %c.in = xor i32 %c, %bz
+  br label %bits
+
+bits:
+  %k = phi i32 [ 0, %bytes ], [ %k.next, %bits ]
+  %v = phi i32 [ %c.in, %bytes ], [ %v.next, %bits ]
+  %lsb = and i32 %v, 1
+  %mask = sub i32 0, %lsb
+  %poly = and i32 %mask, -306674912
+  %shr = lshr i32 %v, 1
+  %v.next = xor i32 %shr, %poly
+  %k.next = add nuw nsw i32 %k, 1
+  %k.done = icmp eq i32 %k.next, 8
+  br i1 %k.done, label %bits.done, label %bits
+
+bits.done:
+  %c.bits = phi i32 [ %v.next, %bits ]
+  %i.next = add nuw i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %bytes
+
+exit:
+  %r = phi i32 [ %init, %entry ], [ %c.bits, %bits.done ]
+  %res = xor i32 %r, -1
+  ret i32 %res
+}
+
+define i32 @crc32_table_driven(i8* %p, i32 %n, i32 %crc) {
+entry:
+  %init = xor i32 %crc, -1
+  %empty = icmp eq i32 %n, 0
+  br i1 %empty, label %exit, label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %c = phi i32 [ %init, %entry ], [ %c.next, %loop ]
+  %addr = getelementptr inbounds i8, i8* %p, i32 %i
+  %b = load i8, i8* %addr, align 1
+  %bz = zext i8 %b to i32
+  %x = xor i32 %c, %bz
+  %idx = and i32 %x, 255
+  %tp = getelementptr inbounds [256 x i32], [256 x i32]* @crc32_table, i32 0, i32 %idx
+  %t = load i32, i32* %tp, align 4
+  %shr = lshr i32 %c, 8
+  %c.next = xor i32 %t, %shr
+  %i.next = add nuw i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i32 [ %init, %entry ], [ %c.next, %loop ]
+  %res = xor i32 %r, -1
+  ret i32 %res
+}
+
+define zeroext i16 @crc16_ccitt_byte(i16 zeroext %crc, i8 zeroext %b) {
+entry:
+  %c = zext i16 %crc to i32
+  %bz = zext i8 %b to i32
+  %hi = lshr i32 %c, 8
+  %lo = shl i32 %c, 8
+  %sw = or i32 %hi, %lo
+  %x0 = xor i32 %sw, %bz
+  %t0 = and i32 %x0, 255
+  %t1 = lshr i32 %t0, 4
+  %x1 = xor i32 %x0, %t1
+  %t2 = shl i32 %x1, 12
+  %x2 = xor i32 %x1, %t2
+  %t3 = and i32 %x2, 255
+  %t4 = shl i32 %t3, 5
+  %x3 = xor i32 %x2, %t4
+  %r = trunc i32 %x3 to i16
+  ret i16 %r
+}
+
+; BASELINE: crc16_ccitt_byte 14 14
+; BASELINE: crc32_bitwise 20 22
+; BASELINE: crc32_table_driven 17 20
@@ -0,0 +1,67 @@
+; FIR filters: a generic 16-bit sample/coefficient multiply-accumulate loop
+; and a fixed 4-tap filter over a sliding window.
+; RUN: %python %p/../../../../utils/Target/Nios2/codegen-perf.py --llc llc %s
+
+target triple = "nios2"
+
+define i32 @fir_q15(i16* noalias %x, i16* noalias %h, i32 %taps) {
+entry:
+  %empty = icmp eq i32 %taps, 0
+  br i1 %empty, label %exit, label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %xp = getelementptr inbounds i16, i16* %x, i32 %i
+  %hp = getelementptr inbounds i16, i16* %h, i32 %i
+  %xv = load i16, i16* %xp, align 2
+  %hv = load i16, i16* %hp, align 2
+  %xs = sext i16 %xv to i32
+  %hs = sext i16 %hv to i32
+  %m = mul nsw i32 %xs, %hs
+  %acc.next = add nsw i32 %acc, %m
+  %i.next = add nuw i32 %i, 1
+  %done = icmp eq i32 %i.next, %taps
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %q = ashr i32 %r, 15
+  ret i32 %q
+}
+
+define void @fir4_block(i32* noalias %y, i32* noalias %x, i32 %n,
+                        i32 %c0, i32 %c1, i32 %c2, i32 %c3) {
+entry:
+  %empty = icmp eq i32 %n, 0
+  br i1 %empty, label %exit, label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %p0 = getelementptr inbounds i32, i32* %x, i32 %i
+  %p1 = getelementptr inbounds i32, i32* %p0, i32 1
+  %p2 = getelementptr inbounds i32, i32* %p0, i32 2
+  %p3 = getelementptr inbounds i32, i32* %p0, i32 3
+  %x0 = load i32, i32* %p0, align 4
+  %x1 = load i32, i32* %p1, align 4
+  %x2 = load i32, i32* %p2, align 4
+  %x3 = load i32, i32* %p3, align 4
+  %m0 = mul i32 %x0, %c0
+  %m1 = mul i32 %x1, %c1
+  %m2 = mul i32 %x2, %c2
+  %m3 = mul i32 %x3, %c3
+  %s0 = add i32 %m0, %m1
+  %s1 = add i32 %m2, %m3
+  %s = add i32 %s0, %s1
+  %yp = getelementptr inbounds i32, i32* %y, i32 %i
+  store i32 %s, i32* %yp, align 4
+  %i.next = add nuw i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; BASELINE: fir4_block 22 30
+; BASELINE: fir_q15 12 14
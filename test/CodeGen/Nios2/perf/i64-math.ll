@@ -0,0 +1,90 @@
+; 64-bit integer arithmetic on a 32-bit core: carry propagation, compares,
+; variable and constant shifts, and a timestamp accumulation loop.
+; RUN: %python %p/../../../../utils/Target/Nios2/codegen-perf.py --llc llc %s
+
+target triple = "nios2"
+
+define i64 @add64(i64 %a, i64 %b) {
+entry:
+  %r = add i64 %a, %b
+  ret i64 %r
+}
+
+define i64 @sub64(i64 %a, i64 %b) {
+entry:
+  %r = sub i64 %a, %b
+  ret i64 %r
+}
+
+define i32 @cmp64_slt(i64 %a, i64 %b) {
+entry:
+  %c = icmp slt i64 %a, %b
+  %r = zext i1 %c to i32
+  ret i32 %r
+}
+
+define i32 @cmp64_uge(i64 %a, i64 %b) {
+entry:
+  %c = icmp uge i64 %a, %b
+  %r = zext i1 %c to i32
+  ret i32 %r
+}
+
+define i64 @shl64_var(i64 %a, i32 %n) {
+entry:
+  %s = zext i32 %n to i64
+  %r = shl i64 %a, %s
+  ret i64 %r
+}
+
+define i64 @ashr64_var(i64 %a, i32 %n) {
+entry:
+  %s = zext i32 %n to i64
+  %r = ashr i64 %a, %s
+  ret i64 %r
+}
+
+define i64 @lshr64_const(i64 %a) {
+entry:
+  %r = lshr i64 %a, 23
+  ret i64 %r
+}
+
+define i64 @mul32x32_64(i32 %a, i32 %b) {
+entry:
+  %x = zext i32 %a to i64
+  %y = zext i32 %b to i64
+  %r = mul i64 %x, %y
+  ret i64 %r
+}
+
+define i64 @sum_deltas(i32* %ts, i32 %n) {
+entry:
+  %empty = icmp eq i32 %n, 0
+  br i1 %empty, label %exit, label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i64 [ 0, %entry ], [ %acc.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %ts, i32 %i
+  %v = load i32, i32* %p, align 4
+  %w = zext i32 %v to i64
+  %acc.next = add i64 %acc, %w
+  %i.next = add nuw i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ 0, %entry ], [ %acc.next, %loop ]
+  ret i64 %r
+}
+
+; BASELINE: add64 5 5
+; BASELINE: ashr64_var 14 14
+; BASELINE: cmp64_slt 6 6
+; BASELINE: cmp64_uge 6 6
+; BASELINE: lshr64_const 5 5
+; BASELINE: mul32x32_64 3 3
+; BASELINE: shl64_var 14 14
+; BASELINE: sub64 5 5
+; BASELINE: sum_deltas 15 17
@@ -0,0 +1,119 @@
+; Interrupt handling: a dispatcher that walks the pending interrupt bits and
+; calls the registered handlers, and handlers whose prologue and epilogue
+; save and restore callee-saved registers around calls.
+; RUN: %python %p/../../../../utils/Target/Nios2/codegen-perf.py --llc llc %s
+
+target triple = "nios2"
+
+%struct.isr_entry = type { void (i8*, i32)*, i8* }
+
+@isr_table = external global [32 x %struct.isr_entry]
+@ticks = external global i32
+@uart_rx = external global [64 x i8]
+@uart_head = external global i32
+
+declare i32 @llvm.nios2.rdctl(i32)
+declare void @llvm.nios2.wrctl(i32, i32)
+declare i32 @llvm.cttz.i32(i32, i1)
+declare void @wake_task(i32)
+
+define void @irq_dispatch() {
+entry:
+  %ienable = call i32 @llvm.nios2.rdctl(i32 3)
+  %ipending0 = call i32 @llvm.nios2.rdctl(i32 4)
+  %active0 = and i32 %ipending0, %ienable
+  %none = icmp eq i32 %active0, 0
+  br i1 %none, label %exit, label %loop
+
+loop:
+  %active = phi i32 [ %active0, %entry ], [ %active.next, %loop ]
+  %irq = call i32 @llvm.cttz.i32(i32 %active, i1 true)
+  %fnp = getelementptr inbounds [32 x %struct.isr_entry], [32 x %struct.isr_entry]* @isr_table, i32 0, i32 %irq, i32 0
+  %ctxp = getelementptr inbounds [32 x %struct.isr_entry], [32 x %struct.isr_entry]* @isr_table, i32 0, i32 %irq, i32 1
+  %fn = load void (i8*, i32)*, void (i8*, i32)** %fnp, align 4
+  %ctx = load i8*, i8** %ctxp, align 4
+  call void %fn(i8* %ctx, i32 %irq)
+  %ipending = call i32 @llvm.nios2.rdctl(i32 4)
+  %active.next = and i32 %ipending, %ienable
+  %more = icmp ne i32 %active.next, 0
+  br i1 %more, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define void @timer_isr(i8* %ctx, i32 %irq) {
+entry:
+  %regs = bitcast i8* %ctx to i32*
+  %status = getelementptr inbounds i32, i32* %regs, i32 0
+  store volatile i32 0, i32* %status, align 4
+  %t = load i32, i32* @ticks, align 4
+  %t.next = add i32 %t, 1
+  store i32 %t.next, i32* @ticks, align 4
+  %slice = and i32 %t.next, 15
+  %resched = icmp eq i32 %slice, 0
+  br i1 %resched, label %wake, label %exit
+
+wake:
+  call void @wake_task(i32 %t.next)
+  br label %exit
+
+exit:
+  ret void
+}
+
+define void @uart_isr(i8* %ctx, i32 %irq) {
+entry:
+  %regs = bitcast i8* %ctx to i32*
+  %rxdata = getelementptr inbounds i32, i32* %regs, i32 0
+  %statusp = getelementptr inbounds i32, i32* %regs, i32 2
+  %head0 = load i32, i32* @uart_head, align 4
+  br label %poll
+
+poll:
+  %head = phi i32 [ %head0, %entry ], [ %head.next, %store ]
+  %status = load volatile i32, i32* %statusp, align 4
+  %rrdy = and i32 %status, 128
+  %has = icmp ne i32 %rrdy, 0
+  br i1 %has, label %store, label %done
+
+store:
+  %d = load volatile i32, i32* %rxdata, align 4
+  %b = trunc i32 %d to i8
+  %slot = and i32 %head, 63
+  %bp = getelementptr inbounds [64 x i8], [64 x i8]* @uart_rx, i32 0, i32 %slot
+  store i8 %b, i8* %bp, align 1
+  %head.next = add i32 %head, 1
+  br label %poll
+
+done:
+  store i32 %head, i32* @uart_head, align 4
+  %lost = and i32 %status, 8
+  %overrun = icmp ne i32 %lost, 0
+  br i1 %overrun, label %report, label %exit
+
+report:
+  call void @wake_task(i32 %head)
+  store volatile i32 0, i32* %statusp, align 4
+  br label %exit
+
+exit:
+  ret void
+}
+
+define void @critical_section_update(i32* %counter, i32 %delta) {
+entry:
+  %status = call i32 @llvm.nios2.rdctl(i32 0)
+  %masked = and i32 %status, -2
+  call void @llvm.nios2.wrctl(i32 0, i32 %masked)
+  %v = load volatile i32, i32* %counter, align 4
+  %v.next = add i32 %v, %delta
+  store volatile i32 %v.next, i32* %counter, align 4
+  call void @llvm.nios2.wrctl(i32 0, i32 %status)
+  ret void
+}
+
+; BASELINE: critical_section_update 9 11
+; BASELINE: irq_dispatch 36 41
+; BASELINE: timer_isr 13 16
+; BASELINE: uart_isr 27 32
@@ -0,0 +1,105 @@
+; Block copy and fill kernels: word and byte loops, and small fixed-size
+; memcpy/memset calls that are expanded inline.
+; RUN: %python %p/../../../../utils/Target/Nios2/codegen-perf.py --llc llc %s
+
+target triple = "nios2"
+
+%struct.packet = type { i32, i32, i16, i16, [8 x i32] }
+
+declare void @llvm.memcpy.p0i8.p0i8.i32(i8*, i8*, i32, i32, i1)
+declare void @llvm.memset.p0i8.i32(i8*, i8, i32, i32, i1)
+
+define void @copy_words(i32* noalias %dst, i32* noalias %src, i32 %n) {
+entry:
+  %empty = icmp eq i32 %n, 0
+  br i1 %empty, label %exit, label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = getelementptr inbounds i32, i32* %src, i32 %i
+  %d = getelementptr inbounds i32, i32* %dst, i32 %i
+  %v = load i32, i32* %s, align 4
+  store i32 %v, i32* %d, align 4
+  %i.next = add nuw i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+define void @copy_words_unrolled(i32* noalias %dst, i32* noalias %src,
+                                 i32 %n) {
+entry:
+  %blocks = lshr i32 %n, 2
+  %empty = icmp eq i32 %blocks, 0
+  br i1 %empty, label %exit, label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32* [ %src, %entry ], [ %s.next, %loop ]
+  %d = phi i32* [ %dst, %entry ], [ %d.next, %loop ]
+  %s1 = getelementptr inbounds i32, i32* %s, i32 1
+  %s2 = getelementptr inbounds i32, i32* %s, i32 2
+  %s3 = getelementptr inbounds i32, i32* %s, i32 3
+  %d1 = getelementptr inbounds i32, i32* %d, i32 1
+  %d2 = getelementptr inbounds i32, i32* %d, i32 2
+  %d3 = getelementptr inbounds i32, i32* %d, i32 3
+  %v0 = load i32, i32* %s, align 4
+  %v1 = load i32, i32* %s1, align 4
+  %v2 = load i32, i32* %s2, align 4
+  %v3 = load i32, i32* %s3, align 4
+  store i32 %v0, i32* %d, align 4
+  store i32 %v1, i32* %d1, align 4
+  store i32 %v2, i32* %d2, align 4
+  store i32 %v3, i32* %d3, align 4
+  %s.next = getelementptr inbounds i32, i32* %s, i32 4
+  %d.next = getelementptr inbounds i32, i32* %d, i32 4
+  %i.next = add nuw i32 %i, 1
+  %done = icmp eq i32 %i.next, %blocks
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+define void @copy_bytes(i8* noalias %dst, i8* noalias %src, i32 %n) {
+entry:
+  %empty = icmp eq i32 %n, 0
+  br i1 %empty, label %exit, label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = getelementptr inbounds i8, i8* %src, i32 %i
+  %d = getelementptr inbounds i8, i8* %dst, i32 %i
+  %v = load i8, i8* %s, align 1
+  store i8 %v, i8* %d, align 1
+  %i.next = add nuw i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+define void @copy_packet(%struct.packet* noalias %dst,
+                         %struct.packet* noalias %src) {
+entry:
+  %d = bitcast %struct.packet* %dst to i8*
+  %s = bitcast %struct.packet* %src to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i32(i8* %d, i8* %s, i32 44, i32 4, i1 false)
+  ret void
+}
+
+define void @clear_packet(%struct.packet* %p) {
+entry:
+  %d = bitcast %struct.packet* %p to i8*
+  call void @llvm.memset.p0i8.i32(i8* %d, i8 0, i32 44, i32 4, i1 false)
+  ret void
+}
+
+; BASELINE: clear_packet 8 9
+; BASELINE: copy_bytes 8 10
+; BASELINE: copy_packet 23 45
+; BASELINE: copy_words 8 10
+; BASELINE: copy_words_unrolled 15 17
@@ -0,0 +1,131 @@
+; Switch dispatch: a dense opcode switch, a sparse switch, and a small state
+; machine stepping over an input buffer.
+; RUN: %python %p/../../../../utils/Target/Nios2/codegen-perf.py --llc llc %s
+
+target triple = "nios2"
+
+define i32 @dispatch_dense(i32 %op, i32 %a, i32 %b) {
+entry:
+  switch i32 %op, label %default [
+    i32 0, label %op.add
+    i32 1, label %op.sub
+    i32 2, label %op.and
+    i32 3, label %op.or
+    i32 4, label %op.xor
+    i32 5, label %op.shl
+    i32 6, label %op.shr
+    i32 7, label %op.mul
+  ]
+
+op.add:
+  %r0 = add i32 %a, %b
+  ret i32 %r0
+op.sub:
+  %r1 = sub i32 %a, %b
+  ret i32 %r1
+op.and:
+  %r2 = and i32 %a, %b
+  ret i32 %r2
+op.or:
+  %r3 = or i32 %a, %b
+  ret i32 %r3
+op.xor:
+  %r4 = xor i32 %a, %b
+  ret i32 %r4
+op.shl:
+  %r5 = shl i32 %a, %b
+  ret i32 %r5
+op.shr:
+  %r6 = lshr i32 %a, %b
+  ret i32 %r6
+op.mul:
+  %r7 = mul i32 %a, %b
+  ret i32 %r7
+default:
+  ret i32 0
+}
+
+define i32 @dispatch_sparse(i32 %id) {
+entry:
+  switch i32 %id, label %default [
+    i32 3, label %a
+    i32 17, label %b
+    i32 120, label %c
+    i32 1024, label %d
+    i32 65537, label %e
+  ]
+
+a:
+  br label %exit
+b:
+  br label %exit
+c:
+  br label %exit
+d:
+  br label %exit
+e:
+  br label %exit
+default:
+  br label %exit
+
+exit:
+  %r = phi i32 [ 10, %a ], [ 20, %b ], [ 30, %c ], [ 40, %d ], [ 50, %e ],
+               [ -1, %default ]
+  ret i32 %r
+}
+
+define i32 @token_state_machine(i8* %p, i32 %n) {
+entry:
+  %empty = icmp eq i32 %n, 0
+  br i1 %empty, label %exit, label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %next ]
+  %state = phi i32 [ 0, %entry ], [ %state.next, %next ]
+  %count = phi i32 [ 0, %entry ], [ %count.next, %next ]
+  %addr = getelementptr inbounds i8, i8* %p, i32 %i
+  %ch = load i8, i8* %addr, align 1
+  %c = zext i8 %ch to i32
+  switch i32 %state, label %next [
+    i32 0, label %s.space
+    i32 1, label %s.word
+    i32 2, label %s.quote
+  ]
+
+s.space:
+  %is.quote0 = icmp eq i32 %c, 34
+  %is.blank0 = icmp ule i32 %c, 32
+  %st0 = select i1 %is.blank0, i32 0, i32 1
+  %st0q = select i1 %is.quote0, i32 2, i32 %st0
+  %new = icmp ne i32 %st0q, 0
+  %inc = zext i1 %new to i32
+  %cnt0 = add i32 %count, %inc
+  br label %next
+
+s.word:
+  %is.blank1 = icmp ule i32 %c, 32
+  %st1 = select i1 %is.blank1, i32 0, i32 1
+  br label %next
+
+s.quote:
+  %is.quote2 = icmp eq i32 %c, 34
+  %st2 = select i1 %is.quote2, i32 0, i32 2
+  br label %next
+
+next:
+  %state.next = phi i32 [ %st0q, %s.space ], [ %st1, %s.word ],
+                        [ %st2, %s.quote ], [ 0, %loop ]
+  %count.next = phi i32 [ %cnt0, %s.space ], [ %count, %s.word ],
+                        [ %count, %s.quote ], [ %count, %loop ]
+  %i.next = add nuw i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i32 [ 0, %entry ], [ %count.next, %next ]
+  ret i32 %r
+}
+
+; BASELINE: dispatch_dense 26 28
+; BASELINE: dispatch_sparse 24 24
+; BASELINE: token_state_machine 32 32
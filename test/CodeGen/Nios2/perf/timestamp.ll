@@ -0,0 +1,69 @@
+; 64-bit timestamps: a tick counter bumped from the timer interrupt, the
+; elapsed time between two samples and the deadline checks built on it.
+; RUN: %python %p/../../../../utils/Target/Nios2/codegen-perf.py --llc llc %s
+
+target triple = "nios2"
+
+@jiffies = external global i64
+
+define void @tick() {
+entry:
+  %t = load volatile i64, i64* @jiffies, align 4
+  %t.next = add i64 %t, 1
+  store volatile i64 %t.next, i64* @jiffies, align 4
+  ret void
+}
+
+define i64 @elapsed(i64 %now, i64 %start) {
+entry:
+  %d = sub i64 %now, %start
+  ret i64 %d
+}
+
+define i1 @timed_out(i64 %now, i64 %start, i64 %timeout) {
+entry:
+  %d = sub i64 %now, %start
+  %r = icmp uge i64 %d, %timeout
+  ret i1 %r
+}
+
+; time_after(a, b): true if a is later than b, also across a wrap.
+define i1 @time_after(i64 %a, i64 %b) {
+entry:
+  %d = sub i64 %b, %a
+  %r = icmp slt i64 %d, 0
+  ret i1 %r
+}
+
+; Busy-wait until the tick counter reaches the deadline.
+define void @wait_until(i64 %deadline) {
+entry:
+  br label %loop
+
+loop:
+  %t = load volatile i64, i64* @jiffies, align 4
+  %d = sub i64 %deadline, %t
+  %pending = icmp sgt i64 %d, 0
+  br i1 %pending, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; Scale a tick count to microseconds, saturating at the largest timestamp.
+define i64 @ticks_to_us(i64 %ticks, i32 %us_per_tick) {
+entry:
+  %scale = zext i32 %us_per_tick to i64
+  %us = mul i64 %ticks, %scale
+  %hi = lshr i64 %ticks, 40
+  %big = icmp ne i64 %hi, 0
+  %r = select i1 %big, i64 -1, i64 %us
+  ret i64 %r
+}
+
+; BASELINE: elapsed 5 5
+; BASELINE: tick 10 12
+; BASELINE: ticks_to_us 12 12
+; BASELINE: time_after 5 5
+; BASELINE: timed_out 12 16
+; BASELINE: wait_until 15 19
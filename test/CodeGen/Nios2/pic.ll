@@ -0,0 +1,100 @@
+; RUN: llc -march=nios2 -relocation-model=pic < %s | FileCheck %s
+; RUN: llc -march=nios2 -relocation-model=pic -nios2-no-plt < %s \
+; RUN:   | FileCheck %s --check-prefix=NOPLT
+; RUN: llc -march=nios2 -relocation-model=pic -nios2-xgot < %s \
+; RUN:   | FileCheck %s --check-prefix=XGOT
+; RUN: llc -march=nios2 -relocation-model=pic -filetype=obj < %s -o %t
+; RUN: llvm-readobj -r %t | FileCheck %s --check-prefix=RELOC
+
+@ext = external global i32
+@loc = internal global i32 0
+@hid = hidden global i32 0
+
+declare void @extfn()
+declare void @nlb() nonlazybind
+
+define internal void @locfn() {
+  ret void
+}
+
+; The GOT pointer is computed from nextpc. Preemptible data is loaded from
+; its GOT entry, DSO-local data is addressed relative to the GOT.
+; CHECK-LABEL: data:
+; CHECK: nextpc r2
+; CHECK-NEXT: [[PC:\.LCtmp[0-9]+]]:
+; CHECK-NEXT: orhi at, zero, %hiadj(_gp_got-[[PC]])
+; CHECK-NEXT: addi at, at, %lo(_gp_got-[[PC]])
+; CHECK-NEXT: add r2, r2, at
+; CHECK-NEXT: ldw r3, %got(ext)(r2)
+; CHECK-NEXT: ldw r3, 0(r3)
+; CHECK-NEXT: orhi r4, zero, %gotoff_hiadj(loc)
+; CHECK-NEXT: add r4, r4, r2
+; CHECK-NEXT: ldw r4, %gotoff_lo(loc)(r4)
+; CHECK: orhi r4, zero, %gotoff_hiadj(hid)
+; CHECK-NEXT: add r2, r4, r2
+; CHECK-NEXT: ldw r2, %gotoff_lo(hid)(r2)
+; XGOT-LABEL: data:
+; XGOT: orhi r4, zero, %got_hiadj(ext)
+; XGOT-NEXT: add r4, r4, r2
+; XGOT-NEXT: ldw r4, %got_lo(ext)(r4)
+define i32 @data() {
+  %a = load i32, i32* @ext
+  %b = load i32, i32* @loc
+  %c = load i32, i32* @hid
+  %s = add i32 %a, %b
+  %t = add i32 %s, %c
+  ret i32 %t
+}
+
+; A preemptible callee goes through its lazily bound %call entry with the
+; GOT pointer in r22. "call" takes an absolute address, so an internal callee
+; is called through its %gotoff address instead. The address of a nonlazybind
+; callee is loaded from %got once and reused.
+; CHECK-LABEL: calls:
+; CHECK: nextpc r22
+; CHECK: add r22, r22, at
+; CHECK-NEXT: ldw r16, %got(nlb)(r22)
+; CHECK-NEXT: ldw r2, %call(extfn)(r22)
+; CHECK-NEXT: callr r2
+; CHECK-NEXT: orhi [[LOC:r[0-9]+]], zero, %gotoff_hiadj(locfn)
+; CHECK-NEXT: add [[LOC]], [[LOC]], r22
+; CHECK-NEXT: addi [[LOC]], [[LOC]], %gotoff_lo(locfn)
+; CHECK-NEXT: callr [[LOC]]
+; CHECK-NEXT: callr r16
+; CHECK-NEXT: callr r16
+; NOPLT-LABEL: calls:
+; NOPLT-NOT: r22
+; NOPLT: add [[GOT:r[0-9]+]], [[GOT]], at
+; NOPLT-NEXT: ldw [[EXT:r[0-9]+]], %got(extfn)([[GOT]])
+; NOPLT-NEXT: ldw {{r[0-9]+}}, %got(nlb)([[GOT]])
+; NOPLT-NEXT: callr [[EXT]]
+; NOPLT-NEXT: orhi [[LOC:r[0-9]+]], zero, %gotoff_hiadj(locfn)
+; NOPLT-NEXT: add [[LOC]], [[LOC]], [[GOT]]
+; NOPLT-NEXT: addi [[LOC]], [[LOC]], %gotoff_lo(locfn)
+; NOPLT-NEXT: callr [[LOC]]
+; XGOT-LABEL: calls:
+; XGOT: orhi r2, zero, %call_hiadj(extfn)
+; XGOT-NEXT: add r2, r2, r22
+; XGOT-NEXT: ldw r2, %call_lo(extfn)(r2)
+; XGOT-NEXT: callr r2
+define void @calls() {
+  call void @extfn()
+  call void @locfn()
+  call void @nlb()
+  call void @nlb()
+  ret void
+}
+
+; RELOC: Section ({{[0-9]+}}) .rela.text {
+; RELOC-NEXT: 0x8 R_NIOS2_PCREL_HA _gp_got 0x0
+; RELOC-NEXT: 0xC R_NIOS2_PCREL_LO _gp_got 0x4
+; RELOC-NEXT: 0x14 R_NIOS2_GOT16 ext 0x0
+; RELOC-NEXT: 0x1C R_NIOS2_GOTOFF_HA .bss 0x0
+; RELOC-NEXT: 0x24 R_NIOS2_GOTOFF_LO .bss 0x0
+; RELOC-NEXT: 0x2C R_NIOS2_GOTOFF_HA hid 0x0
+; RELOC-NEXT: 0x34 R_NIOS2_GOTOFF_LO hid 0x0
+; RELOC: R_NIOS2_GOT16 nlb 0x0
+; RELOC-NEXT: R_NIOS2_CALL16 extfn 0x0
+; RELOC-NEXT: R_NIOS2_GOTOFF_HA .text 0x0
+; RELOC-NEXT: R_NIOS2_GOTOFF_LO .text 0x0
+; RELOC-NEXT: }
@@ -0,0 +1,51 @@
+; RUN: llc -march=nios2 -verify-machineinstrs < %s | FileCheck %s
+
+; A select becomes a branch around the copy of the false value, taken when
+; the condition is set.
+
+; CHECK-LABEL: select_reg:
+; CHECK: cmpnei [[C:r[0-9]+]], r4, 0
+; CHECK-NEXT: bne [[C]], zero, [[EXIT:LBB[0-9_]+]]
+; CHECK-NEXT: # BB#1:
+; CHECK-NEXT: or r6, r5, zero
+; CHECK-NEXT: [[EXIT]]:
+; CHECK-NEXT: or r2, r6, zero
+; CHECK-NEXT: ret
+define i32 @select_reg(i32 %a, i32 %f, i32 %t) {
+entry:
+  %c = icmp ne i32 %a, 0
+  %r = select i1 %c, i32 %t, i32 %f
+  ret i32 %r
+}
+
+; CHECK-LABEL: select_imm:
+; CHECK: cmpnei [[C:r[0-9]+]], r4, 0
+; CHECK-NEXT: beq [[C]], zero, [[EXIT:LBB[0-9_]+]]
+; CHECK-NEXT: # BB#1:
+; CHECK-NEXT: addi r5, zero, -1
+; CHECK-NEXT: [[EXIT]]:
+; CHECK-NEXT: or r2, r5, zero
+; CHECK-NEXT: ret
+define i32 @select_imm(i32 %a, i32 %f) {
+entry:
+  %c = icmp ne i32 %a, 0
+  %r = select i1 %c, i32 -1, i32 %f
+  ret i32 %r
+}
+
+; Each half of an i64 select tests the same condition.
+; CHECK-LABEL: select_i64:
+; CHECK: cmpnei [[C:r[0-9]+]], r4, 0
+; CHECK: beq [[C]], zero, [[LO:LBB[0-9_]+]]
+; CHECK: addi r5, zero, -1
+; CHECK: [[LO]]:
+; CHECK-NEXT: bne [[C]], zero, [[HI:LBB[0-9_]+]]
+; CHECK: or r3, r6, zero
+; CHECK: [[HI]]:
+; CHECK-NEXT: or r2, r5, zero
+define i64 @select_i64(i32 %a, i64 %f) {
+entry:
+  %c = icmp ne i32 %a, 0
+  %r = select i1 %c, i64 -1, i64 %f
+  ret i64 %r
+}
@@ -0,0 +1,75 @@
+; RUN: llc -march=nios2 -verify-machineinstrs < %s | FileCheck %s
+
+declare void @use(i32*)
+declare void @use8(i8*)
+
+; The accesses to %a are out of reach of the 16-bit offset. They share one
+; base register built in the entry block.
+; CHECK-LABEL: farbase:
+; CHECK: orhi r17, zero, 1
+; CHECK-NEXT: add r17, r17, sp
+; CHECK-NEXT: addi r17, r17, -25516
+; CHECK: stw r16, 4(r17)
+; CHECK-NEXT: stw r16, 8(r17)
+define void @farbase(i32 %x) {
+  %a = alloca [10000 x i32], align 4
+  %b = alloca [10000 x i32], align 4
+  %pa = getelementptr [10000 x i32], [10000 x i32]* %a, i32 0, i32 0
+  %pb = getelementptr [10000 x i32], [10000 x i32]* %b, i32 0, i32 0
+  call void @use(i32* %pa)
+  call void @use(i32* %pb)
+  %q1 = getelementptr [10000 x i32], [10000 x i32]* %b, i32 0, i32 1
+  %q2 = getelementptr [10000 x i32], [10000 x i32]* %b, i32 0, i32 2
+  %q3 = getelementptr [10000 x i32], [10000 x i32]* %b, i32 0, i32 3
+  store volatile i32 %x, i32* %q1
+  store volatile i32 %x, i32* %q2
+  store volatile i32 %x, i32* %q3
+  %r1 = getelementptr [10000 x i32], [10000 x i32]* %a, i32 0, i32 1
+  %r2 = getelementptr [10000 x i32], [10000 x i32]* %a, i32 0, i32 2
+  store volatile i32 %x, i32* %r1
+  store volatile i32 %x, i32* %r2
+  ret void
+}
+
+; An over-aligned local realigns $sp after the callee-saved registers are
+; stored through the unaligned $sp. $fp keeps the unaligned value for the
+; epilogue.
+; CHECK-LABEL: realign:
+; CHECK: addi sp, sp, -64
+; CHECK: stw ra, 60(sp)
+; CHECK-NEXT: stw fp, 56(sp)
+; CHECK: add fp, sp, zero
+; CHECK: srli sp, sp, 5
+; CHECK-NEXT: slli sp, sp, 5
+; CHECK-NEXT: addi r4, sp, 32
+; CHECK-NEXT: call use
+; CHECK-NEXT: add sp, fp, zero
+; CHECK-NEXT: ldw fp, 56(sp)
+; CHECK-NEXT: ldw ra, 60(sp)
+; CHECK-NEXT: addi sp, sp, 64
+; CHECK-NEXT: ret
+define void @realign() {
+  %a = alloca i32, align 32
+  call void @use(i32* %a)
+  ret void
+}
+
+; With variable sized objects as well, the aligned locals are addressed
+; through the base pointer r23.
+; CHECK-LABEL: realign_vla:
+; CHECK: stw r23, 16(sp)
+; CHECK: add fp, sp, zero
+; CHECK: srli sp, sp, 5
+; CHECK-NEXT: slli sp, sp, 5
+; CHECK-NEXT: add r23, sp, zero
+; CHECK: addi r4, r23, 0
+; CHECK-NEXT: call use
+; CHECK: add sp, fp, zero
+; CHECK-NEXT: ldw r23, 16(sp)
+define void @realign_vla(i32 %n) {
+  %a = alloca i32, align 32
+  %v = alloca i8, i32 %n
+  call void @use(i32* %a)
+  call void @use8(i8* %v)
+  ret void
+}
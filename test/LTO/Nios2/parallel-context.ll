@@ -0,0 +1,38 @@
+; Each partition of a parallel LTO code generation is cloned into an
+; LLVMContext of its own. Check that struct types, GEPs and struct loads
+; and stores survive the move.
+; RUN: llvm-as -o %t.bc %s
+; RUN: llvm-lto -exported-symbol=walk -exported-symbol=push -j2 -o %t.o %t.bc
+; RUN: llvm-objdump -t %t.o.0 %t.o.1 | FileCheck %s
+
+; Which partition gets which function depends on the splitting heuristics;
+; both must be code generated, together with the definition of @head.
+; CHECK-DAG: .data {{[0-9a-f]+}} {{(.hidden )?}}head
+; CHECK-DAG: g F .text {{[0-9a-f]+}} walk
+; CHECK-DAG: g F .text {{[0-9a-f]+}} push
+
+target triple = "nios2"
+
+%node = type { %node*, i32 }
+
+@head = global %node { %node* @head, i32 0 }, align 4
+
+define i32 @walk(%node* %n) {
+entry:
+  %next.addr = getelementptr inbounds %node, %node* %n, i32 0, i32 0
+  %next = load %node*, %node** %next.addr, align 4
+  %whole = load %node, %node* %next, align 4
+  %val = extractvalue %node %whole, 1
+  ret i32 %val
+}
+
+define void @push(%node* %n, i32 %v) {
+entry:
+  %old = load %node, %node* @head, align 4
+  store %node %old, %node* %n, align 4
+  %link = insertvalue %node { %node* undef, i32 undef }, %node* %n, 0
+  %new = insertvalue %node %link, i32 %v, 1
+  store %node %new, %node* @head, align 4
+  %r = call i32 @walk(%node* %n)
+  ret void
+}
@@ -0,0 +1,27 @@
+$shared = comdat any
+
+@llvm.global_ctors = appending global [1 x { i32, void ()*, i8* }] [{ i32, void ()*, i8* } { i32 65535, void ()* @init_a, i8* null }]
+@counter = external global i32
+@table = linkonce_odr global [2 x i32] [i32 1, i32 2], comdat($shared)
+@name_a = global [2 x i8] c"a\00"
+@limit = external global i32
+
+define internal void @init_a() {
+  store i32 2, i32* @counter
+  ret void
+}
+
+define i32 @count_a(i32 %x) {
+  %l = load i32, i32* @limit
+  %h = call i32 @helper(i32 %x)
+  %r = add i32 %h, %l
+  ret i32 %r
+}
+
+define linkonce_odr i32 @helper(i32 %x) {
+  %r = mul i32 %x, 3
+  ret i32 %r
+}
+
+!llvm.ident = !{!0}
+!0 = !{!"a"}
@@ -0,0 +1,18 @@
+@limit = global i32 8
+@name_b = global [2 x i8] c"b\00"
+@counter = external global i32
+
+define i32 @count_b(i32 %x) {
+  %h = call i32 @helper(i32 %x)
+  %c = load i32, i32* @counter
+  %r = add i32 %h, %c
+  ret i32 %r
+}
+
+define linkonce_odr i32 @helper(i32 %x) {
+  %r = mul i32 %x, 3
+  ret i32 %r
+}
+
+!llvm.ident = !{!0}
+!0 = !{!"b"}
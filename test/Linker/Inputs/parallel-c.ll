@@ -0,0 +1,20 @@
+@llvm.global_ctors = appending global [1 x { i32, void ()*, i8* }] [{ i32, void ()*, i8* } { i32 65535, void ()* @init_c, i8* null }]
+@name_c = global [2 x i8] c"c\00"
+@counter = external global i32
+
+define internal void @init_c() {
+  %c = load i32, i32* @counter
+  %n = add i32 %c, 1
+  store i32 %n, i32* @counter
+  ret void
+}
+
+define i32 @count_c(i32 %x) {
+  %r = call i32 @count_a(i32 %x)
+  ret i32 %r
+}
+
+declare i32 @count_a(i32)
+
+!llvm.ident = !{!0}
+!0 = !{!"c"}
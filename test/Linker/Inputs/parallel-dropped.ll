@@ -0,0 +1,12 @@
+define i32 @count_b(i32 %x) {
+  ret i32 %x
+}
+
+define i32 @count_c(i32 %x) {
+  ret i32 %x
+}
+
+define linkonce_odr i32 @helper(i32 %x) {
+  %r = mul i32 %x, 3
+  ret i32 %r
+}
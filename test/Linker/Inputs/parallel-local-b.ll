@@ -0,0 +1,16 @@
+@seen_b = global i32 0
+
+@state = internal global i32 2
+
+define internal i32 @next() {
+  %v = load i32, i32* @state
+  %n = add i32 %v, 2
+  store i32 %n, i32* @state
+  ret i32 %n
+}
+
+define i32 @next_b() {
+  %v = call i32 @next()
+  store i32 %v, i32* @seen_b
+  ret i32 %v
+}
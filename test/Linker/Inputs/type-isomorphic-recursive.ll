@@ -0,0 +1,8 @@
+%node = type { i32, %node* }
+%ref = type { %ref*, %ref*, i64 }
+%wrapper = type { %body* }
+%body = type { i8 }
+
+@l2 = global %node zeroinitializer
+@t2 = global %ref zeroinitializer
+@w2 = global %wrapper zeroinitializer
@@ -0,0 +1,85 @@
+; RUN: llvm-link -S %s %p/Inputs/parallel-a.ll %p/Inputs/parallel-b.ll \
+; RUN:   %p/Inputs/parallel-c.ll > %t.serial.ll
+; RUN: FileCheck %s < %t.serial.ll
+; RUN: llvm-link -S -j2 %s %p/Inputs/parallel-a.ll %p/Inputs/parallel-b.ll \
+; RUN:   %p/Inputs/parallel-c.ll > %t.j2.ll
+; RUN: diff %t.serial.ll %t.j2.ll
+; RUN: llvm-link -S -j4 %s %p/Inputs/parallel-a.ll %p/Inputs/parallel-b.ll \
+; RUN:   %p/Inputs/parallel-c.ll > %t.j4.ll
+; RUN: diff %t.serial.ll %t.j4.ll
+
+; A definition dropped by one run but referenced by an earlier one can't be
+; merged like a serial link does, so the link falls back to it.
+; RUN: llvm-link -S -j2 -v %s %p/Inputs/parallel-a.ll \
+; RUN:   %p/Inputs/parallel-dropped.ll 2> %t.log > %t.fallback.ll
+; RUN: FileCheck --check-prefix=FALLBACK %s < %t.log
+; RUN: llvm-link -S %s %p/Inputs/parallel-a.ll \
+; RUN:   %p/Inputs/parallel-dropped.ll > %t.fallback-serial.ll
+; RUN: diff %t.fallback-serial.ll %t.fallback.ll
+; FALLBACK: linking serially
+
+; Both inputs define an internal @state and @next. The second ones are renamed
+; with suffixes that depend on the names the module has already seen, which
+; the runs do not share, so the link falls back to a serial one.
+; RUN: llvm-link -S %s %p/Inputs/parallel-local-a.ll \
+; RUN:   %p/Inputs/parallel-local-b.ll > %t.local-serial.ll
+; RUN: llvm-link -S -j3 -v %s %p/Inputs/parallel-local-a.ll \
+; RUN:   %p/Inputs/parallel-local-b.ll 2> %t.local.log > %t.local.ll
+; RUN: FileCheck --check-prefix=FALLBACK %s < %t.local.log
+; RUN: diff %t.local-serial.ll %t.local.ll
+; RUN: llvm-link -S -j2 -v %p/Inputs/parallel-local-a.ll \
+; RUN:   %p/Inputs/parallel-local-b.ll 2> %t.local2.log > %t.local2.ll
+; RUN: FileCheck --check-prefix=FALLBACK %s < %t.local2.log
+; RUN: llvm-link -S %p/Inputs/parallel-local-a.ll \
+; RUN:   %p/Inputs/parallel-local-b.ll | diff - %t.local2.ll
+
+; RUN: not llvm-link -j2 -only-needed %s %p/Inputs/parallel-a.ll 2>&1 | \
+; RUN:   FileCheck --check-prefix=OPTIONS %s
+; OPTIONS: -j can't be used with -override
+
+$shared = comdat any
+
+@llvm.global_ctors = appending global [1 x { i32, void ()*, i8* }] [{ i32, void ()*, i8* } { i32 65535, void ()* @init_main, i8* null }]
+@counter = global i32 0
+@table = linkonce_odr global [2 x i32] [i32 1, i32 2], comdat($shared)
+
+; CHECK: @llvm.global_ctors = appending global [3 x { i32, void ()*, i8* }] [{ i32, void ()*, i8* } { i32 65535, void ()* @init_main, i8* null }, { i32, void ()*, i8* } { i32 65535, void ()* @init_a, i8* null }, { i32, void ()*, i8* } { i32 65535, void ()* @init_c, i8* null }]
+; CHECK-NEXT: @counter = global i32 0
+; CHECK-NEXT: @table = linkonce_odr global [2 x i32] [i32 1, i32 2], comdat($shared)
+; CHECK-NEXT: @name_a = global [2 x i8] c"a\00"
+; CHECK-NEXT: @limit = global i32 8
+; CHECK-NEXT: @name_b = global [2 x i8] c"b\00"
+; CHECK-NEXT: @name_c = global [2 x i8] c"c\00"
+
+declare i32 @count_a(i32)
+declare i32 @count_b(i32)
+declare i32 @count_c(i32)
+
+define internal void @init_main() {
+  store i32 1, i32* @counter
+  ret void
+}
+
+define i32 @main() {
+  %a = call i32 @count_a(i32 1)
+  %b = call i32 @count_b(i32 %a)
+  %c = call i32 @count_c(i32 %b)
+  %t = getelementptr [2 x i32], [2 x i32]* @table, i32 0, i32 1
+  %v = load i32, i32* %t
+  %r = add i32 %c, %v
+  ret i32 %r
+}
+
+; CHECK: define internal void @init_main()
+; CHECK: define i32 @main()
+; CHECK: define internal void @init_a()
+; CHECK: define i32 @count_a(i32 %x)
+; CHECK: define linkonce_odr i32 @helper(i32 %x)
+; CHECK: define i32 @count_b(i32 %x)
+; CHECK: define internal void @init_c()
+; CHECK: define i32 @count_c(i32 %x)
+
+!llvm.ident = !{!0}
+!0 = !{!"main"}
+
+; CHECK: !llvm.ident = !{!0, !1, !2, !3}
@@ -0,0 +1,42 @@
+; RUN: llvm-link %s %p/Inputs/type-isomorphic-recursive.ll -S -o - | FileCheck %s
+; RUN: llvm-link %s %p/Inputs/type-isomorphic-recursive.ll -o /dev/null \
+; RUN:   -stats 2>&1 | FileCheck --check-prefix=STATS %s
+; REQUIRES: asserts
+
+; A recursive struct type of the source module is isomorphic to a type of the
+; destination module with another name. Mapping element by element only finds
+; types that are not recursive, so it used to be copied.
+
+; CHECK-NOT: %node
+; CHECK-NOT: %ref
+; CHECK: %list = type { i32, %list* }
+; CHECK: %tree = type { %tree*, %tree*, i64 }
+; The opaque type of the destination module is not given the body of an
+; unrelated type.
+; CHECK: %holder = type { %fwd* }
+; CHECK: %fwd = type opaque
+; CHECK: %wrapper = type { %body* }
+; CHECK: %body = type { i8 }
+
+; CHECK: @l1 = global %list zeroinitializer
+; CHECK: @t1 = global %tree zeroinitializer
+; CHECK: @h1 = global %holder zeroinitializer
+; CHECK: @l2 = global %list zeroinitializer
+; CHECK: @t2 = global %tree zeroinitializer
+; CHECK: @w2 = global %wrapper zeroinitializer
+; CHECK-NOT: %node
+; CHECK-NOT: %ref
+
+; %node and %ref are counted once, as merged by shape.
+; STATS: 5 irmover - Number of struct types copied into the destination module
+; STATS-NOT: mapped to an existing type
+; STATS: 2 irmover - Number of struct types mapped to an isomorphic type found by the hash of its shape
+
+%list = type { i32, %list* }
+%tree = type { %tree*, %tree*, i64 }
+%fwd = type opaque
+%holder = type { %fwd* }
+
+@l1 = global %list zeroinitializer
+@t1 = global %tree zeroinitializer
+@h1 = global %holder zeroinitializer
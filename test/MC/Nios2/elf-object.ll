@@ -0,0 +1,48 @@
+; Nios2 has no assembly parser, so the object is written by llc.
+; RUN: llc -march=nios2 -filetype=obj < %s -o %t
+; RUN: llvm-readobj -h -r %t | FileCheck %s
+; RUN: llvm-objdump -s -j .text %t | FileCheck %s --check-prefix=TEXT
+
+; Only R1 encodings exist, so e_flags is EF_NIOS2_ARCH_R1.
+; CHECK: Machine: EM_ALTERA_NIOS2 (0x71)
+; CHECK: Flags [ (0x0)
+; CHECK-NEXT: ]
+
+; CHECK: Relocations [
+; CHECK-NEXT: Section ({{[0-9]+}}) .rela.text {
+; CHECK-NEXT: 0x18 R_NIOS2_CALL26 f 0x0
+; CHECK-NEXT: 0x20 R_NIOS2_HIADJ16 g 0x0
+; CHECK-NEXT: 0x24 R_NIOS2_LO16 g 0x0
+; CHECK-NEXT: }
+; CHECK-NEXT: Section ({{[0-9]+}}) .rela.data {
+; CHECK-NEXT: 0x0 R_NIOS2_BFD_RELOC_32 g 0x0
+; CHECK-NEXT: }
+
+; Register fields, the branch offset from the next instruction and the
+; swapped operands of "ble" lowered to "bge".
+;   0x00  addi sp, sp, -32       0x04  stw ra, 28(sp)
+;   0x10  or r16, r5, zero       0x18  call f
+;   0x1c  bge r16, r17, 0x2c     0x20  orhi r2, zero, %hiadj(g)
+;   0x24  ldw r2, %lo(g)(r2)     0x28  br 0x30
+;   0x40  ret
+; TEXT: 0000 04f8ffde 1507c0df
+; TEXT: 0010 3ab02028 {{[0-9a-f]+}} 00000000 0e034084
+; TEXT: 0020 34008000 17008010 06010000
+; TEXT: 0040 3a2800f8
+
+@g = global i32 0
+@ptr = global i32* @g
+
+declare void @f()
+
+define i32 @relocs(i32 %a, i32 %b) {
+entry:
+  call void @f()
+  %v = load i32, i32* @g
+  %c = icmp sgt i32 %a, %b
+  br i1 %c, label %t, label %e
+t:
+  ret i32 %v
+e:
+  ret i32 0
+}
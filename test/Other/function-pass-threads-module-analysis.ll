@@ -0,0 +1,46 @@
+; The function pass manager after a module analysis runs on threads too, with
+; the analysis computed again on each of them, and gives the same result.
+; REQUIRES: asserts
+; RUN: opt -S -globals-aa -gvn < %s > %t.serial
+; RUN: opt -S -globals-aa -gvn -function-pass-threads=2 -stats < %s \
+; RUN:   > %t.parallel 2> %t.stats
+; RUN: diff %t.serial %t.parallel
+; RUN: FileCheck %s < %t.parallel
+; RUN: FileCheck --check-prefix=STATS %s < %t.stats
+
+; Globals AA knows that @log does not change @count, so the load of it in
+; @read_twice is reused across the call.
+; CHECK-LABEL: define i32 @read_twice(
+; CHECK: load i32, i32* @count
+; CHECK-NOT: load
+; CHECK: ret i32
+
+; STATS: 4 parallel-function-passes - Number of functions processed on threads
+
+@count = internal global i32 0
+@logged = internal global i32 0
+
+define void @log() {
+  store i32 1, i32* @logged
+  ret void
+}
+
+define void @bump() {
+  %v = load i32, i32* @count
+  %n = add i32 %v, 1
+  store i32 %n, i32* @count
+  ret void
+}
+
+define i32 @read_twice() {
+  %a = load i32, i32* @count
+  call void @log()
+  %b = load i32, i32* @count
+  %s = add i32 %a, %b
+  ret i32 %s
+}
+
+define i32 @read_once() {
+  %a = load i32, i32* @count
+  ret i32 %a
+}
@@ -0,0 +1,88 @@
+; Running the function passes on threads must not change the result.
+; RUN: opt -S -instcombine -simplifycfg < %s > %t.serial
+; RUN: opt -S -instcombine -simplifycfg -function-pass-threads=3 < %s > %t.parallel
+; RUN: diff %t.serial %t.parallel
+; RUN: opt -S -O2 < %s > %t.serial.O2
+; RUN: opt -S -O2 -function-pass-threads=3 < %s > %t.parallel.O2
+; RUN: diff %t.serial.O2 %t.parallel.O2
+; RUN: FileCheck %s < %t.parallel
+
+; The call to printf becomes a call to puts, which is only declared in the
+; copy of the function made for its thread, and the string it prints is a new
+; global there.
+; CHECK: @str{{.*}} = private unnamed_addr constant [6 x i8] c"hello\00"
+; CHECK-LABEL: define void @hello()
+; CHECK-NEXT: call i32 @puts(
+; CHECK-LABEL: define internal i32 @sum(
+; CHECK: load i32, i32* {{.*}}, !tbaa
+; CHECK-LABEL: define void @dispatch(
+; CHECK: blockaddress(@dispatch, %second)
+; CHECK: declare i32 @puts(
+
+%struct.pair = type { i32, i32 }
+%struct.list = type { %struct.list*, %struct.pair }
+
+@.fmt = private unnamed_addr constant [7 x i8] c"hello\0A\00"
+@pairs = global [4 x %struct.pair] zeroinitializer
+@head = global %struct.list* null
+@target = global i8* null
+
+declare i32 @printf(i8*, ...)
+
+define void @hello() {
+  %r = call i32 (i8*, ...) @printf(i8* getelementptr ([7 x i8], [7 x i8]* @.fmt, i32 0, i32 0))
+  ret void
+}
+
+define internal i32 @sum(%struct.pair* %p) {
+entry:
+  %a = getelementptr %struct.pair, %struct.pair* %p, i32 0, i32 0
+  %b = getelementptr %struct.pair, %struct.pair* %p, i32 0, i32 1
+  %x = load i32, i32* %a, !tbaa !0
+  %y = load i32, i32* %b, !tbaa !0
+  %s = add i32 %x, %y
+  %t = mul i32 %s, 1
+  ret i32 %t
+}
+
+define i32 @walk() {
+entry:
+  %l = load %struct.list*, %struct.list** @head
+  br label %loop
+loop:
+  %n = phi %struct.list* [ %l, %entry ], [ %next, %body ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %body ]
+  %done = icmp eq %struct.list* %n, null
+  br i1 %done, label %exit, label %body
+body:
+  %pp = getelementptr %struct.list, %struct.list* %n, i32 0, i32 1
+  %v = call i32 @sum(%struct.pair* %pp)
+  %acc.next = add i32 %acc, %v
+  %np = getelementptr %struct.list, %struct.list* %n, i32 0, i32 0
+  %next = load %struct.list*, %struct.list** %np
+  br label %loop
+exit:
+  ret i32 %acc
+}
+
+define i32 @first() {
+  %p = getelementptr [4 x %struct.pair], [4 x %struct.pair]* @pairs, i32 0, i32 0
+  %v = call i32 @sum(%struct.pair* %p)
+  %w = sub i32 %v, 0
+  ret i32 %w
+}
+
+define void @dispatch(i1 %c) {
+entry:
+  store i8* blockaddress(@dispatch, %second), i8** @target
+  br i1 %c, label %first, label %second
+first:
+  call void @hello()
+  br label %second
+second:
+  ret void
+}
+
+!0 = !{!1, !1, i64 0}
+!1 = !{!"int", !2}
+!2 = !{!"tbaa root"}
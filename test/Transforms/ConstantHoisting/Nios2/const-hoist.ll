@@ -0,0 +1,40 @@
+; RUN: opt -consthoist -S < %s | FileCheck %s
+; RUN: opt -consthoist -disable-nios2-constant-hoisting -S < %s \
+; RUN:     | FileCheck %s --check-prefix=DISABLED
+
+target triple = "nios2"
+
+; Only the constant that takes orhi+ori is worth sharing. The ones that fit
+; the 16-bit field of their instruction, or take a single orhi, are left in
+; place.
+define i32 @f(i32 %x, i32 %y) {
+; CHECK-LABEL: @f(
+; CHECK: %const = bitcast i32 305419896 to i32
+; CHECK-NEXT: %a = add i32 %x, %const
+; CHECK-NEXT: %b = add i32 %y, %const
+; CHECK-NEXT: %c = add i32 %x, -1000
+; CHECK-NEXT: %d = add i32 %y, -1000
+; CHECK-NEXT: %e = or i32 %x, 65535
+; CHECK-NEXT: %f = or i32 %y, 65535
+; CHECK-NEXT: %g = and i32 %x, 1048576
+; CHECK-NEXT: %h = and i32 %y, 1048576
+; DISABLED-LABEL: @f(
+; DISABLED-NOT: %const
+entry:
+  %a = add i32 %x, 305419896
+  %b = add i32 %y, 305419896
+  %c = add i32 %x, -1000
+  %d = add i32 %y, -1000
+  %e = or i32 %x, 65535
+  %f = or i32 %y, 65535
+  %g = and i32 %x, 1048576
+  %h = and i32 %y, 1048576
+  %s1 = add i32 %a, %b
+  %s2 = add i32 %c, %d
+  %s3 = add i32 %e, %f
+  %s4 = add i32 %g, %h
+  %t1 = add i32 %s1, %s2
+  %t2 = add i32 %s3, %s4
+  %r = add i32 %t1, %t2
+  ret i32 %r
+}
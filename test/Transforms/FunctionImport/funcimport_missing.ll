@@ -0,0 +1,22 @@
+; RUN: llvm-as -function-summary %s -o %t.bc
+; RUN: llvm-as -function-summary %p/Inputs/funcimport_alias.ll -o %t2.bc
+; RUN: llvm-lto -thinlto -o %t3 %t.bc %t2.bc
+
+; The module to import from is gone. The importer reports it and imports
+; nothing instead of crashing.
+; RUN: rm %t2.bc
+; RUN: opt -function-import -summary-file %t3.thinlto.bc %s -S -o %t4.ll \
+; RUN:   2> %t.err
+; RUN: FileCheck %s < %t4.ll
+; RUN: FileCheck %s --check-prefix=ERR < %t.err
+
+; CHECK: declare void @callanalias()
+; ERR: function-import: {{.*}}2.bc
+
+define i32 @main() {
+entry:
+  call void @callanalias()
+  ret i32 0
+}
+
+declare void @callanalias()
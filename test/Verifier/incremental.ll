@@ -0,0 +1,56 @@
+; With -verify-incremental, a verifier pass only checks again the functions
+; changed since the last one, and a module pass change makes it check them all.
+; RUN: opt -disable-output -verify-each -simplifycfg -instcombine -stats < %s 2>&1 | FileCheck %s --check-prefix=FULL
+; RUN: opt -disable-output -verify-each -verify-incremental -simplifycfg -instcombine -stats < %s 2>&1 | FileCheck %s --check-prefix=INCR
+; RUN: opt -disable-output -verify-each -verify-incremental -simplifycfg -globaldce -instcombine -stats < %s 2>&1 | FileCheck %s --check-prefix=MODULE
+; REQUIRES: asserts
+
+; FULL-NOT: not verified again
+; FULL: 12 verify - Number of functions verified
+
+; Every function, then @instcombine and @child.
+; INCR: 8 verify - Number of functions verified
+; INCR: 4 verify - Number of unchanged functions not verified again
+
+; globaldce removes @dead, so every function is checked again after it.
+; MODULE: 13 verify - Number of functions verified
+; MODULE: 3 verify - Number of unchanged functions not verified again
+
+declare void @llvm.localescape(...)
+declare i8* @llvm.localrecover(i8*, i8*, i32)
+
+define i32 @instcombine(i32 %x) {
+  %y = add i32 %x, 0
+  ret i32 %y
+}
+
+define i32 @simplifycfg(i1 %c) {
+entry:
+  br i1 %c, label %a, label %b
+a:
+  br label %b
+b:
+  ret i32 0
+}
+
+define i32 @unchanged(i32 %x) {
+  ret i32 %x
+}
+
+; @child recovers the objects of @parent, which is not checked again.
+define void @parent() {
+  %a = alloca i8, align 1
+  %b = alloca i8, align 1
+  call void (...) @llvm.localescape(i8* nonnull %a, i8* nonnull %b)
+  ret void
+}
+
+define i32 @child(i8* %fp, i32 %x) {
+  %p = call i8* @llvm.localrecover(i8* bitcast (void ()* @parent to i8*), i8* %fp, i32 1)
+  %y = mul i32 %x, 1
+  ret i32 %y
+}
+
+define internal void @dead() {
+  ret void
+}
@@ -0,0 +1,26 @@
+target triple = "nios2"
+
+@dead_ptr = global i32 (i32)* @unused_b
+@dead_alias = alias i32 (i32), i32 (i32)* @unused_b
+@.str = private constant [4 x i8] c"abc\00"
+
+define i32 @used(i32 %x) {
+  %r = call i32 @helper(i32 %x)
+  ret i32 %r
+}
+
+define internal i32 @helper(i32 %x) noinline {
+  %r = mul i32 %x, 3
+  ret i32 %r
+}
+
+define i32 @unused_b(i32 %x) {
+  %p = getelementptr [4 x i8], [4 x i8]* @.str, i32 0, i32 0
+  %c = load i8, i8* %p
+  %r = zext i8 %c to i32
+  ret i32 %r
+}
+
+define internal i32 @dead_local(i32 %x) {
+  ret i32 %x
+}
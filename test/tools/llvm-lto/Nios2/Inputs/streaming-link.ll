@@ -0,0 +1,14 @@
+target triple = "nios2"
+
+define i32 @used(i32 %a) noinline {
+entry:
+  %m = mul i32 %a, 7
+  ret i32 %m
+}
+
+; Never referenced, so never parsed in a streaming link.
+define linkonce_odr i32 @unused(i32 %a) {
+entry:
+  %m = mul i32 %a, 11
+  ret i32 %m
+}
@@ -0,0 +1,14 @@
+target triple = "nios2"
+
+define i32 @callee(i32 %a) {
+entry:
+  %r = call i32 @helper(i32 %a)
+  %s = add i32 %r, 3
+  ret i32 %s
+}
+
+define internal i32 @helper(i32 %a) noinline {
+entry:
+  %m = mul i32 %a, %a
+  ret i32 %m
+}
@@ -0,0 +1,76 @@
+; Test that stripping the definitions that can't be reached from the exported
+; symbols before linking produces the same code as internalizing and removing
+; them after linking, without parsing the dead function bodies.
+; RUN: llvm-as %s -o %t.o
+; RUN: llvm-as %p/Inputs/dead-strip.ll -o %t2.o
+; RUN: llvm-lto -filetype=asm -exported-symbol=main -o %t.s %t.o %t2.o
+; RUN: llvm-lto -lto-dead-strip -filetype=asm -exported-symbol=main \
+; RUN:     -o %t.stripped.s %t.o %t2.o
+; RUN: cmp %t.s %t.stripped.s
+; RUN: llvm-lto -lto-dead-strip -lto-streaming-link -filetype=asm \
+; RUN:     -exported-symbol=main -o %t.streaming.s %t.o %t2.o
+; RUN: cmp %t.s %t.streaming.s
+; RUN: FileCheck %s < %t.stripped.s
+
+; The dead definitions are unused_a, unused_b, dead_local, dead_ptr,
+; dead_alias and .str. The bodies of the three functions are never parsed.
+; RUN: llvm-lto -lto-dead-strip -stats -filetype=asm -exported-symbol=main \
+; RUN:     -o %t.stripped.s %t.o %t2.o 2>&1 | FileCheck %s --check-prefix=STATS
+; REQUIRES: asserts
+
+; Every exported symbol is a root.
+; RUN: llvm-lto -filetype=asm -exported-symbol=main -exported-symbol=unused_a \
+; RUN:     -o %t.exported.s %t.o %t2.o
+; RUN: llvm-lto -lto-dead-strip -filetype=asm -exported-symbol=main \
+; RUN:     -exported-symbol=unused_a -o %t.exported.stripped.s %t.o %t2.o
+; RUN: cmp %t.exported.s %t.exported.stripped.s
+; RUN: FileCheck %s --check-prefix=EXPORTED < %t.exported.stripped.s
+
+; CHECK-LABEL: main:
+; CHECK-NOT: unused_a:
+; CHECK-NOT: unused_b:
+; CHECK-NOT: dead_local:
+
+; STATS: 6 lto - Number of unreachable definitions stripped before linking
+; STATS: 3 lto - Number of unreachable function bodies that were never parsed
+
+; EXPORTED-DAG: main:
+; EXPORTED-DAG: unused_a:
+
+target triple = "nios2"
+
+declare i32 @used(i32)
+
+define i32 @main(i32 %a) {
+entry:
+  %r = call i32 @used(i32 %a)
+  %p = load i32, i32* @shared_table
+  %s = add i32 %r, %p
+  %l = load i8*, i8** getelementptr ([1 x i8*], [1 x i8*]* @labels, i32 0, i32 0)
+  %li = ptrtoint i8* %l to i32
+  %t = add i32 %s, %li
+  ret i32 %t
+}
+
+; The blockaddress reached through @labels keeps @target alive, and the walk
+; does not follow its basic block operand.
+@labels = global [1 x i8*] [i8* blockaddress(@target, %bb)]
+define internal i32 @target(i32 %x) {
+entry:
+  br label %bb
+bb:
+  ret i32 %x
+}
+
+; shared_fn is kept with the rest of its comdat.
+$shared = comdat any
+@shared_table = linkonce_odr global i32 7, comdat($shared)
+define linkonce_odr i32 @shared_fn(i32 %x) comdat($shared) {
+  ret i32 %x
+}
+
+define i32 @unused_a(i32 %x) {
+  %r = call i32 @unused_b(i32 %x)
+  ret i32 %r
+}
+declare i32 @unused_b(i32)
@@ -0,0 +1,60 @@
+; Test that a streaming link, which parses function bodies only when the
+; linker needs them and releases them after code generation, produces the
+; same code as a regular one.
+; RUN: llvm-as %s -o %t.o
+; RUN: llvm-as %p/Inputs/streaming-link.ll -o %t2.o
+; RUN: llvm-lto -filetype=asm -exported-symbol=main -o %t.s %t.o %t2.o
+; RUN: llvm-lto -lto-streaming-link -filetype=asm -exported-symbol=main \
+; RUN:     -o %t.streaming.s %t.o %t2.o
+; RUN: cmp %t.s %t.streaming.s
+; RUN: FileCheck %s < %t.streaming.s
+
+; The first module is the destination module with -set-merged-module, and
+; is materialized as a whole. Only the name of the output module differs.
+; RUN: llvm-lto -lto-streaming-link -set-merged-module -filetype=asm \
+; RUN:     -exported-symbol=main -o %t.merged.s %t.o %t2.o
+; RUN: grep -v '\.file' %t.s > %t.nofile.s
+; RUN: grep -v '\.file' %t.merged.s > %t.merged.nofile.s
+; RUN: cmp %t.nofile.s %t.merged.nofile.s
+
+; -time-passes reports the heap in use, and what the released bodies of main,
+; used and dispatch took.
+; RUN: llvm-lto -lto-streaming-link -time-passes -filetype=asm \
+; RUN:     -exported-symbol=main -o %t.streaming.s %t.o %t2.o 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=REPORT
+
+; CHECK-LABEL: main:
+; CHECK: dispatch:
+; CHECK-NOT: unused:
+
+; REPORT: LTO memory usage
+; REPORT: Heap in use after linking:
+; REPORT: Heap in use after optimization:
+; REPORT: Peak heap in use:
+; REPORT: Released after code generation: {{ *[0-9]+}} bytes in 3 functions
+; REPORT: LTO phases
+; REPORT-DAG: Link
+; REPORT-DAG: Optimize
+; REPORT-DAG: Code generation
+
+target triple = "nios2"
+
+declare i32 @used(i32)
+
+define i32 @main(i32 %a) {
+entry:
+  %r = call i32 @used(i32 %a)
+  %s = call i32 @dispatch(i32 %r)
+  ret i32 %s
+}
+
+define i32 @dispatch(i32 %a) noinline {
+entry:
+  %b = and i32 %a, 1
+  %c = icmp eq i32 %b, 0
+  br i1 %c, label %even, label %odd
+even:
+  ret i32 0
+odd:
+  ret i32 1
+}
@@ -0,0 +1,37 @@
+; Test the object cache of the in-process ThinLTO backends.
+; RUN: rm -rf %t.cache
+; RUN: llvm-as -function-summary %s -o %t.o
+; RUN: llvm-as -function-summary %p/Inputs/thinlto-run.ll -o %t2.o
+
+; The first link fills the cache, the second one is served from it.
+; RUN: llvm-lto -thinlto-run -thinlto-cache-dir=%t.cache -thinlto-cache-stats \
+; RUN:     -filetype=asm -o %t3 %t.o %t2.o | FileCheck %s --check-prefix=MISS
+; RUN: llvm-lto -thinlto-run -thinlto-cache-dir=%t.cache -thinlto-cache-stats \
+; RUN:     -filetype=asm -o %t4 %t.o %t2.o | FileCheck %s --check-prefix=HIT
+; RUN: cmp %t3.0 %t4.0
+; RUN: cmp %t3.1 %t4.1
+; RUN: ls %t.cache | count 2
+
+; Different code generation options don't match the entries.
+; RUN: llvm-lto -thinlto-run -thinlto-cache-dir=%t.cache -thinlto-cache-stats \
+; RUN:     -filetype=asm -O1 -o %t5 %t.o %t2.o | FileCheck %s --check-prefix=MISS
+; RUN: ls %t.cache | count 4
+
+; Pruning removes every entry that doesn't fit.
+; RUN: llvm-lto -thinlto-run -thinlto-cache-dir=%t.cache -thinlto-cache-stats \
+; RUN:     -thinlto-cache-max-size=1 -filetype=asm -o %t6 %t.o %t2.o \
+; RUN:     | FileCheck %s --check-prefix=HIT
+; RUN: ls %t.cache | count 0
+
+; MISS: ThinLTO cache hits: 0, misses: 2
+; HIT: ThinLTO cache hits: 2, misses: 0
+
+target triple = "nios2"
+
+define i32 @main(i32 %a) {
+entry:
+  %r = call i32 @callee(i32 %a)
+  ret i32 %r
+}
+
+declare i32 @callee(i32)
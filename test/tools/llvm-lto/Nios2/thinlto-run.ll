@@ -0,0 +1,29 @@
+; Test the in-process ThinLTO backends of llvm-lto: every module imports the
+; functions it calls from the other one, and is compiled on its own.
+; RUN: llvm-as -function-summary %s -o %t.o
+; RUN: llvm-as -function-summary %p/Inputs/thinlto-run.ll -o %t2.o
+; RUN: llvm-lto -thinlto-run -j2 -filetype=asm -o %t3 %t.o %t2.o
+; RUN: FileCheck %s --check-prefix=MAIN < %t3.0
+; RUN: FileCheck %s --check-prefix=CALLEE < %t3.1
+
+target triple = "nios2"
+
+; The callee is imported and inlined into main. Its local helper is promoted
+; so that main can call it.
+; MAIN-LABEL: main:
+; MAIN-NOT: call callee
+; MAIN: call helper.llvm.[[ID:[0-9]+]]
+; MAIN-NOT: helper.llvm.[[ID]]:
+
+; CALLEE-LABEL: callee:
+; CALLEE: call helper.llvm.[[ID:[0-9]+]]
+; CALLEE: .global helper.llvm.[[ID]]
+; CALLEE: helper.llvm.[[ID]]:
+
+define i32 @main(i32 %a) {
+entry:
+  %r = call i32 @callee(i32 %a)
+  ret i32 %r
+}
+
+declare i32 @callee(i32)
@@ -0,0 +1,69 @@
+; RUN: llvm-split -balance -print-costs -o %t %s | FileCheck --check-prefix=COST %s
+; RUN: llvm-dis -o - %t0 | FileCheck --check-prefix=CHECK0 %s
+; RUN: llvm-dis -o - %t1 | FileCheck --check-prefix=CHECK1 %s
+
+; COST: partition 0: cost 17
+; COST: partition 1: cost 17
+
+$c = comdat any
+
+@llvm.used = appending global [1 x i8*] [i8* bitcast (void ()* @used_local to i8*)], section "llvm.metadata"
+
+; The most expensive function goes first, to partition 0.
+; CHECK0: define i32 @big(i32 %a)
+; CHECK1: declare i32 @big(i32)
+define i32 @big(i32 %a) {
+  %1 = add i32 %a, 1
+  %2 = mul i32 %1, %a
+  %3 = xor i32 %2, %1
+  %4 = add i32 %3, 7
+  %5 = mul i32 %4, %3
+  %6 = sub i32 %5, %2
+  %7 = shl i32 %6, 3
+  %8 = or i32 %7, %4
+  %9 = and i32 %8, %5
+  %10 = add i32 %9, %6
+  %11 = xor i32 %10, %a
+  ret i32 %11
+}
+
+; @helper is local, so it stays together with both of its users, and keeps
+; its linkage.
+; CHECK0: declare void @small1()
+; CHECK1: define void @small1()
+define void @small1() {
+  call void @helper()
+  ret void
+}
+
+; CHECK0: declare void @small2()
+; CHECK1: define void @small2()
+define void @small2() {
+  call void @helper()
+  ret void
+}
+
+; CHECK1: define internal void @helper()
+define internal void @helper() {
+  ret void
+}
+
+; Members of a comdat stay together.
+; CHECK0: declare void @c1()
+; CHECK1: define void @c1()
+define void @c1() comdat($c) {
+  ret void
+}
+
+; CHECK0: declare void @c2()
+; CHECK1: define void @c2()
+define void @c2() comdat($c) {
+  ret void
+}
+
+; A local referred to by llvm.used has to be externalized.
+; CHECK0: define hidden void @used_local()
+; CHECK1: declare hidden void @used_local()
+define internal void @used_local() {
+  ret void
+}
@@ -15,19 +15,34 @@
 
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/CodeGen/CommandFlags.h"
 #include "llvm/CodeGen/LinkAllAsmWriterComponents.h"
 #include "llvm/CodeGen/LinkAllCodegenComponents.h"
 #include "llvm/CodeGen/MIRParser/MIRParser.h"
+#include "llvm/CodeGen/ParallelCG.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Mangler.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IRReader/IRReader.h"
+#include "llvm/MC/MCAsmBackend.h"
+#include "llvm/MC/MCAsmInfo.h"
+#include "llvm/MC/MCCodeEmitter.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCInstrInfo.h"
+#include "llvm/MC/MCObjectFileInfo.h"
+#include "llvm/MC/MCParser/MCAsmParser.h"
+#include "llvm/MC/MCRegisterInfo.h"
+#include "llvm/MC/MCStreamer.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/MCTargetAsmParser.h"
 #include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CommandLine.h"
@@ -36,6 +51,7 @@
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/PluginLoader.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
@@ -103,6 +119,10 @@ static cl::opt<bool>
                           "manager and verify the result is the same."),
                  cl::init(false));
 
+static cl::opt<unsigned>
+    Parallelism("j", cl::Prefix, cl::init(1),
+                cl::desc("Number of code generation threads"));
+
 static int compileModule(char **, LLVMContext &);
 
 static std::unique_ptr<tool_output_file>
@@ -173,6 +193,225 @@ GetOutputStream(const char *TargetName, Triple::OSType OS,
   return FDOut;
 }
 
+/// Whether the identifier character C can appear in a label.
+static bool isLabelChar(char C) {
+  return isalnum(static_cast<unsigned char>(C)) || C == '_' || C == '.' ||
+         C == '$';
+}
+
+/// Append the assembly Asm of partition Part to Out. The labels the partition
+/// defines that start with one of Prefixes, and that are not the name of a
+/// global of the module, are private to it; other partitions number theirs
+/// the same way, so they are given a suffix unique to the partition. Comments
+/// and string literals are copied as they are.
+static void appendPartition(StringRef Asm, unsigned Part,
+                            ArrayRef<StringRef> Prefixes,
+                            const StringSet<> &GlobalNames,
+                            StringRef CommentString, raw_ostream &Out) {
+  StringSet<> Private;
+  if (Part != 0) {
+    SmallVector<StringRef, 0> Lines;
+    Asm.split(Lines, '\n');
+    for (StringRef Line : Lines) {
+      size_t End = 0;
+      while (End != Line.size() && isLabelChar(Line[End]))
+        ++End;
+      StringRef Label = Line.substr(0, End);
+      if (End == 0 || End == Line.size() || Line[End] != ':' ||
+          GlobalNames.count(Label))
+        continue;
+      for (StringRef Prefix : Prefixes)
+        if (!Prefix.empty() && Label.startswith(Prefix))
+          Private.insert(Label);
+    }
+  }
+  if (Private.empty()) {
+    Out << Asm;
+    return;
+  }
+
+  std::string Suffix = ".p" + utostr(Part);
+  size_t I = 0, Unpad = 0;
+  while (I != Asm.size()) {
+    if (!CommentString.empty() && Asm.substr(I).startswith(CommentString)) {
+      size_t End = Asm.find('\n', I);
+      if (End == StringRef::npos)
+        End = Asm.size();
+      Out << Asm.slice(I, End);
+      I = End;
+    } else if (Asm[I] == '"') {
+      size_t End = I + 1;
+      while (End != Asm.size() && Asm[End] != '"' && Asm[End] != '\n')
+        End += Asm[End] == '\\' ? 2 : 1;
+      End = std::min(End + 1, Asm.size());
+      Out << Asm.slice(I, End);
+      I = End;
+    } else if (isLabelChar(Asm[I])) {
+      size_t End = I;
+      while (End != Asm.size() && isLabelChar(Asm[End]))
+        ++End;
+      StringRef Token = Asm.slice(I, End);
+      Out << Token;
+      I = End;
+      if (Private.count(Token)) {
+        Out << Suffix;
+        Unpad += Suffix.size();
+      }
+    } else if (Asm[I] == ' ' && Unpad && I + 1 != Asm.size() &&
+               Asm[I + 1] == ' ') {
+      // Keep the comment that follows in its column.
+      ++I;
+      --Unpad;
+    } else {
+      if (Asm[I] == '\n')
+        Unpad = 0;
+      Out << Asm[I++];
+    }
+  }
+}
+
+/// Assemble Asm into an object file on OS with the MC layer of TM. Without
+/// OS, only check that the target has an assembly parser.
+static bool assemble(StringRef Asm, const TargetMachine &TM,
+                     raw_pwrite_stream *OS) {
+  const Target &T = TM.getTarget();
+  const Triple &TT = TM.getTargetTriple();
+  const MCRegisterInfo &MRI = *TM.getMCRegisterInfo();
+  const MCAsmInfo &MAI = *TM.getMCAsmInfo();
+  const MCSubtargetInfo &STI = *TM.getMCSubtargetInfo();
+  const MCInstrInfo &MCII = *TM.getMCInstrInfo();
+
+  SourceMgr SrcMgr;
+  SrcMgr.AddNewSourceBuffer(
+      MemoryBuffer::getMemBuffer(Asm, OutputFilename, false), SMLoc());
+  MCObjectFileInfo MOFI;
+  MCContext Ctx(&MAI, &MRI, &MOFI, &SrcMgr);
+  MOFI.InitMCObjectFileInfo(TT, TM.getRelocationModel(), TM.getCodeModel(),
+                            Ctx);
+
+  const MCTargetOptions &MCOptions = TM.Options.MCOptions;
+  std::unique_ptr<MCStreamer> Str;
+  if (OS) {
+    MCCodeEmitter *CE = T.createMCCodeEmitter(MCII, MRI, Ctx);
+    MCAsmBackend *MAB = T.createMCAsmBackend(MRI, TT.str(), TM.getTargetCPU());
+    Str.reset(T.createMCObjectStreamer(
+        TT, Ctx, *MAB, *OS, CE, STI, MCOptions.MCRelaxAll,
+        MCOptions.MCIncrementalLinkerCompatible,
+        /*DWARFMustBeAtTheEnd*/ false));
+  } else
+    Str.reset(createNullStreamer(Ctx));
+  std::unique_ptr<MCAsmParser> Parser(
+      createMCAsmParser(SrcMgr, Ctx, *Str, MAI));
+  std::unique_ptr<MCTargetAsmParser> TAP(
+      T.createMCAsmParser(STI, *Parser, MCII, MCOptions));
+  if (!TAP)
+    return false;
+  if (!OS)
+    return true;
+  Parser->setTargetParser(*TAP);
+  return !Parser->Run(/*NoInitialTextSection=*/false);
+}
+
+/// Whether compileModuleInParallel can produce the output of M. An object
+/// file is assembled from the joined assembly of the partitions, which needs
+/// an assembly parser for the target. Debug info is left to a serial
+/// compilation: the compile units and line tables of the partitions can't be
+/// joined as text.
+static bool canCompileInParallel(const Module &M, const TargetMachine &TM) {
+  if (M.getNamedMetadata("llvm.dbg.cu"))
+    return false;
+  return FileType != TargetMachine::CGFT_ObjectFile ||
+         assemble("", TM, nullptr);
+}
+
+/// Split M into Parallelism partitions of about the same estimated codegen
+/// cost, and run the code generator on each of them on its own thread, in a
+/// context of its own, to assembly in memory. The partitions are joined into
+/// the single output file, which is assembled for -filetype=obj.
+///
+/// The functions of one module can't be compiled in parallel into one
+/// output: the MachineModuleInfo, the MCContext and the AsmPrinter that
+/// collect the output are per module and not thread-safe, and neither is the
+/// LLVMContext the IR lives in. The partitions have their own, so the labels
+/// they number privately are made unique when they are joined.
+static int compileModuleInParallel(char **argv, std::unique_ptr<Module> M,
+                                   TargetMachine &Target, StringRef CPUStr,
+                                   StringRef FeaturesStr,
+                                   const TargetOptions &Options,
+                                   CodeGenOpt::Level OLvl) {
+  std::unique_ptr<tool_output_file> Out = GetOutputStream(
+      Target.getTarget().getName(), Target.getTargetTriple().getOS(), argv[0]);
+  if (!Out)
+    return 1;
+
+  // The partitions look their target up again from the triple, which -march
+  // may have changed.
+  M->setTargetTriple(Target.getTargetTriple().str());
+  M->setDataLayout(Target.createDataLayout());
+  setFunctionAttributes(CPUStr, FeaturesStr, *M);
+
+  // The symbols of the globals, which keep their names in the partitions.
+  StringSet<> GlobalNames;
+  Mangler Mang;
+  auto AddName = [&](const GlobalValue &GV) {
+    if (!GV.hasName())
+      return;
+    SmallString<64> Name;
+    Mang.getNameWithPrefix(Name, &GV, /*CannotUsePrivateLabel=*/false);
+    GlobalNames.insert(Name);
+  };
+  for (const GlobalVariable &GV : M->globals())
+    AddName(GV);
+  for (const Function &F : *M)
+    AddName(F);
+  for (const GlobalAlias &GA : M->aliases())
+    AddName(GA);
+
+  std::vector<SmallString<0>> Parts(Parallelism);
+  std::vector<std::unique_ptr<raw_svector_ostream>> PartOSs;
+  std::vector<raw_pwrite_stream *> OSs;
+  for (SmallString<0> &Part : Parts) {
+    PartOSs.push_back(llvm::make_unique<raw_svector_ostream>(Part));
+    OSs.push_back(PartOSs.back().get());
+  }
+
+  // Before executing passes, print the final values of the LLVM options.
+  cl::PrintOptionValues();
+
+  splitCodeGen(std::move(M), OSs, CPUStr, FeaturesStr, Options, RelocModel,
+               CMModel, OLvl, TargetMachine::CGFT_AssemblyFile);
+
+  const MCAsmInfo &MAI = *Target.getMCAsmInfo();
+  StringRef Prefixes[] = {MAI.getPrivateGlobalPrefix(),
+                          MAI.getPrivateLabelPrefix()};
+  SmallString<0> Asm;
+  raw_svector_ostream AsmOS(Asm);
+  for (unsigned I = 0; I != Parallelism; ++I)
+    appendPartition(Parts[I], I, Prefixes, GlobalNames,
+                    MAI.getCommentString(), AsmOS);
+
+  switch (FileType) {
+  case TargetMachine::CGFT_AssemblyFile:
+    Out->os() << Asm;
+    break;
+  case TargetMachine::CGFT_ObjectFile: {
+    SmallVector<char, 0> Buffer;
+    raw_svector_ostream BOS(Buffer);
+    if (!assemble(Asm, Target, &BOS)) {
+      errs() << argv[0] << ": error: can't assemble the partitions.\n";
+      return 1;
+    }
+    Out->os().write(Buffer.data(), Buffer.size());
+    break;
+  }
+  case TargetMachine::CGFT_Null:
+    break;
+  }
+
+  Out->keep();
+  return 0;
+}
+
 // main - Entry point for the llc compiler.
 //
 int main(int argc, char **argv) {
@@ -302,6 +541,19 @@ static int compileModule(char **argv, LLVMContext &Context) {
   if (FloatABIForCalls != FloatABI::Default)
     Options.FloatABIType = FloatABIForCalls;
 
+  if (Parallelism > 1) {
+    if (MIR || CompileTwice || DisableSimplifyLibCalls || !RunPass.empty() ||
+        !StartAfter.empty() || !StopAfter.empty()) {
+      errs() << argv[0] << ": -j can't be used with MIR input, "
+                           "-compile-twice, -disable-simplify-libcalls, "
+                           "-run-pass, -start-after or -stop-after.\n";
+      return 1;
+    }
+    if (canCompileInParallel(*M, *Target))
+      return compileModuleInParallel(argv, std::move(M), *Target, CPUStr,
+                                     FeaturesStr, Options, OLvl);
+  }
+
   // Figure out where we are going to send the output.
   std::unique_ptr<tool_output_file> Out =
       GetOutputStream(TheTarget->getName(), TheTriple.getOS(), argv[0]);
@@ -14,6 +14,10 @@
 
 #include "llvm/Linker/Linker.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/AutoUpgrade.h"
 #include "llvm/IR/DiagnosticInfo.h"
@@ -21,6 +25,7 @@
 #include "llvm/IR/FunctionInfo.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/TypeFinder.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Object/FunctionIndexObjectFile.h"
@@ -32,8 +37,11 @@
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/SystemUtils.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 #include <memory>
+#include <mutex>
 using namespace llvm;
 
 static cl::list<std::string>
@@ -93,6 +101,12 @@ static cl::opt<bool>
     PreserveModules("preserve-modules",
                     cl::desc("Preserve linked modules for testing"));
 
+static cl::opt<unsigned>
+    Threads("j", cl::Prefix, cl::init(1),
+            cl::desc("Number of linking threads. With more than one, runs of "
+                     "inputs are linked into modules of their own in "
+                     "parallel, which are then merged pairwise"));
+
 static cl::opt<bool> PreserveBitcodeUseListOrder(
     "preserve-bc-uselistorder",
     cl::desc("Preserve use-list order when writing LLVM bitcode."),
@@ -125,7 +139,11 @@ static std::unique_ptr<Module> loadFile(const char *argv0,
   return Result;
 }
 
+// Serializes the diagnostics of the threads of a parallel link.
+static std::mutex DiagnosticLock;
+
 static void diagnosticHandler(const DiagnosticInfo &DI) {
+  std::lock_guard<std::mutex> Lock(DiagnosticLock);
   unsigned Severity = DI.getSeverity();
   switch (Severity) {
   case DS_Error:
@@ -246,9 +264,57 @@ static bool importFunctions(const char *argv0, LLVMContext &Context,
   return true;
 }
 
+namespace {
+enum DefinitionKind { NotInComdat = 1, InComdat = 2 };
+
+/// The module linked from a run of the inputs, in a context of its own.
+struct LinkedRun {
+  std::unique_ptr<LLVMContext> Context;
+  std::unique_ptr<Module> Composite;
+
+  /// The names of the linkonce and available_externally definitions of the
+  /// inputs that the run did not link, because nothing referenced them when
+  /// they were seen. A global of the same name in an earlier run would have
+  /// made the linker consider them.
+  StringSet<> Dropped;
+
+  /// Whether the inputs defined each external name in a comdat, outside of
+  /// one, or both. The linker lets a comdat member replace a definition
+  /// outside of it, but not the other way around.
+  StringMap<unsigned> DefinitionKinds;
+
+  /// Whether linking an input renamed a local because its name was taken.
+  /// The suffix a module appends depends on the names it has seen, so it is
+  /// only the one of a serial link in the first run.
+  bool RenamedLocal = false;
+
+  bool Failed = false;
+  /// Whether merging the runs would not give the module of a serial link.
+  bool Diverged = false;
+};
+}
+
+template <typename CallbackT>
+static void forEachGlobalValue(Module &M, CallbackT Callback) {
+  for (GlobalVariable &GV : M.globals())
+    Callback(GV);
+  for (Function &F : M)
+    Callback(F);
+  for (GlobalAlias &GA : M.aliases())
+    Callback(GA);
+}
+
+/// Whether the linker only links the definition GV when something references
+/// it.
+static bool isLinkedOnlyIfReferenced(const GlobalValue &GV) {
+  return !GV.isDeclaration() &&
+         (GV.hasLocalLinkage() || GV.hasLinkOnceLinkage() ||
+          GV.hasAvailableExternallyLinkage());
+}
+
 static bool linkFiles(const char *argv0, LLVMContext &Context, Linker &L,
-                      const cl::list<std::string> &Files,
-                      unsigned Flags) {
+                      ArrayRef<std::string> Files, unsigned Flags,
+                      LinkedRun *Run = nullptr) {
   // Filter out flags that don't apply to the first file we load.
   unsigned ApplicableFlags = Flags & Linker::Flags::OverrideFromSrc;
   for (const auto &File : Files) {
@@ -280,8 +346,35 @@ static bool linkFiles(const char *argv0, LLVMContext &Context, Linker &L,
     if (Verbose)
       errs() << "Linking in '" << File << "'\n";
 
+    // Record the definitions of M that are only linked when referenced, and
+    // that the run already has or does not take.
+    std::vector<std::string> Lazy;
+    if (Run)
+      forEachGlobalValue(*M, [&](GlobalValue &GV) {
+        if (GlobalValue *DGV = Run->Composite->getNamedValue(GV.getName()))
+          if (GV.hasLocalLinkage() || DGV->hasLocalLinkage())
+            Run->RenamedLocal = true;
+        if (GV.hasLocalLinkage() || GV.isDeclaration())
+          return;
+        Run->DefinitionKinds[GV.getName()] |=
+            GV.getComdat() ? InComdat : NotInComdat;
+        if (!isLinkedOnlyIfReferenced(GV))
+          return;
+        GlobalValue *DGV = Run->Composite->getNamedValue(GV.getName());
+        if (DGV && !DGV->isDeclaration())
+          Run->Dropped.insert(GV.getName());
+        else
+          Lazy.push_back(GV.getName());
+      });
+
     if (L.linkInModule(std::move(M), ApplicableFlags, Index.get()))
       return false;
+
+    for (const std::string &Name : Lazy) {
+      GlobalValue *DGV = Run->Composite->getNamedValue(Name);
+      if (!DGV || DGV->isDeclaration())
+        Run->Dropped.insert(Name);
+    }
     // All linker flags apply to linking of subsequent files.
     ApplicableFlags = Flags;
 
@@ -298,6 +391,278 @@ static bool linkFiles(const char *argv0, LLVMContext &Context, Linker &L,
   return true;
 }
 
+/// Whether a struct type of M was renamed because its name was taken in the
+/// context. The number the context appends depends on all of the types it
+/// has seen, so it would not be the one of a serial link.
+static bool hasRenamedStructType(Module &M) {
+  TypeFinder StructTypes;
+  StructTypes.run(M, true);
+  for (StructType *STy : StructTypes) {
+    StringRef Name = STy->getName();
+    size_t Dot = Name.rfind('.');
+    if (Dot == StringRef::npos || Dot + 1 == Name.size() ||
+        Name.find_first_not_of("0123456789", Dot + 1) != StringRef::npos)
+      continue;
+    if (M.getTypeByName(Name.substr(0, Dot)))
+      return true;
+  }
+  return false;
+}
+
+/// Whether linking R into L gives the module that linking the inputs of R one
+/// by one into L would.
+static bool canMergeRuns(const LinkedRun &L, LinkedRun &R) {
+  // A definition that R dropped, but that a global of L would have made the
+  // linker resolve against it: take it over a declaration, or over another
+  // definition through a comdat, or map the metadata of R that referenced
+  // it to the global of L.
+  for (const auto &Entry : R.Dropped) {
+    GlobalValue *GV = L.Composite->getNamedValue(Entry.getKey());
+    if (GV && !GV->hasLocalLinkage())
+      return false;
+  }
+
+  // A local that shares its name with a global of the other run is renamed,
+  // with a suffix that depends on the names the module has seen.
+  bool LocalCollision = false;
+  forEachGlobalValue(*R.Composite, [&](GlobalValue &GV) {
+    GlobalValue *LGV = L.Composite->getNamedValue(GV.getName());
+    if (LGV && (GV.hasLocalLinkage() || LGV->hasLocalLinkage()))
+      LocalCollision = true;
+  });
+  if (LocalCollision)
+    return false;
+
+  // A name that the inputs define both in and out of a comdat resolves
+  // differently depending on which comes first, so only the order of a
+  // serial link is known to give the same result, or error.
+  for (const auto &Entry : R.DefinitionKinds) {
+    auto I = L.DefinitionKinds.find(Entry.getKey());
+    if (I != L.DefinitionKinds.end() &&
+        (I->second | Entry.getValue()) == (InComdat | NotInComdat))
+      return false;
+  }
+
+  // Conversely, a definition that R took when it was referenced, but that
+  // nothing references anymore, for example after a weak definition
+  // replaced its user, would not be linked from R.
+  SmallPtrSet<const Comdat *, 16> LiveComdats;
+  forEachGlobalValue(*R.Composite, [&](GlobalValue &GV) {
+    GV.removeDeadConstantUsers();
+    if (const Comdat *C = GV.getComdat())
+      if (!GV.isDeclaration() &&
+          (!isLinkedOnlyIfReferenced(GV) ||
+           (GV.hasLinkOnceLinkage() && !GV.use_empty())))
+        LiveComdats.insert(C);
+  });
+  bool Unreferenced = false;
+  forEachGlobalValue(*R.Composite, [&](GlobalValue &GV) {
+    const Comdat *C = GV.getComdat();
+    if (isLinkedOnlyIfReferenced(GV) && GV.use_empty() &&
+        (!C || !LiveComdats.count(C)))
+      Unreferenced = true;
+  });
+  return !Unreferenced;
+}
+
+namespace {
+/// Where a global of a run goes when the run is merged: its position in the
+/// run, and the name of a local, which is only restored once the merged
+/// values are in order.
+struct RunPosition {
+  unsigned Position;
+  bool IsLocal;
+  std::string Name;
+};
+}
+
+/// Move the values of List that the merge added to its end, in the order of
+/// Positions, and give the locals their names back. Return false if a local
+/// could not get its name back because it was taken.
+template <typename ListT>
+static bool sortMergedValues(
+    ListT &List,
+    const DenseMap<const GlobalValue *, std::pair<std::string, bool>> &Old,
+    const StringSet<> &Appending, const StringMap<RunPosition> &Positions) {
+  typedef typename ListT::value_type ValueT;
+  std::vector<std::pair<const RunPosition *, ValueT *>> New;
+  for (ValueT &GV : List) {
+    auto P = Positions.find(GV.getName());
+    // The linker puts the concatenation of appending globals in the place of
+    // the one of L.
+    if (GV.hasAppendingLinkage() && Appending.count(GV.getName()))
+      continue;
+    // A value of L that the linker replaced may have left its address to a
+    // new one, but not its name, unless it was a local that a new global
+    // took the name of.
+    auto I = Old.find(&GV);
+    if (I != Old.end() &&
+        (I->second.first == GV.getName() ||
+         (I->second.second && (P == Positions.end() || !P->second.IsLocal))))
+      continue;
+    New.emplace_back(P == Positions.end() ? nullptr : &P->second, &GV);
+  }
+  std::stable_sort(New.begin(), New.end(),
+                   [](const std::pair<const RunPosition *, ValueT *> &A,
+                      const std::pair<const RunPosition *, ValueT *> &B) {
+                     if (!A.first || !B.first)
+                       return A.first && !B.first;
+                     return A.first->Position < B.first->Position;
+                   });
+  bool Restored = true;
+  for (const auto &Entry : New) {
+    List.splice(List.end(), List, Entry.second);
+    if (Entry.first && Entry.first->IsLocal) {
+      Entry.second->setName(Entry.first->Name);
+      if (Entry.second->getName() != Entry.first->Name)
+        Restored = false;
+    }
+  }
+  return Restored;
+}
+
+/// Link R into L, which takes over what R dropped. R is destroyed.
+///
+/// A serial link would have appended the globals and named metadata of the
+/// inputs of R to the ones of L in the order of R, while the linker creates
+/// them in the order it reaches them, so the new ones are sorted back. The
+/// locals of R are linked under temporary names, and get theirs back in that
+/// order. If one of them is renamed instead, L is marked Diverged.
+static void mergeRuns(LinkedRun &L, LinkedRun &R) {
+  L.Failed |= R.Failed;
+  L.Diverged |= R.Diverged;
+  if (L.Failed || L.Diverged || !canMergeRuns(L, R)) {
+    L.Diverged = true;
+    return;
+  }
+
+  Module &Dst = *L.Composite;
+  DenseMap<const GlobalValue *, std::pair<std::string, bool>> Old;
+  StringSet<> OldAppending, OldNamedMD;
+  forEachGlobalValue(Dst, [&](GlobalValue &GV) {
+    Old[&GV] = std::make_pair(GV.getName().str(), GV.hasLocalLinkage());
+    if (GV.hasAppendingLinkage())
+      OldAppending.insert(GV.getName());
+  });
+  for (NamedMDNode &NMD : Dst.named_metadata())
+    OldNamedMD.insert(NMD.getName());
+
+  StringMap<RunPosition> Positions;
+  std::vector<std::string> NamedMD;
+  unsigned Position = 0, NextTemporary = 0;
+  forEachGlobalValue(*R.Composite, [&](GlobalValue &GV) {
+    RunPosition P = {Position++, GV.hasLocalLinkage(), GV.getName()};
+    if (P.IsLocal) {
+      std::string Temporary;
+      do
+        Temporary = "llvm-link.local." + utostr(NextTemporary++);
+      while (Dst.getNamedValue(Temporary) ||
+             R.Composite->getNamedValue(Temporary));
+      GV.setName(Temporary);
+    }
+    Positions[GV.getName()] = std::move(P);
+  });
+  for (NamedMDNode &NMD : R.Composite->named_metadata())
+    if (!OldNamedMD.count(NMD.getName()))
+      NamedMD.push_back(NMD.getName());
+
+  std::unique_ptr<Module> Src =
+      CloneModuleIntoContext(R.Composite.get(), *L.Context);
+  R.Composite.reset();
+  R.Context.reset();
+  if (Linker::linkModules(Dst, std::move(Src))) {
+    L.Failed = true;
+    return;
+  }
+
+  bool Restored =
+      sortMergedValues(Dst.getGlobalList(), Old, OldAppending, Positions);
+  Restored &=
+      sortMergedValues(Dst.getFunctionList(), Old, OldAppending, Positions);
+  Restored &=
+      sortMergedValues(Dst.getAliasList(), Old, OldAppending, Positions);
+  // The module has no way to move named metadata, so recreate it at the end.
+  for (const std::string &Name : NamedMD) {
+    NamedMDNode *NMD = Dst.getNamedMetadata(Name);
+    if (!NMD)
+      continue;
+    SmallVector<MDNode *, 8> Operands(NMD->op_begin(), NMD->op_end());
+    Dst.eraseNamedMetadata(NMD);
+    NMD = Dst.getOrInsertNamedMetadata(Name);
+    for (MDNode *Op : Operands)
+      NMD->addOperand(Op);
+  }
+  for (const auto &Entry : R.Dropped)
+    L.Dropped.insert(Entry.getKey());
+  for (const auto &Entry : R.DefinitionKinds)
+    L.DefinitionKinds[Entry.getKey()] |= Entry.getValue();
+  L.Diverged |= !Restored || hasRenamedStructType(Dst);
+}
+
+/// Link Files in Threads runs of about the same size, each into a module in a
+/// context of its own, in parallel, and merge the modules pairwise, in a tree.
+/// Each input is linked into its run just like a serial link would, but a
+/// run does not see the globals of the earlier ones, and its struct types
+/// are renamed by a context of its own. When that could make the result
+/// differ from a serial link, Result is marked Diverged.
+static void linkFilesInParallel(const char *argv0, ArrayRef<std::string> Files,
+                                LinkedRun &Result) {
+  // Split Files into contiguous runs of about the same total size, so that
+  // the order in which the inputs are linked is preserved.
+  unsigned NumRuns = std::min<size_t>(Threads, Files.size());
+  std::vector<uint64_t> Sizes;
+  uint64_t TotalSize = 0;
+  for (const std::string &File : Files) {
+    uint64_t Size = 0;
+    sys::fs::file_size(File, Size);
+    Sizes.push_back(Size);
+    TotalSize += Size;
+  }
+  std::vector<ArrayRef<std::string>> RunFiles;
+  size_t Begin = 0;
+  uint64_t Linked = 0;
+  for (unsigned I = 0; I != NumRuns; ++I) {
+    size_t End = Begin + 1;
+    Linked += Sizes[Begin];
+    // Leave at least one input to each of the remaining runs.
+    while (End + (NumRuns - I - 1) < Files.size() &&
+           (I + 1 == NumRuns || Linked < TotalSize * (I + 1) / NumRuns))
+      Linked += Sizes[End++];
+    RunFiles.push_back(Files.slice(Begin, End - Begin));
+    Begin = End;
+  }
+
+  std::vector<LinkedRun> Runs(NumRuns);
+  ThreadPool Pool(NumRuns);
+  for (unsigned I = 0; I != NumRuns; ++I)
+    Pool.async([&, I]() {
+      LinkedRun &Run = Runs[I];
+      Run.Context = llvm::make_unique<LLVMContext>();
+      Run.Context->setDiagnosticHandler(diagnosticHandlerWithContext, nullptr,
+                                        true);
+      Run.Composite = make_unique<Module>("llvm-link", *Run.Context);
+      Linker L(*Run.Composite);
+      Run.Failed = !linkFiles(argv0, *Run.Context, L, RunFiles[I],
+                              Linker::Flags::None, &Run);
+      Run.Diverged |= !Run.Failed && ((I != 0 && Run.RenamedLocal) ||
+                                      hasRenamedStructType(*Run.Composite));
+    });
+  Pool.wait();
+
+  while (Runs.size() > 1) {
+    for (unsigned I = 0; I + 1 < Runs.size(); I += 2)
+      Pool.async([&, I]() { mergeRuns(Runs[I], Runs[I + 1]); });
+    Pool.wait();
+    for (unsigned I = 1; 2 * I < Runs.size(); ++I) {
+      // Free the module before the context it lives in.
+      Runs[I].Composite.reset();
+      Runs[I] = std::move(Runs[2 * I]);
+    }
+    Runs.resize((Runs.size() + 1) / 2);
+  }
+  Result = std::move(Runs.front());
+}
+
 int main(int argc, char **argv) {
   // Print a stack trace if we signal out.
   sys::PrintStackTraceOnErrorSignal();
@@ -309,27 +674,53 @@ int main(int argc, char **argv) {
   llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
   cl::ParseCommandLineOptions(argc, argv, "llvm linker\n");
 
-  auto Composite = make_unique<Module>("llvm-link", Context);
-  Linker L(*Composite);
-
   unsigned Flags = Linker::Flags::None;
   if (Internalize)
     Flags |= Linker::Flags::InternalizeLinkedSymbols;
   if (OnlyNeeded)
     Flags |= Linker::Flags::LinkOnlyNeeded;
 
-  // First add all the regular input files
-  if (!linkFiles(argv[0], Context, L, InputFilenames, Flags))
-    return 1;
+  // With -j, the linked module lives in the context of the first run.
+  LinkedRun Parallel;
+  if (Threads > 1) {
+    if (!OverridingInputs.empty() || !Imports.empty() ||
+        !FunctionIndex.empty() || Internalize || OnlyNeeded ||
+        PreserveModules) {
+      errs() << argv[0] << ": -j can't be used with -override, -import, "
+                           "-functionindex, -internalize, -only-needed or "
+                           "-preserve-modules.\n";
+      return 1;
+    }
+    linkFilesInParallel(argv[0], InputFilenames, Parallel);
+    if (Parallel.Failed)
+      return 1;
+    if (Parallel.Diverged) {
+      if (Verbose)
+        errs() << "The runs can't be merged like a serial link, linking "
+                  "serially\n";
+      Parallel.Composite.reset();
+      Parallel.Context.reset();
+    }
+  }
 
-  // Next the -override ones.
-  if (!linkFiles(argv[0], Context, L, OverridingInputs,
-                 Flags | Linker::Flags::OverrideFromSrc))
-    return 1;
+  std::unique_ptr<Module> Composite = std::move(Parallel.Composite);
+  if (!Composite) {
+    Composite = make_unique<Module>("llvm-link", Context);
+    Linker L(*Composite);
 
-  // Import any functions requested via -import
-  if (!importFunctions(argv[0], Context, L))
-    return 1;
+    // First add all the regular input files
+    if (!linkFiles(argv[0], Context, L, InputFilenames, Flags))
+      return 1;
+
+    // Next the -override ones.
+    if (!linkFiles(argv[0], Context, L, OverridingInputs,
+                   Flags | Linker::Flags::OverrideFromSrc))
+      return 1;
+
+    // Import any functions requested via -import
+    if (!importFunctions(argv[0], Context, L))
+      return 1;
+  }
 
   if (DumpAsm) errs() << "Here's the assembly:\n" << *Composite;
 
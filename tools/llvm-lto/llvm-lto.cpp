@@ -19,6 +19,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/LTO/LTOCodeGenerator.h"
 #include "llvm/LTO/LTOModule.h"
+#include "llvm/LTO/ThinLTOCodeGenerator.h"
 #include "llvm/Object/FunctionIndexObjectFile.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
@@ -64,6 +65,24 @@ static cl::opt<bool>
     ThinLTO("thinlto", cl::init(false),
             cl::desc("Only write combined global index for ThinLTO backends"));
 
+static cl::opt<bool> ThinLTORun(
+    "thinlto-run", cl::init(false),
+    cl::desc("Run the ThinLTO backends in process and write an object for "
+             "each input, using -j threads"));
+
+static cl::opt<std::string> ThinLTOCacheDir(
+    "thinlto-cache-dir", cl::init(""),
+    cl::desc("Cache the objects of -thinlto-run in this directory"),
+    cl::value_desc("directory"));
+
+static cl::opt<unsigned long long> ThinLTOCacheMaxSize(
+    "thinlto-cache-max-size", cl::init(0),
+    cl::desc("Prune the ThinLTO cache down to this many bytes (0: no limit)"));
+
+static cl::opt<bool> ThinLTOCacheStats(
+    "thinlto-cache-stats", cl::init(false),
+    cl::desc("Print the number of ThinLTO cache hits and misses"));
+
 static cl::opt<bool>
 SaveModuleFile("save-merged-module", cl::init(false),
                cl::desc("Write merged LTO module to file before CodeGen"));
@@ -234,6 +253,58 @@ static void createCombinedFunctionIndex() {
   OS.close();
 }
 
+/// Import, optimize and compile every input in process, and write the output
+/// of the I-th input to <output>.I.
+static void runThinLTOBackends(const TargetOptions &Options) {
+  if (OutputFilename.empty())
+    error("-thinlto-run requires -o");
+
+  ThinLTOCodeGenerator CodeGen;
+  CodeGen.setTargetOptions(Options);
+  CodeGen.setCodePICModel(RelocModel);
+  CodeGen.setCpu(MCPU.c_str());
+  CodeGen.setOptLevel(OptLevel - '0');
+  CodeGen.setParallelism(Parallelism);
+  CodeGen.setCacheDir(ThinLTOCacheDir);
+  CodeGen.setCachePruningSizeLimit(ThinLTOCacheMaxSize);
+  if (FileType.getNumOccurrences())
+    CodeGen.setFileType(FileType);
+  if (UseDiagnosticHandler)
+    CodeGen.setDiagnosticHandler(handleDiagnostics, nullptr);
+
+  std::string Attrs;
+  for (unsigned I = 0; I < MAttrs.size(); ++I) {
+    if (I > 0)
+      Attrs.append(",");
+    Attrs.append(MAttrs[I]);
+  }
+  CodeGen.setAttr(Attrs.c_str());
+
+  std::vector<std::unique_ptr<MemoryBuffer>> InputBuffers;
+  for (auto &Filename : InputFilenames) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+        MemoryBuffer::getFile(Filename);
+    error(BufferOrErr, "error loading file '" + Filename + "'");
+    InputBuffers.push_back(std::move(*BufferOrErr));
+    CodeGen.addModule(Filename, InputBuffers.back()->getBuffer());
+  }
+
+  if (!CodeGen.run())
+    error("error running the ThinLTO backends");
+  if (ThinLTOCacheStats)
+    outs() << "ThinLTO cache hits: " << CodeGen.getCacheHits()
+           << ", misses: " << CodeGen.getCacheMisses() << '\n';
+
+  auto &Binaries = CodeGen.getProducedBinaries();
+  for (unsigned I = 0, E = Binaries.size(); I != E; ++I) {
+    std::string PartFilename = OutputFilename + "." + utostr(I);
+    std::error_code EC;
+    raw_fd_ostream OS(PartFilename, EC, sys::fs::OpenFlags::F_None);
+    error(EC, "error opening the file '" + PartFilename + "'");
+    OS << Binaries[I]->getBuffer();
+  }
+}
+
 int main(int argc, char **argv) {
   // Print a stack trace if we signal out.
   sys::PrintStackTraceOnErrorSignal();
@@ -264,6 +335,11 @@ int main(int argc, char **argv) {
     return 0;
   }
 
+  if (ThinLTORun) {
+    runThinLTOBackends(Options);
+    return 0;
+  }
+
   unsigned BaseArg = 0;
 
   LLVMContext Context;
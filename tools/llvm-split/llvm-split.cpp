@@ -35,6 +35,14 @@ OutputFilename("o", cl::desc("Override output filename"),
 static cl::opt<unsigned> NumOutputs("j", cl::Prefix, cl::init(2),
                                     cl::desc("Number of output files"));
 
+static cl::opt<bool>
+Balance("balance", cl::desc("Balance the estimated codegen cost of the "
+                            "partitions instead of hashing symbol names"));
+
+static cl::opt<bool>
+PrintCosts("print-costs",
+           cl::desc("Print the estimated codegen cost of each partition"));
+
 int main(int argc, char **argv) {
   LLVMContext &Context = getGlobalContext();
   SMDiagnostic Err;
@@ -49,6 +57,10 @@ int main(int argc, char **argv) {
 
   unsigned I = 0;
   SplitModule(std::move(M), NumOutputs, [&](std::unique_ptr<Module> MPart) {
+    if (PrintCosts)
+      outs() << "partition " << I << ": cost " << estimateCodeGenCost(*MPart)
+             << '\n';
+
     std::error_code EC;
     std::unique_ptr<tool_output_file> Out(new tool_output_file(
         OutputFilename + utostr(I++), EC, sys::fs::F_None));
@@ -61,7 +73,7 @@ int main(int argc, char **argv) {
 
     // Declare success.
     Out->keep();
-  });
+  }, Balance);
 
   return 0;
 }
@@ -20,6 +20,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/LTO/LTOCodeGenerator.h"
 #include "llvm/LTO/LTOModule.h"
+#include "llvm/LTO/ThinLTOCodeGenerator.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetSelect.h"
@@ -135,11 +136,11 @@ struct LibLTOCodeGenerator : LTOCodeGenerator {
 }
 
 DEFINE_SIMPLE_CONVERSION_FUNCTIONS(LibLTOCodeGenerator, lto_code_gen_t)
+DEFINE_SIMPLE_CONVERSION_FUNCTIONS(ThinLTOCodeGenerator, thinlto_code_gen_t)
 DEFINE_SIMPLE_CONVERSION_FUNCTIONS(LTOModule, lto_module_t)
 
-// Convert the subtarget features into a string to pass to LTOCodeGenerator.
-static void lto_add_attrs(lto_code_gen_t cg) {
-  LTOCodeGenerator *CG = unwrap(cg);
+// Convert the subtarget features into a string to pass to the code generator.
+template <typename CodeGenTy> static void lto_add_attrs(CodeGenTy *CG) {
   if (MAttrs.size()) {
     std::string attrs;
     for (unsigned i = 0; i < MAttrs.size(); ++i) {
@@ -375,7 +376,7 @@ void lto_codegen_add_must_preserve_symbol(lto_code_gen_t cg,
 static void maybeParseOptions(lto_code_gen_t cg) {
   if (!parsedOptions) {
     unwrap(cg)->parseCodeGenDebugOptions();
-    lto_add_attrs(cg);
+    lto_add_attrs(unwrap(cg));
     parsedOptions = true;
   }
 }
@@ -435,3 +436,92 @@ void lto_codegen_set_should_embed_uselists(lto_code_gen_t cg,
                                            lto_bool_t ShouldEmbedUselists) {
   unwrap(cg)->setShouldEmbedUselists(ShouldEmbedUselists);
 }
+
+static void handleThinLTODiagnostic(lto_codegen_diagnostic_severity_t Severity,
+                                    const char *Msg, void *) {
+  if (Severity != LTO_DS_ERROR) {
+    errs() << Msg << '\n';
+    return;
+  }
+  sLastErrorString = Msg;
+  sLastErrorString += "\n";
+}
+
+thinlto_code_gen_t thinlto_create_codegen(void) {
+  lto_initialize();
+  ThinLTOCodeGenerator *CodeGen = new ThinLTOCodeGenerator();
+  CodeGen->setTargetOptions(InitTargetOptionsFromCodeGenFlags());
+  CodeGen->setDiagnosticHandler(handleThinLTODiagnostic, nullptr);
+  lto_add_attrs(CodeGen);
+  return wrap(CodeGen);
+}
+
+void thinlto_codegen_dispose(thinlto_code_gen_t cg) { delete unwrap(cg); }
+
+void thinlto_codegen_add_module(thinlto_code_gen_t cg, const char *identifier,
+                                const char *data, int length) {
+  unwrap(cg)->addModule(identifier, StringRef(data, length));
+}
+
+bool thinlto_codegen_process(thinlto_code_gen_t cg) {
+  return !unwrap(cg)->run();
+}
+
+unsigned int thinlto_module_get_num_objects(thinlto_code_gen_t cg) {
+  return unwrap(cg)->getProducedBinaries().size();
+}
+
+LTOObjectBuffer thinlto_module_get_object(thinlto_code_gen_t cg,
+                                          unsigned int index) {
+  assert(index < unwrap(cg)->getProducedBinaries().size() && "Index overflow");
+  MemoryBuffer *Object = unwrap(cg)->getProducedBinaries()[index].get();
+  if (!Object)
+    return LTOObjectBuffer{nullptr, 0};
+  return LTOObjectBuffer{Object->getBufferStart(), Object->getBufferSize()};
+}
+
+void thinlto_codegen_set_parallelism(thinlto_code_gen_t cg,
+                                     unsigned int threads) {
+  unwrap(cg)->setParallelism(threads);
+}
+
+void thinlto_codegen_set_cpu(thinlto_code_gen_t cg, const char *cpu) {
+  unwrap(cg)->setCpu(cpu);
+}
+
+bool thinlto_codegen_set_pic_model(thinlto_code_gen_t cg,
+                                   lto_codegen_model model) {
+  switch (model) {
+  case LTO_CODEGEN_PIC_MODEL_STATIC:
+    unwrap(cg)->setCodePICModel(Reloc::Static);
+    return false;
+  case LTO_CODEGEN_PIC_MODEL_DYNAMIC:
+    unwrap(cg)->setCodePICModel(Reloc::PIC_);
+    return false;
+  case LTO_CODEGEN_PIC_MODEL_DYNAMIC_NO_PIC:
+    unwrap(cg)->setCodePICModel(Reloc::DynamicNoPIC);
+    return false;
+  case LTO_CODEGEN_PIC_MODEL_DEFAULT:
+    unwrap(cg)->setCodePICModel(Reloc::Default);
+    return false;
+  }
+  sLastErrorString = "Unknown PIC model";
+  return true;
+}
+
+void thinlto_codegen_set_cache_dir(thinlto_code_gen_t cg,
+                                   const char *cache_dir) {
+  unwrap(cg)->setCacheDir(cache_dir);
+}
+
+void thinlto_codegen_set_cache_size_limit(thinlto_code_gen_t cg,
+                                          unsigned long long bytes) {
+  unwrap(cg)->setCachePruningSizeLimit(bytes);
+}
+
+void thinlto_codegen_get_cache_stats(thinlto_code_gen_t cg,
+                                     unsigned int *hits,
+                                     unsigned int *misses) {
+  *hits = unwrap(cg)->getCacheHits();
+  *misses = unwrap(cg)->getCacheMisses();
+}
@@ -52,6 +52,7 @@
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ParallelFunctionPasses.h"
 #include <algorithm>
 #include <memory>
 using namespace llvm;
@@ -196,6 +197,12 @@ static cl::opt<bool>
              cl::desc("Run all passes twice, re-using the same pass manager."),
              cl::init(false), cl::Hidden);
 
+static cl::opt<unsigned> FunctionPassThreads(
+    "function-pass-threads",
+    cl::desc("Run the function passes that are not part of a call graph SCC "
+             "pipeline on this many threads"),
+    cl::init(1));
+
 static inline void addPass(legacy::PassManagerBase &PM, Pass *P) {
   // Add the pass to the pass manager...
   PM.add(P);
@@ -205,15 +212,25 @@ static inline void addPass(legacy::PassManagerBase &PM, Pass *P) {
     PM.add(createVerifierPass());
 }
 
+/// This routine adds the function passes that run on every function before the
+/// module passes of optimization level OptLevel.
+static void AddFunctionSimplificationPasses(legacy::FunctionPassManager &FPM,
+                                            unsigned OptLevel,
+                                            unsigned SizeLevel) {
+  FPM.add(createVerifierPass()); // Verify that input is correct
+
+  PassManagerBuilder Builder;
+  Builder.OptLevel = OptLevel;
+  Builder.SizeLevel = SizeLevel;
+  Builder.populateFunctionPassManager(FPM);
+}
+
 /// This routine adds optimization passes based on selected optimization level,
 /// OptLevel.
 ///
 /// OptLevel - Optimization Level
 static void AddOptimizationPasses(legacy::PassManagerBase &MPM,
-                                  legacy::FunctionPassManager &FPM,
                                   unsigned OptLevel, unsigned SizeLevel) {
-  FPM.add(createVerifierPass()); // Verify that input is correct
-
   PassManagerBuilder Builder;
   Builder.OptLevel = OptLevel;
   Builder.SizeLevel = SizeLevel;
@@ -240,7 +257,6 @@ static void AddOptimizationPasses(legacy::PassManagerBase &MPM,
   Builder.SLPVectorize =
       DisableSLPVectorization ? false : OptLevel > 1 && SizeLevel < 2;
 
-  Builder.populateFunctionPassManager(FPM);
   Builder.populateModulePassManager(MPM);
 }
 
@@ -287,6 +303,14 @@ static TargetMachine* GetTargetMachine(Triple TheTriple, StringRef CPUStr,
                                         GetCodeGenOptLevel());
 }
 
+static Pass *CreatePass(const PassInfo *PassInf, TargetMachine *TM) {
+  if (PassInf->getTargetMachineCtor())
+    return PassInf->getTargetMachineCtor()(TM);
+  if (PassInf->getNormalCtor())
+    return PassInf->getNormalCtor()();
+  return nullptr;
+}
+
 #ifdef LINK_POLLY_INTO_TOOLS
 namespace polly {
 void initializePollyPasses(llvm::PassRegistry &Registry);
@@ -445,7 +469,6 @@ int main(int argc, char **argv) {
   // The -disable-simplify-libcalls flag actually disables all builtin optzns.
   if (DisableSimplifyLibCalls)
     TLII.disableAllFunctions();
-  Passes.add(new TargetLibraryInfoWrapperPass(TLII));
 
   // Add an appropriate DataLayout instance for this module.
   const DataLayout &DL = M->getDataLayout();
@@ -453,10 +476,6 @@ int main(int argc, char **argv) {
     M->setDataLayout(DefaultDataLayout);
   }
 
-  // Add internal analysis passes from the target machine.
-  Passes.add(createTargetTransformInfoWrapperPass(TM ? TM->getTargetIRAnalysis()
-                                                     : TargetIRAnalysis()));
-
   std::unique_ptr<legacy::FunctionPassManager> FPasses;
   if (OptLevelO1 || OptLevelO2 || OptLevelOs || OptLevelOz || OptLevelO3) {
     FPasses.reset(new legacy::FunctionPassManager(M.get()));
@@ -482,112 +501,180 @@ int main(int argc, char **argv) {
     NoOutput = true;
   }
 
-  // Create a new optimization pass for each one specified on the command line
-  for (unsigned i = 0; i < PassList.size(); ++i) {
-    if (StandardLinkOpts &&
-        StandardLinkOpts.getPosition() < PassList.getPosition(i)) {
-      AddStandardLinkPasses(Passes);
-      StandardLinkOpts = false;
-    }
+  // The optimization levels whose function passes FPasses runs, so that each
+  // thread of -function-pass-threads can build the same pipeline.
+  std::vector<std::pair<unsigned, unsigned>> FunctionPassLevels;
+
+  // Adds the passes of the command line to PM, and the function passes that
+  // -O<n> runs before them to FPasses. It is called again on every thread of
+  // -function-pass-threads, ForThread, with a target machine of its own for
+  // TM and TIRA, and then adds the same passes to PM only.
+  auto AddPasses = [&](legacy::PassManagerBase &PM, TargetMachine *TM,
+                       TargetIRAnalysis TIRA, bool ForThread) {
+    PM.add(new TargetLibraryInfoWrapperPass(TLII));
+
+    // Add internal analysis passes from the target machine.
+    PM.add(createTargetTransformInfoWrapperPass(std::move(TIRA)));
+
+    bool AddStandardLinkOpts = StandardLinkOpts;
+    bool AddO1 = OptLevelO1, AddO2 = OptLevelO2, AddOs = OptLevelOs,
+         AddOz = OptLevelOz, AddO3 = OptLevelO3;
+    auto AddOptLevel = [&](unsigned OptLevel, unsigned SizeLevel) {
+      if (!ForThread) {
+        AddFunctionSimplificationPasses(*FPasses, OptLevel, SizeLevel);
+        FunctionPassLevels.push_back(std::make_pair(OptLevel, SizeLevel));
+      }
+      AddOptimizationPasses(PM, OptLevel, SizeLevel);
+    };
+
+    // Create a new optimization pass for each one specified on the command
+    // line
+    for (unsigned i = 0; i < PassList.size(); ++i) {
+      if (AddStandardLinkOpts &&
+          StandardLinkOpts.getPosition() < PassList.getPosition(i)) {
+        AddStandardLinkPasses(PM);
+        AddStandardLinkOpts = false;
+      }
 
-    if (OptLevelO1 && OptLevelO1.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, 1, 0);
-      OptLevelO1 = false;
-    }
+      if (AddO1 && OptLevelO1.getPosition() < PassList.getPosition(i)) {
+        AddOptLevel(1, 0);
+        AddO1 = false;
+      }
 
-    if (OptLevelO2 && OptLevelO2.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, 2, 0);
-      OptLevelO2 = false;
-    }
+      if (AddO2 && OptLevelO2.getPosition() < PassList.getPosition(i)) {
+        AddOptLevel(2, 0);
+        AddO2 = false;
+      }
 
-    if (OptLevelOs && OptLevelOs.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, 2, 1);
-      OptLevelOs = false;
-    }
+      if (AddOs && OptLevelOs.getPosition() < PassList.getPosition(i)) {
+        AddOptLevel(2, 1);
+        AddOs = false;
+      }
 
-    if (OptLevelOz && OptLevelOz.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, 2, 2);
-      OptLevelOz = false;
-    }
+      if (AddOz && OptLevelOz.getPosition() < PassList.getPosition(i)) {
+        AddOptLevel(2, 2);
+        AddOz = false;
+      }
 
-    if (OptLevelO3 && OptLevelO3.getPosition() < PassList.getPosition(i)) {
-      AddOptimizationPasses(Passes, *FPasses, 3, 0);
-      OptLevelO3 = false;
-    }
+      if (AddO3 && OptLevelO3.getPosition() < PassList.getPosition(i)) {
+        AddOptLevel(3, 0);
+        AddO3 = false;
+      }
 
-    const PassInfo *PassInf = PassList[i];
-    Pass *P = nullptr;
-    if (PassInf->getTargetMachineCtor())
-      P = PassInf->getTargetMachineCtor()(TM.get());
-    else if (PassInf->getNormalCtor())
-      P = PassInf->getNormalCtor()();
-    else
-      errs() << argv[0] << ": cannot create pass: "
-             << PassInf->getPassName() << "\n";
-    if (P) {
-      PassKind Kind = P->getPassKind();
-      addPass(Passes, P);
-
-      if (AnalyzeOnly) {
-        switch (Kind) {
-        case PT_BasicBlock:
-          Passes.add(createBasicBlockPassPrinter(PassInf, Out->os(), Quiet));
-          break;
-        case PT_Region:
-          Passes.add(createRegionPassPrinter(PassInf, Out->os(), Quiet));
-          break;
-        case PT_Loop:
-          Passes.add(createLoopPassPrinter(PassInf, Out->os(), Quiet));
-          break;
-        case PT_Function:
-          Passes.add(createFunctionPassPrinter(PassInf, Out->os(), Quiet));
-          break;
-        case PT_CallGraphSCC:
-          Passes.add(createCallGraphPassPrinter(PassInf, Out->os(), Quiet));
-          break;
-        default:
-          Passes.add(createModulePassPrinter(PassInf, Out->os(), Quiet));
-          break;
+      const PassInfo *PassInf = PassList[i];
+      Pass *P = CreatePass(PassInf, TM);
+      if (!P && !ForThread)
+        errs() << argv[0] << ": cannot create pass: "
+               << PassInf->getPassName() << "\n";
+      if (P) {
+        PassKind Kind = P->getPassKind();
+        addPass(PM, P);
+
+        if (AnalyzeOnly) {
+          switch (Kind) {
+          case PT_BasicBlock:
+            PM.add(createBasicBlockPassPrinter(PassInf, Out->os(), Quiet));
+            break;
+          case PT_Region:
+            PM.add(createRegionPassPrinter(PassInf, Out->os(), Quiet));
+            break;
+          case PT_Loop:
+            PM.add(createLoopPassPrinter(PassInf, Out->os(), Quiet));
+            break;
+          case PT_Function:
+            PM.add(createFunctionPassPrinter(PassInf, Out->os(), Quiet));
+            break;
+          case PT_CallGraphSCC:
+            PM.add(createCallGraphPassPrinter(PassInf, Out->os(), Quiet));
+            break;
+          default:
+            PM.add(createModulePassPrinter(PassInf, Out->os(), Quiet));
+            break;
+          }
         }
       }
-    }
-
-    if (PrintEachXForm)
-      Passes.add(
-          createPrintModulePass(errs(), "", PreserveAssemblyUseListOrder));
-  }
-
-  if (StandardLinkOpts) {
-    AddStandardLinkPasses(Passes);
-    StandardLinkOpts = false;
-  }
 
-  if (OptLevelO1)
-    AddOptimizationPasses(Passes, *FPasses, 1, 0);
-
-  if (OptLevelO2)
-    AddOptimizationPasses(Passes, *FPasses, 2, 0);
-
-  if (OptLevelOs)
-    AddOptimizationPasses(Passes, *FPasses, 2, 1);
-
-  if (OptLevelOz)
-    AddOptimizationPasses(Passes, *FPasses, 2, 2);
-
-  if (OptLevelO3)
-    AddOptimizationPasses(Passes, *FPasses, 3, 0);
+      if (PrintEachXForm)
+        PM.add(
+            createPrintModulePass(errs(), "", PreserveAssemblyUseListOrder));
+    }
 
-  if (OptLevelO1 || OptLevelO2 || OptLevelOs || OptLevelOz || OptLevelO3) {
-    FPasses->doInitialization();
-    for (Function &F : *M)
-      FPasses->run(F);
-    FPasses->doFinalization();
+    if (AddStandardLinkOpts)
+      AddStandardLinkPasses(PM);
+
+    if (AddO1)
+      AddOptLevel(1, 0);
+
+    if (AddO2)
+      AddOptLevel(2, 0);
+
+    if (AddOs)
+      AddOptLevel(2, 1);
+
+    if (AddOz)
+      AddOptLevel(2, 2);
+
+    if (AddO3)
+      AddOptLevel(3, 0);
+
+    // Check that the module is well formed on completion of optimization
+    if (!NoVerify && !VerifyEach)
+      PM.add(createVerifierPass());
+  };
+
+  AddPasses(Passes, TM.get(),
+            TM ? TM->getTargetIRAnalysis() : TargetIRAnalysis(),
+            /*ForThread=*/false);
+
+  // The function passes that run outside of call graph SCCs run on
+  // -function-pass-threads threads, unless their output is printed. Each
+  // thread gets its own target machine, as subtargets are created and cached
+  // lazily: the TTI pass keeps it alive.
+  if (FunctionPassThreads > 1 && !AnalyzeOnly && !PrintEachXForm &&
+      !PrintBreakpoints)
+    Passes.setFunctionPassThreads(
+        FunctionPassThreads,
+        [&](legacy::PassManagerBase &PM) {
+          std::shared_ptr<TargetMachine> ThreadTM;
+          if (ModuleTriple.getArch())
+            ThreadTM.reset(
+                GetTargetMachine(ModuleTriple, CPUStr, FeaturesStr, Options));
+          TargetIRAnalysis TIRA;
+          if (ThreadTM)
+            TIRA = TargetIRAnalysis([ThreadTM](const Function &F) {
+              return ThreadTM->getTargetIRAnalysis().run(F);
+            });
+          AddPasses(PM, ThreadTM.get(), std::move(TIRA), /*ForThread=*/true);
+        },
+        runFunctionPassesInParallel);
+
+  if (FPasses) {
+    if (FunctionPassThreads > 1) {
+      runFunctionPassesInParallel(
+          *M, FunctionPassThreads, [&](Module &Part, ArrayRef<Function *> Fs) {
+            std::unique_ptr<TargetMachine> ThreadTM;
+            if (ModuleTriple.getArch())
+              ThreadTM.reset(
+                  GetTargetMachine(ModuleTriple, CPUStr, FeaturesStr, Options));
+            legacy::FunctionPassManager FPM(&Part);
+            FPM.add(createTargetTransformInfoWrapperPass(
+                ThreadTM ? ThreadTM->getTargetIRAnalysis()
+                         : TargetIRAnalysis()));
+            for (auto &Level : FunctionPassLevels)
+              AddFunctionSimplificationPasses(FPM, Level.first, Level.second);
+            FPM.doInitialization();
+            for (Function *F : Fs)
+              FPM.run(*F);
+            FPM.doFinalization();
+          });
+    } else {
+      FPasses->doInitialization();
+      for (Function &F : *M)
+        FPasses->run(F);
+      FPasses->doFinalization();
+    }
   }
 
-  // Check that the module is well formed on completion of optimization
-  if (!NoVerify && !VerifyEach)
-    Passes.add(createVerifierPass());
-
   // In run twice mode, we want to make sure the output is bit-by-bit
   // equivalent if we run the pass manager again, so setup two buffers and
   // a stream to write to them. Note that llc does something similar and it
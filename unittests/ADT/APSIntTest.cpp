@@ -151,6 +151,26 @@ TEST(APSIntTest, FromString) {
   EXPECT_EQ(APSInt("-1234").getExtValue(), -1234);
 }
 
+TEST(APSIntTest, FromStringWidth) {
+  // Leading zeros take the numbers past 18 digits, which are parsed as APInts
+  // instead of integers, and have to give the same width and signedness.
+  for (const char *Str : {"0", "1", "255", "256", "-1", "-128", "-129", "-0",
+                        "123456789012345678", "-123456789012345678"}) {
+    bool Neg = Str[0] == '-';
+    std::string Long =
+        (Neg ? "-" : "") + std::string(20, '0') + std::string(Str + Neg);
+    APSInt Short(Str), Wide(Long);
+    EXPECT_EQ(Neg, Short.isSigned()) << Str;
+    EXPECT_EQ(Wide.isSigned(), Short.isSigned()) << Str;
+    EXPECT_EQ(APSInt::compareValues(Wide, Short), 0) << Str;
+    if (Wide.getBoolValue())
+      EXPECT_EQ(Wide.getBitWidth(), Short.getBitWidth()) << Str;
+  }
+  EXPECT_EQ(APSInt("255").getBitWidth(), 8u);
+  EXPECT_EQ(APSInt("-128").getBitWidth(), 8u);
+  EXPECT_EQ(APSInt("-129").getBitWidth(), 9u);
+}
+
 #if defined(GTEST_HAS_DEATH_TEST) && !defined(NDEBUG)
 
 TEST(APSIntTest, StringDeath) {
@@ -13,7 +13,10 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
 
 using namespace llvm;
@@ -152,4 +155,96 @@ TEST(AsmParserTest, TypeAndConstantValueWithSlotMappingParsing) {
   ASSERT_TRUE(isa<ConstantExpr>(V));
 }
 
+/// Generate NumFunctions function bodies in the style of unoptimized front
+/// end output: numbered values, blocks that are referenced before they are
+/// defined, and many keywords, types and constants. Function I has I % 7 + 1
+/// blocks, so that the number of values goes up and down between functions.
+static std::string generateFunctions(unsigned NumFunctions) {
+  std::string Source;
+  raw_string_ostream OS(Source);
+  OS << "%struct.S = type { i32, [4 x i8], double }\n"
+        "@g = global i32 0, align 4\n"
+        "declare i32 @ext(i32, double)\n";
+  for (unsigned I = 0; I != NumFunctions; ++I) {
+    unsigned NumBlocks = I % 7 + 1;
+    OS << "define internal i32 @f" << I
+       << "(i32 %a, %struct.S* nocapture %s) nounwind {\n"
+       << "entry:\n"
+       << "  %0 = alloca i32, align 4\n"
+       << "  store volatile i32 %a, i32* %0, align 4\n"
+       << "  br label %1\n";
+    unsigned N = 1;
+    for (unsigned B = 0; B != NumBlocks; ++B) {
+      OS << "; <label>:" << N << "\n";
+      OS << "  %" << N + 1 << " = load i32, i32* %0, align 4\n"
+         << "  %" << N + 2 << " = add nsw i32 %" << N + 1 << ", -" << B << "\n"
+         << "  %" << N + 3 << " = getelementptr inbounds %struct.S, "
+         << "%struct.S* %s, i64 0, i32 2\n"
+         << "  %" << N + 4 << " = sitofp i32 %" << N + 2 << " to double\n"
+         << "  %" << N + 5 << " = fmul fast double %" << N + 4
+         << ", 2.500000e-01\n"
+         << "  store double %" << N + 5 << ", double* %" << N + 3
+         << ", align 8\n"
+         << "  %" << N + 6 << " = icmp ult i32 %" << N + 2 << ", 4294967295\n"
+         << "  br i1 %" << N + 6 << ", label %" << N + 7 << ", label %"
+         << N + 7 << "\n";
+      N += 7;
+    }
+    OS << "; <label>:" << N << "\n"
+       << "  %" << N + 1 << " = call i32 @ext(i32 %" << N - 5
+       << ", double 0x7FF0000000000000)\n"
+       << "  ret i32 %" << N + 1 << "\n"
+       << "}\n\n";
+  }
+  return OS.str();
+}
+
+TEST(AsmParserTest, NumberedValuesAcrossFunctions) {
+  LLVMContext Ctx;
+  SMDiagnostic Error;
+  auto Mod = parseAssemblyString(generateFunctions(20), Error, Ctx);
+  ASSERT_TRUE(Mod != nullptr) << Error.getMessage().str();
+
+  for (unsigned I = 0; I != 20; ++I) {
+    Function *F = Mod->getFunction(("f" + Twine(I)).str());
+    ASSERT_TRUE(F != nullptr);
+    EXPECT_EQ(I % 7 + 3, F->size());
+    unsigned NumInsts = 0;
+    for (const BasicBlock &BB : *F)
+      NumInsts += BB.size();
+    EXPECT_EQ(3 + 8 * (I % 7 + 1) + 2, NumInsts);
+  }
+
+  // The numbered values of a function are not visible in the next one.
+  StringRef Source = "define i32 @f() {\n"
+                     "  %1 = add i32 1, 2\n"
+                     "  ret i32 %1\n"
+                     "}\n"
+                     "define i32 @g() {\n"
+                     "  ret i32 %1\n"
+                     "}\n";
+  EXPECT_FALSE(parseAssemblyString(Source, Error, Ctx));
+  EXPECT_EQ("use of undefined value '%1'", Error.getMessage());
+}
+
+/// A benchmark of the throughput of the parser, which is not run by default.
+/// Run it with --gtest_also_run_disabled_tests.
+TEST(AsmParserTest, DISABLED_ParseThroughput) {
+  std::string Source = generateFunctions(20000);
+  double Best = 0;
+  for (unsigned Run = 0; Run != 3; ++Run) {
+    LLVMContext Ctx;
+    SMDiagnostic Error;
+    TimeRecord Start = TimeRecord::getCurrentTime(true);
+    auto Mod = parseAssemblyString(Source, Error, Ctx);
+    TimeRecord End = TimeRecord::getCurrentTime(false);
+    ASSERT_TRUE(Mod != nullptr) << Error.getMessage().str();
+    double Seconds = End.getProcessTime() - Start.getProcessTime();
+    if (Run == 0 || Seconds < Best)
+      Best = Seconds;
+  }
+  outs() << format("parsed %.1f MB in %.3f s: %.1f MB/s\n",
+                   Source.size() / 1e6, Best, Source.size() / 1e6 / Best);
+}
+
 } // end anonymous namespace
@@ -21,6 +21,21 @@ class NullDataStreamer : public DataStreamer {
     return len;
   }
 };
+
+class BufferStreamer : public DataStreamer {
+  StringRef Buffer;
+
+public:
+  BufferStreamer(StringRef Buffer) : Buffer(Buffer) {}
+  size_t GetBytes(unsigned char *OutBuf, size_t Length) override {
+    if (Length >= Buffer.size())
+      Length = Buffer.size();
+
+    std::copy(Buffer.begin(), Buffer.begin() + Length, OutBuf);
+    Buffer = Buffer.drop_front(Length);
+    return Length;
+  }
+};
 }
 
 TEST(StreamingMemoryObject, Test) {
@@ -37,3 +52,13 @@ TEST(StreamingMemoryObject, TestSetKnownObjectSize) {
   O.setKnownObjectSize(24);
   EXPECT_EQ((uint64_t) 8, O.readBytes(Buf, 16, 16));
 }
+
+TEST(StreamingMemoryObject, getPointer) {
+  // Past the first chunk, so that getPointer has to fetch the bytes.
+  std::string Input(StreamingMemoryObject::kChunkSize * 2, 'a');
+  Input[StreamingMemoryObject::kChunkSize + 4] = 'b';
+  StreamingMemoryObject O(make_unique<BufferStreamer>(Input));
+  const uint8_t *P = O.getPointer(StreamingMemoryObject::kChunkSize + 3, 2);
+  EXPECT_EQ('a', P[0]);
+  EXPECT_EQ('b', P[1]);
+}
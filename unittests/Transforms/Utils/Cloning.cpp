@@ -11,6 +11,7 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/AsmParser/Parser.h"
 #include "llvm/IR/Argument.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/DIBuilder.h"
@@ -22,7 +23,10 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
 
 using namespace llvm;
@@ -447,4 +451,164 @@ TEST_F(CloneModule, Verify) {
   EXPECT_FALSE(verifyModule(*NewM));
 }
 
+TEST(CloneModuleIntoContext, Roundtrip) {
+  static const char *ModuleString = R"(
+    %node = type { %node*, i32 }
+    %opaque = type opaque
+    $c = comdat any
+    @g = global %node { %node* @g, i32 1 }, comdat($c), align 4
+    @str = private unnamed_addr constant [4 x i8] c"abc\00", align 1
+    @floats = constant <2 x float> <float 1.0, float 2.0>
+    @ext = external thread_local global %opaque
+    @a = alias %node, %node* @g
+    @addr = global i8* blockaddress(@f, %next)
+
+    declare void @llvm.dbg.value(metadata, i64, metadata, metadata)
+    declare i32 @__gxx_personality_v0(...)
+    declare void @use(i32)
+
+    define i32 @f(i32 %x) #0 !dbg !4 {
+    entry:
+      %y = add nsw i32 %x, 1, !custom !9
+      call void @llvm.dbg.value(metadata i32 %z, i64 0, metadata !7, metadata !DIExpression()), !dbg !8
+      br label %next
+    next:
+      %z = phi i32 [ %y, %entry ]
+      call void @use(i32 signext %z) [ "deopt"(i32 %z) ]
+      ret i32 %z, !dbg !8
+    }
+
+    define void @h() prefix i32 42 personality i32 (...)* @__gxx_personality_v0 {
+    entry:
+      invoke void @use(i32 0) to label %cont unwind label %lpad
+    cont:
+      ret void
+    lpad:
+      %lp = landingpad { i8*, i32 } cleanup
+      resume { i8*, i32 } %lp
+    }
+
+    define i32 @walk(%node* %n, %node %v) {
+    entry:
+      %next.addr = getelementptr inbounds %node, %node* %n, i32 0, i32 0
+      %next = load %node*, %node** %next.addr
+      %whole = load %node, %node* %next
+      store %node %v, %node* %n
+      %val = extractvalue %node %whole, 1
+      ret i32 %val
+    }
+
+    attributes #0 = { nounwind "target-cpu"="generic" }
+
+    !llvm.dbg.cu = !{!0}
+    !llvm.module.flags = !{!3}
+
+    !0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: true, runtimeVersion: 0, emissionKind: 1, subprograms: !2)
+    !1 = !DIFile(filename: "f.c", directory: "/tmp")
+    !2 = !{!4}
+    !3 = !{i32 2, !"Debug Info Version", i32 3}
+    !4 = distinct !DISubprogram(name: "f", scope: !1, file: !1, line: 1, type: !5, isLocal: false, isDefinition: true, scopeLine: 1, isOptimized: true)
+    !5 = !DISubroutineType(types: !6)
+    !6 = !{null}
+    !7 = !DILocalVariable(name: "z", scope: !4, file: !1, line: 2, type: null)
+    !8 = !DILocation(line: 2, column: 3, scope: !4)
+    !9 = !{!"custom", i32 7}
+  )";
+
+  auto OldC = llvm::make_unique<LLVMContext>();
+  SMDiagnostic Err;
+  std::unique_ptr<Module> OldM = parseAssemblyString(ModuleString, Err, *OldC);
+  ASSERT_TRUE(OldM != nullptr);
+
+  // Give the custom metadata kind a different ID in the new context.
+  LLVMContext NewC;
+  NewC.getMDKindID("another.kind");
+  std::unique_ptr<Module> NewM = CloneModuleIntoContext(OldM.get(), NewC);
+  EXPECT_EQ(&NewC, &NewM->getContext());
+
+  std::string OldIR, NewIR;
+  raw_string_ostream OldOS(OldIR), NewOS(NewIR);
+  OldM->print(OldOS, nullptr);
+  OldOS.flush();
+
+  // The clone must not depend on anything in the old context.
+  OldM.reset();
+  OldC.reset();
+
+  EXPECT_FALSE(verifyModule(*NewM, &errs()));
+  NewM->print(NewOS, nullptr);
+  NewOS.flush();
+  EXPECT_EQ(OldIR, NewIR);
+}
+
+TEST(CopyFunctionBodiesFromContext, Roundtrip) {
+  static const char *ModuleString = R"(
+    %pair = type { i32, i32 }
+    @g = internal global %pair { i32 1, i32 2 }
+
+    define internal i32 @get(i32 %i) {
+      %p = getelementptr %pair, %pair* @g, i32 0, i32 1
+      %v = load i32, i32* %p, !tbaa !0
+      %r = add i32 %v, %i
+      ret i32 %r
+    }
+
+    define i32 @other() {
+      %r = call i32 @get(i32 0)
+      ret i32 %r
+    }
+
+    !0 = !{!1, !1, i64 0}
+    !1 = !{!"int", !2}
+    !2 = !{!"tbaa root"}
+  )";
+
+  LLVMContext C;
+  SMDiagnostic Err;
+  std::unique_ptr<Module> M = parseAssemblyString(ModuleString, Err, C);
+  ASSERT_TRUE(M != nullptr);
+  Function *Get = M->getFunction("get");
+  Function *Other = M->getFunction("other");
+
+  LLVMContext NewC;
+  ValueToValueMapTy VMap;
+  std::unique_ptr<Module> NewM = CloneModuleIntoContext(
+      M.get(), NewC, VMap,
+      [&](const GlobalValue *GV) { return GV != Other; });
+  EXPECT_TRUE(NewM->getFunction("other")->isDeclaration());
+  EXPECT_FALSE(verifyModule(*NewM, &errs()));
+
+  // Rewrite the clone of @get to call a new function, which the copy has to
+  // declare in the original module.
+  Function *NewGet = cast<Function>(VMap[Get]);
+  Instruction *Add = &*std::next(NewGet->getEntryBlock().begin(), 2);
+  Function *Hook = Function::Create(
+      FunctionType::get(Type::getInt32Ty(NewC), {Type::getInt32Ty(NewC)},
+                        false),
+      GlobalValue::ExternalLinkage, "hook", NewM.get());
+  Instruction *Call = CallInst::Create(Hook, {Add}, "h");
+  Call->insertAfter(Add);
+  NewGet->getEntryBlock().getTerminator()->setOperand(0, Call);
+
+  CopyFunctionBodiesFromContext(*M, {Get}, VMap);
+  VMap.clear();
+  NewM.reset();
+
+  EXPECT_FALSE(verifyModule(*M, &errs()));
+  Function *NewHook = M->getFunction("hook");
+  ASSERT_TRUE(NewHook != nullptr);
+  EXPECT_TRUE(NewHook->isDeclaration());
+
+  BasicBlock &Entry = Get->getEntryBlock();
+  EXPECT_EQ(5u, Entry.size());
+  auto *Load = cast<LoadInst>(&*std::next(Entry.begin()));
+  EXPECT_EQ(M->getNamedGlobal("g"),
+            cast<GEPOperator>(Load->getPointerOperand())->getPointerOperand());
+  EXPECT_TRUE(Load->getMetadata(LLVMContext::MD_tbaa) != nullptr);
+  auto *NewCall = cast<CallInst>(Entry.getTerminator()->getOperand(0));
+  EXPECT_EQ(NewHook, NewCall->getCalledFunction());
+  auto *NewAdd = cast<BinaryOperator>(NewCall->getArgOperand(0));
+  EXPECT_EQ(&*Get->arg_begin(), NewAdd->getOperand(1));
+}
+
 }
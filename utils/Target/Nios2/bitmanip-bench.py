@@ -0,0 +1,167 @@
+#!/usr/bin/env python
+"""Nios2 bit manipulation lowering microbenchmark.
+
+Compiles small kernels built around rotates, bswap, ctz, clz and popcount
+with llc, once with the Nios2 lowerings and once with
+-disable-nios2-bitmanip-lowering, and reports the static instruction count
+of each function side by side. Calls to runtime helpers are listed, since a
+"call __mulsi3" is one instruction but far from free:
+
+  bitmanip-bench.py --llc build/bin/llc
+  bitmanip-bench.py --llc build/bin/llc --mattr=-hw-mul
+  bitmanip-bench.py --llc build/bin/llc --llc-arg=-nios2-custom-ctz=3
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+
+KERNELS = [
+  ("rotl_imm", """
+  %l = shl i32 %a, 7
+  %r = lshr i32 %a, 25
+  %x = or i32 %l, %r
+  ret i32 %x"""),
+  ("rotr_imm", """
+  %r = lshr i32 %a, 13
+  %l = shl i32 %a, 19
+  %x = or i32 %l, %r
+  ret i32 %x"""),
+  ("rotl_var", """
+  %n = and i32 %b, 31
+  %m = sub i32 32, %n
+  %l = shl i32 %a, %n
+  %r = lshr i32 %a, %m
+  %x = or i32 %l, %r
+  ret i32 %x"""),
+  ("bswap", """
+  %x = call i32 @llvm.bswap.i32(i32 %a)
+  ret i32 %x"""),
+  ("bswap16", """
+  %t = trunc i32 %a to i16
+  %s = call i16 @llvm.bswap.i16(i16 %t)
+  %x = zext i16 %s to i32
+  ret i32 %x"""),
+  ("cttz", """
+  %x = call i32 @llvm.cttz.i32(i32 %a, i1 false)
+  ret i32 %x"""),
+  ("cttz_undef", """
+  %x = call i32 @llvm.cttz.i32(i32 %a, i1 true)
+  ret i32 %x"""),
+  ("ctlz", """
+  %x = call i32 @llvm.ctlz.i32(i32 %a, i1 false)
+  ret i32 %x"""),
+  ("ctlz_undef", """
+  %x = call i32 @llvm.ctlz.i32(i32 %a, i1 true)
+  ret i32 %x"""),
+  ("ctpop", """
+  %x = call i32 @llvm.ctpop.i32(i32 %a)
+  ret i32 %x"""),
+  ("log2_floor", """
+  %z = call i32 @llvm.ctlz.i32(i32 %a, i1 true)
+  %x = sub i32 31, %z
+  ret i32 %x"""),
+  ("hash_mix", """
+  %m = mul i32 %a, -1640531535
+  %l = shl i32 %m, 15
+  %r = lshr i32 %m, 17
+  %o = or i32 %l, %r
+  %x = xor i32 %o, %b
+  ret i32 %x"""),
+]
+
+DECLS = """
+declare i16 @llvm.bswap.i16(i16)
+declare i32 @llvm.bswap.i32(i32)
+declare i32 @llvm.cttz.i32(i32, i1)
+declare i32 @llvm.ctlz.i32(i32, i1)
+declare i32 @llvm.ctpop.i32(i32)
+"""
+
+
+def gen_module(path):
+  with open(path, "w") as out:
+    out.write('target triple = "nios2"\n')
+    out.write(DECLS)
+    for name, body in KERNELS:
+      out.write("\ndefine i32 @%s(i32 %%a, i32 %%b) {\nentry:%s\n}\n" %
+                (name, body))
+
+
+def count_instructions(asm):
+  """Map each function to (instruction count, list of called symbols)."""
+  result = {}
+  func = None
+  for line in asm.splitlines():
+    m = re.match(r"^([A-Za-z_][\w.]*):", line)
+    if m and not m.group(1).startswith(".L"):
+      func = m.group(1)
+      result[func] = [0, []]
+      continue
+    if func is None:
+      continue
+    text = line.split("#")[0].strip()
+    if not text or text.endswith(":"):
+      continue
+    if text.startswith("."):
+      if text.startswith(".Lfunc_end") or text.startswith(".size"):
+        func = None
+      continue
+    result[func][0] += 1
+    m = re.match(r"^call\s+(\S+)", text)
+    if m:
+      result[func][1].append(m.group(1))
+  return result
+
+
+def run_llc(llc, ir, args):
+  cmd = [llc, "-O2", "-o", "-", ir] + args
+  return count_instructions(subprocess.check_output(cmd).decode())
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+      formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("--llc", default="llc", help="llc binary to run")
+  parser.add_argument("--mattr", default="",
+                      help="target features, e.g. -hw-mul for no multiplier")
+  parser.add_argument("--llc-arg", action="append", default=[],
+                      help="extra llc argument for the new lowering")
+  parser.add_argument("--keep", action="store_true",
+                      help="keep the generated files")
+  args = parser.parse_args()
+
+  tmpdir = tempfile.mkdtemp(prefix="nios2-bitmanip-bench-")
+  ir = os.path.join(tmpdir, "bitmanip.ll")
+  gen_module(ir)
+
+  common = ["-mattr=" + args.mattr] if args.mattr else []
+  old = run_llc(args.llc, ir, common + ["-disable-nios2-bitmanip-lowering"])
+  new = run_llc(args.llc, ir, common + args.llc_arg)
+
+  print("%-12s %8s %8s  %s" % ("function", "generic", "nios2", "calls"))
+  total_old = total_new = 0
+  for name, _ in KERNELS:
+    o, n = old[name], new[name]
+    total_old += o[0]
+    total_new += n[0]
+    calls = " ".join(sorted(set(o[1]))) or "-"
+    if n[1]:
+      calls += " -> " + " ".join(sorted(set(n[1])))
+    print("%-12s %8d %8d  %s" % (name, o[0], n[0], calls))
+  print("%-12s %8d %8d" % ("total", total_old, total_new))
+
+  if args.keep:
+    print("files kept in %s" % tmpdir)
+  else:
+    os.remove(ir)
+    os.rmdir(tmpdir)
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
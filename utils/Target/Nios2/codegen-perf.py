@@ -0,0 +1,161 @@
+#!/usr/bin/env python
+"""Nios2 codegen performance regression harness.
+
+Compiles each kernel with llc for Nios2 and measures, per function, the
+static instruction count and the cycle estimate that the Nios2 asm printer
+computes from the scheduling model (-nios2-print-cycles). The numbers are
+compared against the baseline lines recorded in the kernel itself:
+
+  ; BASELINE: <function> <instructions> <cycles>
+
+and the run fails if either metric of any function grows by more than the
+threshold. Extra llc flags for a kernel go on "; LLC-ARGS:" lines.
+
+The kernels live in test/CodeGen/Nios2/perf and run as part of check-llvm.
+After an intended change in the generated code, refresh the baselines with
+
+  codegen-perf.py --llc build/bin/llc --update test/CodeGen/Nios2/perf/*.ll
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+
+
+BASELINE_RE = re.compile(r"^;\s*BASELINE:\s*(\S+)\s+(\d+)\s+(\d+)\s*$")
+LLC_ARGS_RE = re.compile(r"^;\s*LLC-ARGS:(.*)$")
+CYCLES_RE = re.compile(r"^\s*#\s*static cycles:\s*(\d+)")
+TYPE_RE = re.compile(r"^\s*\.type\s+([^,\s]+)\s*,\s*@function")
+LABEL_RE = re.compile(r"^([A-Za-z_$][\w.$]*):")
+
+
+def read_kernel(path):
+  """Return the baseline of each function and the extra llc arguments."""
+  baseline = {}
+  llc_args = []
+  with open(path) as f:
+    for line in f:
+      m = BASELINE_RE.match(line)
+      if m:
+        baseline[m.group(1)] = (int(m.group(2)), int(m.group(3)))
+        continue
+      m = LLC_ARGS_RE.match(line)
+      if m:
+        llc_args += m.group(1).split()
+  return baseline, llc_args
+
+
+def measure(asm):
+  """Map each function in asm to (instructions, cycles)."""
+  functions = set()
+  counts = {}
+  cycles = {}
+  current = None
+  for line in asm.splitlines():
+    m = TYPE_RE.match(line)
+    if m:
+      functions.add(m.group(1))
+      continue
+    m = LABEL_RE.match(line)
+    if m:
+      # Nios2 block labels have no private prefix, so only the label of a
+      # function starts a new one.
+      if m.group(1) in functions:
+        current = m.group(1)
+        counts[current] = 0
+      continue
+    if current is None:
+      continue
+    m = CYCLES_RE.match(line)
+    if m:
+      cycles[current] = int(m.group(1))
+      current = None
+      continue
+    text = line.split("#")[0].strip()
+    if not text or text.startswith(".") or text.endswith(":"):
+      continue
+    counts[current] += 1
+  return dict((f, (counts[f], cycles.get(f, 0))) for f in counts)
+
+
+def run_llc(llc, path, args):
+  cmd = [llc, "-O2", "-nios2-print-cycles", "-o", "-", path] + args
+  return measure(subprocess.check_output(cmd).decode())
+
+
+def write_baseline(path, results):
+  with open(path) as f:
+    lines = [l for l in f if not BASELINE_RE.match(l)]
+  while lines and not lines[-1].strip():
+    lines.pop()
+  lines.append("\n")
+  for func in sorted(results):
+    insts, cycles = results[func]
+    lines.append("; BASELINE: %s %d %d\n" % (func, insts, cycles))
+  with open(path, "w") as f:
+    f.writelines(lines)
+
+
+def exceeds(new, old, threshold):
+  return new > old * (1.0 + threshold / 100.0)
+
+
+def check_kernel(path, args):
+  baseline, llc_args = read_kernel(path)
+  results = run_llc(args.llc, path, llc_args + args.llc_arg)
+
+  if args.update:
+    write_baseline(path, results)
+    print("%s: recorded %d functions" % (path, len(results)))
+    return True
+
+  ok = True
+  for func in sorted(results):
+    insts, cycles = results[func]
+    if func not in baseline:
+      print("%s: %s: no baseline (%d instructions, %d cycles)" %
+            (path, func, insts, cycles))
+      ok = False
+      continue
+    old_insts, old_cycles = baseline[func]
+    status = "ok"
+    if (exceeds(insts, old_insts, args.threshold) or
+        exceeds(cycles, old_cycles, args.threshold)):
+      status = "REGRESSION"
+      ok = False
+    elif insts < old_insts or cycles < old_cycles:
+      status = "improved, run with --update"
+    if args.verbose or status != "ok":
+      print("%s: %-24s instructions %4d -> %4d  cycles %5d -> %5d  %s" %
+            (path, func, old_insts, insts, old_cycles, cycles, status))
+
+  for func in sorted(set(baseline) - set(results)):
+    print("%s: %s: in the baseline but not generated" % (path, func))
+    ok = False
+  return ok
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+      formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("kernels", nargs="+", help="IR files to compile")
+  parser.add_argument("--llc", default="llc", help="llc binary to run")
+  parser.add_argument("--threshold", type=float, default=2.0,
+                      help="allowed growth of either metric, in percent")
+  parser.add_argument("--llc-arg", action="append", default=[],
+                      help="extra llc argument for every kernel")
+  parser.add_argument("--update", action="store_true",
+                      help="rewrite the baselines with the current numbers")
+  parser.add_argument("-v", "--verbose", action="store_true",
+                      help="print every function, not only the changes")
+  args = parser.parse_args()
+
+  ok = True
+  for path in args.kernels:
+    ok &= check_kernel(path, args)
+  return 0 if ok else 1
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,105 @@
+#!/usr/bin/env python
+"""Nios2 object emission throughput benchmark.
+
+Generates a large Nios2 module and measures how fast it is turned into an ELF
+object. The Nios2 target has no assembly parser, so instead of feeding a .s
+file to llvm-mc this drives the same MC object streamer through llc at -O0,
+and subtracts an identical run with -filetype=null so that only the cost of
+encoding, fixups and the ELF writer is reported:
+
+  obj-emission-bench.py --llc build/bin/llc --functions 4000 --repeat 5
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def gen_function(out, i):
+  # A mix of the instructions -O0 code is made of: stack traffic, global
+  # %hiadj/%lo accesses, branches and calls, each needing a fixup or not.
+  out.write("define i32 @f%d(i32 %%a, i32 %%b) {\n" % i)
+  out.write("entry:\n")
+  out.write("  %%g = load i32, i32* @g%d\n" % (i % 64))
+  out.write("  %x = add i32 %a, %g\n")
+  out.write("  %c = icmp slt i32 %x, %b\n")
+  out.write("  br i1 %c, label %then, label %else\n")
+  out.write("then:\n")
+  out.write("  %y = mul i32 %x, %b\n")
+  out.write("  store i32 %%y, i32* @g%d\n" % ((i + 1) % 64))
+  out.write("  br label %exit\n")
+  out.write("else:\n")
+  if i:
+    out.write("  %%z = call i32 @f%d(i32 %%b, i32 %%x)\n" % (i - 1))
+  else:
+    out.write("  %z = sub i32 %b, %x\n")
+  out.write("  br label %exit\n")
+  out.write("exit:\n")
+  out.write("  %r = phi i32 [ %y, %then ], [ %z, %else ]\n")
+  out.write("  ret i32 %r\n")
+  out.write("}\n\n")
+
+
+def gen_module(path, functions):
+  with open(path, "w") as out:
+    out.write('target triple = "nios2"\n\n')
+    for i in range(64):
+      out.write("@g%d = global i32 %d\n" % (i, i))
+    out.write("\n")
+    for i in range(functions):
+      gen_function(out, i)
+
+
+def time_llc(llc, ir, filetype, output, repeat):
+  best = None
+  for _ in range(repeat):
+    start = time.time()
+    subprocess.check_call([llc, "-O0", "-filetype=" + filetype,
+                           "-o", output, ir])
+    elapsed = time.time() - start
+    best = elapsed if best is None else min(best, elapsed)
+  return best
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+      formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("--llc", default="llc", help="llc binary to run")
+  parser.add_argument("--functions", type=int, default=4000,
+                      help="number of functions in the generated module")
+  parser.add_argument("--repeat", type=int, default=3,
+                      help="runs per mode; the fastest one is reported")
+  parser.add_argument("--keep", action="store_true",
+                      help="keep the generated files")
+  args = parser.parse_args()
+
+  tmpdir = tempfile.mkdtemp(prefix="nios2-obj-bench-")
+  ir = os.path.join(tmpdir, "bench.ll")
+  obj = os.path.join(tmpdir, "bench.o")
+  gen_module(ir, args.functions)
+
+  t_null = time_llc(args.llc, ir, "null", os.devnull, args.repeat)
+  t_obj = time_llc(args.llc, ir, "obj", obj, args.repeat)
+  size = os.path.getsize(obj)
+  emit = max(t_obj - t_null, 1e-9)
+
+  print("functions:        %d" % args.functions)
+  print("object size:      %d bytes" % size)
+  print("llc -filetype=null %.3fs" % t_null)
+  print("llc -filetype=obj  %.3fs" % t_obj)
+  print("object emission:   %.3fs (%.1f MB/s)" % (emit, size / emit / 1e6))
+
+  if args.keep:
+    print("files kept in %s" % tmpdir)
+  else:
+    os.remove(ir)
+    os.remove(obj)
+    os.rmdir(tmpdir)
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
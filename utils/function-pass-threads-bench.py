@@ -0,0 +1,133 @@
+#!/usr/bin/env python
+"""opt -function-pass-threads scaling benchmark.
+
+Generates a large module of independent functions, each with a few loops,
+struct accesses and calls, and times opt on it at several thread counts,
+once at -O2, where the function passes that are not part of the call graph
+SCC pipeline use the threads, and once with a pipeline made only of function
+passes, which runs entirely on the threads:
+
+  function-pass-threads-bench.py --opt build/bin/opt
+  function-pass-threads-bench.py --opt build/bin/opt --functions 4000 -j 1,4
+
+The textual output of every run is compared with the one of the first thread
+count, and the benchmark fails if they differ. The bitcode is not compared,
+as the order of the entries of its symbol tables may change.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+
+FUNCTION_PASSES = ["-sroa", "-early-cse", "-instcombine", "-simplifycfg",
+                   "-reassociate", "-gvn", "-licm", "-loop-rotate",
+                   "-indvars", "-dse", "-adce"]
+
+HEADER = """%pair = type { i32, i32 }
+@table = global [64 x %pair] zeroinitializer
+declare i32 @printf(i8*, ...)
+@fmt = private unnamed_addr constant [4 x i8] c"%d\\0A\\00"
+"""
+
+BODY = """
+define i32 @f%(n)d(i32 %%n, i32 %%k) {
+entry:
+  %%buf = alloca [16 x i32]
+  %%acc = alloca i32
+  store i32 %(n)d, i32* %%acc
+  br label %%loop
+loop:
+  %%i = phi i32 [ 0, %%entry ], [ %%i.next, %%latch ]
+  %%idx = and i32 %%i, 63
+  %%p = getelementptr [64 x %%pair], [64 x %%pair]* @table, i32 0, i32 %%idx, i32 1
+  %%v = load i32, i32* %%p
+  %%m = mul i32 %%v, %%k
+  %%s = add i32 %%m, %(n)d
+  %%slot = and i32 %%i, 15
+  %%b = getelementptr [16 x i32], [16 x i32]* %%buf, i32 0, i32 %%slot
+  store i32 %%s, i32* %%b
+  %%a = load i32, i32* %%acc
+  %%a2 = add i32 %%a, %%s
+  store i32 %%a2, i32* %%acc
+  %%odd = icmp eq i32 %%slot, 7
+  br i1 %%odd, label %%print, label %%latch
+print:
+  %%r = call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @fmt, i32 0, i32 0), i32 %%a2)
+  br label %%latch
+latch:
+  %%i.next = add i32 %%i, 1
+  %%c = icmp slt i32 %%i.next, %%n
+  br i1 %%c, label %%loop, label %%exit
+exit:
+  %%res = load i32, i32* %%acc
+  %%prev = call i32 @f%(prev)d(i32 %%res, i32 %%k)
+  %%sum = add i32 %%res, %%prev
+  ret i32 %%sum
+}
+"""
+
+
+def gen_module(path, functions):
+  with open(path, "w") as out:
+    out.write(HEADER)
+    for n in range(functions):
+      out.write(BODY % {"n": n, "prev": (n + functions - 1) % functions})
+
+
+def run_opt(opt, ir, args, out):
+  start = time.time()
+  subprocess.check_call([opt, "-S", "-o", out, ir] + args)
+  return time.time() - start
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+      formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("--opt", default="opt", help="opt binary to run")
+  parser.add_argument("--functions", type=int, default=2000,
+                      help="number of functions in the generated module")
+  parser.add_argument("-j", "--threads", default="1,2,4,8",
+                      help="comma separated thread counts to time")
+  parser.add_argument("--keep", action="store_true",
+                      help="keep the generated files")
+  args = parser.parse_args()
+
+  threads = [int(t) for t in args.threads.split(",")]
+  tmpdir = tempfile.mkdtemp(prefix="function-pass-threads-bench-")
+  ir = os.path.join(tmpdir, "input.ll")
+  gen_module(ir, args.functions)
+
+  ok = True
+  print("%-16s %8s %8s %8s" % ("pipeline", "threads", "seconds", "speedup"))
+  for name, pipeline in [("-O2", ["-O2"]), ("function passes",
+                                            FUNCTION_PASSES)]:
+    base_time = None
+    base_out = None
+    for t in threads:
+      out = os.path.join(tmpdir, "%s-%d.ll" % (pipeline[0].strip("-"), t))
+      secs = run_opt(args.opt, ir,
+                     pipeline + ["-function-pass-threads=%d" % t], out)
+      if base_time is None:
+        base_time, base_out = secs, out
+      else:
+        with open(base_out, "rb") as a, open(out, "rb") as b:
+          if a.read() != b.read():
+            print("%s: output with %d threads differs" % (name, t))
+            ok = False
+      print("%-16s %8d %8.2f %7.2fx" % (name, t, secs, base_time / secs))
+
+  if args.keep:
+    print("files kept in %s" % tmpdir)
+  else:
+    for f in os.listdir(tmpdir):
+      os.remove(os.path.join(tmpdir, f))
+    os.rmdir(tmpdir)
+  return 0 if ok else 1
+
+
+if __name__ == "__main__":
+  sys.exit(main())